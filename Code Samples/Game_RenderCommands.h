@@ -0,0 +1,201 @@
+#if !defined(GAME_RENDER_COMMANDS_H)
+#define GAME_RENDER_COMMANDS_H
+
+// Note: Render commands, from the game to the platform.
+// Instead of drawing straight into game_offscreen_buffer, the game can push compact commands into a push buffer, each
+// with a 64 bit sort key. After GameUpdateAndRender the platform radix sorts the keys, cuts the sorted commands into
+// batches of the same layer, pipeline and texture, and hands the batches to whichever backend draws the frame: the
+// Vulkan renderer or a software rasterizer into the back buffer (Win32_RenderCommands.cpp).
+// The push buffer is the last RENDER_COMMANDS_SIZE bytes of the transient storage. The platform takes them off
+// TransientStorageSize, so they never overlap what the game does with the rest, and resets the buffer before every
+// GameUpdateAndRender. GetRenderCommands finds it. The header is always there while the game runs (the platform
+// doesn't run the game without it), but if the storage had no room for the buffer its Size is 0 and every push is
+// dropped; HasRenderCommands tells the game whether pushing does anything.
+// Entries go up from the start of the buffer and their sort entries come down from the end, so there's no fixed
+// count of either, only the two meeting. A push that doesn't fit is dropped (and counted).
+// Positions are the center of the quad, in the units of the renderer's sprites. The software backend shows -1..1 in
+// X and Y (Y up) across the back buffer.
+
+#define RENDER_COMMANDS_SIZE            Megabytes(4)
+
+// Note: The key, most significant bits first. The layer decides what goes on top of what. Within a layer the commands
+// are grouped by pipeline and texture before depth, so overlapping commands in one layer with different textures
+// have no set order between them. The same key keeps the order the commands were pushed in.
+#define RENDER_SORT_LAYER_SHIFT         56  // Note: 8 bits.
+#define RENDER_SORT_PIPELINE_SHIFT      52  // Note: 4 bits.
+#define RENDER_SORT_TEXTURE_SHIFT       32  // Note: 20 bits.
+#define RENDER_SORT_TEXTURE_MASK        0xFFFFF
+#define RENDER_SORT_MATERIAL_SHIFT      RENDER_SORT_TEXTURE_SHIFT  // Note: What's above depth, the part a batch shares.
+
+enum render_pipeline
+{
+    RenderPipeline_Clear,
+    RenderPipeline_Rectangle,
+    RenderPipeline_Sprite,
+
+    RenderPipeline_Count,
+};
+
+// Note: Lives in the game's memory for as long as any command uses it.
+struct render_texture
+{
+    uint32* Pixels;         // Note: RGBA8 (R in the low byte), tightly packed, top row first.
+    uint32 Width;
+    uint32 Height;
+    uint32 SortIndex;       // Note: Unique per texture, up to RENDER_SORT_TEXTURE_MASK.
+    uint32 RendererHandle;  // Note: The platform's, 0 until the renderer has seen the texture.
+};
+
+struct render_entry_header
+{
+    uint32 Type;            // Note: render_pipeline.
+};
+
+struct render_entry_clear
+{
+    render_entry_header Header;
+    uint32 Color;           // Note: RGBA8, like all the colors here.
+};
+
+struct render_entry_rectangle
+{
+    render_entry_header Header;
+    real32 X, Y, Z;
+    real32 Width, Height;
+    uint32 Color;
+};
+
+struct render_entry_sprite
+{
+    render_entry_header Header;
+    real32 X, Y, Z;
+    real32 Width, Height;
+    real32 UVRect[4];       // Note: Min UV, max UV, in the texture. The min V is the top of the sprite.
+    uint32 Tint;
+    render_texture* Texture;
+};
+
+struct render_sort_entry
+{
+    uint64 Key;
+    uint32 Offset;          // Note: Of the entry, from Base.
+    uint32 Reserved;
+};
+
+struct game_render_commands
+{
+    uint8* Base;
+    uint32 Size;
+    uint32 PushUsed;        // Note: Entries, from Base up.
+    uint32 SortEntryAt;     // Note: Sort entries, from here up to Size, the last one pushed first.
+    uint32 EntryCount;
+    uint32 DroppedCount;
+};
+
+inline game_render_commands*
+GetRenderCommands(game_memory* Memory)
+{
+    game_render_commands* Result = (game_render_commands*)((uint8*)Memory->TransientStorage + Memory->TransientStorageSize);
+    return(Result);
+}
+
+inline bool32
+HasRenderCommands(game_render_commands* Commands)
+{
+    bool32 Result = (Commands && Commands->Size > 0);
+    return(Result);
+}
+
+// Note: Depth sorts ascending, so the smallest goes first (underneath). The float's bits are flipped so that they
+// compare as unsigned in the same order as the floats do.
+inline uint64
+RenderSortKey(uint32 Layer, render_pipeline Pipeline, uint32 TextureIndex, real32 Depth)
+{
+    union { real32 Float; uint32 Bits; } Convert;
+    Convert.Float = Depth;
+    uint32 DepthBits = (Convert.Bits & 0x80000000) ? ~Convert.Bits : (Convert.Bits | 0x80000000);
+
+    uint64 Result = ((uint64)(Layer & 0xFF) << RENDER_SORT_LAYER_SHIFT) |
+                    ((uint64)(Pipeline & 0xF) << RENDER_SORT_PIPELINE_SHIFT) |
+                    ((uint64)(TextureIndex & RENDER_SORT_TEXTURE_MASK) << RENDER_SORT_TEXTURE_SHIFT) |
+                    DepthBits;
+    return(Result);
+}
+
+inline void*
+PushRenderEntry(game_render_commands* Commands, uint32 Size, render_pipeline Type, uint64 Key)
+{
+    void* Result = 0;
+    Size = (Size + 7) & ~7;     // Note: Keeps the texture pointers aligned.
+    if (Commands->PushUsed + Size + sizeof(render_sort_entry) <= Commands->SortEntryAt)
+    {
+        render_entry_header* Header = (render_entry_header*)(Commands->Base + Commands->PushUsed);
+        Header->Type = Type;
+
+        Commands->SortEntryAt -= sizeof(render_sort_entry);
+        render_sort_entry* SortEntry = (render_sort_entry*)(Commands->Base + Commands->SortEntryAt);
+        SortEntry->Key = Key;
+        SortEntry->Offset = Commands->PushUsed;
+
+        Commands->PushUsed += Size;
+        ++Commands->EntryCount;
+        Result = Header;
+    }
+    else
+    {
+        ++Commands->DroppedCount;
+    }
+    return(Result);
+}
+
+// Note: The whole frame, underneath everything else in layer 0.
+inline void
+PushClear(game_render_commands* Commands, uint32 Color)
+{
+    render_entry_clear* Entry = (render_entry_clear*)PushRenderEntry(Commands, sizeof(render_entry_clear), RenderPipeline_Clear, 0);
+    if (Entry)
+    {
+        Entry->Color = Color;
+    }
+}
+
+inline void
+PushRectangle(game_render_commands* Commands, uint32 Layer, real32 X, real32 Y, real32 Z, real32 Width, real32 Height, uint32 Color)
+{
+    uint64 Key = RenderSortKey(Layer, RenderPipeline_Rectangle, 0, Z);
+    render_entry_rectangle* Entry = (render_entry_rectangle*)PushRenderEntry(Commands, sizeof(render_entry_rectangle), RenderPipeline_Rectangle, Key);
+    if (Entry)
+    {
+        Entry->X = X;
+        Entry->Y = Y;
+        Entry->Z = Z;
+        Entry->Width = Width;
+        Entry->Height = Height;
+        Entry->Color = Color;
+    }
+}
+
+// Note: UVRect is min U, min V, max U, max V. A Tint of 0xFFFFFFFF leaves the texture as it is.
+inline void
+PushSprite(game_render_commands* Commands, uint32 Layer, render_texture* Texture, real32 X, real32 Y, real32 Z,
+           real32 Width, real32 Height, real32* UVRect, uint32 Tint)
+{
+    uint64 Key = RenderSortKey(Layer, RenderPipeline_Sprite, Texture->SortIndex, Z);
+    render_entry_sprite* Entry = (render_entry_sprite*)PushRenderEntry(Commands, sizeof(render_entry_sprite), RenderPipeline_Sprite, Key);
+    if (Entry)
+    {
+        Entry->X = X;
+        Entry->Y = Y;
+        Entry->Z = Z;
+        Entry->Width = Width;
+        Entry->Height = Height;
+        Entry->UVRect[0] = UVRect[0];
+        Entry->UVRect[1] = UVRect[1];
+        Entry->UVRect[2] = UVRect[2];
+        Entry->UVRect[3] = UVRect[3];
+        Entry->Tint = Tint;
+        Entry->Texture = Texture;
+    }
+}
+
+#endif
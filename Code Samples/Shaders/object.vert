@@ -0,0 +1,33 @@
+#version 450
+
+// Note: One quad per object. The transforms live in this frame's part of the dynamic ring (binding 1, dynamic offset),
+// the push constants say where this draw's objects start.
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct ObjectData {
+    mat4 Model;
+    vec4 Color;
+};
+
+layout(std430, binding = 1) readonly buffer Objects { ObjectData objects[]; };
+
+layout(push_constant) uniform DrawConstants {
+    uint FirstObject;
+    vec4 Tint;
+} draw;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    ObjectData object = objects[draw.FirstObject + gl_InstanceIndex];
+    gl_Position = ubo.proj * ubo.view * object.Model * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor * object.Color.rgb * draw.Tint.rgb;
+}
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Note: Every texture comes from the bindless set (set 1), picked by the instance's texture ID. Instances with different
+// textures share a draw, so the index isn't uniform across it.
+
+layout(location = 0) in vec4 fragTint;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in float fragPage;
+layout(location = 3) flat in uint fragTexture;
+
+layout(set = 1, binding = 0) uniform texture2DArray Textures[];
+layout(set = 1, binding = 2) uniform sampler Sampler;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = fragTint * texture(sampler2DArray(Textures[nonuniformEXT(fragTexture)], Sampler), vec3(fragUV, fragPage));
+}
@@ -0,0 +1,36 @@
+#version 450
+
+// Note: Instanced sprite. Binding 0 is the shared quad, binding 1 is one SpriteInstance per sprite.
+// The UV rect is in the texture's UV space: for the atlas (and any texture) the integer part of x is the array layer.
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec2 inCorner;      // Note: Quad corner, -0.5..0.5.
+layout(location = 2) in vec3 inPosition;
+layout(location = 3) in vec2 inSize;
+layout(location = 4) in vec4 inUVRect;
+layout(location = 5) in vec4 inTint;
+layout(location = 6) in uint inTexture;     // Note: Bindless texture ID.
+
+layout(location = 0) out vec4 fragTint;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out float fragPage;
+layout(location = 3) flat out uint fragTexture;
+
+void main() {
+    vec3 worldPosition = inPosition + vec3(inCorner * inSize, 0.0);
+    gl_Position = ubo.proj * ubo.view * vec4(worldPosition, 1.0);
+
+    float page = floor(inUVRect.x);
+    vec4 rect = inUVRect - vec4(page, 0.0, page, 0.0);
+
+    vec2 t = inCorner + 0.5;
+    fragUV = mix(rect.xy, rect.zw, vec2(t.x, 1.0 - t.y));
+    fragPage = page;
+    fragTint = inTint;
+    fragTexture = inTexture;
+}
@@ -0,0 +1,288 @@
+// Note: Sprite sheet atlas.
+// Sprite sheets are the artists' images, one per SpriteDefinition::Atlas. They are packed into the pages of one 2D array
+// image, which the sprite shader samples as bindless texture 0 (Vulkan_Bindless.cpp). A page is a grid of 8x8 cells;
+// a sheet takes a rectangle of whole cells, so finding room is a search over one 64 bit mask per page and nothing ever
+// has to be repacked.
+// Only sheets that were drawn recently stay resident. A sheet is uploaded through the staging ring the first frame it's
+// drawn, and when there's no room, the least recently used sheets that no frame in flight can still be sampling are
+// evicted. The game keeps the pixels, so an evicted sheet can come back any time.
+// The image stays in GENERAL layout. Uploads only ever land in cells nobody is sampling, so there's no transition to wait for.
+// The sprites' UV rects are moved into the array on the way into their instances: x gets the page index added as its integer
+// part, which the vertex shader takes back off. Sheets that aren't resident (or have no pixels) map onto a white block in
+// page 0 and draw as plain tint.
+
+#define VULKAN_ATLAS_PAGE_SIZE          2048
+#define VULKAN_ATLAS_PAGE_COUNT         4       // Note: 16MB each.
+#define VULKAN_ATLAS_CELLS_PER_SIDE     8       // Note: 64 cells, one bit each.
+#define VULKAN_ATLAS_CELL_SIZE          (VULKAN_ATLAS_PAGE_SIZE / VULKAN_ATLAS_CELLS_PER_SIDE)
+#define VULKAN_ATLAS_WHITE_SIZE         4       // Note: In the first cell of page 0, which is never handed out.
+
+namespace Vulkan
+{
+    struct SpriteSheet
+    {
+        uint32_t* Pixels;       // Note: RGBA8, tightly packed. The game's, null if the sheet was never registered.
+        uint32_t Width;
+        uint32_t Height;
+
+        bool32 Resident;
+        uint32_t Page;
+        uint32_t CellX;
+        uint32_t CellY;
+        uint32_t CellWidth;     // Note: In cells.
+        uint32_t CellHeight;
+        uint64_t LastUsedFrame;
+    };
+
+    struct AtlasStats
+    {
+        uint64_t Frames;
+        uint64_t UploadBytes;
+        VkDeviceSize FrameUploadBytes;      // Note: The frame being built.
+        VkDeviceSize PeakFrameUploadBytes;
+        uint32_t Uploads;
+        uint32_t Evictions;
+        uint32_t Misses;                    // Note: A sheet drew white because it couldn't be made resident.
+    };
+
+    struct SpriteAtlas
+    {
+        VkImage Image;
+        VkImageView View;
+        VkSampler Sampler;
+        MemoryAllocation Memory;
+
+        SpriteSheet Sheets[VULKAN_SPRITE_MAX_ATLASES];
+        uint64_t PageCells[VULKAN_ATLAS_PAGE_COUNT];        // Note: Bit CellY * 8 + CellX is set if the cell is taken.
+        glm::vec4 Transforms[VULKAN_SPRITE_MAX_ATLASES];    // Note: Per sheet, see ApplySheetTransform.
+
+        AtlasStats Stats;
+    };
+
+    inline glm::vec4
+    GetWhiteSheetTransform()
+    {
+        float Center = 0.5f * (float)VULKAN_ATLAS_WHITE_SIZE / (float)VULKAN_ATLAS_PAGE_SIZE;
+        glm::vec4 Result = glm::vec4(0.0f, 0.0f, Center, Center);
+        return(Result);
+    }
+
+    inline uint64_t
+    GetAtlasCellMask(uint32_t CellX, uint32_t CellY, uint32_t CellWidth, uint32_t CellHeight)
+    {
+        uint64_t Row = ((1ull << CellWidth) - 1) << CellX;
+        uint64_t Result = 0;
+        for (uint32_t Y = CellY; Y < CellY + CellHeight; ++Y)
+        {
+            Result |= Row << (Y * VULKAN_ATLAS_CELLS_PER_SIDE);
+        }
+        return(Result);
+    }
+
+    // Note: Image, view and sampler are made by the caller. Records the one layout transition the image ever gets
+    // and the white block into the current upload batch.
+    internal void
+    InitSpriteAtlas(SpriteAtlas* Atlas, UploadContext* Upload)
+    {
+        VkCommandBuffer CommandBuffer = BeginUploadBatch(Upload);
+
+        VkImageMemoryBarrier Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = 0;
+        Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.image = Atlas->Image;
+        Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Barrier.subresourceRange.levelCount = 1;
+        Barrier.subresourceRange.layerCount = VULKAN_ATLAS_PAGE_COUNT;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+        uint32_t White[VULKAN_ATLAS_WHITE_SIZE * VULKAN_ATLAS_WHITE_SIZE];
+        for (uint32_t Index = 0; Index < VULKAN_ATLAS_WHITE_SIZE * VULKAN_ATLAS_WHITE_SIZE; ++Index)
+        {
+            White[Index] = 0xFFFFFFFF;
+        }
+        UploadToImage(Upload, Atlas->Image, 0, 0, 0, VULKAN_ATLAS_WHITE_SIZE, VULKAN_ATLAS_WHITE_SIZE, White);
+        Atlas->PageCells[0] = 1;
+
+        for (uint32_t SheetIndex = 0; SheetIndex < VULKAN_SPRITE_MAX_ATLASES; ++SheetIndex)
+        {
+            Atlas->Transforms[SheetIndex] = GetWhiteSheetTransform();
+        }
+    }
+
+    // Note: Only for sheets no frame in flight is sampling anymore.
+    internal void
+    EvictSpriteSheet(SpriteAtlas* Atlas, uint32_t SheetIndex)
+    {
+        SpriteSheet* Sheet = &Atlas->Sheets[SheetIndex];
+        if (Sheet->Resident)
+        {
+            Atlas->PageCells[Sheet->Page] &= ~GetAtlasCellMask(Sheet->CellX, Sheet->CellY, Sheet->CellWidth, Sheet->CellHeight);
+            Sheet->Resident = false;
+            Atlas->Transforms[SheetIndex] = GetWhiteSheetTransform();
+            ++Atlas->Stats.Evictions;
+        }
+    }
+
+    // Note: First fit, page by page, row by row.
+    internal bool32
+    FindAtlasSpace(SpriteAtlas* Atlas, uint32_t CellWidth, uint32_t CellHeight, uint32_t* Page, uint32_t* CellX, uint32_t* CellY)
+    {
+        for (uint32_t PageIndex = 0; PageIndex < VULKAN_ATLAS_PAGE_COUNT; ++PageIndex)
+        {
+            for (uint32_t Y = 0; Y + CellHeight <= VULKAN_ATLAS_CELLS_PER_SIDE; ++Y)
+            {
+                for (uint32_t X = 0; X + CellWidth <= VULKAN_ATLAS_CELLS_PER_SIDE; ++X)
+                {
+                    if (!(Atlas->PageCells[PageIndex] & GetAtlasCellMask(X, Y, CellWidth, CellHeight)))
+                    {
+                        *Page = PageIndex;
+                        *CellX = X;
+                        *CellY = Y;
+                        return(true);
+                    }
+                }
+            }
+        }
+        return(false);
+    }
+
+    // Note: Evicts least recently used sheets until the sheet fits. Sheets drawn by FrameNumber - FramesInFlight or later
+    // may still be sampled by a frame in flight (or this one), so they stay. Returns false if there's no room even then.
+    internal bool32
+    MakeSpriteSheetResident(SpriteAtlas* Atlas, UploadContext* Upload, uint32_t SheetIndex, uint64_t FrameNumber, uint32_t FramesInFlight)
+    {
+        SpriteSheet* Sheet = &Atlas->Sheets[SheetIndex];
+        uint32_t CellWidth = (Sheet->Width + VULKAN_ATLAS_CELL_SIZE - 1) / VULKAN_ATLAS_CELL_SIZE;
+        uint32_t CellHeight = (Sheet->Height + VULKAN_ATLAS_CELL_SIZE - 1) / VULKAN_ATLAS_CELL_SIZE;
+
+        uint32_t Page, CellX, CellY;
+        while (!FindAtlasSpace(Atlas, CellWidth, CellHeight, &Page, &CellX, &CellY))
+        {
+            uint32_t Oldest = VULKAN_SPRITE_MAX_ATLASES;
+            for (uint32_t Index = 0; Index < VULKAN_SPRITE_MAX_ATLASES; ++Index)
+            {
+                SpriteSheet* Candidate = &Atlas->Sheets[Index];
+                if (Candidate->Resident && Candidate->LastUsedFrame + FramesInFlight <= FrameNumber &&
+                    (Oldest == VULKAN_SPRITE_MAX_ATLASES || Candidate->LastUsedFrame < Atlas->Sheets[Oldest].LastUsedFrame))
+                {
+                    Oldest = Index;
+                }
+            }
+            if (Oldest == VULKAN_SPRITE_MAX_ATLASES)
+            {
+                return(false);
+            }
+            EvictSpriteSheet(Atlas, Oldest);
+        }
+
+        Sheet->Resident = true;
+        Sheet->Page = Page;
+        Sheet->CellX = CellX;
+        Sheet->CellY = CellY;
+        Sheet->CellWidth = CellWidth;
+        Sheet->CellHeight = CellHeight;
+        Atlas->PageCells[Page] |= GetAtlasCellMask(CellX, CellY, CellWidth, CellHeight);
+
+        uint32_t X = CellX * VULKAN_ATLAS_CELL_SIZE;
+        uint32_t Y = CellY * VULKAN_ATLAS_CELL_SIZE;
+        UploadToImage(Upload, Atlas->Image, Page, X, Y, Sheet->Width, Sheet->Height, Sheet->Pixels);
+
+        float PageSize = (float)VULKAN_ATLAS_PAGE_SIZE;
+        Atlas->Transforms[SheetIndex] = glm::vec4((float)Sheet->Width / PageSize, (float)Sheet->Height / PageSize,
+                                                  (float)Page + (float)X / PageSize, (float)Y / PageSize);
+
+        VkDeviceSize Bytes = (VkDeviceSize)Sheet->Width * Sheet->Height * 4;
+        Atlas->Stats.UploadBytes += Bytes;
+        Atlas->Stats.FrameUploadBytes += Bytes;
+        ++Atlas->Stats.Uploads;
+        return(true);
+    }
+
+    // Note: Once per frame, before any instance is written. UsedSheets has a bit per sheet drawn this frame.
+    internal void
+    UpdateAtlasResidency(SpriteAtlas* Atlas, UploadContext* Upload, uint64_t UsedSheets, uint64_t FrameNumber, uint32_t FramesInFlight)
+    {
+        AtlasStats* Stats = &Atlas->Stats;
+        if (Stats->FrameUploadBytes > Stats->PeakFrameUploadBytes)
+        {
+            Stats->PeakFrameUploadBytes = Stats->FrameUploadBytes;
+        }
+        Stats->FrameUploadBytes = 0;
+        ++Stats->Frames;
+
+        // Note: Mark them all first, so making one resident never evicts another one this frame needs.
+        for (uint32_t SheetIndex = 0; SheetIndex < VULKAN_SPRITE_MAX_ATLASES; ++SheetIndex)
+        {
+            if (UsedSheets & (1ull << SheetIndex))
+            {
+                Atlas->Sheets[SheetIndex].LastUsedFrame = FrameNumber;
+            }
+        }
+
+        for (uint32_t SheetIndex = 0; SheetIndex < VULKAN_SPRITE_MAX_ATLASES; ++SheetIndex)
+        {
+            SpriteSheet* Sheet = &Atlas->Sheets[SheetIndex];
+            if ((UsedSheets & (1ull << SheetIndex)) && Sheet->Pixels && !Sheet->Resident)
+            {
+                if (!MakeSpriteSheetResident(Atlas, Upload, SheetIndex, FrameNumber, FramesInFlight))
+                {
+                    ++Stats->Misses;
+                }
+            }
+        }
+    }
+
+    // Note: Page utilization is by texel: the cells a sheet takes can be bigger than the sheet.
+    internal int
+    FormatAtlasStats(char* Text, int Size, SpriteAtlas* Atlas)
+    {
+        AtlasStats* Stats = &Atlas->Stats;
+        uint64_t Frames = Stats->Frames ? Stats->Frames : 1;
+        int Used = snprintf(Text, Size,
+            "atlas: %d pages of %dx%d, %.1fKB uploaded/frame avg, %.1fKB peak, %u uploads, %u evictions, %u misses\n",
+            VULKAN_ATLAS_PAGE_COUNT, VULKAN_ATLAS_PAGE_SIZE, VULKAN_ATLAS_PAGE_SIZE,
+            (double)Stats->UploadBytes / (1024.0 * (double)Frames), (double)Stats->PeakFrameUploadBytes / 1024.0,
+            Stats->Uploads, Stats->Evictions, Stats->Misses);
+        Used = ClampReportLength(Used, Size);
+
+        for (uint32_t Page = 0; Page < VULKAN_ATLAS_PAGE_COUNT; ++Page)
+        {
+            uint32_t CellCount = 0;
+            for (uint32_t Cell = 0; Cell < VULKAN_ATLAS_CELLS_PER_SIDE * VULKAN_ATLAS_CELLS_PER_SIDE; ++Cell)
+            {
+                CellCount += (Atlas->PageCells[Page] >> Cell) & 1;
+            }
+
+            uint64_t Texels = (Page == 0) ? VULKAN_ATLAS_WHITE_SIZE * VULKAN_ATLAS_WHITE_SIZE : 0;
+            for (uint32_t SheetIndex = 0; SheetIndex < VULKAN_SPRITE_MAX_ATLASES; ++SheetIndex)
+            {
+                SpriteSheet* Sheet = &Atlas->Sheets[SheetIndex];
+                if (Sheet->Resident && Sheet->Page == Page)
+                {
+                    Texels += (uint64_t)Sheet->Width * Sheet->Height;
+                }
+            }
+
+            int More = snprintf(Text + Used, Size - Used, "  page %u: %u/%d cells, %.1f%% of texels\n",
+                                Page, CellCount, VULKAN_ATLAS_CELLS_PER_SIDE * VULKAN_ATLAS_CELLS_PER_SIDE,
+                                100.0 * (double)Texels / ((double)VULKAN_ATLAS_PAGE_SIZE * VULKAN_ATLAS_PAGE_SIZE));
+            Used += More;
+            Used = ClampReportLength(Used, Size);
+        }
+        return(Used);
+    }
+
+    internal void
+    OutputAtlasStats(SpriteAtlas* Atlas)
+    {
+        char Text[512];
+        FormatAtlasStats(Text, sizeof(Text), Atlas);
+        OutputDebugStringA(Text);
+    }
+}
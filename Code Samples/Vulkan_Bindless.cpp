@@ -0,0 +1,399 @@
+// Note: Bindless descriptors.
+// One descriptor set holds every texture and storage buffer the shaders can get at, as two big arrays (binding 0 sampled
+// images, binding 1 storage buffers) plus the one sampler they're all read with (binding 2). It's bound once as set 1 and
+// never changes; what a draw reads is picked by an ID that comes with the instance (SpriteInstance::Texture), so sprites
+// that use different textures still go in the same draw.
+// The arrays are partially bound and update-after-bind: an ID is written the moment it's handed out, even while frames
+// in flight have the set bound, since those frames can't be using an ID that didn't exist when they were recorded.
+// Released IDs are the reverse: they're held back, along with anything the table owns behind them, until every frame
+// that was submitted while they were still live is done, the same way Vulkan_Deferred.cpp works.
+// Texture 0 is the sprite atlas (Vulkan_Atlas.cpp), which stays there for good.
+
+#define VULKAN_BINDLESS_ARRAY_SIZE      1024    // Note: Per array. Far under the update-after-bind limits descriptor indexing guarantees.
+#define VULKAN_BINDLESS_ATLAS_TEXTURE   0
+#define VULKAN_BINDLESS_INVALID_ID      0xFFFFFFFF
+
+namespace Vulkan
+{
+    enum BindlessKind
+    {
+        BindlessKind_Texture,
+        BindlessKind_Buffer,
+
+        BindlessKind_Count,
+    };
+
+    struct BindlessRetired
+    {
+        uint32_t ID;
+        uint64_t SubmittedFrames;   // Note: Frames submitted when it was released; it's free again once those have all finished.
+    };
+
+    // Note: IDs are handed out from the free list first, then from the never used ones past HighWater.
+    struct BindlessArray
+    {
+        uint32_t HighWater;
+        uint32_t FreeIDs[VULKAN_BINDLESS_ARRAY_SIZE];
+        uint32_t FreeCount;
+        BindlessRetired Retired[VULKAN_BINDLESS_ARRAY_SIZE];
+        uint32_t RetiredCount;
+        uint32_t LiveCount;
+    };
+
+    // Note: A texture the table made and has to destroy along with its ID. Image is null for the ones it was only handed.
+    struct BindlessTexture
+    {
+        VkImage Image;
+        VkImageView View;
+        MemoryAllocation Memory;
+        VkExtent2D Extent;          // Note: Set by whoever made the image, so it can be made again (see Vulkan_Defrag.cpp).
+    };
+
+    struct BindlessStats
+    {
+        uint64_t Writes;
+        uint64_t Releases;
+        uint32_t PeakLive[BindlessKind_Count];
+        uint32_t Failures;          // Note: An array was full.
+    };
+
+    struct BindlessTable
+    {
+        VkDevice Device;
+        DeviceMemoryAllocator* Allocator;
+        VkDescriptorSetLayout SetLayout;
+        VkDescriptorPool DescriptorPool;
+        VkDescriptorSet DescriptorSet;
+
+        BindlessArray Arrays[BindlessKind_Count];
+        BindlessTexture Textures[VULKAN_BINDLESS_ARRAY_SIZE];
+
+        BindlessStats Stats;
+    };
+
+    internal void
+    InitBindlessTable(BindlessTable* Table, VkDevice Device, DeviceMemoryAllocator* Allocator)
+    {
+        *Table = {};
+        Table->Device = Device;
+        Table->Allocator = Allocator;
+
+        VkDescriptorSetLayoutBinding Bindings[3] = {};
+        Bindings[0].binding = 0;
+        Bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        Bindings[0].descriptorCount = VULKAN_BINDLESS_ARRAY_SIZE;
+        Bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        Bindings[1].binding = 1;
+        Bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        Bindings[1].descriptorCount = VULKAN_BINDLESS_ARRAY_SIZE;
+        Bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        Bindings[2].binding = 2;
+        Bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        Bindings[2].descriptorCount = 1;
+        Bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorBindingFlags ArrayFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                              VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        VkDescriptorBindingFlags BindingFlags[3] = { ArrayFlags, ArrayFlags, 0 };
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo FlagsInfo = {};
+        FlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        FlagsInfo.bindingCount = 3;
+        FlagsInfo.pBindingFlags = BindingFlags;
+
+        VkDescriptorSetLayoutCreateInfo LayoutInfo = {};
+        LayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        LayoutInfo.pNext = &FlagsInfo;
+        LayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        LayoutInfo.bindingCount = 3;
+        LayoutInfo.pBindings = Bindings;
+
+        if (vkCreateDescriptorSetLayout(Device, &LayoutInfo, nullptr, &Table->SetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor set layout!");
+        }
+
+        VkDescriptorPoolSize PoolSizes[3] = {};
+        PoolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        PoolSizes[0].descriptorCount = VULKAN_BINDLESS_ARRAY_SIZE;
+        PoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        PoolSizes[1].descriptorCount = VULKAN_BINDLESS_ARRAY_SIZE;
+        PoolSizes[2].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+        PoolSizes[2].descriptorCount = 1;
+
+        VkDescriptorPoolCreateInfo PoolInfo = {};
+        PoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        PoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        PoolInfo.poolSizeCount = 3;
+        PoolInfo.pPoolSizes = PoolSizes;
+        PoolInfo.maxSets = 1;
+
+        if (vkCreateDescriptorPool(Device, &PoolInfo, nullptr, &Table->DescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create bindless descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo AllocInfo = {};
+        AllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        AllocInfo.descriptorPool = Table->DescriptorPool;
+        AllocInfo.descriptorSetCount = 1;
+        AllocInfo.pSetLayouts = &Table->SetLayout;
+
+        if (vkAllocateDescriptorSets(Device, &AllocInfo, &Table->DescriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate bindless descriptor set!");
+        }
+    }
+
+    internal void
+    DestroyBindlessTexture(BindlessTable* Table, uint32_t ID)
+    {
+        BindlessTexture* Texture = &Table->Textures[ID];
+        if (Texture->Image)
+        {
+            vkDestroyImageView(Table->Device, Texture->View, nullptr);
+            vkDestroyImage(Table->Device, Texture->Image, nullptr);
+            FreeDeviceMemory(Table->Allocator, &Texture->Memory);
+        }
+        *Texture = {};
+    }
+
+    // Note: Only when nothing is in flight any more. Everything the table still owns goes, released or not.
+    internal void
+    DestroyBindlessTable(BindlessTable* Table)
+    {
+        for (uint32_t ID = 0; ID < VULKAN_BINDLESS_ARRAY_SIZE; ++ID)
+        {
+            DestroyBindlessTexture(Table, ID);
+        }
+        vkDestroyDescriptorPool(Table->Device, Table->DescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(Table->Device, Table->SetLayout, nullptr);
+    }
+
+    // Note: The one sampler every texture is read with. Before the set is first bound.
+    internal void
+    SetBindlessSampler(BindlessTable* Table, VkSampler Sampler)
+    {
+        VkDescriptorImageInfo ImageInfo = {};
+        ImageInfo.sampler = Sampler;
+
+        VkWriteDescriptorSet Write = {};
+        Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        Write.dstSet = Table->DescriptorSet;
+        Write.dstBinding = 2;
+        Write.descriptorCount = 1;
+        Write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        Write.pImageInfo = &ImageInfo;
+        vkUpdateDescriptorSets(Table->Device, 1, &Write, 0, nullptr);
+    }
+
+    internal uint32_t
+    AllocateBindlessID(BindlessTable* Table, BindlessKind Kind)
+    {
+        BindlessArray* Array = &Table->Arrays[Kind];
+        uint32_t ID = VULKAN_BINDLESS_INVALID_ID;
+        if (Array->FreeCount)
+        {
+            ID = Array->FreeIDs[--Array->FreeCount];
+        }
+        else if (Array->HighWater < VULKAN_BINDLESS_ARRAY_SIZE)
+        {
+            ID = Array->HighWater++;
+        }
+
+        if (ID == VULKAN_BINDLESS_INVALID_ID)
+        {
+            ++Table->Stats.Failures;
+        }
+        else
+        {
+            ++Array->LiveCount;
+            if (Array->LiveCount > Table->Stats.PeakLive[Kind])
+            {
+                Table->Stats.PeakLive[Kind] = Array->LiveCount;
+            }
+        }
+        return(ID);
+    }
+
+    // Note: The view has to be a 2D array view, the shaders sample everything as sampler2DArray. Layout is what it'll be
+    // in whenever it's sampled. Image, if given, is the table's to destroy (with Memory) once the ID is released.
+    internal uint32_t
+    AddBindlessTexture(BindlessTable* Table, VkImageView View, VkImageLayout Layout, VkImage Image, MemoryAllocation* Memory)
+    {
+        uint32_t ID = AllocateBindlessID(Table, BindlessKind_Texture);
+        if (ID == VULKAN_BINDLESS_INVALID_ID)
+        {
+            return(ID);
+        }
+
+        BindlessTexture* Texture = &Table->Textures[ID];
+        Texture->Image = Image;
+        Texture->View = View;
+        if (Memory)
+        {
+            Texture->Memory = *Memory;
+        }
+
+        VkDescriptorImageInfo ImageInfo = {};
+        ImageInfo.imageView = View;
+        ImageInfo.imageLayout = Layout;
+
+        VkWriteDescriptorSet Write = {};
+        Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        Write.dstSet = Table->DescriptorSet;
+        Write.dstBinding = 0;
+        Write.dstArrayElement = ID;
+        Write.descriptorCount = 1;
+        Write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        Write.pImageInfo = &ImageInfo;
+        vkUpdateDescriptorSets(Table->Device, 1, &Write, 0, nullptr);
+
+        ++Table->Stats.Writes;
+        return(ID);
+    }
+
+    // Note: Points a live texture ID at another image with the same contents. Old gets what the table owned before,
+    // for the caller to destroy. Only while no submitted frame can still be reading the ID: the descriptor is in use.
+    internal void
+    ReplaceBindlessTexture(BindlessTable* Table, uint32_t ID, VkImageView View, VkImageLayout Layout, VkImage Image, MemoryAllocation* Memory,
+                           BindlessTexture* Old)
+    {
+        BindlessTexture* Texture = &Table->Textures[ID];
+        *Old = *Texture;
+        Texture->Image = Image;
+        Texture->View = View;
+        Texture->Memory = *Memory;
+
+        VkDescriptorImageInfo ImageInfo = {};
+        ImageInfo.imageView = View;
+        ImageInfo.imageLayout = Layout;
+
+        VkWriteDescriptorSet Write = {};
+        Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        Write.dstSet = Table->DescriptorSet;
+        Write.dstBinding = 0;
+        Write.dstArrayElement = ID;
+        Write.descriptorCount = 1;
+        Write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        Write.pImageInfo = &ImageInfo;
+        vkUpdateDescriptorSets(Table->Device, 1, &Write, 0, nullptr);
+
+        ++Table->Stats.Writes;
+    }
+
+    // Note: The buffer stays the caller's.
+    internal uint32_t
+    AddBindlessBuffer(BindlessTable* Table, VkBuffer Buffer, VkDeviceSize Offset, VkDeviceSize Range)
+    {
+        uint32_t ID = AllocateBindlessID(Table, BindlessKind_Buffer);
+        if (ID == VULKAN_BINDLESS_INVALID_ID)
+        {
+            return(ID);
+        }
+
+        VkDescriptorBufferInfo BufferInfo = {};
+        BufferInfo.buffer = Buffer;
+        BufferInfo.offset = Offset;
+        BufferInfo.range = Range;
+
+        VkWriteDescriptorSet Write = {};
+        Write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        Write.dstSet = Table->DescriptorSet;
+        Write.dstBinding = 1;
+        Write.dstArrayElement = ID;
+        Write.descriptorCount = 1;
+        Write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        Write.pBufferInfo = &BufferInfo;
+        vkUpdateDescriptorSets(Table->Device, 1, &Write, 0, nullptr);
+
+        ++Table->Stats.Writes;
+        return(ID);
+    }
+
+    // Note: Nothing recorded from here on may use the ID. It's reused (and its texture destroyed) once the frames
+    // submitted so far are done, see RetireBindless.
+    internal void
+    ReleaseBindless(BindlessTable* Table, BindlessKind Kind, uint32_t ID, uint64_t SubmittedFrames)
+    {
+        BindlessArray* Array = &Table->Arrays[Kind];
+        Assert(ID < Array->HighWater);
+        Assert(Array->RetiredCount < VULKAN_BINDLESS_ARRAY_SIZE);
+
+        BindlessRetired* Retired = &Array->Retired[Array->RetiredCount++];
+        Retired->ID = ID;
+        Retired->SubmittedFrames = SubmittedFrames;
+        --Array->LiveCount;
+        ++Table->Stats.Releases;
+    }
+
+    // Note: CompletedFrames = how many frames, counted from the first, are known to have finished on the GPU.
+    internal void
+    RetireBindless(BindlessTable* Table, uint64_t CompletedFrames)
+    {
+        for (uint32_t Kind = 0; Kind < BindlessKind_Count; ++Kind)
+        {
+            BindlessArray* Array = &Table->Arrays[Kind];
+
+            // Note: Released in submission order, so the ones that are done are all at the front.
+            uint32_t DoneCount = 0;
+            while (DoneCount < Array->RetiredCount && Array->Retired[DoneCount].SubmittedFrames <= CompletedFrames)
+            {
+                uint32_t ID = Array->Retired[DoneCount].ID;
+                if (Kind == BindlessKind_Texture)
+                {
+                    DestroyBindlessTexture(Table, ID);
+                }
+                Array->FreeIDs[Array->FreeCount++] = ID;
+                ++DoneCount;
+            }
+
+            if (DoneCount)
+            {
+                Array->RetiredCount -= DoneCount;
+                memmove(Array->Retired, Array->Retired + DoneCount, Array->RetiredCount * sizeof(BindlessRetired));
+            }
+        }
+    }
+
+    // Note: Records the image's one layout transition (to GENERAL, where it stays) and its pixels into the current upload batch.
+    internal void
+    UploadBindlessTexture(UploadContext* Upload, VkImage Image, uint32_t Width, uint32_t Height, const uint32_t* Pixels)
+    {
+        VkCommandBuffer CommandBuffer = BeginUploadBatch(Upload);
+
+        VkImageMemoryBarrier Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = 0;
+        Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.image = Image;
+        Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Barrier.subresourceRange.levelCount = 1;
+        Barrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &Barrier);
+
+        UploadToImage(Upload, Image, 0, 0, 0, Width, Height, Pixels);
+    }
+
+    internal int
+    FormatBindlessStats(char* Text, int Size, BindlessTable* Table)
+    {
+        BindlessStats* Stats = &Table->Stats;
+        int Used = snprintf(Text, Size,
+            "bindless: %u textures, %u buffers live (%u/%u peak of %d), %llu writes, %llu releases, %u failures\n",
+            Table->Arrays[BindlessKind_Texture].LiveCount, Table->Arrays[BindlessKind_Buffer].LiveCount,
+            Stats->PeakLive[BindlessKind_Texture], Stats->PeakLive[BindlessKind_Buffer], VULKAN_BINDLESS_ARRAY_SIZE,
+            Stats->Writes, Stats->Releases, Stats->Failures);
+        return(ClampReportLength(Used, Size));
+    }
+
+    internal void
+    OutputBindlessStats(BindlessTable* Table)
+    {
+        char Text[256];
+        FormatBindlessStats(Text, sizeof(Text), Table);
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,406 @@
+// Note: GPU-driven sprite drawing.
+// The sprites live on the GPU (SpriteCuller::SourceInstances), uploaded once when they change instead of
+// rebuilt every frame. Each frame a compute pass culls them against the camera, compacts the survivors into
+// per-atlas runs and writes one VkDrawIndexedIndirectCommand per atlas that has anything left. The draw is then
+// a single vkCmdDrawIndexedIndirectCount, so the CPU cost of a frame doesn't depend on how many sprites there are.
+// Everything the compute pass writes is per frame in flight, so two frames never touch the same buffers.
+// The source instances keep their sheet space UV rects; the scatter pass moves them into the atlas with this frame's
+// sheet transforms, so residency can change without uploading the sprites again. Sprites with a texture of their own
+// (SpriteDefinition::Texture) keep their UV rect as it is and still go in their atlas' run, the runs are only buckets
+// now that the textures come from the bindless set.
+// Uploads go by chunks of VULKAN_SPRITE_CHUNK_ROWS rows (64KB of instances). The culler remembers the version of each
+// chunk it last uploaded (SpriteEntityColumns::ChunkVersions) and only converts and copies the chunks that changed,
+// plus any rows past the last count, so sprites that don't move cost nothing. Up to VULKAN_CULL_MAX_FRAME_BYTES a frame
+// they're copied at the start of the frame's own commands, out of the dynamic ring, with one vkCmdCopyBuffer of one
+// region per chunk for each buffer; the barrier in front of it waits for the earlier frames' compute passes, so
+// nothing waits on the CPU. More than that goes through the upload queue after waiting for the frames in flight.
+// Changed definitions don't bump any version, SetCulledSprites uploads everything again. A chunk that goes up again
+// also puts its sprites back where the columns say, whatever the simulation did to them.
+
+#define VULKAN_CULL_GROUP_SIZE          64  // Note: Has to match local_size_x in sprite_cull.comp.
+#define VULKAN_CULL_MAX_FRAME_BYTES     (1024 * 1024)   // Note: Out of the dynamic ring's VULKAN_DYNAMIC_RING_FRAME_SIZE.
+#define VULKAN_CULL_DYNAMIC_OFFSET_COUNT 2  // Note: Camera (binding 0) and sheet transforms (binding 6), both in the dynamic ring.
+
+namespace Vulkan
+{
+    // Note: Mirrors the IndirectDraws block in sprite_cull.comp.
+    struct SpriteCullIndirect
+    {
+        uint32_t DrawCount;
+        uint32_t Pad[3];
+        uint32_t AtlasCounts[VULKAN_SPRITE_MAX_ATLASES];
+        uint32_t AtlasFirst[VULKAN_SPRITE_MAX_ATLASES];
+        VkDrawIndexedIndirectCommand Commands[VULKAN_SPRITE_MAX_ATLASES];
+    };
+
+    struct SpriteCullFrame
+    {
+        VkBuffer Slots;             // Note: Per source instance, its slot within its atlas run (or ~0 if culled).
+        MemoryAllocation SlotsMemory;
+        VkBuffer VisibleInstances;  // Note: Compacted survivors, bound as the instance vertex buffer.
+        MemoryAllocation VisibleMemory;
+        VkBuffer Indirect;          // Note: One SpriteCullIndirect.
+        MemoryAllocation IndirectMemory;
+        VkDescriptorSet DescriptorSet;
+    };
+
+    struct SpriteUploadStats
+    {
+        uint64_t Updates;           // Note: UpdateCulledSprites and SetCulledSprites calls.
+        uint64_t Bytes;
+        uint64_t Chunks;
+        uint32_t FrameCopies;       // Note: Updates copied in the frame's commands.
+        uint32_t WaitedUploads;     // Note: Updates too big for that, which waited for the frames in flight.
+        uint32_t LastBytes;
+    };
+
+    struct SpriteCuller
+    {
+        VkDescriptorSetLayout SetLayout;
+        VkPipelineLayout PipelineLayout;
+        VkPipeline CullPipeline;
+        VkPipeline BuildPipeline;
+        VkPipeline ScatterPipeline;
+        VkDescriptorPool DescriptorPool;
+
+        VkBuffer SourceInstances;
+        MemoryAllocation SourceMemory;
+        VkBuffer SourceAtlases;
+        MemoryAllocation SourceAtlasMemory;
+        uint32_t SourceCount;
+        uint64_t SourceSheets;      // Note: Bit per atlas that any source sprite uses.
+
+        SpriteCullFrame Frames[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+        // Note: Per chunk of the source, the version it was last uploaded at and the atlases its rows use.
+        uint32_t ChunkVersions[VULKAN_SPRITE_MAX_CHUNKS];
+        uint64_t ChunkSheets[VULKAN_SPRITE_MAX_CHUNKS];
+        bool32 ChunksUploaded;      // Note: False until the first upload, and after SetCulledSprites: every chunk is dirty.
+
+        // Note: From GatherDirtySpriteChunks, for the count DirtyCount.
+        uint32_t DirtyChunks[VULKAN_SPRITE_MAX_CHUNKS];
+        uint32_t DirtyChunkCount;
+        uint32_t DirtyCount;
+
+        // Note: Written by WriteDirtySpriteChunks, recorded by RecordDirtySpriteChunks.
+        VkBufferCopy InstanceRegions[VULKAN_SPRITE_MAX_CHUNKS];
+        VkBufferCopy AtlasRegions[VULKAN_SPRITE_MAX_CHUNKS];
+        uint32_t RegionCount;
+
+        SpriteUploadStats UploadStats;
+
+        bool32 DrawIndirectCount;   // Note: Without it, every command slot is drawn and the empty ones are no-ops.
+        bool32 MultiDrawIndirect;   // Note: Without it, one vkCmdDrawIndexedIndirect per command slot.
+    };
+
+    struct SpriteCullConstants
+    {
+        uint32_t InstanceCount;
+        uint32_t QuadIndexCount;
+        uint32_t QuadFirstIndex;    // Note: Where the quad is in the geometry buffer, for the draw commands.
+        int32_t QuadVertexOffset;
+    };
+
+    // Note: The chunks that changed since they were last uploaded. Returns how many bytes they come to.
+    internal uint32_t
+    GatherDirtySpriteChunks(SpriteCuller* Culler, SpriteEntityColumns* Columns)
+    {
+        uint32_t Count = Columns->Count;
+        if (Count > VULKAN_SPRITE_MAX_INSTANCES)
+        {
+            // Todo: Logging.
+            Count = VULKAN_SPRITE_MAX_INSTANCES;
+        }
+
+        Culler->DirtyChunkCount = 0;
+        Culler->DirtyCount = Count;
+        uint32_t Bytes = 0;
+        uint32_t ChunkCount = (Count + VULKAN_SPRITE_CHUNK_ROWS - 1) / VULKAN_SPRITE_CHUNK_ROWS;
+        for (uint32_t Chunk = 0; Chunk < ChunkCount; ++Chunk)
+        {
+            uint32_t First = Chunk * VULKAN_SPRITE_CHUNK_ROWS;
+            uint32_t End = (Count - First < VULKAN_SPRITE_CHUNK_ROWS) ? Count : First + VULKAN_SPRITE_CHUNK_ROWS;
+            bool32 Dirty = (!Culler->ChunksUploaded || !Columns->ChunkVersions || End > Culler->SourceCount ||
+                            Columns->ChunkVersions[Chunk] != Culler->ChunkVersions[Chunk]);
+            if (Dirty)
+            {
+                Culler->DirtyChunks[Culler->DirtyChunkCount++] = Chunk;
+                Bytes += (End - First) * (sizeof(SpriteInstance) + sizeof(uint32_t));
+            }
+        }
+        return(Bytes);
+    }
+
+    // Note: Rows of one chunk into Instances and Atlases. Returns how many. The rows stay where they are, so one whose Atlas
+    // is out of range can't be left out: it goes in as a zero sized sprite of atlas 0, which draws nothing, since
+    // sprite_cull.comp indexes its per-atlas counts with the atlas.
+    internal uint32_t
+    ConvertSpriteChunk(SpriteCuller* Culler, SpriteEntityColumns* Columns, SpriteDefinition* Definitions, uint32_t Chunk,
+                       SpriteInstance* Instances, uint32_t* Atlases)
+    {
+        uint32_t First = Chunk * VULKAN_SPRITE_CHUNK_ROWS;
+        uint32_t RowCount = (Culler->DirtyCount - First < VULKAN_SPRITE_CHUNK_ROWS) ? Culler->DirtyCount - First : VULKAN_SPRITE_CHUNK_ROWS;
+
+        uint64_t Sheets = 0;
+        for (uint32_t Index = 0; Index < RowCount; ++Index)
+        {
+            uint32_t Row = First + Index;
+            SpriteDefinition* Definition = &Definitions[Columns->Sprites[Row]];
+
+            SpriteInstance* Instance = &Instances[Index];
+            Instance->Position = Columns->Positions[Row];
+            Instance->Size = Columns->Sizes[Row];
+            Instance->UVRect = Definition->UVRect;
+            Instance->Tint = Columns->Tints ? Columns->Tints[Row] : 0xFFFFFFFF;
+            Instance->Texture = Definition->Texture;
+            if (Definition->Atlas >= VULKAN_SPRITE_MAX_ATLASES)
+            {
+                // Todo: Logging.
+                Instance->Size = glm::vec2(0.0f, 0.0f);
+                Atlases[Index] = 0;
+                continue;
+            }
+            Atlases[Index] = Definition->Atlas;
+            if (Definition->Texture == VULKAN_BINDLESS_ATLAS_TEXTURE)
+            {
+                Sheets |= 1ull << Definition->Atlas;
+            }
+        }
+        Culler->ChunkSheets[Chunk] = Sheets;
+        return(RowCount);
+    }
+
+    // Note: Once the dirty chunks are on their way: their versions, the count and the atlases in use.
+    internal void
+    CommitDirtySpriteChunks(SpriteCuller* Culler, SpriteEntityColumns* Columns, uint32_t Bytes)
+    {
+        for (uint32_t Index = 0; Index < Culler->DirtyChunkCount; ++Index)
+        {
+            uint32_t Chunk = Culler->DirtyChunks[Index];
+            Culler->ChunkVersions[Chunk] = Columns->ChunkVersions ? Columns->ChunkVersions[Chunk] : 0;
+        }
+        Culler->ChunksUploaded = true;
+        Culler->SourceCount = Culler->DirtyCount;
+
+        // Note: A chunk cut short by a smaller count keeps its old atlases, which only means one more resident sheet.
+        Culler->SourceSheets = 0;
+        uint32_t ChunkCount = (Culler->SourceCount + VULKAN_SPRITE_CHUNK_ROWS - 1) / VULKAN_SPRITE_CHUNK_ROWS;
+        for (uint32_t Chunk = 0; Chunk < ChunkCount; ++Chunk)
+        {
+            Culler->SourceSheets |= Culler->ChunkSheets[Chunk];
+        }
+
+        SpriteUploadStats* Stats = &Culler->UploadStats;
+        ++Stats->Updates;
+        Stats->Bytes += Bytes;
+        Stats->Chunks += Culler->DirtyChunkCount;
+        Stats->LastBytes = Bytes;
+        Culler->DirtyChunkCount = 0;
+    }
+
+    // Note: Queues the dirty chunks for the upload queue. The caller has to make sure no frame in flight is still using
+    // the source buffers.
+    internal void
+    UploadDirtySpriteChunks(SpriteCuller* Culler, UploadContext* Upload, SpriteEntityColumns* Columns, SpriteDefinition* Definitions,
+                            uint32_t Bytes)
+    {
+        SpriteInstance Instances[VULKAN_SPRITE_CHUNK_ROWS];
+        uint32_t Atlases[VULKAN_SPRITE_CHUNK_ROWS];
+        for (uint32_t Index = 0; Index < Culler->DirtyChunkCount; ++Index)
+        {
+            uint32_t Chunk = Culler->DirtyChunks[Index];
+            uint32_t First = Chunk * VULKAN_SPRITE_CHUNK_ROWS;
+            uint32_t RowCount = ConvertSpriteChunk(Culler, Columns, Definitions, Chunk, Instances, Atlases);
+            UploadToBuffer(Upload, Culler->SourceInstances, First * sizeof(SpriteInstance), Instances, RowCount * sizeof(SpriteInstance));
+            UploadToBuffer(Upload, Culler->SourceAtlases, First * sizeof(uint32_t), Atlases, RowCount * sizeof(uint32_t));
+        }
+        ++Culler->UploadStats.WaitedUploads;
+        CommitDirtySpriteChunks(Culler, Columns, Bytes);
+    }
+
+    // Note: Converts the game's columns to instances and queues all of them for upload into the source buffers.
+    // The caller has to make sure no frame in flight is still culling the old contents.
+    internal void
+    UploadCulledSprites(SpriteCuller* Culler, UploadContext* Upload, SpriteEntityColumns* Columns, SpriteDefinition* Definitions)
+    {
+        Culler->ChunksUploaded = false;
+        uint32_t Bytes = GatherDirtySpriteChunks(Culler, Columns);
+        UploadDirtySpriteChunks(Culler, Upload, Columns, Definitions, Bytes);
+    }
+
+    // Note: Converts the dirty chunks straight into this frame's part of the dynamic ring, and commits them. Returns false,
+    // and leaves everything dirty, if the ring doesn't have the room.
+    internal bool32
+    WriteDirtySpriteChunks(SpriteCuller* Culler, DynamicRing* Ring, SpriteEntityColumns* Columns, SpriteDefinition* Definitions,
+                           uint32_t Bytes)
+    {
+        uint32_t RowCount = 0;
+        for (uint32_t Index = 0; Index < Culler->DirtyChunkCount; ++Index)
+        {
+            uint32_t First = Culler->DirtyChunks[Index] * VULKAN_SPRITE_CHUNK_ROWS;
+            RowCount += (Culler->DirtyCount - First < VULKAN_SPRITE_CHUNK_ROWS) ? Culler->DirtyCount - First : VULKAN_SPRITE_CHUNK_ROWS;
+        }
+
+        uint32_t InstanceOffset;
+        uint32_t AtlasOffset;
+        SpriteInstance* Instances = (SpriteInstance*)PushDynamicData(Ring, RowCount * sizeof(SpriteInstance), &InstanceOffset);
+        uint32_t* Atlases = Instances ? (uint32_t*)PushDynamicData(Ring, RowCount * sizeof(uint32_t), &AtlasOffset) : nullptr;
+        if (!Atlases)
+        {
+            return(false);
+        }
+
+        Culler->RegionCount = 0;
+        for (uint32_t Index = 0; Index < Culler->DirtyChunkCount; ++Index)
+        {
+            uint32_t Chunk = Culler->DirtyChunks[Index];
+            uint32_t First = Chunk * VULKAN_SPRITE_CHUNK_ROWS;
+            uint32_t ChunkRows = ConvertSpriteChunk(Culler, Columns, Definitions, Chunk, Instances, Atlases);
+
+            VkBufferCopy* InstanceRegion = &Culler->InstanceRegions[Culler->RegionCount];
+            InstanceRegion->srcOffset = InstanceOffset;
+            InstanceRegion->dstOffset = First * sizeof(SpriteInstance);
+            InstanceRegion->size = ChunkRows * sizeof(SpriteInstance);
+            VkBufferCopy* AtlasRegion = &Culler->AtlasRegions[Culler->RegionCount];
+            AtlasRegion->srcOffset = AtlasOffset;
+            AtlasRegion->dstOffset = First * sizeof(uint32_t);
+            AtlasRegion->size = ChunkRows * sizeof(uint32_t);
+            ++Culler->RegionCount;
+
+            Instances += ChunkRows;
+            Atlases += ChunkRows;
+            InstanceOffset += ChunkRows * sizeof(SpriteInstance);
+            AtlasOffset += ChunkRows * sizeof(uint32_t);
+        }
+
+        ++Culler->UploadStats.FrameCopies;
+        CommitDirtySpriteChunks(Culler, Columns, Bytes);
+        return(true);
+    }
+
+    // Note: Ahead of the simulation and the cull. Earlier frames' compute passes read (and the simulation writes) the
+    // source buffers, the barrier in front waits for them on the GPU.
+    internal void
+    RecordDirtySpriteChunks(SpriteCuller* Culler, VkCommandBuffer CommandBuffer, VkBuffer RingBuffer)
+    {
+        VkMemoryBarrier Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdCopyBuffer(CommandBuffer, RingBuffer, Culler->SourceInstances, Culler->RegionCount, Culler->InstanceRegions);
+        vkCmdCopyBuffer(CommandBuffer, RingBuffer, Culler->SourceAtlases, Culler->RegionCount, Culler->AtlasRegions);
+
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &Barrier, 0, nullptr, 0, nullptr);
+        Culler->RegionCount = 0;
+    }
+
+    internal int
+    FormatSpriteUploadStats(char* Text, int Size, SpriteUploadStats* Stats, uint64_t Frames)
+    {
+        Frames = Frames ? Frames : 1;
+        int Used = snprintf(Text, Size,
+            "sprite uploads (GPU culled): %.1fKB per frame avg, %llu chunks of %uKB in %llu updates (%u in frame, %u waited), last %.1fKB\n",
+            (double)Stats->Bytes / 1024.0 / (double)Frames, Stats->Chunks, VULKAN_SPRITE_CHUNK_SIZE / 1024, Stats->Updates,
+            Stats->FrameCopies, Stats->WaitedUploads, Stats->LastBytes / 1024.0);
+        return(ClampReportLength(Used, Size));
+    }
+
+    internal void
+    OutputSpriteUploadStats(SpriteUploadStats* Stats, uint64_t Frames)
+    {
+        char Text[256];
+        FormatSpriteUploadStats(Text, sizeof(Text), Stats, Frames);
+        OutputDebugStringA(Text);
+    }
+
+    // Note: Records the three compute passes. Has to go outside the render pass.
+    // DynamicOffsets are the camera's and the sheet transforms', VULKAN_CULL_DYNAMIC_OFFSET_COUNT of them.
+    internal void
+    RecordSpriteCull(SpriteCuller* Culler, VkCommandBuffer CommandBuffer, uint32_t FrameIndex, GeometryRange* Quad, uint32_t* DynamicOffsets)
+    {
+        SpriteCullFrame* Frame = &Culler->Frames[FrameIndex];
+
+        // Note: Zero the counters and every command, unused command slots then draw nothing.
+        vkCmdFillBuffer(CommandBuffer, Frame->Indirect, 0, sizeof(SpriteCullIndirect), 0);
+
+        VkMemoryBarrier Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+        SpriteCullConstants Constants = {};
+        Constants.InstanceCount = Culler->SourceCount;
+        Constants.QuadIndexCount = Quad->IndexCount;
+        Constants.QuadFirstIndex = Quad->FirstIndex;
+        Constants.QuadVertexOffset = Quad->VertexOffset;
+        vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Culler->PipelineLayout, 0, 1, &Frame->DescriptorSet,
+            VULKAN_CULL_DYNAMIC_OFFSET_COUNT, DynamicOffsets);
+        vkCmdPushConstants(CommandBuffer, Culler->PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants), &Constants);
+
+        uint32_t GroupCount = (Culler->SourceCount + VULKAN_CULL_GROUP_SIZE - 1) / VULKAN_CULL_GROUP_SIZE;
+        Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Culler->CullPipeline);
+        vkCmdDispatch(CommandBuffer, GroupCount, 1, 1);
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Culler->BuildPipeline);
+        vkCmdDispatch(CommandBuffer, 1, 1, 1); // Note: One thread per atlas.
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Culler->ScatterPipeline);
+        vkCmdDispatch(CommandBuffer, GroupCount, 1, 1);
+
+        Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            0, 1, &Barrier, 0, nullptr, 0, nullptr);
+    }
+
+    // Note: Records the draws inside the render pass. The sprite pipeline, vertex layout and sets (main and bindless) are
+    // the same as the CPU path, only the instance buffer and the draw parameters come from the compute pass.
+    // The geometry buffers have to be bound already.
+    internal void
+    RecordSpriteCullDraws(SpriteCuller* Culler, VkCommandBuffer CommandBuffer, uint32_t FrameIndex, VkPipeline SpritePipeline,
+                          VkPipelineLayout PipelineLayout, VkDescriptorSet* DescriptorSets, uint32_t* DynamicOffsets)
+    {
+        SpriteCullFrame* Frame = &Culler->Frames[FrameIndex];
+
+        vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, SpritePipeline);
+        vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, 2, DescriptorSets, VULKAN_DYNAMIC_OFFSET_COUNT, DynamicOffsets);
+
+        VkDeviceSize Offset = 0;
+        vkCmdBindVertexBuffers(CommandBuffer, 1, 1, &Frame->VisibleInstances, &Offset);
+
+        VkDeviceSize CommandsOffset = offsetof(SpriteCullIndirect, Commands);
+        uint32_t Stride = sizeof(VkDrawIndexedIndirectCommand);
+        if (Culler->DrawIndirectCount)
+        {
+            vkCmdDrawIndexedIndirectCount(CommandBuffer, Frame->Indirect, CommandsOffset,
+                Frame->Indirect, offsetof(SpriteCullIndirect, DrawCount), VULKAN_SPRITE_MAX_ATLASES, Stride);
+        }
+        else if (Culler->MultiDrawIndirect)
+        {
+            vkCmdDrawIndexedIndirect(CommandBuffer, Frame->Indirect, CommandsOffset, VULKAN_SPRITE_MAX_ATLASES, Stride);
+        }
+        else
+        {
+            for (uint32_t DrawIndex = 0; DrawIndex < VULKAN_SPRITE_MAX_ATLASES; ++DrawIndex)
+            {
+                vkCmdDrawIndexedIndirect(CommandBuffer, Frame->Indirect, CommandsOffset + DrawIndex * Stride, 1, Stride);
+            }
+        }
+    }
+}
@@ -0,0 +1,242 @@
+// Note: Deferred destruction.
+// Things that frames still in flight may be using are queued along with how many frames had been submitted at the time,
+// and destroyed once all of those frames are known to be done. DrawFrame retires the queue right after its fence wait,
+// when every frame up to the one that last used the slot has been waited on, so retiring never waits on anything.
+// Swap chain recreation is what this is for: the old swap chain is handed to the new one as oldSwapchain, and it,
+// its image views and its framebuffers are queued here instead of the whole device waiting idle for them.
+// The recreation times are kept here too, with whether it waited idle (the old way, still there with "-resizeidle").
+// Pipelines replaced by a shader hot reload (Vulkan_HotReload.cpp) go through here as well, and so do the textures the
+// defragmentation moved out of (Vulkan_Defrag.cpp), image, view and memory together.
+
+#define VULKAN_DEFERRED_DESTROY_CAPACITY    256 // Note: A recreation takes 2 per image + 1, a defragmentation pass one per move. Plenty for a resize every frame.
+
+namespace Vulkan
+{
+    enum DeferredDestroyKind
+    {
+        DeferredDestroyKind_Framebuffer,
+        DeferredDestroyKind_ImageView,
+        DeferredDestroyKind_Swapchain,
+        DeferredDestroyKind_Pipeline,
+        DeferredDestroyKind_Texture,
+    };
+
+    struct DeferredDestroy
+    {
+        DeferredDestroyKind Kind;
+        union
+        {
+            VkFramebuffer Framebuffer;
+            VkImageView ImageView;
+            VkSwapchainKHR Swapchain;
+            VkPipeline Pipeline;
+            BindlessTexture Texture;
+        };
+        uint64_t SubmittedFrames;   // Note: It goes once this many frames have finished. Usually the frames submitted when it was queued.
+    };
+
+    struct DeferredDestroyStats
+    {
+        uint64_t Queued;
+        uint64_t Destroyed;
+        uint32_t PeakCount;
+        uint32_t IdleWaits;         // Note: The queue was full and had to be emptied the slow way.
+    };
+
+    struct DeferredDestroyQueue
+    {
+        VkDevice Device;
+        DeviceMemoryAllocator* Allocator;   // Note: For the textures' memory.
+        DeferredDestroy Entries[VULKAN_DEFERRED_DESTROY_CAPACITY];
+        uint32_t Count;
+
+        DeferredDestroyStats Stats;
+    };
+
+    struct SwapChainRecreateStats
+    {
+        uint32_t Count;
+        uint32_t IdleCount;         // Note: Of those, how many waited for the device to go idle.
+        double TotalMS;
+        float MaxMS;
+        float LastMS;
+    };
+
+    internal void
+    InitDeferredDestroyQueue(DeferredDestroyQueue* Queue, VkDevice Device, DeviceMemoryAllocator* Allocator)
+    {
+        *Queue = {};
+        Queue->Device = Device;
+        Queue->Allocator = Allocator;
+    }
+
+    internal void
+    DestroyDeferred(DeferredDestroyQueue* Queue, DeferredDestroy* Entry)
+    {
+        VkDevice Device = Queue->Device;
+        switch (Entry->Kind)
+        {
+            case DeferredDestroyKind_Framebuffer:
+            {
+                vkDestroyFramebuffer(Device, Entry->Framebuffer, nullptr);
+            } break;
+            case DeferredDestroyKind_ImageView:
+            {
+                vkDestroyImageView(Device, Entry->ImageView, nullptr);
+            } break;
+            case DeferredDestroyKind_Swapchain:
+            {
+                vkDestroySwapchainKHR(Device, Entry->Swapchain, nullptr);
+            } break;
+            case DeferredDestroyKind_Pipeline:
+            {
+                vkDestroyPipeline(Device, Entry->Pipeline, nullptr);
+            } break;
+            case DeferredDestroyKind_Texture:
+            {
+                vkDestroyImageView(Device, Entry->Texture.View, nullptr);
+                vkDestroyImage(Device, Entry->Texture.Image, nullptr);
+                FreeDeviceMemory(Queue->Allocator, &Entry->Texture.Memory);
+            } break;
+        }
+    }
+
+    // Note: Only when nothing is in flight any more (after vkDeviceWaitIdle).
+    internal void
+    FlushDeferredDestroys(DeferredDestroyQueue* Queue)
+    {
+        for (uint32_t i = 0; i < Queue->Count; i++)
+        {
+            DestroyDeferred(Queue, &Queue->Entries[i]);
+        }
+        Queue->Stats.Destroyed += Queue->Count;
+        Queue->Count = 0;
+    }
+
+    // Note: CompletedFrames = how many frames, counted from the first, are known to have finished on the GPU.
+    internal void
+    RetireDeferredDestroys(DeferredDestroyQueue* Queue, uint64_t CompletedFrames)
+    {
+        // Note: Not all in order (an old swap chain is held longer than what's queued after it), so the whole queue is
+        // walked and what's left is packed down.
+        uint32_t KeptCount = 0;
+        for (uint32_t i = 0; i < Queue->Count; i++)
+        {
+            if (Queue->Entries[i].SubmittedFrames <= CompletedFrames)
+            {
+                DestroyDeferred(Queue, &Queue->Entries[i]);
+            }
+            else
+            {
+                Queue->Entries[KeptCount++] = Queue->Entries[i];
+            }
+        }
+
+        Queue->Stats.Destroyed += Queue->Count - KeptCount;
+        Queue->Count = KeptCount;
+    }
+
+    internal void
+    DeferDestroy(DeferredDestroyQueue* Queue, DeferredDestroy Entry)
+    {
+        if (Queue->Count == VULKAN_DEFERRED_DESTROY_CAPACITY)
+        {
+            // Note: Only with a lot of recreations inside a few frames. One idle wait is the price then.
+            vkDeviceWaitIdle(Queue->Device);
+            FlushDeferredDestroys(Queue);
+            ++Queue->Stats.IdleWaits;
+        }
+
+        Queue->Entries[Queue->Count++] = Entry;
+        ++Queue->Stats.Queued;
+        if (Queue->Count > Queue->Stats.PeakCount)
+        {
+            Queue->Stats.PeakCount = Queue->Count;
+        }
+    }
+
+    inline void
+    DeferDestroyFramebuffer(DeferredDestroyQueue* Queue, VkFramebuffer Framebuffer, uint64_t SubmittedFrames)
+    {
+        DeferredDestroy Entry = {};
+        Entry.Kind = DeferredDestroyKind_Framebuffer;
+        Entry.Framebuffer = Framebuffer;
+        Entry.SubmittedFrames = SubmittedFrames;
+        DeferDestroy(Queue, Entry);
+    }
+
+    inline void
+    DeferDestroyImageView(DeferredDestroyQueue* Queue, VkImageView ImageView, uint64_t SubmittedFrames)
+    {
+        DeferredDestroy Entry = {};
+        Entry.Kind = DeferredDestroyKind_ImageView;
+        Entry.ImageView = ImageView;
+        Entry.SubmittedFrames = SubmittedFrames;
+        DeferDestroy(Queue, Entry);
+    }
+
+    inline void
+    DeferDestroySwapchain(DeferredDestroyQueue* Queue, VkSwapchainKHR Swapchain, uint64_t SubmittedFrames)
+    {
+        DeferredDestroy Entry = {};
+        Entry.Kind = DeferredDestroyKind_Swapchain;
+        Entry.Swapchain = Swapchain;
+        Entry.SubmittedFrames = SubmittedFrames;
+        DeferDestroy(Queue, Entry);
+    }
+
+    inline void
+    DeferDestroyPipeline(DeferredDestroyQueue* Queue, VkPipeline Pipeline, uint64_t SubmittedFrames)
+    {
+        DeferredDestroy Entry = {};
+        Entry.Kind = DeferredDestroyKind_Pipeline;
+        Entry.Pipeline = Pipeline;
+        Entry.SubmittedFrames = SubmittedFrames;
+        DeferDestroy(Queue, Entry);
+    }
+
+    inline void
+    DeferDestroyTexture(DeferredDestroyQueue* Queue, BindlessTexture* Texture, uint64_t SubmittedFrames)
+    {
+        DeferredDestroy Entry = {};
+        Entry.Kind = DeferredDestroyKind_Texture;
+        Entry.Texture = *Texture;
+        Entry.SubmittedFrames = SubmittedFrames;
+        DeferDestroy(Queue, Entry);
+    }
+
+    inline void
+    AddSwapChainRecreate(SwapChainRecreateStats* Stats, float MS, bool32 WaitedIdle)
+    {
+        ++Stats->Count;
+        Stats->IdleCount += WaitedIdle ? 1 : 0;
+        Stats->TotalMS += MS;
+        Stats->LastMS = MS;
+        if (MS > Stats->MaxMS)
+        {
+            Stats->MaxMS = MS;
+        }
+    }
+
+    internal int
+    FormatSwapChainRecreateStats(char* Text, size_t Size, SwapChainRecreateStats* Stats)
+    {
+        double Count = Stats->Count ? (double)Stats->Count : 1.0;
+        int Used = snprintf(Text, Size,
+            "swap chain recreated %u times (%u waiting idle): %.3fms avg, %.3fms max, %.3fms last\n",
+            Stats->Count, Stats->IdleCount, Stats->TotalMS / Count, Stats->MaxMS, Stats->LastMS);
+        return(ClampReportLength(Used, Size));
+    }
+
+    internal void
+    OutputDeferredDestroyStats(DeferredDestroyQueue* Queue, SwapChainRecreateStats* RecreateStats)
+    {
+        char Text[512];
+        int Used = FormatSwapChainRecreateStats(Text, sizeof(Text), RecreateStats);
+        DeferredDestroyStats* Stats = &Queue->Stats;
+        snprintf(Text + Used, sizeof(Text) - Used,
+            "deferred destroys: %llu queued, %llu destroyed, %u peak of %d, %u idle waits\n",
+            Stats->Queued, Stats->Destroyed, Stats->PeakCount, VULKAN_DEFERRED_DESTROY_CAPACITY, Stats->IdleWaits);
+        OutputDebugStringA(Text);
+    }
+}
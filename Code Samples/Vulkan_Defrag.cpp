@@ -0,0 +1,236 @@
+// Note: Defragmentation of the image blocks.
+// A buffer or image can't be bound to other memory, so moving a sub-allocation means making a new one somewhere else,
+// copying on the GPU, and pointing whoever uses it at the new one. The bindless textures are the ones that can be moved
+// like that: they come and go at runtime (RegisterTexture / ReleaseTexture), which is where the holes come from, and
+// they're only ever reached through their ID, so the table just gets the new view at the same ID. Everything else
+// lives as long as the renderer does and stays where it is.
+// Every VULKAN_DEFRAG_CHECK_INTERVAL frames DrawFrame looks for the emptiest image block that holds nothing but bindless
+// textures, in a memory type that's over VULKAN_DEFRAG_THRESHOLD fragmented, whose contents fit into the other blocks.
+// Its textures move into those (never into a new block) and the block goes back to the driver.
+// Nothing is waited on. A pass goes in three stages, each at the start of a DrawFrame once the GPU has caught up:
+// - The copies go out as an upload batch. The frame recorded next waits on them on the GPU, like on any upload.
+// - Once that frame is done, and at a DrawFrame where no other frame is in flight either, every ID is pointed at its
+//   copy. A texture descriptor that a submitted frame might read can't be rewritten (the bindless array is only
+//   update-unused-while-pending), so this stage polls the fences of all the frames in flight and waits for a frame
+//   that finds them all signaled. The old images go into the deferred destroy queue. A texture the game released
+//   and the table destroyed meanwhile just loses its copy.
+// - Once the deferred destroys have run, the old images are gone and the empty block goes back to the driver.
+// The block takes no new allocations while it's being emptied, and no new pass starts until the last one is done.
+// A pass never moves more than VULKAN_DEFRAG_MAX_MOVE_BYTES, so the copies stay a small upload.
+
+#define VULKAN_DEFRAG_CHECK_INTERVAL    120
+#define VULKAN_DEFRAG_THRESHOLD         0.5f
+#define VULKAN_DEFRAG_MAX_MOVES         64
+#define VULKAN_DEFRAG_MAX_MOVE_BYTES    (16 * 1024 * 1024)
+
+namespace Vulkan
+{
+    struct DefragMove
+    {
+        uint32_t ID;
+        VkImage OldImage;           // Note: What the ID pointed at when the copy was recorded.
+        BindlessTexture New;
+    };
+
+    enum DefragStage
+    {
+        DefragStage_Idle,
+        DefragStage_Copying,        // Note: The copies are out, the IDs still point at the old images.
+        DefragStage_Releasing,      // Note: The IDs point at the copies, the old images are in the deferred destroy queue.
+    };
+
+    struct DefragPass
+    {
+        DefragStage Stage;
+        uint32_t BlockIndex;
+        uint64_t UploadValue;       // Note: Signaled once the copies are done.
+        uint64_t StageFrames;       // Note: How many frames have to be done before the next stage.
+        DefragMove Moves[VULKAN_DEFRAG_MAX_MOVES];
+        uint32_t MoveCount;
+        VkDeviceSize MovedBytes;
+        float MS;                   // Note: CPU time of the stages so far.
+    };
+
+    struct DefragStats
+    {
+        uint32_t Checks;
+        uint32_t Passes;
+        uint64_t Moves;
+        uint64_t MovedBytes;
+        uint32_t BlocksReleased;
+        uint32_t FailedMoves;       // Note: Didn't fit into the other blocks after all (buddy pieces are powers of two).
+        float TotalMS;              // Note: CPU time, all stages of a pass together.
+        float MaxMS;
+    };
+
+    // Note: Same measure as MemoryStats::Fragmentation, over the blocks of one memory type and kind.
+    internal float
+    GetMemoryTypeFragmentation(DeviceMemoryAllocator* Allocator, uint32_t MemoryTypeIndex, MemoryResourceKind Kind)
+    {
+        VkDeviceSize FreeBytes = 0;
+        VkDeviceSize LargestFreeBytes = 0;
+        for (uint32_t BlockIndex = 0; BlockIndex < Allocator->BlockCount; ++BlockIndex)
+        {
+            MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+            if (Block->Memory != VK_NULL_HANDLE && !Block->Dedicated && Block->MemoryTypeIndex == MemoryTypeIndex && Block->Kind == Kind)
+            {
+                FreeBytes += Block->Size - Block->UsedBytes;
+                if (Block->Tree[1] && MemorySizeForOrder(Block->Tree[1] - 1) > LargestFreeBytes)
+                {
+                    LargestFreeBytes = MemorySizeForOrder(Block->Tree[1] - 1);
+                }
+            }
+        }
+
+        float Result = (FreeBytes > 0) ? 1.0f - (float)LargestFreeBytes / (float)FreeBytes : 0.0f;
+        return(Result);
+    }
+
+    // Note: The block to evacuate, or VULKAN_MEMORY_NO_BLOCK if there's nothing worth doing.
+    internal uint32_t
+    PickDefragBlock(DeviceMemoryAllocator* Allocator, BindlessTable* Table)
+    {
+        uint32_t TextureCounts[VULKAN_MEMORY_MAX_BLOCKS] = {};
+        for (uint32_t ID = 0; ID < VULKAN_BINDLESS_ARRAY_SIZE; ++ID)
+        {
+            BindlessTexture* Texture = &Table->Textures[ID];
+            if (Texture->Image)
+            {
+                Assert(Allocator->Blocks[Texture->Memory.BlockIndex].Memory == Texture->Memory.Memory);
+                ++TextureCounts[Texture->Memory.BlockIndex];
+            }
+        }
+
+        uint32_t Result = VULKAN_MEMORY_NO_BLOCK;
+        VkDeviceSize ResultUsedBytes = 0;
+        for (uint32_t BlockIndex = 0; BlockIndex < Allocator->BlockCount; ++BlockIndex)
+        {
+            MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+            if (Block->Memory == VK_NULL_HANDLE || Block->Dedicated || Block->Kind != MemoryResourceKind_Optimal ||
+                !Block->AllocationCount || Block->AllocationCount != TextureCounts[BlockIndex] ||
+                Block->AllocationCount > VULKAN_DEFRAG_MAX_MOVES || Block->UsedBytes > VULKAN_DEFRAG_MAX_MOVE_BYTES ||
+                (Result != VULKAN_MEMORY_NO_BLOCK && Block->UsedBytes >= ResultUsedBytes))
+            {
+                continue;
+            }
+
+            VkDeviceSize FreeElsewhere = 0;
+            for (uint32_t OtherIndex = 0; OtherIndex < Allocator->BlockCount; ++OtherIndex)
+            {
+                MemoryBlock* Other = &Allocator->Blocks[OtherIndex];
+                if (OtherIndex != BlockIndex && Other->Memory != VK_NULL_HANDLE && !Other->Dedicated &&
+                    Other->MemoryTypeIndex == Block->MemoryTypeIndex && Other->Kind == Block->Kind)
+                {
+                    FreeElsewhere += Other->Size - Other->UsedBytes;
+                }
+            }
+
+            if (FreeElsewhere >= Block->UsedBytes &&
+                GetMemoryTypeFragmentation(Allocator, Block->MemoryTypeIndex, Block->Kind) > VULKAN_DEFRAG_THRESHOLD)
+            {
+                Result = BlockIndex;
+                ResultUsedBytes = Block->UsedBytes;
+            }
+        }
+        return(Result);
+    }
+
+    // Note: Into the current upload batch. Both images are in GENERAL, where bindless textures live; the source may
+    // have been uploaded to earlier in the same batch.
+    internal void
+    RecordTextureMove(UploadContext* Upload, VkImage Source, VkImage Destination, VkExtent2D Extent)
+    {
+        VkCommandBuffer CommandBuffer = BeginUploadBatch(Upload);
+
+        VkImageMemoryBarrier Barriers[2] = {};
+        Barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        Barriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        Barriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        Barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barriers[0].image = Source;
+        Barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Barriers[0].subresourceRange.levelCount = 1;
+        Barriers[0].subresourceRange.layerCount = 1;
+        Barriers[1] = Barriers[0];
+        Barriers[1].srcAccessMask = 0;
+        Barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Barriers[1].image = Destination;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 2, Barriers);
+
+        VkImageCopy Copy = {};
+        Copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Copy.srcSubresource.layerCount = 1;
+        Copy.dstSubresource = Copy.srcSubresource;
+        Copy.extent = { Extent.width, Extent.height, 1 };
+        vkCmdCopyImage(CommandBuffer, Source, VK_IMAGE_LAYOUT_GENERAL, Destination, VK_IMAGE_LAYOUT_GENERAL, 1, &Copy);
+    }
+
+    // Note: For a copy no descriptor ever pointed at, so nothing in flight can be using it.
+    internal void
+    DestroyDefragCopy(VkDevice Device, DeviceMemoryAllocator* Allocator, DefragMove* Move)
+    {
+        vkDestroyImageView(Device, Move->New.View, nullptr);
+        vkDestroyImage(Device, Move->New.Image, nullptr);
+        FreeDeviceMemory(Allocator, &Move->New.Memory);
+        Move->New = {};
+    }
+
+    // Note: At shutdown, after vkDeviceWaitIdle. The copies that weren't switched to go, the old images are the table's
+    // or the deferred destroy queue's.
+    internal void
+    CancelDefragPass(DefragPass* Pass, VkDevice Device, DeviceMemoryAllocator* Allocator)
+    {
+        if (Pass->Stage == DefragStage_Copying)
+        {
+            for (uint32_t MoveIndex = 0; MoveIndex < Pass->MoveCount; ++MoveIndex)
+            {
+                DestroyDefragCopy(Device, Allocator, &Pass->Moves[MoveIndex]);
+            }
+        }
+        if (Pass->Stage != DefragStage_Idle)
+        {
+            Allocator->Blocks[Pass->BlockIndex].Evacuating = false;
+        }
+        Pass->Stage = DefragStage_Idle;
+    }
+
+    internal void
+    AddDefragPass(DefragStats* Stats, uint32_t MoveCount, VkDeviceSize MovedBytes, bool32 BlockReleased, float MS)
+    {
+        ++Stats->Passes;
+        Stats->Moves += MoveCount;
+        Stats->MovedBytes += MovedBytes;
+        if (BlockReleased)
+        {
+            ++Stats->BlocksReleased;
+        }
+        Stats->TotalMS += MS;
+        if (MS > Stats->MaxMS)
+        {
+            Stats->MaxMS = MS;
+        }
+    }
+
+    internal int
+    FormatDefragStats(char* Text, int Size, DefragStats* Stats)
+    {
+        int Used = snprintf(Text, Size,
+            "defragmentation: %u passes in %u checks, %llu textures moved (%.2fMB), %u blocks released, %u failed moves, %.3fms total, %.3fms max\n",
+            Stats->Passes, Stats->Checks, Stats->Moves, Stats->MovedBytes / (1024.0 * 1024.0), Stats->BlocksReleased,
+            Stats->FailedMoves, Stats->TotalMS, Stats->MaxMS);
+        return(ClampReportLength(Used, Size));
+    }
+
+    internal void
+    OutputDefragStats(DefragStats* Stats)
+    {
+        char Text[256];
+        FormatDefragStats(Text, sizeof(Text), Stats);
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,141 @@
+// Note: Per frame dynamic data.
+// One persistently mapped, host visible buffer with a region per frame in flight. Everything that changes every frame
+// (the camera, the per object transforms) is bump allocated out of the current frame's region, and the shaders reach it
+// through the dynamic offsets of one descriptor set that is written once at startup. Drawing more objects never means
+// allocating, writing or binding another set, only passing other offsets to vkCmdBindDescriptorSets.
+// A region is reused once its frame's fence has signaled. Small things that change per draw (which objects, a tint)
+// go in push constants instead, see ObjectDrawConstants.
+
+#define VULKAN_DYNAMIC_RING_FRAME_SIZE  (4 * 1024 * 1024)   // Note: A little over 50K objects per frame besides the camera.
+#define VULKAN_DYNAMIC_OFFSET_COUNT     2   // Note: Per bind of the main set: 0 = camera (uniform), 1 = objects (storage).
+#define VULKAN_MAX_OBJECT_BATCHES       64
+
+namespace Vulkan
+{
+    // Note: Mirrors ObjectData in object.vert (std430, 80 bytes).
+    struct ObjectData
+    {
+        glm::mat4 Model;
+        glm::vec4 Color;
+    };
+
+    // Note: Mirrors the push constant block in object.vert. Stays well under the 128 bytes every device has.
+    struct ObjectDrawConstants
+    {
+        uint32_t FirstObject;   // Note: Into this frame's object array; gl_InstanceIndex is added on top.
+        uint32_t Pad[3];
+        glm::vec4 Tint;
+    };
+
+    // Note: One SubmitObjects call. The objects are the caller's until DrawFrame copies them into the ring.
+    // Which mesh they draw is settled then too: a static mesh by ID, or dynamic geometry (also the caller's until then)
+    // pushed into the frame's part of the geometry buffer. Mesh is where it ended up.
+    struct ObjectBatch
+    {
+        ObjectData* Objects;
+        uint32_t Count;
+        uint32_t FirstObject;
+        glm::vec4 Tint;
+
+        uint32_t MeshID;                // Note: VULKAN_GEOMETRY_INVALID_MESH for dynamic geometry.
+        const void* DynamicVertices;
+        uint32_t DynamicVertexCount;
+        const uint32_t* DynamicIndices;
+        uint32_t DynamicIndexCount;
+        GeometryRange Mesh;
+    };
+
+    struct DynamicRingStats
+    {
+        uint64_t Frames;
+        uint64_t Allocations;
+        uint64_t FailedAllocations; // Note: Didn't fit in the frame's region, the data was dropped.
+        uint64_t BytesUsed;
+        VkDeviceSize PeakFrameBytes;
+    };
+
+    struct DynamicRing
+    {
+        VkBuffer Buffer;
+        uint8_t* Base;              // Note: Mapped, write-only from the CPU's side.
+        VkDeviceSize FrameSize;
+        VkDeviceSize Alignment;     // Note: The larger of the uniform and storage buffer offset alignments.
+        uint32_t FrameIndex;
+        VkDeviceSize Used;          // Note: Within the current frame's region.
+
+        DynamicRingStats Stats;
+    };
+
+    internal void
+    InitDynamicRing(DynamicRing* Ring, VkBuffer Buffer, void* Mapped, VkDeviceSize FrameSize,
+                    VkDeviceSize UniformAlignment, VkDeviceSize StorageAlignment)
+    {
+        *Ring = {};
+        Ring->Buffer = Buffer;
+        Ring->Base = (uint8_t*)Mapped;
+        Ring->FrameSize = FrameSize;
+        Ring->Alignment = (UniformAlignment > StorageAlignment) ? UniformAlignment : StorageAlignment;
+        if (Ring->Alignment < 16)
+        {
+            Ring->Alignment = 16;
+        }
+    }
+
+    // Note: Only once the frame's fence has signaled, the GPU may still be reading the region before that.
+    internal void
+    BeginDynamicFrame(DynamicRing* Ring, uint32_t FrameIndex)
+    {
+        if (Ring->Used > Ring->Stats.PeakFrameBytes)
+        {
+            Ring->Stats.PeakFrameBytes = Ring->Used;
+        }
+        Ring->FrameIndex = FrameIndex;
+        Ring->Used = 0;
+        ++Ring->Stats.Frames;
+    }
+
+    // Note: Returns where to write Size bytes, and their dynamic offset from the start of the buffer.
+    // Returns null if the frame's region is full; nothing is allocated then.
+    internal void*
+    PushDynamicData(DynamicRing* Ring, VkDeviceSize Size, uint32_t* Offset)
+    {
+        VkDeviceSize Start = (Ring->Used + Ring->Alignment - 1) & ~(Ring->Alignment - 1);
+        if (Start + Size > Ring->FrameSize)
+        {
+            ++Ring->Stats.FailedAllocations;
+            return(nullptr);
+        }
+
+        Ring->Used = Start + Size;
+        ++Ring->Stats.Allocations;
+        Ring->Stats.BytesUsed += Size;
+
+        VkDeviceSize BufferOffset = Ring->FrameIndex * Ring->FrameSize + Start;
+        *Offset = (uint32_t)BufferOffset;
+        return(Ring->Base + BufferOffset);
+    }
+
+    // Note: How many more objects fit in this frame's region, with ReservedBytes left over for what's pushed after them.
+    inline uint32_t
+    GetDynamicObjectCapacity(DynamicRing* Ring, VkDeviceSize ReservedBytes)
+    {
+        VkDeviceSize Start = (Ring->Used + Ring->Alignment - 1) & ~(Ring->Alignment - 1);
+        VkDeviceSize End = (ReservedBytes < Ring->FrameSize) ? Ring->FrameSize - ReservedBytes : 0;
+        uint32_t Result = (Start < End) ? (uint32_t)((End - Start) / sizeof(ObjectData)) : 0;
+        return(Result);
+    }
+
+    internal void
+    OutputDynamicRingStats(DynamicRing* Ring)
+    {
+        DynamicRingStats* Stats = &Ring->Stats;
+        uint64_t Frames = Stats->Frames ? Stats->Frames : 1;
+        char Text[256];
+        snprintf(Text, sizeof(Text),
+            "dynamic ring: %llu frames, %llu allocations (%llu failed), %.1fKB/frame avg, %.1fKB peak of %.1fKB\n",
+            Stats->Frames, Stats->Allocations, Stats->FailedAllocations,
+            (double)Stats->BytesUsed / (1024.0 * (double)Frames), (double)Stats->PeakFrameBytes / 1024.0,
+            (double)Ring->FrameSize / 1024.0);
+        OutputDebugStringA(Text);
+    }
+}
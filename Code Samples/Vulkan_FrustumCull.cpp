@@ -0,0 +1,205 @@
+// Note: CPU frustum culling, for the CPU filled sprites.
+// The sprites are spheres (position, half the diagonal of the size), tested against the six planes of the camera's
+// view projection, the same test sprite_cull.comp does on the GPU side. The planes are kept SoA, and with AVX2 eight
+// rows go through each plane at once: their positions and sizes are gathered straight out of the game's columns.
+// The result is a bit per row (a byte per eight rows), so slices that start on a multiple of 8 never share a byte
+// and can be culled on different threads. Without AVX2 the same math runs one row at a time; the multiplies and adds
+// happen in the same order either way, so both paths keep the same rows.
+
+#include <immintrin.h>
+#include <intrin.h>
+
+#define VULKAN_FRUSTUM_PLANE_COUNT  6
+#define VULKAN_CULL_ROWS_PER_MASK   8
+
+namespace Vulkan
+{
+    // Note: Normalized, a sphere is inside a plane when X*x + Y*y + Z*z + W >= -radius.
+    struct FrustumPlanes
+    {
+        float X[VULKAN_FRUSTUM_PLANE_COUNT];
+        float Y[VULKAN_FRUSTUM_PLANE_COUNT];
+        float Z[VULKAN_FRUSTUM_PLANE_COUNT];
+        float W[VULKAN_FRUSTUM_PLANE_COUNT];
+    };
+
+    struct FrustumCullStats
+    {
+        uint64_t Frames;
+        uint64_t Visible;
+        uint64_t Culled;
+        uint32_t LastVisible;
+        uint32_t LastCulled;
+    };
+
+    internal bool32
+    CPUHasAVX2()
+    {
+        int Info[4];
+        __cpuid(Info, 0);
+        if (Info[0] < 7)
+        {
+            return(false);
+        }
+
+        // Note: The OS has to save the YMM registers too (OSXSAVE, then XCR0 bits 1 and 2).
+        __cpuid(Info, 1);
+        if (!(Info[2] & (1 << 27)) || !(Info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+        {
+            return(false);
+        }
+
+        __cpuidex(Info, 7, 0);
+        return((Info[1] & (1 << 5)) != 0);
+    }
+
+    // Note: Vulkan clip space, 0 <= z <= w, so the near plane is just the third row.
+    internal void
+    ExtractFrustumPlanes(FrustumPlanes* Planes, glm::mat4 ViewProjection)
+    {
+        glm::vec4 Row0 = glm::vec4(ViewProjection[0][0], ViewProjection[1][0], ViewProjection[2][0], ViewProjection[3][0]);
+        glm::vec4 Row1 = glm::vec4(ViewProjection[0][1], ViewProjection[1][1], ViewProjection[2][1], ViewProjection[3][1]);
+        glm::vec4 Row2 = glm::vec4(ViewProjection[0][2], ViewProjection[1][2], ViewProjection[2][2], ViewProjection[3][2]);
+        glm::vec4 Row3 = glm::vec4(ViewProjection[0][3], ViewProjection[1][3], ViewProjection[2][3], ViewProjection[3][3]);
+
+        glm::vec4 Source[VULKAN_FRUSTUM_PLANE_COUNT] = { Row3 + Row0, Row3 - Row0, Row3 + Row1, Row3 - Row1, Row2, Row3 - Row2 };
+        for (uint32_t PlaneIndex = 0; PlaneIndex < VULKAN_FRUSTUM_PLANE_COUNT; ++PlaneIndex)
+        {
+            glm::vec4 Plane = Source[PlaneIndex] / glm::length(glm::vec3(Source[PlaneIndex]));
+            Planes->X[PlaneIndex] = Plane.x;
+            Planes->Y[PlaneIndex] = Plane.y;
+            Planes->Z[PlaneIndex] = Plane.z;
+            Planes->W[PlaneIndex] = Plane.w;
+        }
+    }
+
+    inline bool32
+    SphereInFrustum(FrustumPlanes* Planes, glm::vec3 Center, glm::vec2 Size)
+    {
+        float Radius = 0.5f * sqrtf(Size.x * Size.x + Size.y * Size.y);
+        for (uint32_t PlaneIndex = 0; PlaneIndex < VULKAN_FRUSTUM_PLANE_COUNT; ++PlaneIndex)
+        {
+            float Distance = Center.x * Planes->X[PlaneIndex] + Center.y * Planes->Y[PlaneIndex] +
+                             Center.z * Planes->Z[PlaneIndex] + Planes->W[PlaneIndex];
+            if (!(Distance >= -Radius))
+            {
+                return(false);
+            }
+        }
+        return(true);
+    }
+
+    // Note: Rows RowBegin up to RowEnd, RowBegin a multiple of 8. Masks is indexed by Row / 8 and written a whole byte
+    // at a time. Returns how many rows are visible.
+    internal uint32_t
+    CullSpheresScalar(FrustumPlanes* Planes, glm::vec3* Positions, glm::vec2* Sizes, uint32_t RowBegin, uint32_t RowEnd, uint8_t* Masks)
+    {
+        Assert((RowBegin % VULKAN_CULL_ROWS_PER_MASK) == 0);
+        uint32_t Visible = 0;
+        for (uint32_t GroupRow = RowBegin; GroupRow < RowEnd; GroupRow += VULKAN_CULL_ROWS_PER_MASK)
+        {
+            uint32_t GroupEnd = (RowEnd - GroupRow < VULKAN_CULL_ROWS_PER_MASK) ? RowEnd : GroupRow + VULKAN_CULL_ROWS_PER_MASK;
+            uint32_t Mask = 0;
+            for (uint32_t Row = GroupRow; Row < GroupEnd; ++Row)
+            {
+                if (SphereInFrustum(Planes, Positions[Row], Sizes[Row]))
+                {
+                    Mask |= 1 << (Row - GroupRow);
+                    ++Visible;
+                }
+            }
+            Masks[GroupRow / VULKAN_CULL_ROWS_PER_MASK] = (uint8_t)Mask;
+        }
+        return(Visible);
+    }
+
+    // Note: Same as CullSpheresScalar, eight rows at a time. Only call it if CPUHasAVX2.
+    internal uint32_t
+    CullSpheresAVX2(FrustumPlanes* Planes, glm::vec3* Positions, glm::vec2* Sizes, uint32_t RowBegin, uint32_t RowEnd, uint8_t* Masks)
+    {
+        Assert((RowBegin % VULKAN_CULL_ROWS_PER_MASK) == 0);
+        uint32_t FullEnd = RowBegin + ((RowEnd - RowBegin) & ~(VULKAN_CULL_ROWS_PER_MASK - 1));
+
+        __m256 PlaneX[VULKAN_FRUSTUM_PLANE_COUNT];
+        __m256 PlaneY[VULKAN_FRUSTUM_PLANE_COUNT];
+        __m256 PlaneZ[VULKAN_FRUSTUM_PLANE_COUNT];
+        __m256 PlaneW[VULKAN_FRUSTUM_PLANE_COUNT];
+        for (uint32_t PlaneIndex = 0; PlaneIndex < VULKAN_FRUSTUM_PLANE_COUNT; ++PlaneIndex)
+        {
+            PlaneX[PlaneIndex] = _mm256_set1_ps(Planes->X[PlaneIndex]);
+            PlaneY[PlaneIndex] = _mm256_set1_ps(Planes->Y[PlaneIndex]);
+            PlaneZ[PlaneIndex] = _mm256_set1_ps(Planes->Z[PlaneIndex]);
+            PlaneW[PlaneIndex] = _mm256_set1_ps(Planes->W[PlaneIndex]);
+        }
+
+        // Note: Float offsets of eight consecutive vec3s and vec2s.
+        __m256i PositionIndices = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        __m256i SizeIndices = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+        __m256 Half = _mm256_set1_ps(0.5f);
+        __m256 SignBit = _mm256_set1_ps(-0.0f);
+
+        uint32_t Visible = 0;
+        for (uint32_t GroupRow = RowBegin; GroupRow < FullEnd; GroupRow += VULKAN_CULL_ROWS_PER_MASK)
+        {
+            float* Position = (float*)&Positions[GroupRow];
+            float* Size = (float*)&Sizes[GroupRow];
+            __m256 X = _mm256_i32gather_ps(Position + 0, PositionIndices, 4);
+            __m256 Y = _mm256_i32gather_ps(Position + 1, PositionIndices, 4);
+            __m256 Z = _mm256_i32gather_ps(Position + 2, PositionIndices, 4);
+            __m256 Width = _mm256_i32gather_ps(Size + 0, SizeIndices, 4);
+            __m256 Height = _mm256_i32gather_ps(Size + 1, SizeIndices, 4);
+
+            __m256 Radius = _mm256_mul_ps(Half, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(Width, Width), _mm256_mul_ps(Height, Height))));
+            __m256 NegativeRadius = _mm256_xor_ps(Radius, SignBit);
+
+            __m256 Inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (uint32_t PlaneIndex = 0; PlaneIndex < VULKAN_FRUSTUM_PLANE_COUNT; ++PlaneIndex)
+            {
+                __m256 Distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(X, PlaneX[PlaneIndex]), _mm256_mul_ps(Y, PlaneY[PlaneIndex])),
+                    _mm256_mul_ps(Z, PlaneZ[PlaneIndex])), PlaneW[PlaneIndex]);
+                Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(Distance, NegativeRadius, _CMP_GE_OQ));
+            }
+
+            uint32_t Mask = (uint32_t)_mm256_movemask_ps(Inside);
+            Masks[GroupRow / VULKAN_CULL_ROWS_PER_MASK] = (uint8_t)Mask;
+            Visible += __popcnt(Mask);
+        }
+
+        // Note: The last few rows of the columns.
+        if (FullEnd < RowEnd)
+        {
+            Visible += CullSpheresScalar(Planes, Positions, Sizes, FullEnd, RowEnd, Masks);
+        }
+        return(Visible);
+    }
+
+    internal void
+    AddFrustumCullFrame(FrustumCullStats* Stats, uint32_t Visible, uint32_t Culled)
+    {
+        ++Stats->Frames;
+        Stats->Visible += Visible;
+        Stats->Culled += Culled;
+        Stats->LastVisible = Visible;
+        Stats->LastCulled = Culled;
+    }
+
+    internal int
+    FormatFrustumCullStats(char* Text, int Size, FrustumCullStats* Stats, bool32 AVX2)
+    {
+        uint64_t Frames = Stats->Frames ? Stats->Frames : 1;
+        int Used = snprintf(Text, Size,
+            "sprite culling (CPU, %s): %.0f visible, %.0f culled per frame avg; last frame %u visible, %u culled\n",
+            AVX2 ? "AVX2" : "scalar", (double)Stats->Visible / (double)Frames, (double)Stats->Culled / (double)Frames,
+            Stats->LastVisible, Stats->LastCulled);
+        return(ClampReportLength(Used, Size));
+    }
+
+    internal void
+    OutputFrustumCullStats(FrustumCullStats* Stats, bool32 AVX2)
+    {
+        char Text[256];
+        FormatFrustumCullStats(Text, sizeof(Text), Stats, AVX2);
+        OutputDebugStringA(Text);
+    }
+}
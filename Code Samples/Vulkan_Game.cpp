@@ -5,16 +5,16 @@
 #include <vulkan/vulkan.h>
 #include <stdexcept>
 #include <cstdlib> // Note: This just stores EXIT_SUCCESS and EXIT_FAILURE macros.
-// Todo: Replace these with simple arrays (reduces compile time)
+// Todo: Replace these with simple arrays (reduces compile time). Only startup uses them now, nothing per frame.
 #include <vector>
 #include <map>
 #include <set>
 #include <cstdint>      // Necessary for uint32_t
-#include <array>
 // Make geometry spin around
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <chrono>
+#include <cstdio>
 
 #define GLM_FORCE_RADIANS
 
@@ -30,8 +30,58 @@ typedef int32_t bool32;
 #define Assert(Expression)
 #endif
 
+#define VULKAN_MAX_FRAMES_IN_FLIGHT 4     // Note: Array sizes. How many are actually used is set at runtime (SetFramesInFlight).
+#define VULKAN_DEFAULT_FRAMES_IN_FLIGHT 2
+#define VULKAN_MAX_SWAPCHAIN_IMAGES 8     // Note: More than any driver hands out; extra images are left alone.
+#define VULKAN_MAX_SURFACE_FORMATS 64
+#define VULKAN_MAX_PRESENT_MODES 8
+#define VULKAN_MAX_QUEUE_FAMILIES 16
+
+// Note: snprintf returns the length it wanted, not what it wrote. The stats reports clamp that to Size - 1 with this
+// so the next part appends at the terminator and returned lengths add up to what's actually in the buffer.
+inline int
+ClampReportLength(int Used, size_t Size)
+{
+    if (Used > (int)Size - 1)
+    {
+        Used = (int)Size - 1;
+    }
+    return(Used);
+}
+
+#include "Vulkan_Jobs.cpp"
+#include "Vulkan_HeapCheck.cpp"
+#include "Vulkan_Memory.cpp"
+#include "Vulkan_Timing.cpp"
+#include "Vulkan_Upload.cpp"
+#include "Vulkan_VertexLayout.cpp"
+#include "Vulkan_Geometry.cpp"
+#include "Vulkan_Bindless.cpp"
+#include "Vulkan_Defrag.cpp"
+#include "Vulkan_FrustumCull.cpp"
+#include "Vulkan_Sprites.cpp"
+#include "Vulkan_DynamicRing.cpp"
+#include "Vulkan_Atlas.cpp"
+#include "Vulkan_Culling.cpp"
+#include "Vulkan_Simulation.cpp"
+#include "Vulkan_Recording.cpp"
+#include "Vulkan_PipelineCache.cpp"
+#include "Vulkan_Readback.cpp"
+#include "Vulkan_SoftwarePresent.cpp"
+#include "Vulkan_RenderGraph.cpp"
+#include "Vulkan_Deferred.cpp"
+#include "Vulkan_HotReload.cpp"
+
 namespace Vulkan
 {
+    // Note: Handed back to the platform for every presented frame, so it can close out a latency event.
+    struct FrameLatencyStamp
+    {
+        uint32_t InputID;       // Note: 0 when no input was tagged for this frame.
+        int64_t SubmitCounter;  // Note: QueryPerformanceCounter after vkQueueSubmit returned.
+        int64_t PresentCounter; // Note: QueryPerformanceCounter after vkQueuePresentKHR returned (not scan-out).
+    };
+
     class HelloTriangleApplication
     {
 
@@ -39,110 +89,325 @@ namespace Vulkan
         // For now I'm just passing the game memory so that we can read files to test shader compilation
         void InitVulkan(HWND Window, HINSTANCE Instance, game_memory* GameMemory)
         {
+            LARGE_INTEGER startCounter;
+            QueryPerformanceCounter(&startCounter);
+            gameMemory = GameMemory;
+
             CreateInstance();
+#if Game_SLOW
             SetupDebugMesseger();
-            CreateSurface(Window, Instance);
+#endif
+            if (!headless) {
+                CreateSurface(Window, Instance);
+            }
             PickPhysicalDevice();
             CreateLogicalDevice();
-            RECT ClientRect;
-            GetClientRect(Window, &ClientRect);
-            int FrameBufferWidth = ClientRect.right - ClientRect.left;
-            int FrameBufferHeight = ClientRect.bottom - ClientRect.top;
-            CreateSwapChain(FrameBufferWidth, FrameBufferHeight);
+            InitDeviceMemoryAllocator(&memoryAllocator, physicalDevice, _Device, memoryBudgetEnabled);
+            InitDeferredDestroyQueue(&deferredDestroys, _Device, &memoryAllocator);
+            InitBindlessTable(&bindlessTable, _Device, &memoryAllocator); // Note: Set 1 of the pipeline layout.
+            InitPipelineCache(&pipelineCache, physicalDevice, _Device, GameMemory);
+            InitShaderReload(&shaderReload, _Device, GameMemory);
+            if (headless) {
+                CreateOffscreenImages();
+            }
+            else {
+                RECT ClientRect;
+                GetClientRect(Window, &ClientRect);
+                int FrameBufferWidth = ClientRect.right - ClientRect.left;
+                int FrameBufferHeight = ClientRect.bottom - ClientRect.top;
+                CreateSwapChain(FrameBufferWidth, FrameBufferHeight);
+                lastFrameBufferWidth = FrameBufferWidth;
+                lastFrameBufferHeight = FrameBufferHeight;
+            }
             CreateImageViews();
             CreateRenderPass();
+            CreateDescriptorSetLayout(); // Note: The pipeline layout needs this, so it has to come first.
             CreateGraphicsPipeline(GameMemory);
-            CreateDescriptorSetLayout();
             CreateFramebuffers();
             CreateCommandPool();
-            CreateVertexBuffer();
-            CreateIndexBuffer();
-            CreateUniformBuffers();
+            CreateUploadContext();
+            CreateGeometryBuffer();
+            CreateSpriteAtlas();
+            FlushUploads(&uploadContext); // Note: The first DrawFrame waits on this on the GPU.
+            CreateDynamicRing();
+            CreateSpriteRenderer(GameMemory);
+            CreateSpriteCuller(GameMemory);
+            CreateSpriteSimulation(GameMemory);
+            if (!headless) {
+                CreateSoftwarePresent();
+            }
             CreateDescriptorPool();
             CreateDescriptorSets();
-            CreateCommandBuffers();
             CreateSyncObjects();
+            InitGPUTimer(&gpuTimer, _Device, framesInFlight, graphicsTimestampBits, timestampPeriod);
+            if (headless) {
+                CreateReadbackRing();
+            }
+            CreateRenderGraph();
+            InitJobQueue(&jobQueue, GetDefaultJobThreadCount());
+            if (!headless) {
+                // Note: Not for headless runs, their frames have to come out the same every time.
+                StartShaderReload(&shaderReload, BuildReloadedPipeline, this);
+            }
+
+            pipelineCache.Stats.StartupMS = MillisecondsSince(startCounter);
+#if Game_SLOW
+            OutputPipelineCacheStats(&pipelineCache);
+#endif
+        }
+
+        // Note: No window, surface, swap chain or present. Frames are rendered into offscreen images of the given size
+        // and read back with GetReadbackFrame. Animation runs on a fixed 60Hz step, so frame N looks the same on every run.
+        void InitVulkanHeadless(game_memory* GameMemory, uint32_t Width, uint32_t Height)
+        {
+            headless = true;
+            offscreenExtent = { Width, Height };
+            InitVulkan(0, 0, GameMemory);
         }
 
         void Cleanup()
         {
+            vkDeviceWaitIdle(_Device);
+            DestroyJobQueue(&jobQueue);
+            StopShaderReload(&shaderReload);
+#if Game_SLOW
+            OutputShaderReloadStats(&shaderReload);
+#endif
+
             CleanupSwapChain();
+#if Game_SLOW
+            OutputDeferredDestroyStats(&deferredDestroys, &swapChainRecreateStats);
+#endif
+            FlushDeferredDestroys(&deferredDestroys);
+
+#if Game_SLOW
+            OutputDynamicRingStats(&dynamicRing);
+#endif
+            vkDestroyBuffer     (_Device, dynamicRing.Buffer, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &dynamicRingMemory);
 
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-                vkDestroyBuffer (_Device, uniformBuffers[i], nullptr);
-                vkFreeMemory    (_Device, uniformBuffersMemory[i], nullptr);
+#if Game_SLOW
+            OutputFrustumCullStats(&spriteRenderer.CullStats, spriteRenderer.UseAVX2);
+#endif
+            for (size_t i = 0; i < framesInFlight; i++) {
+                vkDestroyBuffer (_Device, spriteRenderer.Frames[i].InstanceBuffer, nullptr);
+                FreeDeviceMemory(&memoryAllocator, &spriteRenderer.Frames[i].InstanceMemory);
             }
+            vkDestroyPipeline   (_Device, spriteRenderer.Pipeline, nullptr);
+            vkDestroyPipeline   (_Device, objectPipeline, nullptr);
+#if Game_SLOW
+            OutputSpriteUploadStats(&spriteCuller.UploadStats, frameNumber);
+#endif
+            DestroySpriteCuller();
+#if Game_SLOW
+            OutputSimulationStats(&spriteSimulation);
+#endif
+            DestroySpriteSimulation();
 
-            vkDestroyDescriptorPool(_Device, descriptorPool, nullptr);)
-            vkDestroyDescriptorSetLayout(_Device, descriptorSetLayout, nullptr);
+#if Game_SLOW
+            OutputAtlasStats(&spriteAtlas);
+#endif
+            vkDestroySampler    (_Device, spriteAtlas.Sampler, nullptr);
+            vkDestroyImageView  (_Device, spriteAtlas.View, nullptr);
+            vkDestroyImage      (_Device, spriteAtlas.Image, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &spriteAtlas.Memory);
+
+            CancelDefragPass(&defragPass, _Device, &memoryAllocator);
+#if Game_SLOW
+            OutputBindlessStats(&bindlessTable);
+#endif
+            DestroyBindlessTable(&bindlessTable);
+
+            if (headless) {
+#if Game_SLOW
+                OutputReadbackStats(&readbackRing);
+#endif
+                for (size_t i = 0; i < VULKAN_READBACK_RING_SIZE; i++) {
+                    vkDestroyBuffer (_Device, readbackRing.Slots[i].Buffer, nullptr);
+                    FreeDeviceMemory(&memoryAllocator, &readbackRing.Slots[i].Memory);
+                }
+            }
+
+            if (!headless) {
+#if Game_SLOW
+                OutputSoftwarePresentStats(&softwarePresent);
+#endif
+                if (softwarePresent.Supported) {
+                    vkDestroyBuffer (_Device, softwarePresent.StagingBuffer, nullptr);
+                    FreeDeviceMemory(&memoryAllocator, &softwarePresent.StagingMemory);
+                }
+            }
+#if Game_SLOW
+            OutputRenderGraphStats(&renderGraph.Stats);
+#endif
+            DestroyRenderGraph(&renderGraph);
 
-            // Cleanup vertex buffer.
-            vkDestroyBuffer     (_Device, vertexBuffer, nullptr);
-            vkFreeMemory        (_Device, vertexBufferMemory, nullptr);
+            vkDestroyDescriptorPool(_Device, descriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(_Device, descriptorSetLayout, nullptr);
 
-            // Cleanup index buffer.
-            vkDestroyBuffer     (_Device, indexBuffer, nullptr);
-            vkFreeMemory        (_Device, indexBufferMemory, nullptr);
+            // Cleanup geometry buffers.
+#if Game_SLOW
+            OutputGeometryStats(&geometry);
+#endif
+            vkDestroyBuffer     (_Device, geometry.VertexBuffer, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &geometryVertexMemory);
+            vkDestroyBuffer     (_Device, geometry.IndexBuffer, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &geometryIndexMemory);
 
             vkDestroyPipeline   (_Device, graphicsPipeline, nullptr);
             vkDestroyPipelineLayout(_Device, pipelineLayout, nullptr);
             vkDestroyRenderPass (_Device, renderPass, nullptr);
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkDestroyRenderPass (_Device, softwareRenderPass, nullptr);
+            for (size_t i = 0; i < framesInFlight; i++) {
                 vkDestroySemaphore(_Device, renderFinishedSemaphores[i], nullptr);
                 vkDestroySemaphore(_Device, imageAvailableSemaphores[i], nullptr);
                 vkDestroyFence(_Device, inFlightFences[i], nullptr);
             }
-            vkDestroyCommandPool    (_Device, commandPool, nullptr);
+            for (size_t i = 0; i < framesInFlight; i++) {
+                DestroyFrameCommandPools(_Device, &frameCommandPools[i]);
+            }
+#if Game_SLOW
+            OutputGPUTimerStats(&gpuTimer);
+            OutputFramePacingStats(&framePacing, framesInFlight, presentMode);
+            OutputFrameAllocationStats(&frameAllocations);
+#endif
+            DestroyGPUTimer(&gpuTimer);
+#if Game_SLOW
+            OutputUploadStats(&uploadContext);
+#endif
+            DestroyUploadContext(&uploadContext);
+            vkDestroyBuffer     (_Device, uploadRingBuffer, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &uploadRingMemory);
+            // Note: Saved on every shutdown, so pipelines built since the last launch get added.
+            SavePipelineCache(&pipelineCache, gameMemory);
+#if Game_SLOW
+            OutputPipelineCacheStats(&pipelineCache);
+#endif
+            DestroyPipelineCache(&pipelineCache);
+#if Game_SLOW
+            OutputDefragStats(&defragStats);
+            OutputMemoryStats(&memoryAllocator);
+#endif
+            DestroyDeviceMemoryAllocator(&memoryAllocator);
             vkDestroyDevice(_Device, nullptr);
 #if Game_SLOW
             DestroyDebugUtilsMessengerEXT(_Instance, _DebugMessenger, nullptr);
 #endif
-            vkDestroySurfaceKHR     (_Instance, surface, nullptr);
+            if (surface != VK_NULL_HANDLE) {
+                vkDestroySurfaceKHR (_Instance, surface, nullptr);
+            }
             vkDestroyInstance       (_Instance, nullptr);
         }
 
-        void DrawFrame(int FrameBufferWidth, int FrameBufferHeight)
+        // LatencyID: ID of the input event this frame's update consumed (0 if none).
+        void DrawFrame(int FrameBufferWidth, int FrameBufferHeight, uint32_t LatencyID = 0)
         {
+            // Note: Nothing from here to the end of the frame may allocate, see Vulkan_HeapCheck.cpp.
+            uint32_t heapAllocationsBefore = GetHeapAllocationCount();
+            LARGE_INTEGER fenceWaitCounter;
+            QueryPerformanceCounter(&fenceWaitCounter);
             vkWaitForFences(_Device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+            float fenceWaitMS = MillisecondsSince(fenceWaitCounter);
+            RetireUploads(&uploadContext);
+            // Note: Every frame up to the one that last used this slot has now been waited on, here or in an earlier DrawFrame.
+            if (frameNumber + 1 >= framesInFlight) {
+                RetireDeferredDestroys(&deferredDestroys, frameNumber + 1 - framesInFlight);
+                RetireBindless(&bindlessTable, frameNumber + 1 - framesInFlight);
+                RetireGeometryMeshes(&geometry, frameNumber + 1 - framesInFlight);
+            }
+            UpdateDefragmentation();
+            if (frameNumber && (frameNumber % VULKAN_DEFRAG_CHECK_INTERVAL) == 0 && defragPass.Stage == DefragStage_Idle) {
+                BeginDefragmentation();
+            }
+            // Note: Before anything is recorded, so the whole frame draws with the same pipelines.
+            ApplyShaderReloads(&shaderReload, &deferredDestroys, frameNumber);
+            BeginDynamicFrame(&dynamicRing, currentFrame);
+            BeginGeometryFrame(&geometry, currentFrame);
+            // Note: The frame that last used this slot is done, so its timestamps are ready without waiting.
+            ResolveFrameTimestamps(&gpuTimer, currentFrame, fenceWaitMS, TakeRetiredUploadMS(&uploadContext));
+            if (headless && frameNumber >= framesInFlight) {
+                RetireReadbackFrames(&readbackRing, frameNumber - framesInFlight);
+            }
 
-            uint32_t imageIndex;
-            VkResult result = vkAcquireNextImageKHR(_Device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+            // Note: Offscreen there is one image per frame in flight and nothing to acquire.
+            uint32_t imageIndex = currentFrame;
+            VkResult result = VK_SUCCESS;
+            // Note: Not every driver says out of date when the window changes size. A minimized window (0 x 0) has nothing to draw to.
+            if (!headless && FrameBufferWidth > 0 && FrameBufferHeight > 0 &&
+                (FrameBufferWidth != lastFrameBufferWidth || FrameBufferHeight != lastFrameBufferHeight)) {
+                framebufferResized = true;
+            }
+            LARGE_INTEGER acquireCounter;
+            QueryPerformanceCounter(&acquireCounter);
+            if (!headless) {
+                result = vkAcquireNextImageKHR(_Device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+            }
 
             if (result == VK_ERROR_OUT_OF_DATE_KHR) {
                 RecreateSwapChain(FrameBufferWidth, FrameBufferHeight);
+                AddFrameAllocations(&frameAllocations, heapAllocationsBefore);
                 return;
             }
             else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
                 throw std::runtime_error("failed to acquire swap chain image!");
             }
+            LARGE_INTEGER acquireDoneCounter;
+            QueryPerformanceCounter(&acquireDoneCounter);
 
             vkResetFences(_Device, 1, &inFlightFences[currentFrame]);
 
-            vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-            RecordCommandBuffer(commandBuffers[currentFrame], imageIndex);
-
+            // Note: Only now are this frame's instance buffer, dynamic ring region and command pools free to use (its fence just signaled).
+            // The camera and objects go into the ring first, recording needs their offsets.
             UpdateUniformBuffer(currentFrame);
+            WriteObjectBatches();
+            WriteSoftwareFrame(&softwarePresent, currentFrame);
+            RecordCommandBuffer(imageIndex);
+
+            // Note: Anything uploaded this frame goes out now. The draw waits for it on the GPU, not here.
+            FlushUploads(&uploadContext);
 
             VkSubmitInfo submitInfo{};
             submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-            VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-            VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-            submitInfo.waitSemaphoreCount = 1;
-            submitInfo.pWaitSemaphores = waitSemaphores;
-            submitInfo.pWaitDstStageMask = waitStages;
+            // Note: The upload timeline is only waited on while something is still in flight. Binary semaphores ignore their value.
+            VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame], uploadContext.Timeline };
+            uint64_t waitValues[] = { 0, uploadContext.LastSubmittedValue };
+            VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+            uint32_t waitFirst = headless ? 1 : 0; // Note: Offscreen there is no acquire to wait for.
+            uint32_t waitCount = (UploadsPending(&uploadContext) ? 2 : 1) - waitFirst;
+
+            VkTimelineSemaphoreSubmitInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.waitSemaphoreValueCount = waitCount;
+            timelineInfo.pWaitSemaphoreValues = waitValues + waitFirst;
+
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.waitSemaphoreCount = waitCount;
+            submitInfo.pWaitSemaphores = waitSemaphores + waitFirst;
+            submitInfo.pWaitDstStageMask = waitStages + waitFirst;
 
             submitInfo.commandBufferCount = 1;
-            submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+            submitInfo.pCommandBuffers = &frameCommandPools[currentFrame].Primary;
 
             VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.signalSemaphoreCount = headless ? 0 : 1;
             submitInfo.pSignalSemaphores = signalSemaphores;
 
             if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to submit draw command buffer!");
             }
 
+            ++frameNumber;
+            if (headless) {
+                AddFramePacing(&framePacing, fenceWaitMS, 0, 0, 0);
+                currentFrame = (currentFrame + 1) % framesInFlight;
+                AddFrameAllocations(&frameAllocations, heapAllocationsBefore);
+                return;
+            }
+
+            LARGE_INTEGER SubmitCounter;
+            QueryPerformanceCounter(&SubmitCounter);
+
             VkPresentInfoKHR presentInfo{};
             presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -157,15 +422,389 @@ namespace Vulkan
 
             result = vkQueuePresentKHR(presentQueue, &presentInfo);
 
-            if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            LARGE_INTEGER PresentCounter;
+            QueryPerformanceCounter(&PresentCounter);
+            latencyStamp.InputID = LatencyID;
+            latencyStamp.SubmitCounter = SubmitCounter.QuadPart;
+            latencyStamp.PresentCounter = PresentCounter.QuadPart;
+            latencyStampValid = true;
+            AddFramePacing(&framePacing, fenceWaitMS, acquireCounter.QuadPart, acquireDoneCounter.QuadPart, PresentCounter.QuadPart);
+
+            if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized || presentModeChanged) {
                 framebufferResized = false;
+                presentModeChanged = false;
                 RecreateSwapChain(FrameBufferWidth, FrameBufferHeight);
             }
             else if (result != VK_SUCCESS) {
                 throw std::runtime_error("failed to present swap chain image!");
             }
 
-            currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+            currentFrame = (currentFrame + 1) % framesInFlight;
+            AddFrameAllocations(&frameAllocations, heapAllocationsBefore);
+        }
+
+        // Note: Returns false if the last DrawFrame didn't get to present (e.g. the swap chain was out of date),
+        // in which case the input is still waiting to show up on screen.
+        bool GetPresentedLatencyStamp(FrameLatencyStamp* Stamp)
+        {
+            bool Result = latencyStampValid;
+            if (Result)
+            {
+                *Stamp = latencyStamp;
+                latencyStampValid = false;
+            }
+            return Result;
+        }
+
+        // Note: Headless only. Returns false if no frame has finished since the last call; never waits on the GPU.
+        // The pixels (R8G8B8A8, sRGB) stay valid until the next DrawFrame.
+        bool GetReadbackFrame(ReadbackFrame* Frame)
+        {
+            return headless && AcquireReadbackFrame(&readbackRing, _Device, inFlightFences, Frame);
+        }
+
+        // Note: GPU timing of the most recently finished frame, usually two frames behind the one being drawn.
+        // Returns false if no frame has finished since the last call (or the device has no timestamps).
+        bool GetFrameGPUTiming(FrameGPUTiming* Timing)
+        {
+            bool Result = gpuTimer.LatestIsNew;
+            if (Result)
+            {
+                *Timing = gpuTimer.Latest;
+                gpuTimer.LatestIsNew = false;
+            }
+            return Result;
+        }
+
+        // Note: True while a frame has been copied but not picked up with GetReadbackFrame yet.
+        bool IsReadbackPending()
+        {
+            return headless && GetOldestReadbackSlot(&readbackRing) != nullptr;
+        }
+
+        int GetFramesInFlight()
+        {
+            return framesInFlight;
+        }
+
+        // Note: 1 to VULKAN_MAX_FRAMES_IN_FLIGHT. Has to be called before InitVulkan; the per frame resources are made there.
+        void SetFramesInFlight(uint32_t Count)
+        {
+            if (_Device != VK_NULL_HANDLE) {
+                return;
+            }
+            framesInFlight = (Count < 1) ? 1 : (Count > VULKAN_MAX_FRAMES_IN_FLIGHT) ? VULKAN_MAX_FRAMES_IN_FLIGHT : Count;
+        }
+
+        // Note: Any time. After InitVulkan the swap chain is recreated at the end of the next DrawFrame.
+        // Falls back to FIFO (which every device has) if the mode isn't supported.
+        void SetPresentMode(VkPresentModeKHR Mode)
+        {
+            requestedPresentMode = Mode;
+            presentModeChanged = (_Device != VK_NULL_HANDLE && !headless);
+        }
+
+        bool IsPresentModeSupported(VkPresentModeKHR Mode)
+        {
+            if (headless || surface == VK_NULL_HANDLE) {
+                return false;
+            }
+            SwapChainSupportDetails swapChainSupport;
+            QuerySwapChainSupport(physicalDevice, &swapChainSupport);
+            for (uint32_t i = 0; i < swapChainSupport.presentModeCount; i++) {
+                if (swapChainSupport.presentModes[i] == Mode) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Note: The mode the current swap chain was actually made with.
+        VkPresentModeKHR GetPresentMode()
+        {
+            return presentMode;
+        }
+
+        // Note: Heap allocations made during DrawFrame. Only counted with Game_SLOW, otherwise always none.
+        void GetFrameAllocations(FrameAllocationStats* Stats)
+        {
+            *Stats = frameAllocations;
+        }
+
+        // Note: CPU side pacing since the last ResetFramePacing: fence waits, acquire and acquire-to-present times.
+        void GetFramePacing(FramePacingStats* Stats)
+        {
+            *Stats = framePacing;
+        }
+
+        void ResetFramePacing()
+        {
+            framePacing = {};
+        }
+
+        // Note: How long the frames that recreated the swap chain spent doing it.
+        void GetSwapChainRecreateStats(SwapChainRecreateStats* Stats)
+        {
+            *Stats = swapChainRecreateStats;
+        }
+
+        // Note: Any time. True goes back to waiting for the device to go idle on every recreation, to compare against.
+        void SetSwapChainRecreateWaitsIdle(bool WaitsIdle)
+        {
+            recreateWaitsIdle = WaitsIdle;
+        }
+
+        // Note: Threads used for filling and recording sprites, the calling thread included.
+        uint32_t GetRecordThreadCount()
+        {
+            return jobQueue.WorkerCount + 1;
+        }
+
+        // Note: Sprites for the next DrawFrame. The columns have to stay valid until then;
+        // they are read once DrawFrame knows which instance buffer is free.
+        void SubmitSprites(SpriteEntityColumns* Columns, SpriteDefinition* Definitions)
+        {
+            spriteColumns = Columns;
+            spriteDefinitions = Definitions;
+        }
+
+        // Note: The game's software back buffer, scaled to the window and presented by the next DrawFrame under whatever
+        // else it draws, see Vulkan_SoftwarePresent.cpp. The pixels have to stay valid until then. Returns false if the
+        // swap chain can't take it (or there is none), in which case the caller has to present it some other way.
+        bool SubmitSoftwareFrame(game_offscreen_buffer* Buffer)
+        {
+            if (!softwarePresent.Supported) {
+                return false;
+            }
+            softwarePresent.Pending = *Buffer;
+            softwarePresent.HasPending = true;
+            return true;
+        }
+
+        // Note: Draws one test quad per object in the next DrawFrame, each with its own transform and color, all tinted by Tint.
+        // The objects have to stay valid until then; DrawFrame copies them into the dynamic ring. Up to VULKAN_MAX_OBJECT_BATCHES
+        // calls per frame, each one is a single instanced draw. Objects that don't fit in the frame's ring region are dropped.
+        void SubmitObjects(ObjectData* Objects, uint32_t Count, glm::vec4 Tint)
+        {
+            SubmitMeshObjects(quadMesh, Objects, Count, Tint);
+        }
+
+        // Note: Like SubmitObjects, with a mesh from CreateMesh instead of the test quad. Batches of a mesh that's released
+        // before the next DrawFrame are dropped.
+        void SubmitMeshObjects(uint32_t Mesh, ObjectData* Objects, uint32_t Count, glm::vec4 Tint)
+        {
+            if (objectBatchCount < VULKAN_MAX_OBJECT_BATCHES && Count) {
+                ObjectBatch* batch = &objectBatches[objectBatchCount++];
+                *batch = {};
+                batch->Objects = Objects;
+                batch->Count = Count;
+                batch->Tint = Tint;
+                batch->MeshID = Mesh;
+            }
+        }
+
+        // Note: Like SubmitMeshObjects, with geometry for the next DrawFrame only. The vertices and indices have to stay
+        // valid until then, DrawFrame copies them into the frame's part of the geometry buffer. Geometry that doesn't fit
+        // there is dropped along with its objects.
+        void SubmitDynamicMeshObjects(const MeshVertex* Vertices, uint32_t VertexCount, const uint32_t* Indices, uint32_t IndexCount,
+                                      ObjectData* Objects, uint32_t Count, glm::vec4 Tint)
+        {
+            if (objectBatchCount < VULKAN_MAX_OBJECT_BATCHES && Count) {
+                ObjectBatch* batch = &objectBatches[objectBatchCount++];
+                *batch = {};
+                batch->Objects = Objects;
+                batch->Count = Count;
+                batch->Tint = Tint;
+                batch->MeshID = VULKAN_GEOMETRY_INVALID_MESH;
+                batch->DynamicVertices = Vertices;
+                batch->DynamicVertexCount = VertexCount;
+                batch->DynamicIndices = Indices;
+                batch->DynamicIndexCount = IndexCount;
+            }
+        }
+
+        // Note: A static mesh in the geometry buffer (see MakeMeshVertex), indices count from the mesh's first vertex.
+        // Copied right away. Returns VULKAN_GEOMETRY_INVALID_MESH if it doesn't fit.
+        uint32_t CreateMesh(const MeshVertex* Vertices, uint32_t VertexCount, const uint32_t* Indices, uint32_t IndexCount)
+        {
+            return CreateGeometryMesh(&geometry, &uploadContext, Vertices, VertexCount, Indices, IndexCount);
+        }
+
+        // Note: Its space is reused once the frames in flight are done with it.
+        void ReleaseMesh(uint32_t Mesh)
+        {
+            if (Mesh != quadMesh) {
+                ReleaseGeometryMesh(&geometry, Mesh, frameNumber);
+            }
+        }
+
+        // Note: The pixels of the sprite sheet that SpriteDefinition::Atlas == SheetIndex refers to: RGBA8, tightly packed,
+        // at most VULKAN_ATLAS_PAGE_SIZE on a side. They have to stay valid, the sheet is uploaded again whenever it comes back
+        // after an eviction. Sprites of a sheet without pixels draw as plain tint. Replacing a sheet waits for the frames in flight.
+        bool RegisterSpriteSheet(uint32_t SheetIndex, uint32_t* Pixels, uint32_t Width, uint32_t Height)
+        {
+            if (SheetIndex >= VULKAN_SPRITE_MAX_ATLASES || Width > VULKAN_ATLAS_PAGE_SIZE || Height > VULKAN_ATLAS_PAGE_SIZE) {
+                return false;
+            }
+
+            SpriteSheet* sheet = &spriteAtlas.Sheets[SheetIndex];
+            if (sheet->Resident) {
+                vkWaitForFences(_Device, framesInFlight, inFlightFences, VK_TRUE, UINT64_MAX);
+                EvictSpriteSheet(&spriteAtlas, SheetIndex);
+            }
+            sheet->Pixels = Pixels;
+            sheet->Width = Width;
+            sheet->Height = Height;
+            return true;
+        }
+
+        // Note: Per heap budget and usage, per category usage, fragmentation and what the defragmentation did, for the reports.
+        void GetDeviceMemoryStats(MemoryStats* Stats, DefragStats* Defrag)
+        {
+            *Stats = GetMemoryStats(&memoryAllocator);
+            *Defrag = defragStats;
+        }
+
+        // Note: The same as text. Returns the length written.
+        int FormatDeviceMemoryStats(char* Text, int Size)
+        {
+            MemoryStats stats = GetMemoryStats(&memoryAllocator);
+            int used = FormatMemoryStats(Text, Size, &stats);
+            used += FormatDefragStats(Text + used, Size - used, &defragStats);
+            return used;
+        }
+
+        // Note: Atlas page utilization and upload bytes per frame, for the reports. Returns the length written.
+        int FormatSpriteAtlasStats(char* Text, int Size)
+        {
+            return FormatAtlasStats(Text, Size, &spriteAtlas);
+        }
+
+        // Note: Render graph passes, barriers per frame and the memory transient aliasing saved, for the reports. Returns the length written.
+        int FormatFrameGraphStats(char* Text, int Size)
+        {
+            return FormatRenderGraphStats(Text, Size, &renderGraph.Stats);
+        }
+
+        // Note: Visible and culled CPU sprites per frame, for the reports. Returns the length written.
+        int FormatSpriteCullStats(char* Text, int Size)
+        {
+            return FormatFrustumCullStats(Text, Size, &spriteRenderer.CullStats, spriteRenderer.UseAVX2);
+        }
+
+        // Note: Bytes of GPU culled sprites uploaded per frame, for the reports. Returns the length written.
+        int FormatCulledSpriteUploadStats(char* Text, int Size)
+        {
+            return FormatSpriteUploadStats(Text, Size, &spriteCuller.UploadStats, frameNumber);
+        }
+
+        // Note: A texture of its own for sprites that don't come from a sheet: RGBA8, tightly packed, at most VULKAN_ATLAS_PAGE_SIZE
+        // on a side. The pixels are copied into the next upload batch. Returns the ID for SpriteDefinition::Texture, or
+        // VULKAN_BINDLESS_INVALID_ID if the bindless set is full. Drawing with it doesn't split any draws.
+        uint32_t RegisterTexture(uint32_t* Pixels, uint32_t Width, uint32_t Height)
+        {
+            if (!Width || !Height || Width > VULKAN_ATLAS_PAGE_SIZE || Height > VULKAN_ATLAS_PAGE_SIZE) {
+                return VULKAN_BINDLESS_INVALID_ID;
+            }
+
+            VkImage image;
+            VkImageView view;
+            MemoryAllocation memory;
+            CreateTextureImage(Width, Height, true, &image, &view, &memory);
+
+            uint32_t id = AddBindlessTexture(&bindlessTable, view, VK_IMAGE_LAYOUT_GENERAL, image, &memory);
+            if (id == VULKAN_BINDLESS_INVALID_ID) {
+                vkDestroyImageView(_Device, view, nullptr);
+                vkDestroyImage(_Device, image, nullptr);
+                FreeDeviceMemory(&memoryAllocator, &memory);
+                return VULKAN_BINDLESS_INVALID_ID;
+            }
+            bindlessTable.Textures[id].Extent = { Width, Height };
+
+            UploadBindlessTexture(&uploadContext, image, Width, Height, Pixels);
+            return id;
+        }
+
+        // Note: Sprites submitted from here on can't use the ID any more. The texture goes once the frames in flight are done with it.
+        void ReleaseTexture(uint32_t Texture)
+        {
+            if (Texture != VULKAN_BINDLESS_ATLAS_TEXTURE && Texture != VULKAN_BINDLESS_INVALID_ID) {
+                ReleaseBindless(&bindlessTable, BindlessKind_Texture, Texture, frameNumber);
+            }
+        }
+
+        // Note: Sprites that are culled and drawn on the GPU every frame until the next call (Count 0 clears them).
+        // The columns are copied right away. This waits for the frames in flight, so call it when the set changes, not every frame.
+        void SetCulledSprites(SpriteEntityColumns* Columns, SpriteDefinition* Definitions)
+        {
+            vkWaitForFences(_Device, framesInFlight, inFlightFences, VK_TRUE, UINT64_MAX);
+            UploadCulledSprites(&spriteCuller, &uploadContext, Columns, Definitions);
+            culledColumns = nullptr;
+        }
+
+        // Note: Same sprites as the last SetCulledSprites or UpdateCulledSprites, with some rows written since
+        // (MarkSpriteRowsWritten) or a different count. Only the changed chunks go up, in the next DrawFrame's commands
+        // without waiting; above VULKAN_CULL_MAX_FRAME_BYTES this waits for the frames in flight like SetCulledSprites.
+        // Without Columns->ChunkVersions every chunk counts as changed. The columns have to stay valid until the next DrawFrame.
+        void UpdateCulledSprites(SpriteEntityColumns* Columns, SpriteDefinition* Definitions)
+        {
+            culledColumns = nullptr;
+            culledDirtyBytes = GatherDirtySpriteChunks(&spriteCuller, Columns);
+            if (!spriteCuller.DirtyChunkCount) {
+                CommitDirtySpriteChunks(&spriteCuller, Columns, 0);
+            }
+            else if (culledDirtyBytes > VULKAN_CULL_MAX_FRAME_BYTES) {
+                vkWaitForFences(_Device, framesInFlight, inFlightFences, VK_TRUE, UINT64_MAX);
+                UploadDirtySpriteChunks(&spriteCuller, &uploadContext, Columns, Definitions, culledDirtyBytes);
+            }
+            else {
+                culledColumns = Columns;
+                culledDefinitions = Definitions;
+            }
+        }
+
+        // Note: Velocity and destination columns for the culled sprites, row for row (Count 0 stops the simulation).
+        // Like SetCulledSprites this waits for the frames in flight. Setting the culled sprites again puts them back
+        // where the columns say, the simulated positions only ever live on the GPU.
+        void SetSimulatedSprites(glm::vec3* Velocities, glm::vec4* Destinations, uint32_t Count)
+        {
+            vkWaitForFences(_Device, framesInFlight, inFlightFences, VK_TRUE, UINT64_MAX);
+            UploadSimulationColumns(&spriteSimulation, &uploadContext, Velocities, Destinations, Count);
+        }
+
+        // Note: Runs one simulation step on the GPU at the start of the next DrawFrame, ahead of the cull.
+        void SimulateSprites(float DeltaTime, float Speed)
+        {
+            spriteSimulation.StepQueued = true;
+            spriteSimulation.Step.DeltaTime = DeltaTime;
+            spriteSimulation.Step.Speed = Speed;
+        }
+
+        // Note: Copies the positions out after the next simulated step, for checking them against the CPU.
+        void RequestSimulationReadback()
+        {
+            spriteSimulation.ReadbackQueued = true;
+            spriteSimulation.ReadbackRecorded = false;
+        }
+
+        // Note: Waits for the frame with the readback. Returns false if none was recorded since RequestSimulationReadback.
+        bool GetSimulatedPositions(glm::vec3* Positions, uint32_t Count)
+        {
+            if (!spriteSimulation.ReadbackRecorded) {
+                return false;
+            }
+
+            vkWaitForFences(_Device, 1, &inFlightFences[spriteSimulation.ReadbackFrameIndex], VK_TRUE, UINT64_MAX);
+            SpriteInstance* instances = (SpriteInstance*)spriteSimulation.ReadbackMemory.Mapped;
+            if (Count > spriteSimulation.Count) {
+                Count = spriteSimulation.Count;
+            }
+            for (uint32_t i = 0; i < Count; i++) {
+                Positions[i] = instances[i].Position;
+            }
+            spriteSimulation.ReadbackRecorded = false;
+            ++spriteSimulation.Stats.Readbacks;
+            return true;
         }
 
     private:
@@ -177,7 +816,6 @@ namespace Vulkan
         };
         std::vector<const char*> _EnabledExtensions =
         {
-            VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
             VK_KHR_SURFACE_EXTENSION_NAME,
             VK_KHR_WIN32_SURFACE_EXTENSION_NAME
         };
@@ -186,77 +824,111 @@ namespace Vulkan
         };
         VkDebugUtilsMessengerEXT _DebugMessenger;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-        VkDevice _Device;
+        VkDevice _Device = VK_NULL_HANDLE;
         VkQueue graphicsQueue; // Note: Implicitly cleaned up when logical device is destroyed.
-        VkSurfaceKHR surface;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
         VkQueue presentQueue;
-        VkSwapchainKHR swapChain;
-        std::vector<VkImage> swapChainImages;
+        VkQueue transferQueue; // Note: Same as graphicsQueue when there is no dedicated transfer family.
+        uint32_t sharedQueueFamilies[2];
+        uint32_t sharedQueueFamilyCount = 1;
+        VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+        VkImage swapChainImages[VULKAN_MAX_SWAPCHAIN_IMAGES];
+        uint32_t swapChainImageCount = 0; // Note: Also the count of the image views and framebuffers once they're made.
         VkFormat swapChainImageFormat;
         VkExtent2D swapChainExtent;
-        std::vector<VkImageView> swapChainImageViews;
+        VkImageView swapChainImageViews[VULKAN_MAX_SWAPCHAIN_IMAGES];
         VkRenderPass renderPass;
         VkDescriptorSetLayout descriptorSetLayout;
         VkPipelineLayout pipelineLayout;
         VkPipeline graphicsPipeline;
-        std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkCommandPool commandPool;
-        std::vector<VkCommandBuffer> commandBuffers;; // Note: Implicitly cleaned up when the CommandPool is destroyed.
-        std::vector<VkSemaphore> imageAvailableSemaphores;
-        std::vector<VkSemaphore> renderFinishedSemaphores;
-        std::vector<VkFence> inFlightFences;
-        const int MAX_FRAMES_IN_FLIGHT = 2;
+        VkPipeline objectPipeline;
+        VkFramebuffer swapChainFramebuffers[VULKAN_MAX_SWAPCHAIN_IMAGES];
+        FrameCommandPools frameCommandPools[VULKAN_MAX_FRAMES_IN_FLIGHT];
+        JobQueue jobQueue;
+        FrameRecordState recordState;
+        RecordSliceJob recordJobs[VULKAN_SPRITE_MAX_SLICES];
+        VkSemaphore imageAvailableSemaphores[VULKAN_MAX_FRAMES_IN_FLIGHT];
+        VkSemaphore renderFinishedSemaphores[VULKAN_MAX_FRAMES_IN_FLIGHT];
+        VkFence inFlightFences[VULKAN_MAX_FRAMES_IN_FLIGHT];
+        uint32_t framesInFlight = VULKAN_DEFAULT_FRAMES_IN_FLIGHT; // Note: Fixed once InitVulkan has created the per frame resources.
         uint32_t currentFrame = 0;
         bool framebufferResized = false;
-        VkBuffer vertexBuffer;
-        VkDeviceMemory vertexBufferMemory;
-        VkBuffer indexBuffer;
-        VkDeviceMemory indexBufferMemory;
-        std::vector<VkBuffer> uniformBuffers;
-        std::vector<VkDeviceMemory> uniformBuffersMemory;
-        std::vector<void*> uniformBuffersMapped;
+        int lastFrameBufferWidth = 0;   // Note: What the swap chain was last made for.
+        int lastFrameBufferHeight = 0;
+        bool recreateWaitsIdle = false;
+        DeferredDestroyQueue deferredDestroys;
+        SwapChainRecreateStats swapChainRecreateStats = {};
+        VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        bool presentModeChanged = false;
+        FramePacingStats framePacing = {};
+        DeviceMemoryAllocator memoryAllocator;
+        PipelineCache pipelineCache;
+        ShaderReload shaderReload;
+        game_memory* gameMemory = nullptr;
+        SpriteRenderer spriteRenderer;
+        SpriteCuller spriteCuller;
+        SpriteEntityColumns* culledColumns = nullptr;   // Note: From UpdateCulledSprites, for the next DrawFrame to copy.
+        SpriteDefinition* culledDefinitions = nullptr;
+        uint32_t culledDirtyBytes = 0;
+        SpriteSimulation spriteSimulation;
+        SpriteAtlas spriteAtlas = {};
+        BindlessTable bindlessTable;
+        uint32_t cullDynamicOffsets[VULKAN_CULL_DYNAMIC_OFFSET_COUNT] = {}; // Note: This frame's camera and sheet transforms.
+        bool32 drawIndirectCountEnabled = false;
+        bool32 multiDrawIndirectEnabled = false;
+        SpriteEntityColumns* spriteColumns = nullptr;
+        SpriteDefinition* spriteDefinitions = nullptr;
+        UploadContext uploadContext;
+        VkBuffer uploadRingBuffer;
+        MemoryAllocation uploadRingMemory;
+        GeometryBuffer geometry = {};
+        MemoryAllocation geometryVertexMemory;
+        MemoryAllocation geometryIndexMemory;
+        uint32_t quadMesh = VULKAN_GEOMETRY_INVALID_MESH; // Note: The test quad, also what sprites and plain objects are drawn with.
+        DynamicRing dynamicRing = {};
+        MemoryAllocation dynamicRingMemory;
+        VkDeviceSize minUniformBufferOffsetAlignment = 256;
+        VkDeviceSize minStorageBufferOffsetAlignment = 256;
+        uint32_t dynamicOffsets[VULKAN_DYNAMIC_OFFSET_COUNT] = {}; // Note: This frame's camera and object array.
+        ObjectBatch objectBatches[VULKAN_MAX_OBJECT_BATCHES];
+        uint32_t objectBatchCount = 0;
         VkDescriptorPool descriptorPool;
-        std::vector<VkDescriptorSet> descriptorSets;
-
-        struct Vertex {
-            glm::vec2 pos;
-            glm::vec3 color;
-
-            static VkVertexInputBindingDescription getBindingDescription() 
-            {
-                VkVertexInputBindingDescription bindingDescription = {};
-                bindingDescription.binding = 0;
-                bindingDescription.stride = sizeof(Vertex);
-                bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-                return(bindingDescription);
-            }
-             
-            static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() 
-            {
-                std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-
-                attributeDescriptions[0].binding = 0;
-                attributeDescriptions[0].location = 0;
-                attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-                attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-                attributeDescriptions[1].binding = 0;
-                attributeDescriptions[1].location = 1;
-                attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-                attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-                return attributeDescriptions;
-            }
-        };
-
-        const std::vector<Vertex> vertices = {
-            {{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-            {{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-            {{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
-            {{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}
+        VkDescriptorSet descriptorSet; // Note: One for every frame, the frames only differ in their dynamic offsets.
+        FrameLatencyStamp latencyStamp = {};
+        bool latencyStampValid = false;
+        uint64_t frameNumber = 0;
+        GPUTimer gpuTimer = {};
+        FrameAllocationStats frameAllocations = {};
+        uint32_t graphicsTimestampBits = 0;
+        uint32_t transferTimestampBits = 0;
+        float timestampPeriod = 1.0f;
+        bool32 headless = false;
+        VkExtent2D offscreenExtent = {};
+        MemoryAllocation offscreenImageMemory[VULKAN_MAX_FRAMES_IN_FLIGHT];
+        ReadbackRing readbackRing = {};
+        SoftwarePresent softwarePresent = {};
+        bool32 memoryBudgetEnabled = false;
+        bool32 hostQueryResetEnabled = false;
+        RenderGraph renderGraph = {};
+        uint32_t backbufferResource;
+        uint32_t softwareFrameResource;
+        uint32_t softwareCopyPass;
+        uint32_t softwareBlitPass;
+        uint32_t recordImageIndex;  // Note: For the render graph's passes, while RecordCommandBuffer runs the graph.
+        uint32_t recordSliceCount;
+        DefragPass defragPass = {};
+        DefragStats defragStats = {};
+        VkRenderPass softwareRenderPass; // Note: renderPass, but loading the software frame instead of clearing. Compatible with it.
+
+        const std::vector<MeshVertex> vertices = {
+            MakeMeshVertex({-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}),
+            MakeMeshVertex({0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}),
+            MakeMeshVertex({0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}),
+            MakeMeshVertex({-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f})
         };
 
-        const std::vector<uint16_t> _Indices = {
+        const std::vector<uint32_t> _Indices = {
             0, 1, 2, 2, 3, 0
         };
 
@@ -267,15 +939,23 @@ namespace Vulkan
         };
 
         void CleanupSwapChain() {
-            for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
+            for (uint32_t i = 0; i < swapChainImageCount; i++) {
                 vkDestroyFramebuffer(_Device, swapChainFramebuffers[i], nullptr);
             }
 
-            for (size_t i = 0; i < swapChainImageViews.size(); i++) {
+            for (uint32_t i = 0; i < swapChainImageCount; i++) {
                 vkDestroyImageView(_Device, swapChainImageViews[i], nullptr);
             }
 
-            vkDestroySwapchainKHR(_Device, swapChain, nullptr);
+            if (headless) {
+                for (uint32_t i = 0; i < swapChainImageCount; i++) {
+                    vkDestroyImage(_Device, swapChainImages[i], nullptr);
+                    FreeDeviceMemory(&memoryAllocator, &offscreenImageMemory[i]);
+                }
+            }
+            else {
+                vkDestroySwapchainKHR(_Device, swapChain, nullptr);
+            }
         }
 
         bool checkValidationLayerSupport() {
@@ -361,13 +1041,19 @@ namespace Vulkan
             appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
             appInfo.pEngineName = "No Engine";
             appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-            appInfo.apiVersion = VK_API_VERSION_1_0;
+            appInfo.apiVersion = VK_API_VERSION_1_2; // Note: Timeline semaphores (uploads) are core in 1.2.
 
             VkInstanceCreateInfo createInfo = {};
             createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
             createInfo.pApplicationInfo = &appInfo;
 
             auto extensions = _EnabledExtensions; 
+            if (headless) {
+                extensions.clear(); // Note: No surface, so none of the WSI extensions.
+            }
+#if Game_SLOW
+            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); // Note: Only for the validation messages.
+#endif
             createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
             createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -429,6 +1115,10 @@ namespace Vulkan
             bool32 presentFamily_HasValue;
             uint32_t presentFamily;
 
+            // Note: Optional. Only set for a family that can transfer but not draw.
+            bool32 transferFamily_HasValue;
+            uint32_t transferFamily;
+
             bool IsComplete() {
                 return graphicsFamily_HasValue && presentFamily_HasValue;
             }
@@ -441,27 +1131,42 @@ namespace Vulkan
             uint32_t queueFamilyCount = 0;
             vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
 
-            std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-            vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+            // Note: Also called from CreateSwapChain on every recreation, so no heap here.
+            VkQueueFamilyProperties queueFamilies[VULKAN_MAX_QUEUE_FAMILIES];
+            if (queueFamilyCount > VULKAN_MAX_QUEUE_FAMILIES) {
+                queueFamilyCount = VULKAN_MAX_QUEUE_FAMILIES;
+            }
+            vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies);
 
+            // Note: Look at every family, the dedicated transfer family is usually near the end.
             int i = 0;
-            for (const auto& queueFamily : queueFamilies)
+            for (uint32_t familyIndex = 0; familyIndex < queueFamilyCount; familyIndex++)
             {
-                if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                const VkQueueFamilyProperties& queueFamily = queueFamilies[familyIndex];
+                if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily_HasValue) {
                     indices.graphicsFamily_HasValue = TRUE;
                     indices.graphicsFamily = i;
                 }
 
                 VkBool32 presentSupport = false;
-                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+                if (headless) {
+                    presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0; // Note: Nothing is presented, the graphics queue stands in.
+                }
+                else {
+                    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+                }
 
-                if (presentSupport) {
+                if (presentSupport && !indices.presentFamily_HasValue) {
                     indices.presentFamily_HasValue = TRUE;
                     indices.presentFamily = i;
                 }
 
-                if (indices.IsComplete()) {
-                    break;
+                if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                    // Note: Prefer a pure transfer family (the copy engine) over an async compute one.
+                    if (!indices.transferFamily_HasValue || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                        indices.transferFamily_HasValue = TRUE;
+                        indices.transferFamily = i;
+                    }
                 }
 
                 i++;
@@ -486,12 +1191,27 @@ namespace Vulkan
             return requiredExtensions.empty();
         }
 
-        uint32_t clamp(uint32_t value, uint32_t min, uint32_t max)
-        {
-            if (value < min) return min;
-            if (value > max) return max;
-            return value;
-        }
+        bool HasDeviceExtension(VkPhysicalDevice device, const char* name) {
+            uint32_t extensionCount;
+            vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+            for (const auto& extension : availableExtensions) {
+                if (strcmp(extension.extensionName, name) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint32_t clamp(uint32_t value, uint32_t min, uint32_t max)
+        {
+            if (value < min) return min;
+            if (value > max) return max;
+            return value;
+        }
 
         VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, int FrameBufferWidth, int FrameBufferHeight) 
         {
@@ -512,19 +1232,20 @@ namespace Vulkan
             }
         }
 
-        VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) 
+        VkPresentModeKHR chooseSwapPresentMode(const VkPresentModeKHR* availablePresentModes, uint32_t availablePresentModeCount) 
         {
-            for (const auto& availablePresentMode : availablePresentModes) {
-                if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                    return availablePresentMode;
+            for (uint32_t i = 0; i < availablePresentModeCount; i++) {
+                if (availablePresentModes[i] == requestedPresentMode) {
+                    return availablePresentModes[i];
                 }
             }
             return VK_PRESENT_MODE_FIFO_KHR;
         }
 
-        VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) 
+        VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const VkSurfaceFormatKHR* availableFormats, uint32_t availableFormatCount) 
         {
-            for (const auto& availableFormat : availableFormats) {
+            for (uint32_t i = 0; i < availableFormatCount; i++) {
+                const VkSurfaceFormatKHR& availableFormat = availableFormats[i];
                 if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
                     return availableFormat;
                 }
@@ -536,13 +1257,17 @@ namespace Vulkan
         bool IsDeviceSuitable(VkPhysicalDevice device)
         {
             QueueFamilyIndices indices = FindQueueFamilies(device);
+            if (headless) {
+                return(indices.IsComplete()); // Note: No swap chain to support.
+            }
 
             bool extensionsSupported = CheckDeviceExtensionSupport(device);
 
             bool swapChainAdequate = false;
             if (extensionsSupported) {
-                SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
-                swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+                SwapChainSupportDetails swapChainSupport;
+                QuerySwapChainSupport(device, &swapChainSupport);
+                swapChainAdequate = swapChainSupport.formatCount != 0 && swapChainSupport.presentModeCount != 0;
             }
 
             return(indices.IsComplete() && extensionsSupported && swapChainAdequate);
@@ -589,34 +1314,25 @@ namespace Vulkan
             }
         }
 
+        // Note: Fixed arrays, this is queried again on every swap chain recreation.
         struct SwapChainSupportDetails {
             VkSurfaceCapabilitiesKHR capabilities;
-            std::vector<VkSurfaceFormatKHR> formats;
-            std::vector<VkPresentModeKHR> presentModes;
+            VkSurfaceFormatKHR formats[VULKAN_MAX_SURFACE_FORMATS];
+            uint32_t formatCount;
+            VkPresentModeKHR presentModes[VULKAN_MAX_PRESENT_MODES];
+            uint32_t presentModeCount;
         };
 
-        SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device) 
+        // Note: If there are more formats or modes than fit, the driver returns VK_INCOMPLETE and the first ones.
+        void QuerySwapChainSupport(VkPhysicalDevice device, SwapChainSupportDetails* details) 
         {
-            SwapChainSupportDetails details;
-            vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
-
-            uint32_t formatCount;
-            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+            vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details->capabilities);
 
-            if (formatCount != 0) {
-                details.formats.resize(formatCount);
-                vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
-            }
-
-            uint32_t presentModeCount;
-            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+            details->formatCount = VULKAN_MAX_SURFACE_FORMATS;
+            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &details->formatCount, details->formats);
 
-            if (presentModeCount != 0) {
-                details.presentModes.resize(presentModeCount);
-                vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
-            }
-
-            return details;
+            details->presentModeCount = VULKAN_MAX_PRESENT_MODES;
+            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &details->presentModeCount, details->presentModes);
         }
 
         void CreateLogicalDevice()
@@ -625,6 +1341,9 @@ namespace Vulkan
 
             std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
             std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+            if (indices.transferFamily_HasValue) {
+                uniqueQueueFamilies.insert(indices.transferFamily);
+            }
 
 
             float queuePriority = 1.0f;
@@ -637,15 +1356,66 @@ namespace Vulkan
                 queueCreateInfos.push_back(queueCreateInfo);
             }
 
+            VkPhysicalDeviceVulkan12Features supportedFeatures12 = {};
+            supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            VkPhysicalDeviceFeatures2 supportedFeatures = {};
+            supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            supportedFeatures.pNext = &supportedFeatures12;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+            if (!supportedFeatures12.timelineSemaphore) {
+                throw std::runtime_error("timeline semaphores not supported!");
+            }
+            // Note: Everything the bindless set needs (see Vulkan_Bindless.cpp).
+            if (!supportedFeatures12.descriptorIndexing ||
+                !supportedFeatures12.runtimeDescriptorArray ||
+                !supportedFeatures12.descriptorBindingPartiallyBound ||
+                !supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind ||
+                !supportedFeatures12.descriptorBindingStorageBufferUpdateAfterBind ||
+                !supportedFeatures12.descriptorBindingUpdateUnusedWhilePending ||
+                !supportedFeatures12.shaderSampledImageArrayNonUniformIndexing) {
+                throw std::runtime_error("descriptor indexing not supported!");
+            }
+
+            // Note: The GPU culled sprites use these when they're there and fall back to plainer indirect draws when not.
             VkPhysicalDeviceFeatures deviceFeatures = {};
+            deviceFeatures.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+            multiDrawIndirectEnabled = supportedFeatures.features.multiDrawIndirect;
+
+            VkPhysicalDeviceVulkan12Features features12 = {};
+            features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            features12.timelineSemaphore = VK_TRUE;
+            features12.descriptorIndexing = VK_TRUE;
+            features12.runtimeDescriptorArray = VK_TRUE;
+            features12.descriptorBindingPartiallyBound = VK_TRUE;
+            features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            features12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
+            drawIndirectCountEnabled = supportedFeatures12.drawIndirectCount;
+            // Note: The upload batches reset their timestamp queries from the host, the transfer queue can't.
+            features12.hostQueryReset = supportedFeatures12.hostQueryReset;
+            hostQueryResetEnabled = supportedFeatures12.hostQueryReset;
 
             VkDeviceCreateInfo createInfo = {};
             createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+            createInfo.pNext = &features12;
             createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
             createInfo.pQueueCreateInfos = queueCreateInfos.data();
             createInfo.pEnabledFeatures = &deviceFeatures;
-            createInfo.enabledExtensionCount = static_cast<uint32_t>(_DeviceExtensions.size());
-            createInfo.ppEnabledExtensionNames = _DeviceExtensions.data();
+            // Note: VK_EXT_memory_budget only if it's there, the allocator estimates the budget without it.
+            const char* deviceExtensions[2];
+            uint32_t deviceExtensionCount = 0;
+            if (!headless) {
+                deviceExtensions[deviceExtensionCount++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+            }
+            memoryBudgetEnabled = HasDeviceExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            if (memoryBudgetEnabled) {
+                deviceExtensions[deviceExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+            }
+            createInfo.enabledExtensionCount = deviceExtensionCount;
+            createInfo.ppEnabledExtensionNames = deviceExtensions;
             // Note: This isn't required, but added for backwards compatability.
 #if Game_SLOW
             createInfo.enabledLayerCount = static_cast<uint32_t>(_ValidationLayers.size());
@@ -659,6 +1429,35 @@ namespace Vulkan
 
             vkGetDeviceQueue(_Device, indices.graphicsFamily, 0, &graphicsQueue);
             vkGetDeviceQueue(_Device, indices.presentFamily, 0, &presentQueue);
+
+            // Note: For the GPU timestamps. A family with 0 valid bits can't write them at all.
+            uint32_t queueFamilyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+            VkPhysicalDeviceProperties deviceProperties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+            timestampPeriod = deviceProperties.limits.timestampPeriod;
+            minUniformBufferOffsetAlignment = deviceProperties.limits.minUniformBufferOffsetAlignment;
+            minStorageBufferOffsetAlignment = deviceProperties.limits.minStorageBufferOffsetAlignment;
+            // Note: The object binding's range is a whole region of the dynamic ring (every device has at least 128MB).
+            if (deviceProperties.limits.maxStorageBufferRange < VULKAN_DYNAMIC_RING_FRAME_SIZE) {
+                throw std::runtime_error("failed to fit a dynamic ring region in a storage buffer binding!");
+            }
+            graphicsTimestampBits = queueFamilies[indices.graphicsFamily].timestampValidBits;
+            transferTimestampBits = indices.transferFamily_HasValue ? queueFamilies[indices.transferFamily].timestampValidBits : graphicsTimestampBits;
+
+            sharedQueueFamilies[0] = indices.graphicsFamily;
+            if (indices.transferFamily_HasValue) {
+                vkGetDeviceQueue(_Device, indices.transferFamily, 0, &transferQueue);
+                sharedQueueFamilies[1] = indices.transferFamily;
+                sharedQueueFamilyCount = 2;
+            }
+            else {
+                transferQueue = graphicsQueue;
+                sharedQueueFamilyCount = 1;
+            }
         }
 
         void CreateSurface(HWND Window, HINSTANCE Instance)
@@ -678,10 +1477,11 @@ namespace Vulkan
 
         void CreateSwapChain(int FrameBufferWidth, int FrameBufferHeight)
         {
-            SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(physicalDevice);
+            SwapChainSupportDetails swapChainSupport;
+            QuerySwapChainSupport(physicalDevice, &swapChainSupport);
 
-            VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
-            VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+            VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats, swapChainSupport.formatCount);
+            presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, swapChainSupport.presentModeCount);
             VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities, FrameBufferWidth, FrameBufferHeight);
 
             uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -699,6 +1499,9 @@ namespace Vulkan
             createInfo.imageExtent = extent;
             createInfo.imageArrayLayers = 1;
             createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+                createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; // Note: For the software frame's blit.
+            }
 
             QueueFamilyIndices indices = FindQueueFamilies(physicalDevice);
             uint32_t queueFamilyIndices[] = { indices.graphicsFamily, indices.presentFamily };
@@ -716,25 +1519,274 @@ namespace Vulkan
             createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
             createInfo.presentMode = presentMode;
             createInfo.clipped = VK_TRUE;
+            // Note: On a recreation the old one is still here, the new one can take over its resources.
+            // The old one is retired by this even if creation fails, and destroyed by the caller either way.
+            createInfo.oldSwapchain = swapChain;
 
             VkResult result = vkCreateSwapchainKHR(_Device, &createInfo, nullptr, &swapChain);
             if (result != VK_SUCCESS) {
                 throw std::runtime_error("failed to create swap chain!");
             }
 
-            vkGetSwapchainImagesKHR(_Device, swapChain, &imageCount, nullptr);
-            swapChainImages.resize(imageCount);
-            vkGetSwapchainImagesKHR(_Device, swapChain, &imageCount, swapChainImages.data());
+            // Note: The driver may make more than minImageCount, but not anywhere near VULKAN_MAX_SWAPCHAIN_IMAGES.
+            imageCount = VULKAN_MAX_SWAPCHAIN_IMAGES;
+            if (vkGetSwapchainImagesKHR(_Device, swapChain, &imageCount, swapChainImages) != VK_SUCCESS) {
+                throw std::runtime_error("failed to get swap chain images!");
+            }
+            swapChainImageCount = imageCount;
 
             swapChainImageFormat = surfaceFormat.format;
             swapChainExtent = extent;
         }
 
-        void CreateImageViews()
+        // Note: Headless stand-in for CreateSwapChain, one image per frame in flight. The image views and framebuffers
+        // are made from swapChainImages as usual, so recording doesn't know the difference.
+        void CreateOffscreenImages()
+        {
+            swapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB; // Note: Same encoding as the B8G8R8A8_SRGB swap chain, in the order image files want.
+            swapChainExtent = offscreenExtent;
+            swapChainImageCount = framesInFlight;
+
+            for (uint32_t i = 0; i < swapChainImageCount; i++)
+            {
+                VkImageCreateInfo imageInfo = {};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.format = swapChainImageFormat;
+                imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+                if (vkCreateImage(_Device, &imageInfo, nullptr, &swapChainImages[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create offscreen image!");
+                }
+
+                VkMemoryRequirements memRequirements;
+                vkGetImageMemoryRequirements(_Device, swapChainImages[i], &memRequirements);
+
+                uint32_t memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                AllocateDeviceMemory(&memoryAllocator, memRequirements, memoryTypeIndex, MemoryResourceKind_Optimal, MemoryCategory_Image, &offscreenImageMemory[i]);
+
+                vkBindImageMemory(_Device, swapChainImages[i], offscreenImageMemory[i].Memory, offscreenImageMemory[i].Offset);
+            }
+        }
+
+        // Note: Host visible buffers for the frames being read back, cached if the device has it.
+        void CreateReadbackRing()
+        {
+            readbackRing = {};
+            readbackRing.Width = swapChainExtent.width;
+            readbackRing.Height = swapChainExtent.height;
+            readbackRing.Pitch = swapChainExtent.width * 4;
+            readbackRing.SlotSize = (VkDeviceSize)readbackRing.Pitch * swapChainExtent.height;
+
+            VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            readbackRing.HostCached = false;
+            for (uint32_t i = 0; i < memoryAllocator.MemoryProperties.memoryTypeCount; i++) {
+                if ((memoryAllocator.MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                    readbackRing.HostCached = true;
+                    break;
+                }
+            }
+            if (!readbackRing.HostCached) {
+                properties &= ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            }
+
+            for (size_t i = 0; i < VULKAN_READBACK_RING_SIZE; i++) {
+                CreateBuffer(readbackRing.SlotSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties,
+                    readbackRing.Slots[i].Buffer, readbackRing.Slots[i].Memory);
+            }
+        }
+
+        // Note: The staging ring and the image the software frame is blitted from. Leaves softwarePresent.Supported false
+        // (and makes nothing) if the swap chain images can't be blitted to.
+        void CreateSoftwarePresent()
+        {
+            softwarePresent = {};
+
+            VkSurfaceCapabilitiesKHR capabilities;
+            vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+
+            bool32 srgb = (swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat == VK_FORMAT_R8G8B8A8_SRGB);
+            softwarePresent.Format = srgb ? VK_FORMAT_B8G8R8A8_SRGB : VK_FORMAT_B8G8R8A8_UNORM;
+            if (!(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) ||
+                !CanBlitSoftwareFrame(physicalDevice, softwarePresent.Format, swapChainImageFormat)) {
+                return;
+            }
+
+            softwarePresent.SlotSize = (VkDeviceSize)VULKAN_SOFTWARE_FRAME_MAX_WIDTH * VULKAN_SOFTWARE_FRAME_MAX_HEIGHT * VULKAN_SOFTWARE_FRAME_BYTES_PER_PIXEL;
+            CreateBuffer(softwarePresent.SlotSize * framesInFlight, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, softwarePresent.StagingBuffer, softwarePresent.StagingMemory);
+            softwarePresent.Staging = (uint8_t*)softwarePresent.StagingMemory.Mapped;
+
+            // Note: The image it's copied into on the GPU is a render graph transient, see CreateRenderGraph.
+            softwarePresent.Supported = true;
+        }
+
+        // Note: A bindless texture's image: RGBA8, sampled as a one layer array. Returns false (and makes nothing) if
+        // newBlockAllowed is false and the existing image blocks have no room.
+        bool CreateTextureImage(uint32_t width, uint32_t height, bool32 newBlockAllowed, VkImage* image, VkImageView* view, MemoryAllocation* memory)
+        {
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+            imageInfo.extent = { width, height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            if (sharedQueueFamilyCount > 1) {
+                imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+                imageInfo.queueFamilyIndexCount = sharedQueueFamilyCount;
+                imageInfo.pQueueFamilyIndices = sharedQueueFamilies;
+            }
+
+            if (vkCreateImage(_Device, &imageInfo, nullptr, image) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create texture image!");
+            }
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(_Device, *image, &memRequirements);
+
+            uint32_t memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            if (newBlockAllowed) {
+                AllocateDeviceMemory(&memoryAllocator, memRequirements, memoryTypeIndex, MemoryResourceKind_Optimal, MemoryCategory_Image, memory);
+            }
+            else if (!TryAllocateDeviceMemory(&memoryAllocator, memRequirements, memoryTypeIndex, MemoryResourceKind_Optimal, MemoryCategory_Image, memory)) {
+                vkDestroyImage(_Device, *image, nullptr);
+                return false;
+            }
+            vkBindImageMemory(_Device, *image, memory->Memory, memory->Offset);
+
+            // Note: An array view of one layer, the sprite shader samples every texture as an array.
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = *image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+            viewInfo.format = imageInfo.format;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(_Device, &viewInfo, nullptr, view) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create texture image view!");
+            }
+            return true;
+        }
+
+        // Note: Starts moving the textures out of one mostly empty image block, see Vulkan_Defrag.cpp. Right after DrawFrame's
+        // fence wait, before anything of the frame is recorded, so the frame waits on the copies. Usually finds nothing to do.
+        void BeginDefragmentation()
+        {
+            ++defragStats.Checks;
+            uint32_t blockIndex = PickDefragBlock(&memoryAllocator, &bindlessTable);
+            if (blockIndex == VULKAN_MEMORY_NO_BLOCK) {
+                return;
+            }
+
+            LARGE_INTEGER defragCounter;
+            QueryPerformanceCounter(&defragCounter);
+
+            DefragPass* pass = &defragPass;
+            pass->BlockIndex = blockIndex;
+            pass->MoveCount = 0;
+            pass->MovedBytes = 0;
+            memoryAllocator.Blocks[blockIndex].Evacuating = true;
+
+            for (uint32_t id = 0; id < VULKAN_BINDLESS_ARRAY_SIZE && pass->MoveCount < VULKAN_DEFRAG_MAX_MOVES; id++) {
+                BindlessTexture* texture = &bindlessTable.Textures[id];
+                if (!texture->Image || texture->Memory.BlockIndex != blockIndex) {
+                    continue;
+                }
+
+                DefragMove* move = &pass->Moves[pass->MoveCount];
+                move->New = {};
+                if (!CreateTextureImage(texture->Extent.width, texture->Extent.height, false, &move->New.Image, &move->New.View, &move->New.Memory)) {
+                    ++defragStats.FailedMoves;
+                    break;
+                }
+
+                RecordTextureMove(&uploadContext, texture->Image, move->New.Image, texture->Extent);
+                move->ID = id;
+                move->OldImage = texture->Image;
+                pass->MovedBytes += move->New.Memory.Size;
+                pass->MoveCount++;
+            }
+
+            // Note: Every frame submitted from here on waits for the copies on the GPU, this one included.
+            pass->UploadValue = FlushUploads(&uploadContext);
+            pass->StageFrames = frameNumber + 1;
+            pass->Stage = DefragStage_Copying;
+            pass->MS = MillisecondsSince(defragCounter);
+        }
+
+        // Note: Takes the defragmentation pass to its next stage once the GPU has caught up, never waits. Every DrawFrame,
+        // right after the retires.
+        void UpdateDefragmentation()
         {
-            swapChainImageViews.resize(swapChainImages.size());
+            DefragPass* pass = &defragPass;
+            uint64_t completedFrames = (frameNumber + 1 >= framesInFlight) ? frameNumber + 1 - framesInFlight : 0;
+            if (pass->Stage == DefragStage_Idle || completedFrames < pass->StageFrames ||
+                uploadContext.CompletedValue < pass->UploadValue) {
+                return;
+            }
+            // Note: The IDs are switched only when no submitted frame can still be reading them, see ReplaceBindlessTexture.
+            // Frames go on being submitted, so it's checked (not waited on) until a frame finds them all done.
+            if (pass->Stage == DefragStage_Copying) {
+                for (uint32_t i = 0; i < framesInFlight; i++) {
+                    if (vkGetFenceStatus(_Device, inFlightFences[i]) != VK_SUCCESS) {
+                        return;
+                    }
+                }
+            }
+
+            LARGE_INTEGER defragCounter;
+            QueryPerformanceCounter(&defragCounter);
+
+            if (pass->Stage == DefragStage_Copying) {
+                // Note: Nothing in flight reads the old images any more; they go the same way as the rest of the deferred destroys.
+                for (uint32_t i = 0; i < pass->MoveCount; i++) {
+                    DefragMove* move = &pass->Moves[i];
+                    if (bindlessTable.Textures[move->ID].Image != move->OldImage) {
+                        // Note: Released and destroyed while the copy was on its way.
+                        DestroyDefragCopy(_Device, &memoryAllocator, move);
+                        continue;
+                    }
 
-            for (size_t i = 0; i < swapChainImages.size(); i++) 
+                    BindlessTexture old;
+                    ReplaceBindlessTexture(&bindlessTable, move->ID, move->New.View, VK_IMAGE_LAYOUT_GENERAL, move->New.Image, &move->New.Memory, &old);
+                    DeferDestroyTexture(&deferredDestroys, &old, frameNumber);
+                }
+                pass->Stage = DefragStage_Releasing;
+                pass->StageFrames = frameNumber;
+                pass->MS += MillisecondsSince(defragCounter);
+            }
+            else {
+                // Note: RetireDeferredDestroys has destroyed the old images by now, so the block is empty unless a move failed.
+                MemoryBlock* block = &memoryAllocator.Blocks[pass->BlockIndex];
+                block->Evacuating = false;
+                bool32 blockReleased = (block->AllocationCount == 0);
+                if (blockReleased) {
+                    DestroyMemoryBlock(&memoryAllocator, pass->BlockIndex);
+                }
+                pass->Stage = DefragStage_Idle;
+                pass->MS += MillisecondsSince(defragCounter);
+                AddDefragPass(&defragStats, pass->MoveCount, pass->MovedBytes, blockReleased, pass->MS);
+            }
+        }
+
+        void CreateImageViews()
+        {
+            for (uint32_t i = 0; i < swapChainImageCount; i++) 
             {
                 VkImageViewCreateInfo createInfo = {};
                 createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -753,6 +1805,8 @@ namespace Vulkan
             }
         }
 
+        // Note: The render graph moves the image into COLOR_ATTACHMENT_OPTIMAL before the pass and out of it after,
+        // so the pass itself neither transitions nor waits for anything.
         void CreateRenderPass()
         {
             VkAttachmentDescription colorAttachment{};
@@ -762,8 +1816,8 @@ namespace Vulkan
             colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
             colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-            colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
             VkAttachmentReference colorAttachmentRef{};
             colorAttachmentRef.attachment = 0;
@@ -774,51 +1828,175 @@ namespace Vulkan
             subpass.colorAttachmentCount = 1;
             subpass.pColorAttachments = &colorAttachmentRef;
 
-            VkSubpassDependency dependency{};
-            dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-            dependency.dstSubpass = 0;
-            dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            dependency.srcAccessMask = 0;
-            dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
             VkRenderPassCreateInfo renderPassInfo{};
             renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
             renderPassInfo.attachmentCount = 1;
             renderPassInfo.pAttachments = &colorAttachment;
             renderPassInfo.subpassCount = 1;
             renderPassInfo.pSubpasses = &subpass;
-            renderPassInfo.dependencyCount = 1;
-            renderPassInfo.pDependencies = &dependency;
 
             if (vkCreateRenderPass(_Device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create render pass!");
             }
+
+            // Note: The software frame was just blitted into the image, so this one keeps it. Only the load op differs,
+            // so framebuffers and pipelines work with both.
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+            if (vkCreateRenderPass(_Device, &renderPassInfo, nullptr, &softwareRenderPass) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create software frame render pass!");
+            }
         }
 
-        // size: length in bytes
-        VkShaderModule CreateShaderModule(void* code, size_t size) 
+        // Note: The frame's image work: the software frame's copy and blit (if it can be presented that way), the render pass,
+        // and offscreen the readback copy. Compiled once, with passes turned off per frame in RecordCommandBuffer.
+        void CreateRenderGraph()
         {
-            VkShaderModuleCreateInfo createInfo{};
-            createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-            createInfo.codeSize = size; // This is in bytes, so we're good
-            createInfo.pCode = (uint32_t*)code;
+            InitRenderGraph(&renderGraph, _Device, &memoryAllocator);
+
+            // Note: The acquire semaphore is waited on at the color attachment stage, so the first barrier starts there.
+            backbufferResource = AddRenderGraphImport(&renderGraph, "backbuffer", VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                headless ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+            if (softwarePresent.Supported) {
+                softwareFrameResource = AddRenderGraphTransient(&renderGraph, "software frame", softwarePresent.Format,
+                    VULKAN_SOFTWARE_FRAME_MAX_WIDTH, VULKAN_SOFTWARE_FRAME_MAX_HEIGHT);
+
+                softwareCopyPass = AddRenderGraphPass(&renderGraph, "software frame copy", RecordSoftwareCopyPass, this);
+                UseRenderGraphImage(&renderGraph, softwareCopyPass, softwareFrameResource, RenderGraphAccess_TransferWrite);
+
+                softwareBlitPass = AddRenderGraphPass(&renderGraph, "software frame blit", RecordSoftwareBlitPass, this);
+                UseRenderGraphImage(&renderGraph, softwareBlitPass, softwareFrameResource, RenderGraphAccess_TransferRead);
+                UseRenderGraphImage(&renderGraph, softwareBlitPass, backbufferResource, RenderGraphAccess_TransferWrite);
+            }
 
-            VkShaderModule shaderModule;
-            if (vkCreateShaderModule(_Device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create shader module!");
+            // Note: Loads when there's a software frame, so it's declared as reading the image too.
+            uint32_t mainPass = AddRenderGraphPass(&renderGraph, "main", RecordMainPass, this);
+            UseRenderGraphImage(&renderGraph, mainPass, backbufferResource, RenderGraphAccess_ColorReadWrite);
+
+            if (headless) {
+                uint32_t readbackPass = AddRenderGraphPass(&renderGraph, "readback", RecordReadbackPass, this);
+                UseRenderGraphImage(&renderGraph, readbackPass, backbufferResource, RenderGraphAccess_TransferRead);
+                SetRenderGraphPassNeverCull(&renderGraph, readbackPass);    // Note: Its output is the readback ring.
             }
-            return shaderModule;
+
+            CompileRenderGraph(&renderGraph);
+        }
+
+        // Note: The render graph's passes. Data is the application, the frame is the one RecordCommandBuffer is recording.
+        static void RecordSoftwareCopyPass(VkCommandBuffer commandBuffer, void* data)
+        {
+            HelloTriangleApplication* app = (HelloTriangleApplication*)data;
+            RecordSoftwareFrameCopy(&app->softwarePresent, commandBuffer, app->currentFrame,
+                GetRenderGraphImage(&app->renderGraph, app->softwareFrameResource));
+        }
+
+        static void RecordSoftwareBlitPass(VkCommandBuffer commandBuffer, void* data)
+        {
+            HelloTriangleApplication* app = (HelloTriangleApplication*)data;
+            RecordSoftwareFrameBlit(&app->softwarePresent, commandBuffer, GetRenderGraphImage(&app->renderGraph, app->softwareFrameResource),
+                app->swapChainImages[app->recordImageIndex], app->swapChainExtent);
+        }
+
+        static void RecordMainPass(VkCommandBuffer commandBuffer, void* data)
+        {
+            HelloTriangleApplication* app = (HelloTriangleApplication*)data;
+            uint32_t currentFrame = app->currentFrame;
+
+            VkRenderPassBeginInfo renderPassInfo = {};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = app->softwarePresent.Active ? app->softwareRenderPass : app->renderPass;
+            renderPassInfo.framebuffer = app->swapChainFramebuffers[app->recordImageIndex];
+            renderPassInfo.renderArea.offset = { 0, 0 };
+            renderPassInfo.renderArea.extent = app->swapChainExtent;
+
+            VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+            renderPassInfo.pClearValues = &clearColor;
+            renderPassInfo.clearValueCount = 1;
+
+            WriteFrameTimestamp(&app->gpuTimer, commandBuffer, currentFrame, VULKAN_TIMESTAMP_RENDER_PASS_BEGIN);
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            vkCmdExecuteCommands(commandBuffer, app->recordSliceCount, app->frameCommandPools[currentFrame].Secondaries);
+            vkCmdEndRenderPass(commandBuffer);
+            WriteFrameTimestamp(&app->gpuTimer, commandBuffer, currentFrame, VULKAN_TIMESTAMP_RENDER_PASS_END);
+        }
+
+        static void RecordReadbackPass(VkCommandBuffer commandBuffer, void* data)
+        {
+            HelloTriangleApplication* app = (HelloTriangleApplication*)data;
+            RecordReadbackCopy(&app->readbackRing, commandBuffer, app->swapChainImages[app->recordImageIndex], app->currentFrame, app->frameNumber);
         }
 
         void CreateGraphicsPipeline(game_memory* GameMemory)
         {
-            debug_read_file_result vertShaderCode = GameMemory->DEBUGPlatformReadEntireFile((char*)"/Game/build/SPIR-V/vert.spv");
-            debug_read_file_result fragShaderCode = GameMemory->DEBUGPlatformReadEntireFile((char*)"/Game/build/SPIR-V/frag.spv");
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            // Note: Set 0 is the main set, set 1 the bindless textures and buffers.
+            VkDescriptorSetLayout setLayouts[] = { descriptorSetLayout, bindlessTable.SetLayout };
+            pipelineLayoutInfo.setLayoutCount = 2;
+            pipelineLayoutInfo.pSetLayouts = setLayouts;
+
+            // Note: Per draw data for the object pipeline. The other pipelines share the layout and just don't read it.
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(ObjectDrawConstants);
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+            if (vkCreatePipelineLayout(_Device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline layout!");
+            }
+
+            VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+            vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            vertexInputInfo.pVertexBindingDescriptions = &MeshVertexLayout.Binding;
+            vertexInputInfo.vertexBindingDescriptionCount = 1;
+            vertexInputInfo.pVertexAttributeDescriptions = MeshVertexLayout.Attributes;
+            vertexInputInfo.vertexAttributeDescriptionCount = MeshVertexLayout.AttributeCount;
+
+            BuildGraphicsPipeline(&graphicsPipeline, GameMemory, "vert.spv", "frag.spv",
+                &vertexInputInfo, VK_CULL_MODE_BACK_BIT, false);
+            // Note: Same quad, but the transform comes from the object array. No culling, a transform may mirror it.
+            BuildGraphicsPipeline(&objectPipeline, GameMemory, "object_vert.spv", "frag.spv",
+                &vertexInputInfo, VK_CULL_MODE_NONE, false);
+        }
+
+        // Note: The callers only pick the shaders, the vertex input and the blending. The shader names are relative to
+        // VULKAN_SHADER_DIRECTORY. The pipeline is watched for shader changes from then on, and *pipeline is replaced
+        // at the start of a frame whenever it's been rebuilt (see Vulkan_HotReload.cpp).
+        void BuildGraphicsPipeline(VkPipeline* pipeline, game_memory* GameMemory, const char* vertName, const char* fragName,
+            VkPipelineVertexInputStateCreateInfo* vertexInputInfo, VkCullModeFlags cullMode, bool32 alphaBlend)
+        {
+            GraphicsPipelineDesc* desc = AddShaderReloadPipeline(&shaderReload, pipeline, vertName, fragName, vertexInputInfo, cullMode, alphaBlend);
+            VkShaderModule vertShaderModule = LoadShaderModule(&pipelineCache, GameMemory, vertName);
+            VkShaderModule fragShaderModule = LoadShaderModule(&pipelineCache, GameMemory, fragName);
+
+            LARGE_INTEGER pipelineCounter;
+            QueryPerformanceCounter(&pipelineCounter);
+
+            if (CreateGraphicsPipelineFromDesc(desc, vertShaderModule, fragShaderModule, pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create graphics pipeline!");
+            }
+            pipelineCache.Stats.PipelineMS += MillisecondsSince(pipelineCounter);
+
+            // Note: The shader modules belong to the pipeline cache now, they're shared with any other pipeline using the same SPIR-V.
+        }
 
-            VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode.Contents, vertShaderCode.ContentsSize);
-            VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode.Contents, fragShaderCode.ContentsSize);
+        // Note: The shader reload thread's way in, see StartShaderReload.
+        static VkResult BuildReloadedPipeline(void* context, GraphicsPipelineDesc* desc, VkShaderModule vertModule,
+            VkShaderModule fragModule, VkPipeline* pipeline)
+        {
+            HelloTriangleApplication* app = (HelloTriangleApplication*)context;
+            return app->CreateGraphicsPipelineFromDesc(desc, vertModule, fragModule, pipeline);
+        }
 
+        // Note: Everything our graphics pipelines have in common: dynamic viewport/scissor, triangle lists, no depth,
+        // pipelineLayout, subpass 0 of renderPass. Runs on the shader reload thread too, so it only reads handles
+        // that don't change after InitVulkan.
+        VkResult CreateGraphicsPipelineFromDesc(GraphicsPipelineDesc* desc, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule,
+            VkPipeline* pipeline)
+        {
             VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
             vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
             vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -833,25 +2011,15 @@ namespace Vulkan
 
             VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-            std::vector<VkDynamicState> dynamicStates = {
+            VkDynamicState dynamicStates[] = {
                 VK_DYNAMIC_STATE_VIEWPORT,
                 VK_DYNAMIC_STATE_SCISSOR
             };
 
             VkPipelineDynamicStateCreateInfo dynamicState = {};
             dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-            dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-            dynamicState.pDynamicStates = dynamicStates.data();
-
-            auto bindingDescription = Vertex::getBindingDescription();
-            auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-            VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-            vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-            vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-            vertexInputInfo.vertexBindingDescriptionCount = 1;
-            vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-            vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+            dynamicState.dynamicStateCount = 2;
+            dynamicState.pDynamicStates = dynamicStates;
 
             VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
             inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -869,7 +2037,7 @@ namespace Vulkan
             rasterizer.rasterizerDiscardEnable = VK_FALSE;
             rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
             rasterizer.lineWidth = 1.0f;
-            rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+            rasterizer.cullMode = desc->CullMode;
             rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
             rasterizer.depthBiasEnable = VK_FALSE;
             rasterizer.depthBiasConstantFactor = 0.0f; // Optional
@@ -894,6 +2062,12 @@ namespace Vulkan
             colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
             colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
             colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
+            if (desc->AlphaBlend) {
+                colorBlendAttachment.blendEnable = VK_TRUE;
+                colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+                colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+                colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            }
 
             VkPipelineColorBlendStateCreateInfo colorBlending = {};
             colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -906,22 +2080,11 @@ namespace Vulkan
             colorBlending.blendConstants[2] = 0.0f; // Optional
             colorBlending.blendConstants[3] = 0.0f; // Optional
 
-            VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-            pipelineLayoutInfo.setLayoutCount = 1;
-            pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-            pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-            pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-            if (vkCreatePipelineLayout(_Device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create pipeline layout!");
-            }
-
             VkGraphicsPipelineCreateInfo pipelineInfo = {};
             pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
             pipelineInfo.pStages = shaderStages;    // pointer
             pipelineInfo.stageCount = 2;            // count of pointer
-            pipelineInfo.pVertexInputState = &vertexInputInfo;
+            pipelineInfo.pVertexInputState = &desc->VertexInput;
             pipelineInfo.pInputAssemblyState = &inputAssembly;
             pipelineInfo.pViewportState = &viewportState;
             pipelineInfo.pRasterizationState = &rasterizer;
@@ -935,22 +2098,377 @@ namespace Vulkan
             pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
             pipelineInfo.basePipelineIndex = -1; // Optional
 
-            if (vkCreateGraphicsPipelines(_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create graphics pipeline!");
+            // Note: The pipeline cache is internally synchronized, so both threads can build through it.
+            return vkCreateGraphicsPipelines(_Device, pipelineCache.Cache, 1, &pipelineInfo, nullptr, pipeline);
+        }
+
+        void CreateSpriteRenderer(game_memory* GameMemory)
+        {
+            spriteRenderer = {};
+            spriteRenderer.UseAVX2 = CPUHasAVX2();
+
+            // Note: Binding 0 is the quad (position only), binding 1 the per-instance data.
+            VkVertexInputBindingDescription bindingDescriptions[] = { MeshVertexLayout.Binding, SpriteInstanceLayout.Binding };
+
+            VkVertexInputAttributeDescription attributeDescriptions[6];
+            attributeDescriptions[0] = MeshVertexLayout.Attributes[0];
+            for (uint32_t i = 0; i < SpriteInstanceLayout.AttributeCount; i++) {
+                attributeDescriptions[1 + i] = SpriteInstanceLayout.Attributes[i];
             }
 
-            // Note: Cleanup (Don't put any code after this).
-            vkDestroyShaderModule(_Device, fragShaderModule, nullptr);
-            vkDestroyShaderModule(_Device, vertShaderModule, nullptr);
-            GameMemory->DEBUGPlatformFreeFileMemory(vertShaderCode.Contents);
-            GameMemory->DEBUGPlatformFreeFileMemory(fragShaderCode.Contents);
+            VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+            vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+            vertexInputInfo.vertexBindingDescriptionCount = 2;
+            vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+            vertexInputInfo.vertexAttributeDescriptionCount = 6;
+
+            // Note: No culling, a negative size flips the sprite.
+            BuildGraphicsPipeline(&spriteRenderer.Pipeline, GameMemory, "sprite_vert.spv", "sprite_frag.spv",
+                &vertexInputInfo, VK_CULL_MODE_NONE, true);
+
+            VkDeviceSize bufferSize = sizeof(SpriteInstance) * VULKAN_SPRITE_MAX_INSTANCES;
+            for (size_t i = 0; i < framesInFlight; i++)
+            {
+                SpriteFrame* frame = &spriteRenderer.Frames[i];
+                CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame->InstanceBuffer, frame->InstanceMemory);
+                frame->Instances = (SpriteInstance*)frame->InstanceMemory.Mapped;
+            }
         }
 
+        void CreateSpriteCuller(game_memory* GameMemory)
+        {
+            spriteCuller = {};
+            spriteCuller.DrawIndirectCount = drawIndirectCountEnabled;
+            spriteCuller.MultiDrawIndirect = multiDrawIndirectEnabled;
+
+            // Note: 0 = UBO, 1 = source instances, 2 = source atlases, 3 = slots, 4 = visible instances, 5 = indirect draws,
+            // 6 = sheet transforms. 0 and 6 are written every frame and live in the dynamic ring.
+            VkDescriptorSetLayoutBinding bindings[7] = {};
+            for (uint32_t i = 0; i < 7; i++) {
+                bindings[i].binding = i;
+                bindings[i].descriptorType = (i == 0) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC :
+                                             (i == 6) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                bindings[i].descriptorCount = 1;
+                bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            }
+
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = 7;
+            layoutInfo.pBindings = bindings;
+
+            if (vkCreateDescriptorSetLayout(_Device, &layoutInfo, nullptr, &spriteCuller.SetLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create cull descriptor set layout!");
+            }
+
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(SpriteCullConstants);
+
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &spriteCuller.SetLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+            if (vkCreatePipelineLayout(_Device, &pipelineLayoutInfo, nullptr, &spriteCuller.PipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create cull pipeline layout!");
+            }
+
+            // Note: The three passes are one shader, specialized on the pass index.
+            VkShaderModule compShaderModule = LoadShaderModule(&pipelineCache, GameMemory, "sprite_cull_comp.spv");
+
+            uint32_t passes[3] = { 0, 1, 2 };
+            VkSpecializationMapEntry specializationEntry{};
+            specializationEntry.constantID = 0;
+            specializationEntry.offset = 0;
+            specializationEntry.size = sizeof(uint32_t);
+
+            VkSpecializationInfo specializationInfos[3] = {};
+            VkComputePipelineCreateInfo pipelineInfos[3] = {};
+            for (uint32_t i = 0; i < 3; i++) {
+                specializationInfos[i].mapEntryCount = 1;
+                specializationInfos[i].pMapEntries = &specializationEntry;
+                specializationInfos[i].dataSize = sizeof(uint32_t);
+                specializationInfos[i].pData = &passes[i];
+
+                pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfos[i].stage.module = compShaderModule;
+                pipelineInfos[i].stage.pName = "main";
+                pipelineInfos[i].stage.pSpecializationInfo = &specializationInfos[i];
+                pipelineInfos[i].layout = spriteCuller.PipelineLayout;
+            }
+
+            LARGE_INTEGER pipelineCounter;
+            QueryPerformanceCounter(&pipelineCounter);
+
+            VkPipeline pipelines[3];
+            if (vkCreateComputePipelines(_Device, pipelineCache.Cache, 3, pipelineInfos, nullptr, pipelines) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create cull pipelines!");
+            }
+            pipelineCache.Stats.PipelineMS += MillisecondsSince(pipelineCounter);
+            spriteCuller.CullPipeline = pipelines[0];
+            spriteCuller.BuildPipeline = pipelines[1];
+            spriteCuller.ScatterPipeline = pipelines[2];
+
+            VkDeviceSize instancesSize = sizeof(SpriteInstance) * VULKAN_SPRITE_MAX_INSTANCES;
+            VkDeviceSize atlasesSize = sizeof(uint32_t) * VULKAN_SPRITE_MAX_INSTANCES;
+            // Note: The simulation moves these in place; transfer source for its readback.
+            CreateBuffer(instancesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, spriteCuller.SourceInstances, spriteCuller.SourceMemory);
+            CreateBuffer(atlasesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                spriteCuller.SourceAtlases, spriteCuller.SourceAtlasMemory);
+
+            for (size_t i = 0; i < framesInFlight; i++) {
+                SpriteCullFrame* frame = &spriteCuller.Frames[i];
+                CreateBuffer(atlasesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    frame->Slots, frame->SlotsMemory);
+                CreateBuffer(instancesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    frame->VisibleInstances, frame->VisibleMemory);
+                CreateBuffer(sizeof(SpriteCullIndirect), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame->Indirect, frame->IndirectMemory);
+            }
+
+            VkDescriptorPoolSize poolSizes[3] = {};
+            poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            poolSizes[0].descriptorCount = framesInFlight;
+            poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            poolSizes[1].descriptorCount = static_cast<uint32_t>(5 * framesInFlight);
+            poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            poolSizes[2].descriptorCount = framesInFlight;
+
+            VkDescriptorPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.poolSizeCount = 3;
+            poolInfo.pPoolSizes = poolSizes;
+            poolInfo.maxSets = framesInFlight;
+
+            if (vkCreateDescriptorPool(_Device, &poolInfo, nullptr, &spriteCuller.DescriptorPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create cull descriptor pool!");
+            }
+
+            for (size_t i = 0; i < framesInFlight; i++) {
+                SpriteCullFrame* frame = &spriteCuller.Frames[i];
+
+                VkDescriptorSetAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                allocInfo.descriptorPool = spriteCuller.DescriptorPool;
+                allocInfo.descriptorSetCount = 1;
+                allocInfo.pSetLayouts = &spriteCuller.SetLayout;
+
+                if (vkAllocateDescriptorSets(_Device, &allocInfo, &frame->DescriptorSet) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate cull descriptor sets!");
+                }
+
+                VkDescriptorBufferInfo bufferInfos[7] = {};
+                bufferInfos[0].buffer = dynamicRing.Buffer; // Note: The camera, at this frame's dynamic offset.
+                bufferInfos[0].range = sizeof(UniformBufferObject);
+                bufferInfos[1].buffer = spriteCuller.SourceInstances;
+                bufferInfos[1].range = VK_WHOLE_SIZE;
+                bufferInfos[2].buffer = spriteCuller.SourceAtlases;
+                bufferInfos[2].range = VK_WHOLE_SIZE;
+                bufferInfos[3].buffer = frame->Slots;
+                bufferInfos[3].range = VK_WHOLE_SIZE;
+                bufferInfos[4].buffer = frame->VisibleInstances;
+                bufferInfos[4].range = VK_WHOLE_SIZE;
+                bufferInfos[5].buffer = frame->Indirect;
+                bufferInfos[5].range = VK_WHOLE_SIZE;
+                bufferInfos[6].buffer = dynamicRing.Buffer;
+                bufferInfos[6].range = sizeof(spriteAtlas.Transforms);
+
+                VkWriteDescriptorSet descriptorWrites[7] = {};
+                for (uint32_t binding = 0; binding < 7; binding++) {
+                    descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[binding].dstSet = frame->DescriptorSet;
+                    descriptorWrites[binding].dstBinding = binding;
+                    descriptorWrites[binding].descriptorType = bindings[binding].descriptorType;
+                    descriptorWrites[binding].descriptorCount = 1;
+                    descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+                }
+
+                vkUpdateDescriptorSets(_Device, 7, descriptorWrites, 0, nullptr);
+            }
+        }
+
+        // Note: After CreateSpriteCuller, the kernels work on its source instances.
+        void CreateSpriteSimulation(game_memory* GameMemory)
+        {
+            spriteSimulation = {};
+
+            // Note: 0 = source instances (positions), 1 = velocities, 2 = destinations.
+            VkDescriptorSetLayoutBinding bindings[3] = {};
+            for (uint32_t i = 0; i < 3; i++) {
+                bindings[i].binding = i;
+                bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                bindings[i].descriptorCount = 1;
+                bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            }
+
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = 3;
+            layoutInfo.pBindings = bindings;
+
+            if (vkCreateDescriptorSetLayout(_Device, &layoutInfo, nullptr, &spriteSimulation.SetLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create simulation descriptor set layout!");
+            }
+
+            VkPushConstantRange pushConstantRange{};
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(SimulationConstants);
+
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &spriteSimulation.SetLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+            if (vkCreatePipelineLayout(_Device, &pipelineLayoutInfo, nullptr, &spriteSimulation.PipelineLayout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create simulation pipeline layout!");
+            }
+
+            // Note: Same as the cull, one shader specialized on the kernel index.
+            VkShaderModule compShaderModule = LoadShaderModule(&pipelineCache, GameMemory, "sprite_sim_comp.spv");
+
+            uint32_t kernels[VULKAN_SIM_KERNEL_COUNT] = { VULKAN_SIM_KERNEL_MOVE_TO_DESTINATION, VULKAN_SIM_KERNEL_VELOCITY };
+            VkSpecializationMapEntry specializationEntry{};
+            specializationEntry.constantID = 0;
+            specializationEntry.offset = 0;
+            specializationEntry.size = sizeof(uint32_t);
+
+            VkSpecializationInfo specializationInfos[VULKAN_SIM_KERNEL_COUNT] = {};
+            VkComputePipelineCreateInfo pipelineInfos[VULKAN_SIM_KERNEL_COUNT] = {};
+            for (uint32_t i = 0; i < VULKAN_SIM_KERNEL_COUNT; i++) {
+                specializationInfos[i].mapEntryCount = 1;
+                specializationInfos[i].pMapEntries = &specializationEntry;
+                specializationInfos[i].dataSize = sizeof(uint32_t);
+                specializationInfos[i].pData = &kernels[i];
+
+                pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+                pipelineInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                pipelineInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+                pipelineInfos[i].stage.module = compShaderModule;
+                pipelineInfos[i].stage.pName = "main";
+                pipelineInfos[i].stage.pSpecializationInfo = &specializationInfos[i];
+                pipelineInfos[i].layout = spriteSimulation.PipelineLayout;
+            }
+
+            LARGE_INTEGER pipelineCounter;
+            QueryPerformanceCounter(&pipelineCounter);
+
+            if (vkCreateComputePipelines(_Device, pipelineCache.Cache, VULKAN_SIM_KERNEL_COUNT, pipelineInfos, nullptr,
+                                         spriteSimulation.Pipelines) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create simulation pipelines!");
+            }
+            pipelineCache.Stats.PipelineMS += MillisecondsSince(pipelineCounter);
+
+            CreateBuffer(sizeof(glm::vec3) * VULKAN_SPRITE_MAX_INSTANCES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, spriteSimulation.Velocities, spriteSimulation.VelocityMemory);
+            CreateBuffer(sizeof(glm::vec4) * VULKAN_SPRITE_MAX_INSTANCES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, spriteSimulation.Destinations, spriteSimulation.DestinationMemory);
+            CreateBuffer(sizeof(SpriteInstance) * VULKAN_SPRITE_MAX_INSTANCES, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, spriteSimulation.Readback, spriteSimulation.ReadbackMemory);
+
+            VkDescriptorPoolSize poolSize{};
+            poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            poolSize.descriptorCount = 3;
+
+            VkDescriptorPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.poolSizeCount = 1;
+            poolInfo.pPoolSizes = &poolSize;
+            poolInfo.maxSets = 1;
+
+            if (vkCreateDescriptorPool(_Device, &poolInfo, nullptr, &spriteSimulation.DescriptorPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create simulation descriptor pool!");
+            }
+
+            VkDescriptorSetAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool = spriteSimulation.DescriptorPool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &spriteSimulation.SetLayout;
+
+            if (vkAllocateDescriptorSets(_Device, &allocInfo, &spriteSimulation.DescriptorSet) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate simulation descriptor set!");
+            }
+
+            VkDescriptorBufferInfo bufferInfos[3] = {};
+            bufferInfos[0].buffer = spriteCuller.SourceInstances;
+            bufferInfos[0].range = VK_WHOLE_SIZE;
+            bufferInfos[1].buffer = spriteSimulation.Velocities;
+            bufferInfos[1].range = VK_WHOLE_SIZE;
+            bufferInfos[2].buffer = spriteSimulation.Destinations;
+            bufferInfos[2].range = VK_WHOLE_SIZE;
+
+            VkWriteDescriptorSet descriptorWrites[3] = {};
+            for (uint32_t binding = 0; binding < 3; binding++) {
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = spriteSimulation.DescriptorSet;
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[binding].descriptorCount = 1;
+                descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+            }
+
+            vkUpdateDescriptorSets(_Device, 3, descriptorWrites, 0, nullptr);
+        }
+
+        void DestroySpriteSimulation()
+        {
+            vkDestroyBuffer     (_Device, spriteSimulation.Velocities, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &spriteSimulation.VelocityMemory);
+            vkDestroyBuffer     (_Device, spriteSimulation.Destinations, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &spriteSimulation.DestinationMemory);
+            vkDestroyBuffer     (_Device, spriteSimulation.Readback, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &spriteSimulation.ReadbackMemory);
+
+            for (uint32_t i = 0; i < VULKAN_SIM_KERNEL_COUNT; i++) {
+                vkDestroyPipeline(_Device, spriteSimulation.Pipelines[i], nullptr);
+            }
+            vkDestroyPipelineLayout(_Device, spriteSimulation.PipelineLayout, nullptr);
+            vkDestroyDescriptorPool(_Device, spriteSimulation.DescriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(_Device, spriteSimulation.SetLayout, nullptr);
+        }
+
+        void DestroySpriteCuller()
+        {
+            for (size_t i = 0; i < framesInFlight; i++) {
+                SpriteCullFrame* frame = &spriteCuller.Frames[i];
+                vkDestroyBuffer (_Device, frame->Slots, nullptr);
+                FreeDeviceMemory(&memoryAllocator, &frame->SlotsMemory);
+                vkDestroyBuffer (_Device, frame->VisibleInstances, nullptr);
+                FreeDeviceMemory(&memoryAllocator, &frame->VisibleMemory);
+                vkDestroyBuffer (_Device, frame->Indirect, nullptr);
+                FreeDeviceMemory(&memoryAllocator, &frame->IndirectMemory);
+            }
+            vkDestroyBuffer     (_Device, spriteCuller.SourceInstances, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &spriteCuller.SourceMemory);
+            vkDestroyBuffer     (_Device, spriteCuller.SourceAtlases, nullptr);
+            FreeDeviceMemory    (&memoryAllocator, &spriteCuller.SourceAtlasMemory);
+
+            vkDestroyPipeline   (_Device, spriteCuller.CullPipeline, nullptr);
+            vkDestroyPipeline   (_Device, spriteCuller.BuildPipeline, nullptr);
+            vkDestroyPipeline   (_Device, spriteCuller.ScatterPipeline, nullptr);
+            vkDestroyPipelineLayout(_Device, spriteCuller.PipelineLayout, nullptr);
+            vkDestroyDescriptorPool(_Device, spriteCuller.DescriptorPool, nullptr);
+            vkDestroyDescriptorSetLayout(_Device, spriteCuller.SetLayout, nullptr);
+        }
+
+        // Note: 0 = camera, 1 = object array, both in the dynamic ring and bound with one dynamic offset each.
+        // Textures are in the bindless set.
         void CreateDescriptorSetLayout()
         {
             VkDescriptorSetLayoutBinding uboLayoutBinding{};
             uboLayoutBinding.binding = 0;
-            uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             uboLayoutBinding.descriptorCount = 1;
 
             // Vertex Stage
@@ -958,10 +2476,18 @@ namespace Vulkan
 
             uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
 
+            VkDescriptorSetLayoutBinding objectLayoutBinding{};
+            objectLayoutBinding.binding = 1;
+            objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            objectLayoutBinding.descriptorCount = 1;
+            objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+            VkDescriptorSetLayoutBinding bindings[] = { uboLayoutBinding, objectLayoutBinding };
+
             VkDescriptorSetLayoutCreateInfo layoutInfo{};
             layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            layoutInfo.bindingCount = 1;
-            layoutInfo.pBindings = &uboLayoutBinding;
+            layoutInfo.bindingCount = 2;
+            layoutInfo.pBindings = bindings;
 
             if (vkCreateDescriptorSetLayout(_Device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create descriptor set layout!");
@@ -970,9 +2496,7 @@ namespace Vulkan
 
         void CreateFramebuffers()
         {
-            swapChainFramebuffers.resize(swapChainImageViews.size());
-
-            for (size_t i = 0; i < swapChainImageViews.size(); i++) 
+            for (uint32_t i = 0; i < swapChainImageCount; i++) 
             {
                 VkImageView attachments[] = 
                 {
@@ -994,68 +2518,150 @@ namespace Vulkan
             }
         }
 
+        // Note: One primary pool and one pool per recording slice, for every frame in flight. Each comes with its command buffer.
         void CreateCommandPool()
         {
             QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(physicalDevice);
 
-            VkCommandPoolCreateInfo poolInfo = {};
-            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-            poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-            poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-
-            if (vkCreateCommandPool(_Device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create command pool!");
+            for (size_t i = 0; i < framesInFlight; i++) {
+                CreateFrameCommandPools(_Device, queueFamilyIndices.graphicsFamily, &frameCommandPools[i]);
             }
         }
 
-        void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) 
+        // Note: The render pass contents are recorded as secondaries on the job threads, one per slice of the sprite rows.
+        // This thread records the primary around them: the cull pass, then the render graph (see CreateRenderGraph).
+        void RecordCommandBuffer(uint32_t imageIndex) 
         {
+            FrameCommandPools* pools = &frameCommandPools[currentFrame];
+
+            uint32_t sliceCount = 1;
+            if (spriteColumns) {
+                uint32_t rowCount = (spriteColumns->Count < VULKAN_SPRITE_MAX_INSTANCES) ? spriteColumns->Count : VULKAN_SPRITE_MAX_INSTANCES;
+                sliceCount = GetRecordSliceCount(rowCount, GetRecordThreadCount());
+                BeginSpriteSlices(&spriteRenderer, spriteColumns, sliceCount);
+            }
+            else {
+                spriteRenderer.InstanceCount = 0;
+                spriteRenderer.SliceCount = 1;
+                spriteRenderer.Slices[0].RowBegin = 0;
+                spriteRenderer.Slices[0].RowEnd = 0;
+                spriteRenderer.Slices[0].Sheets = 0;
+                spriteRenderer.Slices[0].VisibleCount = 0;
+            }
+
+            ResetFrameCommandPools(_Device, pools, sliceCount);
+
+            recordState.RenderPass = renderPass;
+            recordState.Framebuffer = swapChainFramebuffers[imageIndex];
+            recordState.Extent = swapChainExtent;
+            recordState.FrameIndex = currentFrame;
+            recordState.PipelineLayout = pipelineLayout;
+            recordState.DescriptorSets[0] = descriptorSet;
+            recordState.DescriptorSets[1] = bindlessTable.DescriptorSet;
+            recordState.DynamicOffsets[0] = dynamicOffsets[0];
+            recordState.DynamicOffsets[1] = dynamicOffsets[1];
+            recordState.ObjectPipeline = objectPipeline;
+            recordState.ObjectBatches = objectBatches;
+            recordState.ObjectBatchCount = objectBatchCount;
+            recordState.QuadPipeline = graphicsPipeline;
+            recordState.GeometryVertexBuffer = geometry.VertexBuffer;
+            recordState.GeometryIndexBuffer = geometry.IndexBuffer;
+            recordState.Quad = *GetGeometryMesh(&geometry, quadMesh);
+            recordState.Sprites = &spriteRenderer;
+            recordState.Culler = &spriteCuller;
+            recordState.Columns = spriteColumns;
+            recordState.Definitions = spriteDefinitions;
+            recordState.SheetTransforms = spriteAtlas.Transforms;
+            recordState.SoftwareFrame = softwarePresent.Active;
+
+            for (uint32_t i = 0; i < sliceCount; i++) {
+                recordJobs[i].State = &recordState;
+                recordJobs[i].SliceIndex = i;
+                recordJobs[i].CommandBuffer = pools->Secondaries[i];
+                recordJobs[i].Result = VK_SUCCESS;
+            }
+
+            if (spriteColumns) {
+                for (uint32_t i = 0; i < sliceCount; i++) {
+                    AddJob(&jobQueue, CullSliceJob, &recordJobs[i]);
+                }
+                CompleteAllJobs(&jobQueue);
+                AddSpriteCullFrame(&spriteRenderer);
+            }
+
+            // Note: The changed culled sprites, before anything looks at their count or sheets. WriteObjectBatches left
+            // the ring room for them, so they fit; if they somehow didn't, they'd stay dirty for the next UpdateCulledSprites.
+            bool32 copyCulledSprites = false;
+            if (culledColumns) {
+                copyCulledSprites = WriteDirtySpriteChunks(&spriteCuller, &dynamicRing, culledColumns, culledDefinitions, culledDirtyBytes);
+                culledColumns = nullptr;
+            }
+
+            // Note: Residency has to be settled before any instance is written, the UV rects depend on it.
+            uint64_t usedSheets = spriteCuller.SourceCount ? spriteCuller.SourceSheets : 0;
+            for (uint32_t i = 0; i < spriteRenderer.SliceCount; i++) {
+                usedSheets |= spriteRenderer.Slices[i].Sheets;
+            }
+            UpdateAtlasResidency(&spriteAtlas, &uploadContext, usedSheets, frameNumber, framesInFlight);
+
+            cullDynamicOffsets[0] = dynamicOffsets[0];
+            cullDynamicOffsets[1] = dynamicOffsets[0];
+            if (spriteCuller.SourceCount) {
+                void* transforms = PushDynamicData(&dynamicRing, sizeof(spriteAtlas.Transforms), &cullDynamicOffsets[1]);
+                if (!transforms) {
+                    throw std::runtime_error("failed to allocate the sheet transforms from the dynamic ring!");
+                }
+                memcpy(transforms, spriteAtlas.Transforms, sizeof(spriteAtlas.Transforms));
+            }
+
+            for (uint32_t i = 0; i < sliceCount; i++) {
+                AddJob(&jobQueue, RecordSliceJobProc, &recordJobs[i]);
+            }
+            CompleteAllJobs(&jobQueue);
+            spriteColumns = nullptr;
+            objectBatchCount = 0;
+
+            for (uint32_t i = 0; i < sliceCount; i++) {
+                if (recordJobs[i].Result != VK_SUCCESS) {
+                    throw std::runtime_error("failed to record secondary command buffer!");
+                }
+            }
+
+            VkCommandBuffer commandBuffer = pools->Primary;
+
             VkCommandBufferBeginInfo beginInfo = {};
             beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            beginInfo.flags = 0; // Optional
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
             beginInfo.pInheritanceInfo = nullptr; // Optional
 
             if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
                 throw std::runtime_error("failed to begin recording command buffer!");
             }
+            BeginFrameTimestamps(&gpuTimer, commandBuffer, currentFrame, frameNumber);
 
-            VkRenderPassBeginInfo renderPassInfo = {};
-            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassInfo.renderPass = renderPass;
-            renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
-            renderPassInfo.renderArea.offset = { 0, 0 };
-            renderPassInfo.renderArea.extent = swapChainExtent;
-
-            VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-            renderPassInfo.pClearValues = &clearColor;
-            renderPassInfo.clearValueCount = 1;
-
-            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(swapChainExtent.width);
-            viewport.height = static_cast<float>(swapChainExtent.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            if (copyCulledSprites) {
+                RecordDirtySpriteChunks(&spriteCuller, commandBuffer, dynamicRing.Buffer);
+            }
 
-            VkRect2D scissor{};
-            scissor.offset = { 0, 0 };
-            scissor.extent = swapChainExtent;
-            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            // Note: Moves the source instances before the cull reads them.
+            RecordSpriteSimulation(&spriteSimulation, commandBuffer, spriteCuller.SourceInstances, spriteCuller.SourceCount, currentFrame);
+            WriteFrameTimestamp(&gpuTimer, commandBuffer, currentFrame, VULKAN_TIMESTAMP_SIMULATION_END);
 
-            VkBuffer vertexBuffers[] = { vertexBuffer };
-            VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers  (commandBuffer, 0, 1, vertexBuffers, offsets);
-            vkCmdBindIndexBuffer    (commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+            if (spriteCuller.SourceCount) {
+                RecordSpriteCull(&spriteCuller, commandBuffer, currentFrame, &recordState.Quad, cullDynamicOffsets);
+            }
 
-            vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(_Indices.size()), 1, 0, 0, 0);
+            BeginRenderGraphFrame(&renderGraph);
+            SetRenderGraphImage(&renderGraph, backbufferResource, swapChainImages[imageIndex]);
+            if (softwarePresent.Supported) {
+                SetRenderGraphPassEnabled(&renderGraph, softwareCopyPass, softwarePresent.Active);
+                SetRenderGraphPassEnabled(&renderGraph, softwareBlitPass, softwarePresent.Active);
+            }
+            recordImageIndex = imageIndex;
+            recordSliceCount = sliceCount;
+            ExecuteRenderGraph(&renderGraph, commandBuffer);
 
-            vkCmdEndRenderPass(commandBuffer);
+            WriteFrameTimestamp(&gpuTimer, commandBuffer, currentFrame, VULKAN_TIMESTAMP_FRAME_END);
 
             if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
                 throw std::runtime_error("failed to record command buffer!");
@@ -1077,7 +2683,8 @@ namespace Vulkan
             throw std::runtime_error("failed to find suitable memory type!");
         }
 
-        void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) 
+        // Note: The memory comes out of memoryAllocator's blocks. Host visible memory is already mapped (bufferMemory.Mapped).
+        void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory) 
         {
             VkBufferCreateInfo bufferInfo = {};
             bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1085,6 +2692,14 @@ namespace Vulkan
             bufferInfo.usage = usage;
             bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+            // Note: Upload targets are written on the transfer queue and read on the graphics queue.
+            // Concurrent sharing saves us the queue family ownership transfer barriers.
+            if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && sharedQueueFamilyCount > 1) {
+                bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+                bufferInfo.queueFamilyIndexCount = sharedQueueFamilyCount;
+                bufferInfo.pQueueFamilyIndices = sharedQueueFamilies;
+            }
+
             if (vkCreateBuffer(_Device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create buffer!");
             }
@@ -1092,166 +2707,190 @@ namespace Vulkan
             VkMemoryRequirements memRequirements;
             vkGetBufferMemoryRequirements(_Device, buffer, &memRequirements);
 
-            VkMemoryAllocateInfo allocInfo = {};
-            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            allocInfo.allocationSize = memRequirements.size;
-            allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-            if (vkAllocateMemory(_Device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate buffer memory!");
-            }
+            // Note: Host visible buffers that are only copied to or from count as staging.
+            bool32 staging = (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+                             !(usage & ~(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+            uint32_t memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+            AllocateDeviceMemory(&memoryAllocator, memRequirements, memoryTypeIndex, MemoryResourceKind_Linear,
+                staging ? MemoryCategory_Staging : MemoryCategory_Buffer, &bufferMemory);
 
-            vkBindBufferMemory(_Device, buffer, bufferMemory, 0);
+            vkBindBufferMemory(_Device, buffer, bufferMemory.Memory, bufferMemory.Offset);
         }
 
-        void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) 
+        void CreateUploadContext()
         {
-            VkCommandBufferAllocateInfo allocInfo = {};
-            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            allocInfo.commandPool = commandPool;
-            allocInfo.commandBufferCount = 1;
-
-            VkCommandBuffer commandBuffer;
-            vkAllocateCommandBuffers(_Device, &allocInfo, &commandBuffer);
-
-            VkCommandBufferBeginInfo beginInfo = {};
-            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-            vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-            VkBufferCopy copyRegion = {};
-            copyRegion.srcOffset = 0; // Optional
-            copyRegion.dstOffset = 0; // Optional
-            copyRegion.size = size;
-            vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-            vkEndCommandBuffer(commandBuffer);
-
-            VkSubmitInfo submitInfo{};
-            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            submitInfo.commandBufferCount = 1;
-            submitInfo.pCommandBuffers = &commandBuffer;
+            CreateBuffer(VULKAN_UPLOAD_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uploadRingBuffer, uploadRingMemory);
 
-            vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-            vkQueueWaitIdle(graphicsQueue);
-
-            vkFreeCommandBuffers(_Device, commandPool, 1, &commandBuffer);
+            bool32 dedicatedQueue = (sharedQueueFamilyCount > 1);
+            InitUploadContext(&uploadContext, _Device, transferQueue, sharedQueueFamilies[dedicatedQueue ? 1 : 0], dedicatedQueue,
+                uploadRingBuffer, uploadRingMemory.Mapped, VULKAN_UPLOAD_RING_SIZE, transferTimestampBits, timestampPeriod,
+                hostQueryResetEnabled);
         }
 
-        void CreateVertexBuffer()
+        // Note: Every page is a layer of one array image, sampled with nearest filtering (pixel art, and no bleeding between sheets).
+        // Written on the upload queue and read on the graphics queue, so shared between the two like the upload targets.
+        void CreateSpriteAtlas()
         {
-            VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+            spriteAtlas = {};
+
+            VkImageCreateInfo imageInfo = {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+            imageInfo.extent = { VULKAN_ATLAS_PAGE_SIZE, VULKAN_ATLAS_PAGE_SIZE, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = VULKAN_ATLAS_PAGE_COUNT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            if (sharedQueueFamilyCount > 1) {
+                imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+                imageInfo.queueFamilyIndexCount = sharedQueueFamilyCount;
+                imageInfo.pQueueFamilyIndices = sharedQueueFamilies;
+            }
 
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingBufferMemory;
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+            if (vkCreateImage(_Device, &imageInfo, nullptr, &spriteAtlas.Image) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create atlas image!");
+            }
 
-            void* data;
-            vkMapMemory(_Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-            memcpy(data, vertices.data(), (size_t)bufferSize);
-            vkUnmapMemory(_Device, stagingBufferMemory);
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(_Device, spriteAtlas.Image, &memRequirements);
+
+            uint32_t memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            AllocateDeviceMemory(&memoryAllocator, memRequirements, memoryTypeIndex, MemoryResourceKind_Optimal, MemoryCategory_Image, &spriteAtlas.Memory);
+            vkBindImageMemory(_Device, spriteAtlas.Image, spriteAtlas.Memory.Memory, spriteAtlas.Memory.Offset);
+
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = spriteAtlas.Image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+            viewInfo.format = imageInfo.format;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.layerCount = VULKAN_ATLAS_PAGE_COUNT;
+
+            if (vkCreateImageView(_Device, &viewInfo, nullptr, &spriteAtlas.View) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create atlas image view!");
+            }
 
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+            VkSamplerCreateInfo samplerInfo = {};
+            samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter = VK_FILTER_NEAREST;
+            samplerInfo.minFilter = VK_FILTER_NEAREST;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerInfo.maxLod = 0.0f;
+
+            if (vkCreateSampler(_Device, &samplerInfo, nullptr, &spriteAtlas.Sampler) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create atlas sampler!");
+            }
 
-            CopyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+            InitSpriteAtlas(&spriteAtlas, &uploadContext);
 
-            vkDestroyBuffer(_Device, stagingBuffer, nullptr);
-            vkFreeMemory(_Device, stagingBufferMemory, nullptr);
+            // Note: The atlas never changes layout, see Vulkan_Atlas.cpp. Its sampler is the one every bindless texture uses.
+            SetBindlessSampler(&bindlessTable, spriteAtlas.Sampler);
+            uint32_t atlasTexture = AddBindlessTexture(&bindlessTable, spriteAtlas.View, VK_IMAGE_LAYOUT_GENERAL, VK_NULL_HANDLE, nullptr);
+            Assert(atlasTexture == VULKAN_BINDLESS_ATLAS_TEXTURE);
         }
 
-        void CreateIndexBuffer()
+        // Note: One vertex and one index buffer for every mesh, see Vulkan_Geometry.cpp. The test quad is the first mesh in it.
+        void CreateGeometryBuffer()
         {
-            VkDeviceSize bufferSize = sizeof(_Indices[0]) * _Indices.size();
-
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingBufferMemory;
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-            void* data;
-            vkMapMemory(_Device, stagingBufferMemory, 0, bufferSize, 0, &data);
-            memcpy(data, _Indices.data(), (size_t)bufferSize);
-            vkUnmapMemory(_Device, stagingBufferMemory);
-
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-
-            CopyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-            vkDestroyBuffer(_Device, stagingBuffer, nullptr);
-            vkFreeMemory(_Device, stagingBufferMemory, nullptr);
+            VkBuffer vertexBuffer;
+            CreateBuffer(GetGeometryVertexBufferSize(sizeof(MeshVertex), framesInFlight), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, geometryVertexMemory);
+
+            VkBuffer indexBuffer;
+            CreateBuffer(GetGeometryIndexBufferSize(framesInFlight), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, geometryIndexMemory);
+
+            InitGeometryBuffer(&geometry, vertexBuffer, indexBuffer, sizeof(MeshVertex));
+            quadMesh = CreateGeometryMesh(&geometry, &uploadContext, vertices.data(), static_cast<uint32_t>(vertices.size()),
+                _Indices.data(), static_cast<uint32_t>(_Indices.size()));
+            if (quadMesh == VULKAN_GEOMETRY_INVALID_MESH) {
+                throw std::runtime_error("failed to create the quad mesh!");
+            }
         }
 
-        void CreateUniformBuffers()
+        // Note: One buffer, FrameSize per frame in flight. Uniform and storage both, it holds the camera and the objects,
+        // and a transfer source for the changed culled sprites. One more region at the end is never allocated from, it's
+        // there so the object binding's range (a whole region) stays inside the buffer from any offset in the last region.
+        void CreateDynamicRing()
         {
-            VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-            uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-            uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-            uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
-            {
-                CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+            VkDeviceSize bufferSize = (VkDeviceSize)VULKAN_DYNAMIC_RING_FRAME_SIZE * (framesInFlight + 1);
+            VkBuffer buffer;
+            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, dynamicRingMemory);
 
-                vkMapMemory(_Device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
-            }
+            InitDynamicRing(&dynamicRing, buffer, dynamicRingMemory.Mapped, VULKAN_DYNAMIC_RING_FRAME_SIZE,
+                minUniformBufferOffsetAlignment, minStorageBufferOffsetAlignment);
         }
 
         void CreateDescriptorPool()
         {
-            VkDescriptorPoolSize poolSize = {};
-            poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+            VkDescriptorPoolSize poolSizes[2] = {};
+            poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            poolSizes[0].descriptorCount = 1;
+            poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            poolSizes[1].descriptorCount = 1;
 
             VkDescriptorPoolCreateInfo poolInfo{};
             poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-            poolInfo.poolSizeCount = 1;
-            poolInfo.pPoolSizes = &poolSize;
-            poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+            poolInfo.poolSizeCount = 2;
+            poolInfo.pPoolSizes = poolSizes;
+            poolInfo.maxSets = 1;
 
             if (vkCreateDescriptorPool(_Device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create descriptor pool!");
             }
         }
 
+        // Note: Written once. Every frame binds this same set with its own dynamic offsets.
         void CreateDescriptorSets()
         {
-            std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
             VkDescriptorSetAllocateInfo allocInfo{};
             allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
             allocInfo.descriptorPool = descriptorPool;
-            allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-            allocInfo.pSetLayouts = layouts.data();
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &descriptorSetLayout;
 
-            descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
             // Automatically freed by the pool
-            if (vkAllocateDescriptorSets(_Device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+            if (vkAllocateDescriptorSets(_Device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
                 throw std::runtime_error("failed to allocate descriptor sets!");
             }
-        }
-
-        void CreateCommandBuffers()
-        {
-            commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
-            VkCommandBufferAllocateInfo allocInfo = {};
-            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            allocInfo.commandPool = commandPool;
-            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-
-            if (vkAllocateCommandBuffers(_Device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate command buffers!");
+            VkDescriptorBufferInfo bufferInfos[2] = {};
+            bufferInfos[0].buffer = dynamicRing.Buffer;
+            bufferInfos[0].offset = 0;
+            bufferInfos[0].range = sizeof(UniformBufferObject);
+            // Note: The range is fixed here, the dynamic offset only moves it, so it's one frame's region: as many objects
+            // as a frame can hold, wherever in its region they start. CreateDynamicRing leaves room for that past the last region.
+            bufferInfos[1].buffer = dynamicRing.Buffer;
+            bufferInfos[1].offset = 0;
+            bufferInfos[1].range = VULKAN_DYNAMIC_RING_FRAME_SIZE;
+
+            VkWriteDescriptorSet descriptorWrites[2] = {};
+            for (uint32_t binding = 0; binding < 2; binding++) {
+                descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[binding].dstSet = descriptorSet;
+                descriptorWrites[binding].dstBinding = binding;
+                descriptorWrites[binding].dstArrayElement = 0;
+                descriptorWrites[binding].descriptorCount = 1;
             }
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            descriptorWrites[0].pBufferInfo = &bufferInfos[0];
+            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            descriptorWrites[1].pBufferInfo = &bufferInfos[1];
+
+            vkUpdateDescriptorSets(_Device, 2, descriptorWrites, 0, nullptr);
         }
 
         void CreateSyncObjects()
         {
-            imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-            renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-            inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-
             VkSemaphoreCreateInfo semaphoreInfo{};
             semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
@@ -1259,7 +2898,7 @@ namespace Vulkan
             fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
             fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-            for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            for (size_t i = 0; i < framesInFlight; i++) {
                 if (vkCreateSemaphore(_Device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
                     vkCreateSemaphore(_Device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
                     vkCreateFence(_Device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
@@ -1269,22 +2908,55 @@ namespace Vulkan
             }
         }
 
+        // Note: The old swap chain, its image views and framebuffers may still be used by the frames in flight. They go on
+        // the deferred destroy queue with the current frame count and are gone once those frames have finished.
+        // With recreateWaitsIdle everything waits for the device and is destroyed right here instead, like it used to.
         void RecreateSwapChain(int FrameBufferWidth, int FrameBufferHeight) {
-            vkDeviceWaitIdle(_Device);
-
-            CleanupSwapChain();
+            LARGE_INTEGER recreateCounter;
+            QueryPerformanceCounter(&recreateCounter);
+
+            VkSwapchainKHR oldSwapChain = swapChain;
+            if (recreateWaitsIdle) {
+                vkDeviceWaitIdle(_Device);
+                FlushDeferredDestroys(&deferredDestroys);
+                CleanupSwapChain();
+                swapChain = VK_NULL_HANDLE;
+                oldSwapChain = VK_NULL_HANDLE;
+            }
+            else {
+                for (uint32_t i = 0; i < swapChainImageCount; i++) {
+                    DeferDestroyFramebuffer(&deferredDestroys, swapChainFramebuffers[i], frameNumber);
+                    DeferDestroyImageView(&deferredDestroys, swapChainImageViews[i], frameNumber);
+                }
+                swapChainImageCount = 0;
+            }
 
+            // Note: If this throws, swapChain is still the old one (null if we waited idle) and Cleanup destroys it. Its image
+            // views and framebuffers are already on the deferred destroy queue (swapChainImageCount is 0), Cleanup flushes that.
             CreateSwapChain(FrameBufferWidth, FrameBufferHeight);
+            if (oldSwapChain != VK_NULL_HANDLE) {
+                // Note: A frame's render fence doesn't cover its vkQueuePresentKHR, which may still be pending when the fence
+                // signals. The old swap chain is kept framesInFlight frames longer, by then the last present on it is done.
+                DeferDestroySwapchain(&deferredDestroys, oldSwapChain, frameNumber + framesInFlight);
+            }
             CreateImageViews();
             CreateFramebuffers();
+            lastFrameBufferWidth = FrameBufferWidth;
+            lastFrameBufferHeight = FrameBufferHeight;
+
+            AddSwapChainRecreate(&swapChainRecreateStats, MillisecondsSince(recreateCounter), recreateWaitsIdle);
         }
 
+        // Note: Writes the camera into this frame's part of the dynamic ring, at dynamicOffsets[0].
         void UpdateUniformBuffer(uint32_t currentImage) 
         {
             static auto startTime = std::chrono::high_resolution_clock::now();
 
             auto currentTime = std::chrono::high_resolution_clock::now();
             float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+            if (headless) {
+                time = (float)frameNumber / 60.0f; // Note: Fixed step, so readback frames can be compared between runs.
+            }
 
             UniformBufferObject ubo{};
             ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
@@ -1293,7 +2965,64 @@ namespace Vulkan
             // GLM was originally designed for OpenGL, where the Y coordinate of the clip coordinates is inverted.
             ubo.proj[1][1] *= -1;
 
-            memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+            // Note: The CPU sprites are culled against the same camera in RecordCommandBuffer.
+            ExtractFrustumPlanes(&spriteRenderer.Frustum, ubo.proj * ubo.view);
+
+            void* mapped = PushDynamicData(&dynamicRing, sizeof(ubo), &dynamicOffsets[0]);
+            if (!mapped) {
+                throw std::runtime_error("failed to allocate the uniform buffer from the dynamic ring!");
+            }
+            memcpy(mapped, &ubo, sizeof(ubo));
+        }
+
+        // Note: Copies every batch submitted this frame into one object array in the ring, at dynamicOffsets[1].
+        // Without objects the offset just points at the camera, the binding still needs a valid one.
+        void WriteObjectBatches()
+        {
+            dynamicOffsets[1] = dynamicOffsets[0];
+
+            uint32_t objectCount = 0;
+            for (uint32_t i = 0; i < objectBatchCount; i++) {
+                objectCount += objectBatches[i].Count;
+            }
+            // Note: The culled sprites' changed chunks go into the ring after the objects (WriteDirtySpriteChunks, two pushes,
+            // each may be aligned). Their room is kept, or they'd stay stale on the GPU until the next UpdateCulledSprites.
+            VkDeviceSize reservedBytes = culledColumns ? culledDirtyBytes + 2 * dynamicRing.Alignment : 0;
+            uint32_t capacity = GetDynamicObjectCapacity(&dynamicRing, reservedBytes);
+            if (objectCount > capacity) {
+                // Todo: Logging.
+                objectCount = capacity;
+            }
+            if (!objectCount) {
+                objectBatchCount = 0;
+                return;
+            }
+
+            ObjectData* objects = (ObjectData*)PushDynamicData(&dynamicRing, objectCount * sizeof(ObjectData), &dynamicOffsets[1]);
+            uint32_t firstObject = 0;
+            for (uint32_t i = 0; i < objectBatchCount; i++) {
+                ObjectBatch* batch = &objectBatches[i];
+                if (batch->Count > objectCount - firstObject) {
+                    batch->Count = objectCount - firstObject;
+                }
+                // Note: Now that the frame's part of the geometry buffer is free, the mesh can be settled. A batch without one draws nothing.
+                if (batch->MeshID != VULKAN_GEOMETRY_INVALID_MESH) {
+                    GeometryRange* mesh = GetGeometryMesh(&geometry, batch->MeshID);
+                    if (mesh) {
+                        batch->Mesh = *mesh;
+                    }
+                    else {
+                        batch->Count = 0;
+                    }
+                }
+                else if (!PushDynamicGeometry(&geometry, &uploadContext, batch->DynamicVertices, batch->DynamicVertexCount,
+                                              batch->DynamicIndices, batch->DynamicIndexCount, &batch->Mesh)) {
+                    batch->Count = 0;
+                }
+                batch->FirstObject = firstObject;
+                memcpy(objects + firstObject, batch->Objects, batch->Count * sizeof(ObjectData));
+                firstObject += batch->Count;
+            }
         }
     };
 }
\ No newline at end of file
@@ -0,0 +1,439 @@
+// Note: Geometry megabuffer.
+// Every mesh lives in one device local vertex buffer and one index buffer (32 bit indices). Each command buffer
+// binds them once, and a draw only says where its mesh is: firstIndex and vertexOffset of vkCmdDrawIndexed.
+// Drawing more meshes never means more buffers or more binds.
+// Both buffers hold elements of one size (VertexStride bytes per vertex, 4 bytes per index) and are split the same way:
+// - Static: the front of each buffer. Meshes made with CreateGeometryMesh get a range of each from a first fit free list,
+//   in elements. A released mesh's ranges go back once every frame submitted while it was live is done, like Vulkan_Bindless.cpp.
+// - Dynamic: one region per frame in flight at the end, bump allocated and reset like Vulkan_DynamicRing.cpp. For geometry
+//   that changes every frame; it's copied in through the upload ring and only valid for the frame it was pushed in.
+// Indices are relative to the mesh's first vertex, vertexOffset takes care of the rest.
+// The game's meshes are MeshVertex: half float position and unorm8 color, 8 bytes against the 20 of the float
+// vec2 + vec3 it replaced. The shaders read the same vec2/vec3 as before.
+
+#define VULKAN_GEOMETRY_STATIC_VERTICES     (256 * 1024)
+#define VULKAN_GEOMETRY_STATIC_INDICES      (768 * 1024)
+#define VULKAN_GEOMETRY_DYNAMIC_VERTICES    (16 * 1024) // Note: Per frame in flight.
+#define VULKAN_GEOMETRY_DYNAMIC_INDICES     (48 * 1024)
+#define VULKAN_GEOMETRY_MAX_MESHES          1024
+#define VULKAN_GEOMETRY_MAX_FREE_RANGES     256         // Note: Per allocator. Neighbours are merged, so this only fills up with heavy fragmentation.
+#define VULKAN_GEOMETRY_INVALID_MESH        0xFFFFFFFF
+
+namespace Vulkan
+{
+    struct MeshVertex
+    {
+        Half2 Position;
+        Unorm8x4 Color;     // Note: Alpha isn't read.
+    };
+
+    // Note: Binding 0, locations 0 and 1.
+    constexpr VertexField MeshVertexFields[] =
+    {
+        VERTEX_FIELD(MeshVertex, Position),
+        VERTEX_FIELD(MeshVertex, Color),
+    };
+    constexpr VertexLayout<2> MeshVertexLayout = MakeVertexLayout<MeshVertex>(MeshVertexFields, 0, 0);
+
+    inline MeshVertex
+    MakeMeshVertex(glm::vec2 Position, glm::vec3 Color)
+    {
+        MeshVertex Result = { PackHalf2(Position), PackUnorm8x4(glm::vec4(Color, 1.0f)) };
+        return(Result);
+    }
+
+    // Note: Where a mesh is, in the terms vkCmdDrawIndexed takes them.
+    struct GeometryRange
+    {
+        uint32_t FirstIndex;
+        uint32_t IndexCount;
+        int32_t VertexOffset;
+    };
+
+    struct GeometryFreeRange
+    {
+        uint32_t Start;
+        uint32_t Count;
+    };
+
+    // Note: Free ranges sorted by Start, never two that touch.
+    struct GeometryRangeAllocator
+    {
+        GeometryFreeRange Free[VULKAN_GEOMETRY_MAX_FREE_RANGES];
+        uint32_t FreeCount;
+        uint32_t Size;
+        uint32_t Used;
+        uint32_t PeakUsed;
+    };
+
+    struct GeometryMesh
+    {
+        GeometryRange Range;
+        uint32_t VertexCount;
+        bool32 Live;
+    };
+
+    struct GeometryRetired
+    {
+        uint32_t Mesh;
+        uint64_t SubmittedFrames;   // Note: Frames submitted when it was released; its ranges are free again once those have all finished.
+    };
+
+    struct GeometryStats
+    {
+        uint64_t MeshesCreated;
+        uint64_t MeshesReleased;
+        uint32_t PeakLiveMeshes;
+        uint32_t FailedMeshes;      // Note: Out of mesh slots, static space or free list entries.
+        uint32_t LostRanges;        // Note: Freed into a full free list; that space is gone until shutdown.
+
+        uint64_t DynamicFrames;
+        uint64_t DynamicPushes;
+        uint64_t DynamicVertices;
+        uint64_t DynamicIndices;
+        uint32_t FailedDynamicPushes; // Note: Didn't fit in the frame's region, dropped.
+        uint32_t PeakDynamicVertices;
+        uint32_t PeakDynamicIndices;
+    };
+
+    struct GeometryBuffer
+    {
+        VkBuffer VertexBuffer;
+        VkBuffer IndexBuffer;
+        uint32_t VertexStride;
+
+        GeometryRangeAllocator StaticVertices;
+        GeometryRangeAllocator StaticIndices;
+
+        // Note: Mesh IDs come from the free list first, then from the never used ones past HighWater.
+        GeometryMesh Meshes[VULKAN_GEOMETRY_MAX_MESHES];
+        uint32_t FreeMeshes[VULKAN_GEOMETRY_MAX_MESHES];
+        uint32_t FreeMeshCount;
+        uint32_t HighWater;
+        uint32_t LiveMeshCount;
+        GeometryRetired Retired[VULKAN_GEOMETRY_MAX_MESHES];
+        uint32_t RetiredCount;
+
+        uint32_t FrameIndex;
+        uint32_t DynamicVerticesUsed;   // Note: Within the current frame's region.
+        uint32_t DynamicIndicesUsed;
+
+        GeometryStats Stats;
+    };
+
+    inline VkDeviceSize
+    GetGeometryVertexBufferSize(uint32_t VertexStride, uint32_t FramesInFlight)
+    {
+        VkDeviceSize Result = (VkDeviceSize)VertexStride *
+            (VULKAN_GEOMETRY_STATIC_VERTICES + (VkDeviceSize)VULKAN_GEOMETRY_DYNAMIC_VERTICES * FramesInFlight);
+        return(Result);
+    }
+
+    inline VkDeviceSize
+    GetGeometryIndexBufferSize(uint32_t FramesInFlight)
+    {
+        VkDeviceSize Result = sizeof(uint32_t) *
+            (VULKAN_GEOMETRY_STATIC_INDICES + (VkDeviceSize)VULKAN_GEOMETRY_DYNAMIC_INDICES * FramesInFlight);
+        return(Result);
+    }
+
+    internal void
+    InitGeometryRangeAllocator(GeometryRangeAllocator* Allocator, uint32_t Size)
+    {
+        *Allocator = {};
+        Allocator->Size = Size;
+        Allocator->Free[0].Start = 0;
+        Allocator->Free[0].Count = Size;
+        Allocator->FreeCount = 1;
+    }
+
+    // Note: First fit. Returns false if no free range is big enough.
+    internal bool32
+    AllocateGeometryRange(GeometryRangeAllocator* Allocator, uint32_t Count, uint32_t* Start)
+    {
+        for (uint32_t RangeIndex = 0; RangeIndex < Allocator->FreeCount; ++RangeIndex)
+        {
+            GeometryFreeRange* Range = &Allocator->Free[RangeIndex];
+            if (Range->Count >= Count)
+            {
+                *Start = Range->Start;
+                Range->Start += Count;
+                Range->Count -= Count;
+                if (!Range->Count)
+                {
+                    --Allocator->FreeCount;
+                    memmove(Range, Range + 1, (Allocator->FreeCount - RangeIndex) * sizeof(GeometryFreeRange));
+                }
+
+                Allocator->Used += Count;
+                if (Allocator->Used > Allocator->PeakUsed)
+                {
+                    Allocator->PeakUsed = Allocator->Used;
+                }
+                return(true);
+            }
+        }
+        return(false);
+    }
+
+    // Note: Merges with the neighbours. Returns false if the range needed an entry of its own and the list was full.
+    internal bool32
+    FreeGeometryRange(GeometryRangeAllocator* Allocator, uint32_t Start, uint32_t Count)
+    {
+        Allocator->Used -= Count;
+
+        uint32_t Insert = 0;
+        while (Insert < Allocator->FreeCount && Allocator->Free[Insert].Start < Start)
+        {
+            ++Insert;
+        }
+
+        bool32 MergesBefore = (Insert > 0) &&
+            (Allocator->Free[Insert - 1].Start + Allocator->Free[Insert - 1].Count == Start);
+        bool32 MergesAfter = (Insert < Allocator->FreeCount) && (Start + Count == Allocator->Free[Insert].Start);
+
+        if (MergesBefore && MergesAfter)
+        {
+            Allocator->Free[Insert - 1].Count += Count + Allocator->Free[Insert].Count;
+            --Allocator->FreeCount;
+            memmove(&Allocator->Free[Insert], &Allocator->Free[Insert + 1], (Allocator->FreeCount - Insert) * sizeof(GeometryFreeRange));
+        }
+        else if (MergesBefore)
+        {
+            Allocator->Free[Insert - 1].Count += Count;
+        }
+        else if (MergesAfter)
+        {
+            Allocator->Free[Insert].Start = Start;
+            Allocator->Free[Insert].Count += Count;
+        }
+        else
+        {
+            if (Allocator->FreeCount == VULKAN_GEOMETRY_MAX_FREE_RANGES)
+            {
+                return(false);
+            }
+            memmove(&Allocator->Free[Insert + 1], &Allocator->Free[Insert], (Allocator->FreeCount - Insert) * sizeof(GeometryFreeRange));
+            Allocator->Free[Insert].Start = Start;
+            Allocator->Free[Insert].Count = Count;
+            ++Allocator->FreeCount;
+        }
+        return(true);
+    }
+
+    // Note: The buffers are the caller's, made GetGeometryVertexBufferSize and GetGeometryIndexBufferSize big.
+    internal void
+    InitGeometryBuffer(GeometryBuffer* Geometry, VkBuffer VertexBuffer, VkBuffer IndexBuffer, uint32_t VertexStride)
+    {
+        *Geometry = {};
+        Geometry->VertexBuffer = VertexBuffer;
+        Geometry->IndexBuffer = IndexBuffer;
+        Geometry->VertexStride = VertexStride;
+        InitGeometryRangeAllocator(&Geometry->StaticVertices, VULKAN_GEOMETRY_STATIC_VERTICES);
+        InitGeometryRangeAllocator(&Geometry->StaticIndices, VULKAN_GEOMETRY_STATIC_INDICES);
+    }
+
+    // Note: Copies the mesh in through the upload ring. Returns VULKAN_GEOMETRY_INVALID_MESH if it doesn't fit.
+    internal uint32_t
+    CreateGeometryMesh(GeometryBuffer* Geometry, UploadContext* Upload, const void* Vertices, uint32_t VertexCount,
+                       const uint32_t* Indices, uint32_t IndexCount)
+    {
+        uint32_t ID = VULKAN_GEOMETRY_INVALID_MESH;
+        if (Geometry->FreeMeshCount)
+        {
+            ID = Geometry->FreeMeshes[Geometry->FreeMeshCount - 1];
+        }
+        else if (Geometry->HighWater < VULKAN_GEOMETRY_MAX_MESHES)
+        {
+            ID = Geometry->HighWater;
+        }
+
+        uint32_t FirstVertex = 0;
+        uint32_t FirstIndex = 0;
+        if (ID == VULKAN_GEOMETRY_INVALID_MESH || !VertexCount || !IndexCount ||
+            !AllocateGeometryRange(&Geometry->StaticVertices, VertexCount, &FirstVertex))
+        {
+            ++Geometry->Stats.FailedMeshes;
+            return(VULKAN_GEOMETRY_INVALID_MESH);
+        }
+        if (!AllocateGeometryRange(&Geometry->StaticIndices, IndexCount, &FirstIndex))
+        {
+            if (!FreeGeometryRange(&Geometry->StaticVertices, FirstVertex, VertexCount))
+            {
+                ++Geometry->Stats.LostRanges;
+            }
+            ++Geometry->Stats.FailedMeshes;
+            return(VULKAN_GEOMETRY_INVALID_MESH);
+        }
+
+        if (Geometry->FreeMeshCount)
+        {
+            --Geometry->FreeMeshCount;
+        }
+        else
+        {
+            ++Geometry->HighWater;
+        }
+
+        GeometryMesh* Mesh = &Geometry->Meshes[ID];
+        Mesh->Range.FirstIndex = FirstIndex;
+        Mesh->Range.IndexCount = IndexCount;
+        Mesh->Range.VertexOffset = (int32_t)FirstVertex;
+        Mesh->VertexCount = VertexCount;
+        Mesh->Live = true;
+
+        UploadToBuffer(Upload, Geometry->VertexBuffer, (VkDeviceSize)FirstVertex * Geometry->VertexStride,
+            Vertices, (VkDeviceSize)VertexCount * Geometry->VertexStride);
+        UploadToBuffer(Upload, Geometry->IndexBuffer, (VkDeviceSize)FirstIndex * sizeof(uint32_t),
+            Indices, (VkDeviceSize)IndexCount * sizeof(uint32_t));
+
+        ++Geometry->LiveMeshCount;
+        ++Geometry->Stats.MeshesCreated;
+        if (Geometry->LiveMeshCount > Geometry->Stats.PeakLiveMeshes)
+        {
+            Geometry->Stats.PeakLiveMeshes = Geometry->LiveMeshCount;
+        }
+        return(ID);
+    }
+
+    // Note: Null if the mesh isn't live (never made, or released).
+    inline GeometryRange*
+    GetGeometryMesh(GeometryBuffer* Geometry, uint32_t ID)
+    {
+        GeometryRange* Result = nullptr;
+        if (ID < Geometry->HighWater && Geometry->Meshes[ID].Live)
+        {
+            Result = &Geometry->Meshes[ID].Range;
+        }
+        return(Result);
+    }
+
+    // Note: Can't be drawn from now on, but the frames in flight may still be drawing it. Its ranges and ID are
+    // held back until every frame submitted so far is done, see RetireGeometryMeshes.
+    internal void
+    ReleaseGeometryMesh(GeometryBuffer* Geometry, uint32_t ID, uint64_t SubmittedFrames)
+    {
+        if (!GetGeometryMesh(Geometry, ID))
+        {
+            return;
+        }
+        Assert(Geometry->RetiredCount < VULKAN_GEOMETRY_MAX_MESHES);
+
+        Geometry->Meshes[ID].Live = false;
+        GeometryRetired* Retired = &Geometry->Retired[Geometry->RetiredCount++];
+        Retired->Mesh = ID;
+        Retired->SubmittedFrames = SubmittedFrames;
+        --Geometry->LiveMeshCount;
+        ++Geometry->Stats.MeshesReleased;
+    }
+
+    // Note: CompletedFrames = how many frames, counted from the first, are known to have finished on the GPU.
+    internal void
+    RetireGeometryMeshes(GeometryBuffer* Geometry, uint64_t CompletedFrames)
+    {
+        // Note: Released in submission order, so the ones that are done are all at the front.
+        uint32_t DoneCount = 0;
+        while (DoneCount < Geometry->RetiredCount && Geometry->Retired[DoneCount].SubmittedFrames <= CompletedFrames)
+        {
+            uint32_t ID = Geometry->Retired[DoneCount].Mesh;
+            GeometryMesh* Mesh = &Geometry->Meshes[ID];
+            if (!FreeGeometryRange(&Geometry->StaticVertices, (uint32_t)Mesh->Range.VertexOffset, Mesh->VertexCount))
+            {
+                ++Geometry->Stats.LostRanges;
+            }
+            if (!FreeGeometryRange(&Geometry->StaticIndices, Mesh->Range.FirstIndex, Mesh->Range.IndexCount))
+            {
+                ++Geometry->Stats.LostRanges;
+            }
+            Geometry->FreeMeshes[Geometry->FreeMeshCount++] = ID;
+            ++DoneCount;
+        }
+
+        if (DoneCount)
+        {
+            Geometry->RetiredCount -= DoneCount;
+            memmove(Geometry->Retired, Geometry->Retired + DoneCount, Geometry->RetiredCount * sizeof(GeometryRetired));
+        }
+    }
+
+    // Note: Only once the frame's fence has signaled, the GPU may still be reading the region before that.
+    internal void
+    BeginGeometryFrame(GeometryBuffer* Geometry, uint32_t FrameIndex)
+    {
+        if (Geometry->DynamicVerticesUsed > Geometry->Stats.PeakDynamicVertices)
+        {
+            Geometry->Stats.PeakDynamicVertices = Geometry->DynamicVerticesUsed;
+        }
+        if (Geometry->DynamicIndicesUsed > Geometry->Stats.PeakDynamicIndices)
+        {
+            Geometry->Stats.PeakDynamicIndices = Geometry->DynamicIndicesUsed;
+        }
+        Geometry->FrameIndex = FrameIndex;
+        Geometry->DynamicVerticesUsed = 0;
+        Geometry->DynamicIndicesUsed = 0;
+        ++Geometry->Stats.DynamicFrames;
+    }
+
+    // Note: Copies geometry for this frame only into the frame's region. Returns false if it doesn't fit; nothing is pushed then.
+    internal bool32
+    PushDynamicGeometry(GeometryBuffer* Geometry, UploadContext* Upload, const void* Vertices, uint32_t VertexCount,
+                        const uint32_t* Indices, uint32_t IndexCount, GeometryRange* Range)
+    {
+        if (!VertexCount || !IndexCount ||
+            Geometry->DynamicVerticesUsed + VertexCount > VULKAN_GEOMETRY_DYNAMIC_VERTICES ||
+            Geometry->DynamicIndicesUsed + IndexCount > VULKAN_GEOMETRY_DYNAMIC_INDICES)
+        {
+            ++Geometry->Stats.FailedDynamicPushes;
+            return(false);
+        }
+
+        uint32_t FirstVertex = VULKAN_GEOMETRY_STATIC_VERTICES +
+            Geometry->FrameIndex * VULKAN_GEOMETRY_DYNAMIC_VERTICES + Geometry->DynamicVerticesUsed;
+        uint32_t FirstIndex = VULKAN_GEOMETRY_STATIC_INDICES +
+            Geometry->FrameIndex * VULKAN_GEOMETRY_DYNAMIC_INDICES + Geometry->DynamicIndicesUsed;
+        Geometry->DynamicVerticesUsed += VertexCount;
+        Geometry->DynamicIndicesUsed += IndexCount;
+
+        UploadToBuffer(Upload, Geometry->VertexBuffer, (VkDeviceSize)FirstVertex * Geometry->VertexStride,
+            Vertices, (VkDeviceSize)VertexCount * Geometry->VertexStride);
+        UploadToBuffer(Upload, Geometry->IndexBuffer, (VkDeviceSize)FirstIndex * sizeof(uint32_t),
+            Indices, (VkDeviceSize)IndexCount * sizeof(uint32_t));
+
+        Range->FirstIndex = FirstIndex;
+        Range->IndexCount = IndexCount;
+        Range->VertexOffset = (int32_t)FirstVertex;
+
+        ++Geometry->Stats.DynamicPushes;
+        Geometry->Stats.DynamicVertices += VertexCount;
+        Geometry->Stats.DynamicIndices += IndexCount;
+        return(true);
+    }
+
+    // Note: The one vertex and index bind a command buffer needs for every mesh. Instance data goes in binding 1 on its own.
+    inline void
+    BindGeometryBuffers(VkCommandBuffer CommandBuffer, VkBuffer VertexBuffer, VkBuffer IndexBuffer)
+    {
+        VkDeviceSize Offset = 0;
+        vkCmdBindVertexBuffers(CommandBuffer, 0, 1, &VertexBuffer, &Offset);
+        vkCmdBindIndexBuffer(CommandBuffer, IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    internal void
+    OutputGeometryStats(GeometryBuffer* Geometry)
+    {
+        GeometryStats* Stats = &Geometry->Stats;
+        uint64_t Frames = Stats->DynamicFrames ? Stats->DynamicFrames : 1;
+        char Text[512];
+        snprintf(Text, sizeof(Text),
+            "geometry: %llu meshes made, %llu released, %u peak live, %u failed, %u ranges lost; "
+            "static peak %u of %u vertices, %u of %u indices, %u free ranges; "
+            "dynamic %.1f vertices/frame, %.1f indices/frame, peak %u/%u, %u pushes failed\n",
+            Stats->MeshesCreated, Stats->MeshesReleased, Stats->PeakLiveMeshes, Stats->FailedMeshes, Stats->LostRanges,
+            Geometry->StaticVertices.PeakUsed, Geometry->StaticVertices.Size,
+            Geometry->StaticIndices.PeakUsed, Geometry->StaticIndices.Size,
+            Geometry->StaticVertices.FreeCount + Geometry->StaticIndices.FreeCount,
+            (double)Stats->DynamicVertices / (double)Frames, (double)Stats->DynamicIndices / (double)Frames,
+            Stats->PeakDynamicVertices, Stats->PeakDynamicIndices, Stats->FailedDynamicPushes);
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,102 @@
+// Note: Debug check that drawing a frame never touches the heap.
+// Everything DrawFrame needs (swap chain images, sync objects, command pools, jobs, deferred destroys) lives in fixed
+// arrays sized at startup, so a frame that allocates is a bug. With Game_SLOW the global operator new is replaced by
+// one that counts, and DrawFrame looks at the count before and after. The count is process wide: jobs running on
+// the worker threads during the frame are included, but so is anything another thread allocates at the same time.
+// Only operator new is counted; nothing in the frame path calls malloc directly. What the driver allocates through
+// its own allocator isn't ours to count.
+// Without Game_SLOW the count is always 0 and the stats say nothing allocated.
+
+namespace Vulkan
+{
+    struct FrameAllocationStats
+    {
+        uint64_t Frames;
+        uint64_t FramesThatAllocated;
+        uint64_t Allocations;       // Note: Over all frames.
+        uint32_t MostInAFrame;
+        uint32_t LastFrame;
+        uint64_t FirstFrameThatAllocated; // Note: Counting from 0; only valid if FramesThatAllocated isn't 0.
+    };
+
+#if Game_SLOW
+    global_variable LONG volatile GlobalHeapAllocationCount;
+#endif
+
+    inline uint32_t
+    GetHeapAllocationCount()
+    {
+#if Game_SLOW
+        return((uint32_t)GlobalHeapAllocationCount);
+#else
+        return(0);
+#endif
+    }
+
+    // Note: Before is GetHeapAllocationCount from the start of the frame.
+    internal void
+    AddFrameAllocations(FrameAllocationStats* Stats, uint32_t Before)
+    {
+        uint32_t Count = GetHeapAllocationCount() - Before;
+        if (Count)
+        {
+            if (!Stats->FramesThatAllocated)
+            {
+                Stats->FirstFrameThatAllocated = Stats->Frames;
+            }
+            ++Stats->FramesThatAllocated;
+            Stats->Allocations += Count;
+            if (Count > Stats->MostInAFrame)
+            {
+                Stats->MostInAFrame = Count;
+            }
+        }
+        Stats->LastFrame = Count;
+        ++Stats->Frames;
+    }
+
+    internal void
+    OutputFrameAllocationStats(FrameAllocationStats* Stats)
+    {
+        char Text[256];
+        if (Stats->FramesThatAllocated)
+        {
+            snprintf(Text, sizeof(Text), "frame allocations: %llu of %llu frames allocated (first: frame %llu), %llu allocations, at most %u in a frame\n",
+                     Stats->FramesThatAllocated, Stats->Frames, Stats->FirstFrameThatAllocated, Stats->Allocations, Stats->MostInAFrame);
+        }
+        else
+        {
+            snprintf(Text, sizeof(Text), "frame allocations: none in %llu frames\n", Stats->Frames);
+        }
+        OutputDebugStringA(Text);
+    }
+}
+
+#if Game_SLOW
+// Note: Replacing these four is enough, the other forms (nothrow, sized delete) end up in them.
+void* operator new(size_t Size)
+{
+    InterlockedIncrement(&Vulkan::GlobalHeapAllocationCount);
+    void* Result = malloc(Size ? Size : 1);
+    if (!Result)
+    {
+        throw std::bad_alloc();
+    }
+    return(Result);
+}
+
+void* operator new[](size_t Size)
+{
+    return(operator new(Size));
+}
+
+void operator delete(void* Memory) noexcept
+{
+    free(Memory);
+}
+
+void operator delete[](void* Memory) noexcept
+{
+    free(Memory);
+}
+#endif
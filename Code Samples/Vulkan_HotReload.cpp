@@ -0,0 +1,311 @@
+// Note: Shader hot reload.
+// Every graphics pipeline built from files keeps a description of itself here (shaders, vertex input, culling, blending),
+// so it can be built again. A background thread polls the SPIR-V files' write times, and when both of a pipeline's files
+// have settled on a new time (unchanged over one whole poll, so a half written file isn't picked up), it loads them into
+// shader modules of its own, builds the pipeline through the same pipeline cache and hands it over.
+// DrawFrame takes the handed over pipelines at the start of a frame, before anything is recorded, and queues the old ones
+// for deferred destruction, so they go once the frames using them are done. The render loop never waits on a build:
+// taking a pipeline is one flag check, and if a build isn't finished, the frame just draws with the old one.
+// A file that doesn't load or build is skipped until it's written again; the old pipeline stays.
+
+#define VULKAN_RELOAD_MAX_PIPELINES     8
+#define VULKAN_RELOAD_MAX_BINDINGS      2
+#define VULKAN_RELOAD_MAX_ATTRIBUTES    8
+#define VULKAN_RELOAD_POLL_MS           250
+
+namespace Vulkan
+{
+    // Note: VertexInput points into the arrays next to it.
+    struct GraphicsPipelineDesc
+    {
+        char VertName[64];      // Note: Relative to VULKAN_SHADER_DIRECTORY.
+        char FragName[64];
+        VkVertexInputBindingDescription Bindings[VULKAN_RELOAD_MAX_BINDINGS];
+        VkVertexInputAttributeDescription Attributes[VULKAN_RELOAD_MAX_ATTRIBUTES];
+        VkPipelineVertexInputStateCreateInfo VertexInput;
+        VkCullModeFlags CullMode;
+        bool32 AlphaBlend;
+    };
+
+    typedef VkResult ShaderReloadBuildCallback(void* Context, GraphicsPipelineDesc* Desc, VkShaderModule VertModule,
+                                               VkShaderModule FragModule, VkPipeline* Pipeline);
+
+    struct ShaderReloadSlot
+    {
+        GraphicsPipelineDesc Desc;
+        VkPipeline* Target;         // Note: Where the renderer keeps the pipeline it draws with.
+
+        // Note: The background thread's own. Built = what the current pipeline came from, Seen = the last poll.
+        FILETIME BuiltVert;
+        FILETIME BuiltFrag;
+        FILETIME SeenVert;
+        FILETIME SeenFrag;
+
+        VkPipeline Pending;         // Note: Set by the background thread before Ready, taken by the render thread.
+        LONG volatile Ready;
+    };
+
+    struct ShaderReloadStats
+    {
+        uint32_t Builds;
+        uint32_t Failures;
+        uint32_t Swaps;
+        double TotalBuildMS;
+        float MaxBuildMS;
+    };
+
+    struct ShaderReload
+    {
+        VkDevice Device;
+        game_memory* GameMemory;
+        ShaderReloadSlot Slots[VULKAN_RELOAD_MAX_PIPELINES];
+        uint32_t SlotCount;
+
+        ShaderReloadBuildCallback* Build;
+        void* BuildContext;
+        HANDLE Thread;
+        HANDLE StopEvent;
+
+        ShaderReloadStats Stats;
+    };
+
+    inline bool32
+    GetShaderWriteTime(const char* Filename, FILETIME* WriteTime)
+    {
+        char Path[256];
+        snprintf(Path, sizeof(Path), "%s%s", VULKAN_SHADER_DIRECTORY, Filename);
+
+        WIN32_FILE_ATTRIBUTE_DATA Data;
+        bool32 Result = GetFileAttributesExA(Path, GetFileExInfoStandard, &Data);
+        if (Result)
+        {
+            *WriteTime = Data.ftLastWriteTime;
+        }
+        return(Result);
+    }
+
+    inline bool32
+    SameFileTime(FILETIME A, FILETIME B)
+    {
+        return(CompareFileTime(&A, &B) == 0);
+    }
+
+    internal void
+    InitShaderReload(ShaderReload* Reload, VkDevice Device, game_memory* GameMemory)
+    {
+        *Reload = {};
+        Reload->Device = Device;
+        Reload->GameMemory = GameMemory;
+    }
+
+    // Note: Called as each pipeline is first built, before StartShaderReload. Returns the description to build it from.
+    internal GraphicsPipelineDesc*
+    AddShaderReloadPipeline(ShaderReload* Reload, VkPipeline* Target, const char* VertName, const char* FragName,
+                            VkPipelineVertexInputStateCreateInfo* VertexInput, VkCullModeFlags CullMode, bool32 AlphaBlend)
+    {
+        if (Reload->SlotCount == VULKAN_RELOAD_MAX_PIPELINES ||
+            VertexInput->vertexBindingDescriptionCount > VULKAN_RELOAD_MAX_BINDINGS ||
+            VertexInput->vertexAttributeDescriptionCount > VULKAN_RELOAD_MAX_ATTRIBUTES)
+        {
+            throw std::runtime_error("too many hot reloaded pipelines!");
+        }
+
+        ShaderReloadSlot* Slot = &Reload->Slots[Reload->SlotCount++];
+        *Slot = {};
+        Slot->Target = Target;
+
+        GraphicsPipelineDesc* Desc = &Slot->Desc;
+        snprintf(Desc->VertName, sizeof(Desc->VertName), "%s", VertName);
+        snprintf(Desc->FragName, sizeof(Desc->FragName), "%s", FragName);
+        memcpy(Desc->Bindings, VertexInput->pVertexBindingDescriptions,
+               VertexInput->vertexBindingDescriptionCount * sizeof(VkVertexInputBindingDescription));
+        memcpy(Desc->Attributes, VertexInput->pVertexAttributeDescriptions,
+               VertexInput->vertexAttributeDescriptionCount * sizeof(VkVertexInputAttributeDescription));
+        Desc->VertexInput = *VertexInput;
+        Desc->VertexInput.pVertexBindingDescriptions = Desc->Bindings;
+        Desc->VertexInput.pVertexAttributeDescriptions = Desc->Attributes;
+        Desc->CullMode = CullMode;
+        Desc->AlphaBlend = AlphaBlend;
+
+        // Note: The files as they are now are what's being built.
+        GetShaderWriteTime(VertName, &Slot->BuiltVert);
+        GetShaderWriteTime(FragName, &Slot->BuiltFrag);
+        Slot->SeenVert = Slot->BuiltVert;
+        Slot->SeenFrag = Slot->BuiltFrag;
+        return(Desc);
+    }
+
+    // Note: Not through the pipeline cache's module table, which belongs to the render thread. Checks the SPIR-V magic
+    // number, since a file caught mid-write shouldn't get anywhere near the driver.
+    internal bool32
+    LoadReloadedShaderModule(ShaderReload* Reload, const char* Filename, VkShaderModule* Module)
+    {
+        char Path[256];
+        snprintf(Path, sizeof(Path), "%s%s", VULKAN_SHADER_DIRECTORY, Filename);
+
+        debug_read_file_result Code = Reload->GameMemory->DEBUGPlatformReadEntireFile(Path);
+        bool32 Result = (Code.Contents && Code.ContentsSize >= 20 && (Code.ContentsSize % 4) == 0 &&
+                         *(uint32_t*)Code.Contents == 0x07230203);
+        if (Result)
+        {
+            VkShaderModuleCreateInfo CreateInfo = {};
+            CreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            CreateInfo.codeSize = Code.ContentsSize;
+            CreateInfo.pCode = (uint32_t*)Code.Contents;
+            Result = (vkCreateShaderModule(Reload->Device, &CreateInfo, nullptr, Module) == VK_SUCCESS);
+        }
+        Reload->GameMemory->DEBUGPlatformFreeFileMemory(Code.Contents);
+        return(Result);
+    }
+
+    // Note: Background thread. The modules are only needed while the pipeline is being created.
+    internal void
+    RebuildReloadSlot(ShaderReload* Reload, ShaderReloadSlot* Slot)
+    {
+        LARGE_INTEGER BuildCounter;
+        QueryPerformanceCounter(&BuildCounter);
+
+        VkShaderModule VertModule = VK_NULL_HANDLE;
+        VkShaderModule FragModule = VK_NULL_HANDLE;
+        VkPipeline Pipeline = VK_NULL_HANDLE;
+        bool32 Built = (LoadReloadedShaderModule(Reload, Slot->Desc.VertName, &VertModule) &&
+                        LoadReloadedShaderModule(Reload, Slot->Desc.FragName, &FragModule) &&
+                        Reload->Build(Reload->BuildContext, &Slot->Desc, VertModule, FragModule, &Pipeline) == VK_SUCCESS);
+
+        if (VertModule)
+        {
+            vkDestroyShaderModule(Reload->Device, VertModule, nullptr);
+        }
+        if (FragModule)
+        {
+            vkDestroyShaderModule(Reload->Device, FragModule, nullptr);
+        }
+
+        if (Built)
+        {
+            float MS = MillisecondsSince(BuildCounter);
+            ++Reload->Stats.Builds;
+            Reload->Stats.TotalBuildMS += MS;
+            if (MS > Reload->Stats.MaxBuildMS)
+            {
+                Reload->Stats.MaxBuildMS = MS;
+            }
+
+            Slot->Pending = Pipeline;
+            InterlockedExchange(&Slot->Ready, 1);
+
+            char Text[256];
+            snprintf(Text, sizeof(Text), "shader reload: rebuilt %s + %s in %.2fms\n", Slot->Desc.VertName, Slot->Desc.FragName, MS);
+            OutputDebugStringA(Text);
+        }
+        else
+        {
+            ++Reload->Stats.Failures;
+
+            char Text[256];
+            snprintf(Text, sizeof(Text), "shader reload: %s + %s failed, keeping the old pipeline\n", Slot->Desc.VertName, Slot->Desc.FragName);
+            OutputDebugStringA(Text);
+        }
+    }
+
+    internal DWORD WINAPI
+    ShaderReloadThreadProc(LPVOID Parameter)
+    {
+        ShaderReload* Reload = (ShaderReload*)Parameter;
+        while (WaitForSingleObject(Reload->StopEvent, VULKAN_RELOAD_POLL_MS) == WAIT_TIMEOUT)
+        {
+            for (uint32_t SlotIndex = 0; SlotIndex < Reload->SlotCount; ++SlotIndex)
+            {
+                ShaderReloadSlot* Slot = &Reload->Slots[SlotIndex];
+                FILETIME Vert, Frag;
+                if (Slot->Ready || !GetShaderWriteTime(Slot->Desc.VertName, &Vert) || !GetShaderWriteTime(Slot->Desc.FragName, &Frag))
+                {
+                    // Note: The last build hasn't been taken yet, or a file is missing (maybe being replaced). Next poll.
+                    continue;
+                }
+
+                bool32 Changed = !SameFileTime(Vert, Slot->BuiltVert) || !SameFileTime(Frag, Slot->BuiltFrag);
+                bool32 Settled = SameFileTime(Vert, Slot->SeenVert) && SameFileTime(Frag, Slot->SeenFrag);
+                Slot->SeenVert = Vert;
+                Slot->SeenFrag = Frag;
+                if (Changed && Settled)
+                {
+                    // Note: Even if it fails, so a broken file isn't retried every poll.
+                    Slot->BuiltVert = Vert;
+                    Slot->BuiltFrag = Frag;
+                    RebuildReloadSlot(Reload, Slot);
+                }
+            }
+        }
+        return(0);
+    }
+
+    // Note: Build is called on the background thread; it may only touch things that stay put until StopShaderReload.
+    internal void
+    StartShaderReload(ShaderReload* Reload, ShaderReloadBuildCallback* Build, void* BuildContext)
+    {
+        Reload->Build = Build;
+        Reload->BuildContext = BuildContext;
+        Reload->StopEvent = CreateEventA(0, TRUE, FALSE, 0);
+        Reload->Thread = CreateThread(0, 0, ShaderReloadThreadProc, Reload, 0, 0);
+        if (!Reload->StopEvent || !Reload->Thread)
+        {
+            throw std::runtime_error("failed to start the shader reload thread!");
+        }
+    }
+
+    // Note: Waits for a build that's underway. Pipelines that were never taken are destroyed.
+    internal void
+    StopShaderReload(ShaderReload* Reload)
+    {
+        if (Reload->Thread)
+        {
+            SetEvent(Reload->StopEvent);
+            WaitForSingleObject(Reload->Thread, INFINITE);
+            CloseHandle(Reload->Thread);
+            CloseHandle(Reload->StopEvent);
+            Reload->Thread = 0;
+            Reload->StopEvent = 0;
+        }
+
+        for (uint32_t SlotIndex = 0; SlotIndex < Reload->SlotCount; ++SlotIndex)
+        {
+            ShaderReloadSlot* Slot = &Reload->Slots[SlotIndex];
+            if (Slot->Ready)
+            {
+                vkDestroyPipeline(Reload->Device, Slot->Pending, nullptr);
+                Slot->Pending = VK_NULL_HANDLE;
+                Slot->Ready = 0;
+            }
+        }
+    }
+
+    // Note: Render thread, at the start of a frame, before anything is recorded. SubmittedFrames as for DeferDestroy.
+    internal void
+    ApplyShaderReloads(ShaderReload* Reload, DeferredDestroyQueue* Destroys, uint64_t SubmittedFrames)
+    {
+        for (uint32_t SlotIndex = 0; SlotIndex < Reload->SlotCount; ++SlotIndex)
+        {
+            ShaderReloadSlot* Slot = &Reload->Slots[SlotIndex];
+            if (Slot->Ready)
+            {
+                DeferDestroyPipeline(Destroys, *Slot->Target, SubmittedFrames);
+                *Slot->Target = Slot->Pending;
+                Slot->Pending = VK_NULL_HANDLE;
+                InterlockedExchange(&Slot->Ready, 0);
+                ++Reload->Stats.Swaps;
+            }
+        }
+    }
+
+    internal void
+    OutputShaderReloadStats(ShaderReload* Reload)
+    {
+        ShaderReloadStats* Stats = &Reload->Stats;
+        double Builds = Stats->Builds ? (double)Stats->Builds : 1.0;
+        char Text[256];
+        snprintf(Text, sizeof(Text), "shader reload: %u pipelines watched, %u builds (%.2fms avg, %.2fms max), %u swaps, %u failures\n",
+                 Reload->SlotCount, Stats->Builds, Stats->TotalBuildMS / Builds, Stats->MaxBuildMS, Stats->Swaps, Stats->Failures);
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,158 @@
+// Note: A small job queue for spreading frame work over the cores.
+// One thread (the one calling DrawFrame) adds jobs, the workers and that same thread take them. The producer
+// joins in while it waits in CompleteAllJobs, so a queue with zero workers still runs everything, just serially.
+// Jobs are taken in order but can finish in any order; anything that has to be deterministic (like the order
+// command buffers get executed) is decided by the job's data, not by which thread ran it.
+
+#define VULKAN_MAX_JOB_THREADS      8   // Note: Including the thread that owns the queue.
+#define VULKAN_MAX_JOBS             256
+
+namespace Vulkan
+{
+    typedef void JobCallback(void* Data);
+
+    struct JobEntry
+    {
+        JobCallback* Callback;
+        void* Data;
+    };
+
+    struct JobQueue
+    {
+        uint32_t volatile CompletionGoal;
+        uint32_t volatile CompletionCount;
+        uint32_t volatile NextEntryToWrite;
+        uint32_t volatile NextEntryToRead;
+        bool32 volatile Quit;
+        HANDLE Semaphore;
+
+        JobEntry Entries[VULKAN_MAX_JOBS];
+
+        HANDLE Threads[VULKAN_MAX_JOB_THREADS];
+        uint32_t WorkerCount;   // Note: Not counting the owning thread.
+    };
+
+    // Note: Returns true if there was nothing to do.
+    internal bool32
+    DoNextJob(JobQueue* Queue)
+    {
+        bool32 ShouldSleep = false;
+
+        uint32_t OriginalNextEntryToRead = Queue->NextEntryToRead;
+        uint32_t NewNextEntryToRead = (OriginalNextEntryToRead + 1) % VULKAN_MAX_JOBS;
+        if (OriginalNextEntryToRead != Queue->NextEntryToWrite)
+        {
+            uint32_t Index = InterlockedCompareExchange((LONG volatile*)&Queue->NextEntryToRead,
+                                                       NewNextEntryToRead, OriginalNextEntryToRead);
+            if (Index == OriginalNextEntryToRead)
+            {
+                JobEntry Entry = Queue->Entries[Index];
+                Entry.Callback(Entry.Data);
+                InterlockedIncrement((LONG volatile*)&Queue->CompletionCount);
+            }
+        }
+        else
+        {
+            ShouldSleep = true;
+        }
+
+        return(ShouldSleep);
+    }
+
+    internal DWORD WINAPI
+    JobThreadProc(LPVOID Parameter)
+    {
+        JobQueue* Queue = (JobQueue*)Parameter;
+        while (!Queue->Quit)
+        {
+            if (DoNextJob(Queue))
+            {
+                WaitForSingleObjectEx(Queue->Semaphore, INFINITE, FALSE);
+            }
+        }
+        return(0);
+    }
+
+    // Note: ThreadCount includes the calling thread, so 1 means no workers at all.
+    internal void
+    InitJobQueue(JobQueue* Queue, uint32_t ThreadCount)
+    {
+        *Queue = {};
+        if (ThreadCount < 1)
+        {
+            ThreadCount = 1;
+        }
+        if (ThreadCount > VULKAN_MAX_JOB_THREADS)
+        {
+            ThreadCount = VULKAN_MAX_JOB_THREADS;
+        }
+
+        uint32_t WorkerCount = ThreadCount - 1;
+        Queue->Semaphore = CreateSemaphoreEx(0, 0, VULKAN_MAX_JOBS, 0, 0, SEMAPHORE_ALL_ACCESS);
+        for (uint32_t ThreadIndex = 0; ThreadIndex < WorkerCount; ++ThreadIndex)
+        {
+            HANDLE Thread = CreateThread(0, 0, JobThreadProc, Queue, 0, 0);
+            if (!Thread)
+            {
+                break;
+            }
+            Queue->Threads[Queue->WorkerCount++] = Thread;
+        }
+    }
+
+    // Note: One thread per logical processor, the calling thread being one of them.
+    inline uint32_t
+    GetDefaultJobThreadCount()
+    {
+        SYSTEM_INFO SystemInfo;
+        GetSystemInfo(&SystemInfo);
+        return(SystemInfo.dwNumberOfProcessors);
+    }
+
+    // Note: Only the owning thread may add jobs.
+    internal void
+    AddJob(JobQueue* Queue, JobCallback* Callback, void* Data)
+    {
+        uint32_t NewNextEntryToWrite = (Queue->NextEntryToWrite + 1) % VULKAN_MAX_JOBS;
+        Assert(NewNextEntryToWrite != Queue->NextEntryToRead);
+
+        JobEntry* Entry = &Queue->Entries[Queue->NextEntryToWrite];
+        Entry->Callback = Callback;
+        Entry->Data = Data;
+        ++Queue->CompletionGoal;
+
+        // Note: The entry has to be visible before the new write index is.
+        _WriteBarrier();
+        Queue->NextEntryToWrite = NewNextEntryToWrite;
+        ReleaseSemaphore(Queue->Semaphore, 1, 0);
+    }
+
+    internal void
+    CompleteAllJobs(JobQueue* Queue)
+    {
+        while (Queue->CompletionGoal != Queue->CompletionCount)
+        {
+            DoNextJob(Queue);
+        }
+
+        Queue->CompletionGoal = 0;
+        Queue->CompletionCount = 0;
+    }
+
+    internal void
+    DestroyJobQueue(JobQueue* Queue)
+    {
+        Queue->Quit = true;
+        if (Queue->WorkerCount)
+        {
+            ReleaseSemaphore(Queue->Semaphore, Queue->WorkerCount, 0);
+            WaitForMultipleObjects(Queue->WorkerCount, Queue->Threads, TRUE, INFINITE);
+        }
+        for (uint32_t ThreadIndex = 0; ThreadIndex < Queue->WorkerCount; ++ThreadIndex)
+        {
+            CloseHandle(Queue->Threads[ThreadIndex]);
+        }
+        CloseHandle(Queue->Semaphore);
+        Queue->WorkerCount = 0;
+    }
+}
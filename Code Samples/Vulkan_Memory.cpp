@@ -0,0 +1,644 @@
+// Note: Device memory sub-allocator.
+// Instead of one vkAllocateMemory per buffer, we allocate big blocks per memory type and hand out pieces of them
+// with a buddy allocator. Buddy blocks are always aligned to their own size, so any alignment up to the block size
+// comes for free. Linear (buffer) and optimal (image) resources never share a block, which keeps us clear of
+// bufferImageGranularity without having to pad every allocation.
+// Only uses core 1.0 calls, so it runs the same on lavapipe as on real hardware.
+// Each heap has a budget: what VK_EXT_memory_budget says this process can have when the device has it, otherwise a
+// fixed share of the heap (less whatever we've already got). A new block that would go over it first gives the
+// heap's empty blocks back to the driver; if it's still over it's allocated anyway (the budget isn't a hard limit)
+// and counted. A failed vkAllocateMemory gets the same treatment and one more try before it throws.
+// What's used is also counted per category (buffers, images, staging), by what the callers say it's for.
+
+#define VULKAN_MEMORY_MIN_ALLOCATION        256
+#define VULKAN_MEMORY_DEVICE_BLOCK_SIZE     (64 * 1024 * 1024)
+#define VULKAN_MEMORY_HOST_BLOCK_SIZE       (16 * 1024 * 1024)
+#define VULKAN_MEMORY_MAX_BLOCKS            64
+#define VULKAN_MEMORY_NO_BLOCK              0xFFFFFFFF
+#define VULKAN_MEMORY_FALLBACK_BUDGET       0.8f    // Note: Share of a heap we allow ourselves without VK_EXT_memory_budget.
+
+namespace Vulkan
+{
+    enum MemoryResourceKind
+    {
+        MemoryResourceKind_Linear,  // Buffers and linear images.
+        MemoryResourceKind_Optimal, // Optimal tiling images.
+    };
+
+    enum MemoryCategory
+    {
+        MemoryCategory_Buffer,
+        MemoryCategory_Image,
+        MemoryCategory_Staging,     // Host visible buffers that are only copied to or from.
+
+        MemoryCategory_Count,
+    };
+
+    struct MemoryBlock
+    {
+        VkDeviceMemory Memory;
+        VkDeviceSize Size;
+        uint32_t MemoryTypeIndex;
+        MemoryResourceKind Kind;
+        bool32 Dedicated;       // Note: Allocation that didn't fit in a normal block, it owns the whole thing.
+        uint32_t LevelCount;    // Note: Depth of the buddy tree, level 0 is the whole block.
+        uint8_t* Tree;          // Note: Per node (1-based heap order), 1 + the order of the largest free piece below it. 0 = full.
+        void* Mapped;           // Note: Host visible blocks stay mapped for their whole life.
+        VkDeviceSize UsedBytes;
+        uint32_t AllocationCount;
+        bool32 Evacuating;      // Note: Being emptied by the defragmentation, nothing new goes in.
+    };
+
+    struct MemoryAllocation
+    {
+        VkDeviceMemory Memory;
+        VkDeviceSize Offset;
+        VkDeviceSize Size;      // Note: What was actually reserved (rounded up to a power of two).
+        VkDeviceSize RequestedSize;
+        uint32_t BlockIndex;
+        MemoryCategory Category;
+        void* Mapped;           // Note: Null unless the memory is host visible.
+    };
+
+    struct MemoryStats
+    {
+        uint32_t BlockCount;
+        uint32_t DedicatedCount;
+        uint32_t AllocationCount;
+        uint32_t DeviceAllocationCalls;
+        VkDeviceSize ReservedBytes;     // Note: Sum of all vkAllocateMemory sizes.
+        VkDeviceSize UsedBytes;         // Note: Sum of sub-allocation sizes (after rounding).
+        VkDeviceSize RequestedBytes;    // Note: Sum of what callers asked for.
+        VkDeviceSize LargestFreeBytes;
+        float Fragmentation;            // Note: 1 - largest free piece / total free. 0 means all free space is in one piece.
+
+        VkDeviceSize CategoryBytes[MemoryCategory_Count];   // Note: Sub-allocation sizes, like UsedBytes.
+        uint32_t CategoryCounts[MemoryCategory_Count];
+
+        uint32_t HeapCount;
+        VkDeviceSize HeapReservedBytes[VK_MAX_MEMORY_HEAPS];
+        VkDeviceSize HeapUsageBytes[VK_MAX_MEMORY_HEAPS];   // Note: What the driver says this process uses, or HeapReservedBytes.
+        VkDeviceSize HeapBudgetBytes[VK_MAX_MEMORY_HEAPS];
+        bool32 BudgetFromDriver;
+        uint32_t OverBudgetBlocks;      // Note: Blocks allocated over the budget anyway.
+        uint32_t ReleasedEmptyBlocks;   // Note: Given back to the driver to stay in budget (or by the defragmentation).
+        uint32_t FailedAllocations;     // Note: vkAllocateMemory calls that failed and were tried again.
+    };
+
+    struct DeviceMemoryAllocator
+    {
+        VkDevice Device;
+        VkPhysicalDeviceMemoryProperties MemoryProperties;
+        VkDeviceSize BufferImageGranularity;
+
+        MemoryBlock Blocks[VULKAN_MEMORY_MAX_BLOCKS];
+        uint32_t BlockCount;
+
+        uint32_t DeviceAllocationCalls;
+        VkDeviceSize RequestedBytes;
+
+        VkPhysicalDevice PhysicalDevice;
+        bool32 HasMemoryBudget;     // Note: VK_EXT_memory_budget is enabled.
+        VkDeviceSize HeapBudgetBytes[VK_MAX_MEMORY_HEAPS];
+        VkDeviceSize HeapUsageBytes[VK_MAX_MEMORY_HEAPS];
+
+        VkDeviceSize CategoryBytes[MemoryCategory_Count];
+        uint32_t CategoryCounts[MemoryCategory_Count];
+        uint32_t OverBudgetBlocks;
+        uint32_t ReleasedEmptyBlocks;
+        uint32_t FailedAllocations;
+    };
+
+    inline uint32_t
+    MemoryOrderForSize(VkDeviceSize Size)
+    {
+        uint32_t Order = 0;
+        VkDeviceSize OrderSize = VULKAN_MEMORY_MIN_ALLOCATION;
+        while (OrderSize < Size)
+        {
+            OrderSize <<= 1;
+            ++Order;
+        }
+        return(Order);
+    }
+
+    inline VkDeviceSize
+    MemorySizeForOrder(uint32_t Order)
+    {
+        return((VkDeviceSize)VULKAN_MEMORY_MIN_ALLOCATION << Order);
+    }
+
+    inline uint32_t
+    MemoryNodeOrder(MemoryBlock* Block, uint32_t Depth)
+    {
+        return(Block->LevelCount - 1 - Depth);
+    }
+
+    inline uint32_t
+    GetMemoryHeapIndex(DeviceMemoryAllocator* Allocator, uint32_t MemoryTypeIndex)
+    {
+        return(Allocator->MemoryProperties.memoryTypes[MemoryTypeIndex].heapIndex);
+    }
+
+    inline VkDeviceSize
+    GetHeapReservedBytes(DeviceMemoryAllocator* Allocator, uint32_t HeapIndex)
+    {
+        VkDeviceSize Result = 0;
+        for (uint32_t BlockIndex = 0; BlockIndex < Allocator->BlockCount; ++BlockIndex)
+        {
+            MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+            if (Block->Memory != VK_NULL_HANDLE && GetMemoryHeapIndex(Allocator, Block->MemoryTypeIndex) == HeapIndex)
+            {
+                Result += Block->Size;
+            }
+        }
+        return(Result);
+    }
+
+    // Note: The budget moves with what other processes use, so it's asked for again before every new block.
+    internal void
+    UpdateMemoryBudget(DeviceMemoryAllocator* Allocator)
+    {
+        uint32_t HeapCount = Allocator->MemoryProperties.memoryHeapCount;
+        if (Allocator->HasMemoryBudget)
+        {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT Budget = {};
+            Budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+            VkPhysicalDeviceMemoryProperties2 Properties = {};
+            Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            Properties.pNext = &Budget;
+            vkGetPhysicalDeviceMemoryProperties2(Allocator->PhysicalDevice, &Properties);
+
+            for (uint32_t HeapIndex = 0; HeapIndex < HeapCount; ++HeapIndex)
+            {
+                Allocator->HeapBudgetBytes[HeapIndex] = Budget.heapBudget[HeapIndex];
+                Allocator->HeapUsageBytes[HeapIndex] = Budget.heapUsage[HeapIndex];
+            }
+        }
+        else
+        {
+            for (uint32_t HeapIndex = 0; HeapIndex < HeapCount; ++HeapIndex)
+            {
+                VkDeviceSize HeapSize = Allocator->MemoryProperties.memoryHeaps[HeapIndex].size;
+                Allocator->HeapBudgetBytes[HeapIndex] = (VkDeviceSize)((double)HeapSize * VULKAN_MEMORY_FALLBACK_BUDGET);
+                Allocator->HeapUsageBytes[HeapIndex] = GetHeapReservedBytes(Allocator, HeapIndex);
+            }
+        }
+    }
+
+    // Note: HasMemoryBudget if VK_EXT_memory_budget was enabled on the device.
+    internal void
+    InitDeviceMemoryAllocator(DeviceMemoryAllocator* Allocator, VkPhysicalDevice PhysicalDevice, VkDevice Device, bool32 HasMemoryBudget)
+    {
+        *Allocator = {};
+        Allocator->Device = Device;
+        Allocator->PhysicalDevice = PhysicalDevice;
+        Allocator->HasMemoryBudget = HasMemoryBudget;
+        vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &Allocator->MemoryProperties);
+
+        VkPhysicalDeviceProperties Properties;
+        vkGetPhysicalDeviceProperties(PhysicalDevice, &Properties);
+        Allocator->BufferImageGranularity = Properties.limits.bufferImageGranularity;
+
+        UpdateMemoryBudget(Allocator);
+    }
+
+    internal void
+    DestroyMemoryBlock(DeviceMemoryAllocator* Allocator, uint32_t BlockIndex)
+    {
+        MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+        if (Block->Mapped)
+        {
+            vkUnmapMemory(Allocator->Device, Block->Memory);
+        }
+        vkFreeMemory(Allocator->Device, Block->Memory, nullptr);
+        if (Block->Tree)
+        {
+            VirtualFree(Block->Tree, 0, MEM_RELEASE);
+        }
+        *Block = {};
+    }
+
+    // Note: Empty blocks of the heap go back to the driver. Returns how many bytes that freed.
+    internal VkDeviceSize
+    ReleaseEmptyMemoryBlocks(DeviceMemoryAllocator* Allocator, uint32_t HeapIndex)
+    {
+        VkDeviceSize Result = 0;
+        for (uint32_t BlockIndex = 0; BlockIndex < Allocator->BlockCount; ++BlockIndex)
+        {
+            MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+            // Note: A block being evacuated is the defragmentation's to release, it keeps the block's index.
+            if (Block->Memory != VK_NULL_HANDLE && !Block->Dedicated && !Block->AllocationCount && !Block->Evacuating &&
+                GetMemoryHeapIndex(Allocator, Block->MemoryTypeIndex) == HeapIndex)
+            {
+                Result += Block->Size;
+                DestroyMemoryBlock(Allocator, BlockIndex);
+                ++Allocator->ReleasedEmptyBlocks;
+            }
+        }
+        return(Result);
+    }
+
+    internal uint32_t
+    CreateMemoryBlock(DeviceMemoryAllocator* Allocator, VkDeviceSize Size, uint32_t MemoryTypeIndex, MemoryResourceKind Kind, bool32 Dedicated)
+    {
+        // Note: Slots of released blocks get reused.
+        uint32_t BlockIndex = 0;
+        while (BlockIndex < VULKAN_MEMORY_MAX_BLOCKS && Allocator->Blocks[BlockIndex].Memory != VK_NULL_HANDLE)
+        {
+            ++BlockIndex;
+        }
+        if (BlockIndex == VULKAN_MEMORY_MAX_BLOCKS)
+        {
+            throw std::runtime_error("out of device memory blocks!");
+        }
+
+        MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+        *Block = {};
+        Block->Size = Size;
+        Block->MemoryTypeIndex = MemoryTypeIndex;
+        Block->Kind = Kind;
+        Block->Dedicated = Dedicated;
+
+        // Note: Over budget, the empty blocks we were keeping around go first.
+        uint32_t HeapIndex = GetMemoryHeapIndex(Allocator, MemoryTypeIndex);
+        UpdateMemoryBudget(Allocator);
+        if (Allocator->HeapUsageBytes[HeapIndex] + Size > Allocator->HeapBudgetBytes[HeapIndex])
+        {
+            if (ReleaseEmptyMemoryBlocks(Allocator, HeapIndex))
+            {
+                UpdateMemoryBudget(Allocator);
+            }
+            if (Allocator->HeapUsageBytes[HeapIndex] + Size > Allocator->HeapBudgetBytes[HeapIndex])
+            {
+                // Todo: Logging. Going over isn't an error yet, but the driver may start paging.
+                ++Allocator->OverBudgetBlocks;
+            }
+        }
+
+        VkMemoryAllocateInfo AllocInfo = {};
+        AllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        AllocInfo.allocationSize = Size;
+        AllocInfo.memoryTypeIndex = MemoryTypeIndex;
+
+        VkResult Result = vkAllocateMemory(Allocator->Device, &AllocInfo, nullptr, &Block->Memory);
+        ++Allocator->DeviceAllocationCalls;
+        if (Result == VK_ERROR_OUT_OF_DEVICE_MEMORY || Result == VK_ERROR_OUT_OF_HOST_MEMORY)
+        {
+            ++Allocator->FailedAllocations;
+            if (ReleaseEmptyMemoryBlocks(Allocator, HeapIndex))
+            {
+                Result = vkAllocateMemory(Allocator->Device, &AllocInfo, nullptr, &Block->Memory);
+                ++Allocator->DeviceAllocationCalls;
+            }
+        }
+        if (Result != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate device memory block!");
+        }
+
+        VkMemoryPropertyFlags Flags = Allocator->MemoryProperties.memoryTypes[MemoryTypeIndex].propertyFlags;
+        if (Flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            // Note: A VkDeviceMemory can only be mapped once, so the block maps and everyone shares it.
+            if (vkMapMemory(Allocator->Device, Block->Memory, 0, VK_WHOLE_SIZE, 0, &Block->Mapped) != VK_SUCCESS) {
+                throw std::runtime_error("failed to map device memory block!");
+            }
+        }
+
+        if (!Dedicated)
+        {
+            Block->LevelCount = MemoryOrderForSize(Size) + 1;
+            uint32_t NodeCount = 1u << Block->LevelCount; // Note: Index 0 is unused.
+            Block->Tree = (uint8_t*)VirtualAlloc(0, NodeCount, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+            if (!Block->Tree) {
+                throw std::runtime_error("failed to allocate buddy tree!");
+            }
+            for (uint32_t Depth = 0; Depth < Block->LevelCount; ++Depth)
+            {
+                uint8_t Value = (uint8_t)(MemoryNodeOrder(Block, Depth) + 1);
+                for (uint32_t Node = (1u << Depth); Node < (2u << Depth); ++Node)
+                {
+                    Block->Tree[Node] = Value;
+                }
+            }
+        }
+
+        if (BlockIndex >= Allocator->BlockCount)
+        {
+            Allocator->BlockCount = BlockIndex + 1;
+        }
+        return(BlockIndex);
+    }
+
+    // Note: Returns the offset of a free piece of the given order, or false if the block doesn't have one.
+    internal bool32
+    BuddyAllocate(MemoryBlock* Block, uint32_t Order, VkDeviceSize* Offset)
+    {
+        if (Order >= Block->LevelCount || Block->Tree[1] < Order + 1)
+        {
+            return(false);
+        }
+
+        uint32_t Node = 1;
+        uint32_t Depth = 0;
+        while (MemoryNodeOrder(Block, Depth) > Order)
+        {
+            uint32_t Left = Node * 2;
+            // Note: Prefer the left child, which packs allocations towards the start of the block.
+            Node = (Block->Tree[Left] >= Order + 1) ? Left : Left + 1;
+            ++Depth;
+        }
+
+        Block->Tree[Node] = 0;
+        *Offset = (VkDeviceSize)(Node - (1u << Depth)) * MemorySizeForOrder(Order);
+
+        while (Node > 1)
+        {
+            Node /= 2;
+            --Depth;
+            uint8_t Left = Block->Tree[Node * 2];
+            uint8_t Right = Block->Tree[Node * 2 + 1];
+            Block->Tree[Node] = (Left > Right) ? Left : Right;
+        }
+        return(true);
+    }
+
+    internal void
+    BuddyFree(MemoryBlock* Block, VkDeviceSize Offset, uint32_t Order)
+    {
+        uint32_t Depth = Block->LevelCount - 1 - Order;
+        uint32_t Node = (1u << Depth) + (uint32_t)(Offset / MemorySizeForOrder(Order));
+        Assert(Block->Tree[Node] == 0);
+        Block->Tree[Node] = (uint8_t)(Order + 1);
+
+        while (Node > 1)
+        {
+            Node /= 2;
+            --Depth;
+            uint8_t ChildFull = (uint8_t)(MemoryNodeOrder(Block, Depth + 1) + 1);
+            uint8_t Left = Block->Tree[Node * 2];
+            uint8_t Right = Block->Tree[Node * 2 + 1];
+            if (Left == ChildFull && Right == ChildFull)
+            {
+                // Note: Both buddies are free, merge them.
+                Block->Tree[Node] = (uint8_t)(ChildFull + 1);
+            }
+            else
+            {
+                Block->Tree[Node] = (Left > Right) ? Left : Right;
+            }
+        }
+    }
+
+    // Note: Only from the blocks there already are (not the evacuating ones). Returns false if none had room.
+    internal bool32
+    SubAllocateDeviceMemory(DeviceMemoryAllocator* Allocator, uint32_t Order, uint32_t MemoryTypeIndex, MemoryResourceKind Kind,
+                            MemoryAllocation* Allocation)
+    {
+        for (uint32_t BlockIndex = 0; BlockIndex < Allocator->BlockCount; ++BlockIndex)
+        {
+            MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+            VkDeviceSize Offset;
+            if (Block->Memory != VK_NULL_HANDLE && !Block->Dedicated && !Block->Evacuating &&
+                Block->MemoryTypeIndex == MemoryTypeIndex && Block->Kind == Kind &&
+                BuddyAllocate(Block, Order, &Offset))
+            {
+                Block->UsedBytes += MemorySizeForOrder(Order);
+                ++Block->AllocationCount;
+
+                Allocation->Memory = Block->Memory;
+                Allocation->Offset = Offset;
+                Allocation->Size = MemorySizeForOrder(Order);
+                Allocation->BlockIndex = BlockIndex;
+                Allocation->Mapped = Block->Mapped ? (uint8_t*)Block->Mapped + Offset : nullptr;
+                return(true);
+            }
+        }
+        return(false);
+    }
+
+    inline void
+    AddMemoryCategory(DeviceMemoryAllocator* Allocator, MemoryAllocation* Allocation, MemoryCategory Category)
+    {
+        Allocation->Category = Category;
+        Allocator->CategoryBytes[Category] += Allocation->Size;
+        ++Allocator->CategoryCounts[Category];
+    }
+
+    // Note: Like AllocateDeviceMemory, but never makes a new block. For moving things into the blocks there are.
+    internal bool32
+    TryAllocateDeviceMemory(DeviceMemoryAllocator* Allocator, VkMemoryRequirements Requirements, uint32_t MemoryTypeIndex,
+                            MemoryResourceKind Kind, MemoryCategory Category, MemoryAllocation* Allocation)
+    {
+        VkDeviceSize Size = (Requirements.size < Requirements.alignment) ? Requirements.alignment : Requirements.size;
+
+        *Allocation = {};
+        if (!SubAllocateDeviceMemory(Allocator, MemoryOrderForSize(Size), MemoryTypeIndex, Kind, Allocation))
+        {
+            return(false);
+        }
+        Allocation->RequestedSize = Requirements.size;
+        Allocator->RequestedBytes += Requirements.size;
+        AddMemoryCategory(Allocator, Allocation, Category);
+        return(true);
+    }
+
+    internal void
+    AllocateDeviceMemory(DeviceMemoryAllocator* Allocator, VkMemoryRequirements Requirements, uint32_t MemoryTypeIndex,
+                         MemoryResourceKind Kind, MemoryCategory Category, MemoryAllocation* Allocation)
+    {
+        VkMemoryPropertyFlags Flags = Allocator->MemoryProperties.memoryTypes[MemoryTypeIndex].propertyFlags;
+        VkDeviceSize BlockSize = (Flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? VULKAN_MEMORY_DEVICE_BLOCK_SIZE : VULKAN_MEMORY_HOST_BLOCK_SIZE;
+
+        // Note: Don't let one block take a big bite out of a small heap.
+        uint32_t HeapIndex = Allocator->MemoryProperties.memoryTypes[MemoryTypeIndex].heapIndex;
+        VkDeviceSize HeapSize = Allocator->MemoryProperties.memoryHeaps[HeapIndex].size;
+        while (BlockSize > VULKAN_MEMORY_MIN_ALLOCATION && BlockSize > HeapSize / 8)
+        {
+            BlockSize >>= 1;
+        }
+
+        VkDeviceSize Size = Requirements.size;
+        if (Size < Requirements.alignment)
+        {
+            Size = Requirements.alignment;
+        }
+        uint32_t Order = MemoryOrderForSize(Size);
+
+        *Allocation = {};
+        Allocation->RequestedSize = Requirements.size;
+        Allocator->RequestedBytes += Requirements.size;
+
+        if (MemorySizeForOrder(Order) > BlockSize)
+        {
+            uint32_t BlockIndex = CreateMemoryBlock(Allocator, Requirements.size, MemoryTypeIndex, Kind, true);
+            MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+            Block->UsedBytes = Requirements.size;
+            Block->AllocationCount = 1;
+
+            Allocation->Memory = Block->Memory;
+            Allocation->Offset = 0;
+            Allocation->Size = Requirements.size;
+            Allocation->BlockIndex = BlockIndex;
+            Allocation->Mapped = Block->Mapped;
+            AddMemoryCategory(Allocator, Allocation, Category);
+            return;
+        }
+
+        for (uint32_t Pass = 0; Pass < 2; ++Pass)
+        {
+            if (SubAllocateDeviceMemory(Allocator, Order, MemoryTypeIndex, Kind, Allocation))
+            {
+                AddMemoryCategory(Allocator, Allocation, Category);
+                return;
+            }
+
+            // Note: Nothing had room, add a block and go again.
+            if (Pass == 0)
+            {
+                CreateMemoryBlock(Allocator, BlockSize, MemoryTypeIndex, Kind, false);
+            }
+        }
+
+        throw std::runtime_error("failed to sub-allocate device memory!");
+    }
+
+    internal void
+    FreeDeviceMemory(DeviceMemoryAllocator* Allocator, MemoryAllocation* Allocation)
+    {
+        if (Allocation->Memory == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        MemoryBlock* Block = &Allocator->Blocks[Allocation->BlockIndex];
+        Assert(Block->Memory == Allocation->Memory);
+        Allocator->RequestedBytes -= Allocation->RequestedSize;
+        Allocator->CategoryBytes[Allocation->Category] -= Allocation->Size;
+        --Allocator->CategoryCounts[Allocation->Category];
+
+        if (Block->Dedicated)
+        {
+            DestroyMemoryBlock(Allocator, Allocation->BlockIndex);
+        }
+        else
+        {
+            BuddyFree(Block, Allocation->Offset, MemoryOrderForSize(Allocation->Size));
+            Block->UsedBytes -= Allocation->Size;
+            --Block->AllocationCount;
+            // Note: Empty blocks are kept around, allocation patterns tend to repeat (swap chain recreation, reloads).
+            // They only go when the heap runs over its budget.
+        }
+
+        *Allocation = {};
+    }
+
+    internal void
+    DestroyDeviceMemoryAllocator(DeviceMemoryAllocator* Allocator)
+    {
+        for (uint32_t BlockIndex = 0; BlockIndex < Allocator->BlockCount; ++BlockIndex)
+        {
+            if (Allocator->Blocks[BlockIndex].Memory != VK_NULL_HANDLE)
+            {
+                DestroyMemoryBlock(Allocator, BlockIndex);
+            }
+        }
+        Allocator->BlockCount = 0;
+    }
+
+    internal MemoryStats
+    GetMemoryStats(DeviceMemoryAllocator* Allocator)
+    {
+        MemoryStats Stats = {};
+        Stats.DeviceAllocationCalls = Allocator->DeviceAllocationCalls;
+        Stats.RequestedBytes = Allocator->RequestedBytes;
+        for (uint32_t Category = 0; Category < MemoryCategory_Count; ++Category)
+        {
+            Stats.CategoryBytes[Category] = Allocator->CategoryBytes[Category];
+            Stats.CategoryCounts[Category] = Allocator->CategoryCounts[Category];
+        }
+
+        VkDeviceSize FreeBytes = 0;
+        for (uint32_t BlockIndex = 0; BlockIndex < Allocator->BlockCount; ++BlockIndex)
+        {
+            MemoryBlock* Block = &Allocator->Blocks[BlockIndex];
+            if (Block->Memory == VK_NULL_HANDLE)
+            {
+                continue;
+            }
+
+            if (Block->Dedicated)
+            {
+                ++Stats.DedicatedCount;
+            }
+            else
+            {
+                ++Stats.BlockCount;
+                if (Block->Tree[1])
+                {
+                    VkDeviceSize LargestFree = MemorySizeForOrder(Block->Tree[1] - 1);
+                    if (LargestFree > Stats.LargestFreeBytes)
+                    {
+                        Stats.LargestFreeBytes = LargestFree;
+                    }
+                }
+                FreeBytes += Block->Size - Block->UsedBytes;
+            }
+            Stats.AllocationCount += Block->AllocationCount;
+            Stats.ReservedBytes += Block->Size;
+            Stats.UsedBytes += Block->UsedBytes;
+        }
+
+        Stats.Fragmentation = (FreeBytes > 0) ? 1.0f - (float)Stats.LargestFreeBytes / (float)FreeBytes : 0.0f;
+
+        UpdateMemoryBudget(Allocator);
+        Stats.HeapCount = Allocator->MemoryProperties.memoryHeapCount;
+        for (uint32_t HeapIndex = 0; HeapIndex < Stats.HeapCount; ++HeapIndex)
+        {
+            Stats.HeapReservedBytes[HeapIndex] = GetHeapReservedBytes(Allocator, HeapIndex);
+            Stats.HeapUsageBytes[HeapIndex] = Allocator->HeapUsageBytes[HeapIndex];
+            Stats.HeapBudgetBytes[HeapIndex] = Allocator->HeapBudgetBytes[HeapIndex];
+        }
+        Stats.BudgetFromDriver = Allocator->HasMemoryBudget;
+        Stats.OverBudgetBlocks = Allocator->OverBudgetBlocks;
+        Stats.ReleasedEmptyBlocks = Allocator->ReleasedEmptyBlocks;
+        Stats.FailedAllocations = Allocator->FailedAllocations;
+        return(Stats);
+    }
+
+    internal int
+    FormatMemoryStats(char* Text, int Size, MemoryStats* Stats)
+    {
+        float MB = 1024.0f * 1024.0f;
+        int Used = snprintf(Text, Size,
+            "Device memory: %u blocks, %u dedicated, %u allocations, %u vkAllocateMemory calls\n"
+            "  reserved %.2fMB, used %.2fMB (requested %.2fMB), largest free %.2fMB, fragmentation %.1f%%\n"
+            "  buffers %.2fMB (%u), images %.2fMB (%u), staging %.2fMB (%u)\n"
+            "  budget (%s): %u blocks over budget, %u empty blocks released, %u failed allocations\n",
+            Stats->BlockCount, Stats->DedicatedCount, Stats->AllocationCount, Stats->DeviceAllocationCalls,
+            Stats->ReservedBytes / MB, Stats->UsedBytes / MB, Stats->RequestedBytes / MB, Stats->LargestFreeBytes / MB,
+            100.0f * Stats->Fragmentation,
+            Stats->CategoryBytes[MemoryCategory_Buffer] / MB, Stats->CategoryCounts[MemoryCategory_Buffer],
+            Stats->CategoryBytes[MemoryCategory_Image] / MB, Stats->CategoryCounts[MemoryCategory_Image],
+            Stats->CategoryBytes[MemoryCategory_Staging] / MB, Stats->CategoryCounts[MemoryCategory_Staging],
+            Stats->BudgetFromDriver ? "VK_EXT_memory_budget" : "estimated", Stats->OverBudgetBlocks,
+            Stats->ReleasedEmptyBlocks, Stats->FailedAllocations);
+        for (uint32_t HeapIndex = 0; HeapIndex < Stats->HeapCount && Used < Size - 1; ++HeapIndex)
+        {
+            Used += snprintf(Text + Used, Size - Used, "  heap %u: reserved %.2fMB, usage %.2fMB of %.2fMB budget\n",
+                             HeapIndex, Stats->HeapReservedBytes[HeapIndex] / MB, Stats->HeapUsageBytes[HeapIndex] / MB,
+                             Stats->HeapBudgetBytes[HeapIndex] / MB);
+        }
+        return(ClampReportLength(Used, Size));
+    }
+
+    internal void
+    OutputMemoryStats(DeviceMemoryAllocator* Allocator)
+    {
+        MemoryStats Stats = GetMemoryStats(Allocator);
+
+        char Text[2048];
+        FormatMemoryStats(Text, sizeof(Text), &Stats);
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,235 @@
+// Note: Pipeline and shader module caching.
+// The VkPipelineCache is saved to disk at shutdown and handed back to the driver on the next launch, so pipelines
+// we've built before come back without a full compile. The driver only takes data it recognizes, but we check the
+// header against the device ourselves first: a cache from another GPU or driver version is thrown away instead of
+// trusted. Shader modules are keyed by a hash of their SPIR-V, so pipelines sharing a shader share one module.
+// Each entry keeps its own copy of the SPIR-V, and a hash match only counts once the bytes compare equal.
+
+#define VULKAN_PIPELINE_CACHE_PATH      "/Game/build/pipeline_cache.bin"
+#define VULKAN_SHADER_DIRECTORY         "/Game/build/SPIR-V/"
+#define VULKAN_MAX_SHADER_MODULES       64
+
+namespace Vulkan
+{
+    struct ShaderModuleEntry
+    {
+        uint64_t Hash;
+        uint32_t Size;
+        void* Code;                 // Note: Our copy of the SPIR-V, the file memory is freed after loading.
+        VkShaderModule Module;
+    };
+
+    struct PipelineCacheStats
+    {
+        bool32 Warm;                // Note: A valid cache file was loaded.
+        bool32 Rejected;            // Note: There was a file, but it was for another device or driver.
+        uint32_t LoadedBytes;
+        uint32_t SavedBytes;
+        uint32_t ShaderModuleHits;
+        uint32_t ShaderModuleMisses;
+        float PipelineMS;           // Note: Time spent inside vkCreate*Pipelines.
+        float StartupMS;            // Note: All of InitVulkan.
+    };
+
+    struct PipelineCache
+    {
+        VkDevice Device;
+        VkPhysicalDeviceProperties DeviceProperties;
+        VkPipelineCache Cache;
+
+        ShaderModuleEntry Modules[VULKAN_MAX_SHADER_MODULES];
+        uint32_t ModuleCount;
+
+        PipelineCacheStats Stats;
+    };
+
+    inline float
+    MillisecondsSince(LARGE_INTEGER Start)
+    {
+        LARGE_INTEGER End, Frequency;
+        QueryPerformanceCounter(&End);
+        QueryPerformanceFrequency(&Frequency);
+        return(1000.0f * (float)(End.QuadPart - Start.QuadPart) / (float)Frequency.QuadPart);
+    }
+
+    inline uint64_t
+    HashShaderCode(const void* Code, size_t Size)
+    {
+        // Note: FNV-1a, 64 bit.
+        uint64_t Hash = 14695981039346656037ull;
+        const uint8_t* Bytes = (const uint8_t*)Code;
+        for (size_t Index = 0; Index < Size; ++Index)
+        {
+            Hash ^= Bytes[Index];
+            Hash *= 1099511628211ull;
+        }
+        return(Hash);
+    }
+
+    internal bool32
+    IsPipelineCacheDataValid(PipelineCache* Cache, void* Data, uint32_t Size)
+    {
+        if (!Data || Size < sizeof(VkPipelineCacheHeaderVersionOne))
+        {
+            return(false);
+        }
+
+        VkPipelineCacheHeaderVersionOne* Header = (VkPipelineCacheHeaderVersionOne*)Data;
+        bool32 Result = (Header->headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+                         Header->headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                         Header->vendorID == Cache->DeviceProperties.vendorID &&
+                         Header->deviceID == Cache->DeviceProperties.deviceID &&
+                         memcmp(Header->pipelineCacheUUID, Cache->DeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+        return(Result);
+    }
+
+    internal void
+    InitPipelineCache(PipelineCache* Cache, VkPhysicalDevice PhysicalDevice, VkDevice Device, game_memory* GameMemory)
+    {
+        *Cache = {};
+        Cache->Device = Device;
+        vkGetPhysicalDeviceProperties(PhysicalDevice, &Cache->DeviceProperties);
+
+        debug_read_file_result File = GameMemory->DEBUGPlatformReadEntireFile((char*)VULKAN_PIPELINE_CACHE_PATH);
+
+        VkPipelineCacheCreateInfo CreateInfo = {};
+        CreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        if (IsPipelineCacheDataValid(Cache, File.Contents, File.ContentsSize))
+        {
+            CreateInfo.initialDataSize = File.ContentsSize;
+            CreateInfo.pInitialData = File.Contents;
+            Cache->Stats.Warm = true;
+            Cache->Stats.LoadedBytes = File.ContentsSize;
+        }
+        else if (File.Contents)
+        {
+            Cache->Stats.Rejected = true;
+        }
+
+        if (vkCreatePipelineCache(Device, &CreateInfo, nullptr, &Cache->Cache) != VK_SUCCESS)
+        {
+            // Note: Shouldn't happen for data that passed the header check, but try once more from scratch.
+            CreateInfo.initialDataSize = 0;
+            CreateInfo.pInitialData = nullptr;
+            Cache->Stats.Warm = false;
+            if (vkCreatePipelineCache(Device, &CreateInfo, nullptr, &Cache->Cache) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline cache!");
+            }
+        }
+
+        GameMemory->DEBUGPlatformFreeFileMemory(File.Contents);
+    }
+
+    // Note: Returns the module for this SPIR-V, creating it the first time it's seen. Modules live until DestroyPipelineCache.
+    internal VkShaderModule
+    GetShaderModule(PipelineCache* Cache, void* Code, uint32_t Size)
+    {
+        uint64_t Hash = HashShaderCode(Code, Size);
+        for (uint32_t Index = 0; Index < Cache->ModuleCount; ++Index)
+        {
+            ShaderModuleEntry* Entry = &Cache->Modules[Index];
+            if (Entry->Hash == Hash && Entry->Size == Size && memcmp(Entry->Code, Code, Size) == 0)
+            {
+                ++Cache->Stats.ShaderModuleHits;
+                return(Entry->Module);
+            }
+        }
+
+        if (Cache->ModuleCount == VULKAN_MAX_SHADER_MODULES)
+        {
+            throw std::runtime_error("too many shader modules!");
+        }
+
+        VkShaderModuleCreateInfo CreateInfo = {};
+        CreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        CreateInfo.codeSize = Size;
+        CreateInfo.pCode = (uint32_t*)Code;
+
+        ShaderModuleEntry* Entry = &Cache->Modules[Cache->ModuleCount];
+        Entry->Code = VirtualAlloc(0, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (!Entry->Code)
+        {
+            throw std::runtime_error("failed to allocate shader module code!");
+        }
+        memcpy(Entry->Code, Code, Size);
+
+        if (vkCreateShaderModule(Cache->Device, &CreateInfo, nullptr, &Entry->Module) != VK_SUCCESS) {
+            VirtualFree(Entry->Code, 0, MEM_RELEASE);
+            Entry->Code = 0;
+            throw std::runtime_error("failed to create shader module!");
+        }
+        Entry->Hash = Hash;
+        Entry->Size = Size;
+        ++Cache->ModuleCount;
+        ++Cache->Stats.ShaderModuleMisses;
+
+        return(Entry->Module);
+    }
+
+    // Note: Reads a shader from VULKAN_SHADER_DIRECTORY and returns its (cached) module.
+    internal VkShaderModule
+    LoadShaderModule(PipelineCache* Cache, game_memory* GameMemory, const char* Filename)
+    {
+        char Path[256];
+        snprintf(Path, sizeof(Path), "%s%s", VULKAN_SHADER_DIRECTORY, Filename);
+
+        debug_read_file_result Code = GameMemory->DEBUGPlatformReadEntireFile(Path);
+        if (!Code.Contents)
+        {
+            throw std::runtime_error("failed to read shader file!");
+        }
+
+        VkShaderModule Result = GetShaderModule(Cache, Code.Contents, Code.ContentsSize);
+        GameMemory->DEBUGPlatformFreeFileMemory(Code.Contents);
+        return(Result);
+    }
+
+    internal void
+    SavePipelineCache(PipelineCache* Cache, game_memory* GameMemory)
+    {
+        size_t Size = 0;
+        if (vkGetPipelineCacheData(Cache->Device, Cache->Cache, &Size, nullptr) != VK_SUCCESS || Size == 0)
+        {
+            return;
+        }
+
+        void* Data = VirtualAlloc(0, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (Data)
+        {
+            if (vkGetPipelineCacheData(Cache->Device, Cache->Cache, &Size, Data) == VK_SUCCESS &&
+                GameMemory->DEBUGPlatformWriteEntireFile((char*)VULKAN_PIPELINE_CACHE_PATH, (uint32_t)Size, Data))
+            {
+                Cache->Stats.SavedBytes = (uint32_t)Size;
+            }
+            VirtualFree(Data, 0, MEM_RELEASE);
+        }
+    }
+
+    internal void
+    DestroyPipelineCache(PipelineCache* Cache)
+    {
+        for (uint32_t Index = 0; Index < Cache->ModuleCount; ++Index)
+        {
+            vkDestroyShaderModule(Cache->Device, Cache->Modules[Index].Module, nullptr);
+            VirtualFree(Cache->Modules[Index].Code, 0, MEM_RELEASE);
+        }
+        Cache->ModuleCount = 0;
+
+        vkDestroyPipelineCache(Cache->Device, Cache->Cache, nullptr);
+        Cache->Cache = VK_NULL_HANDLE;
+    }
+
+    internal void
+    OutputPipelineCacheStats(PipelineCache* Cache)
+    {
+        PipelineCacheStats* Stats = &Cache->Stats;
+        char Text[512];
+        snprintf(Text, sizeof(Text),
+            "Vulkan startup (%s pipeline cache%s): %.2fms, pipelines %.2fms\n"
+            "pipeline cache: %u bytes loaded, %u bytes saved; shader modules: %u created, %u shared\n",
+            Stats->Warm ? "warm" : "cold", Stats->Rejected ? ", file rejected" : "",
+            Stats->StartupMS, Stats->PipelineMS,
+            Stats->LoadedBytes, Stats->SavedBytes, Stats->ShaderModuleMisses, Stats->ShaderModuleHits);
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,159 @@
+// Note: Headless frame readback.
+// Without a window the frames are rendered into our own images, and each one is copied into a host visible buffer
+// at the end of its command buffer. Nobody ever waits on the GPU to read a frame: the platform polls for the oldest
+// finished copy after each DrawFrame. A copy is finished once its frame's fence has signaled, or once DrawFrame has
+// waited on that fence for a later frame. The ring has a couple more buffers than there are frames in flight, so a
+// platform polling every frame never loses one; a frame that isn't picked up before its buffer comes around again is
+// counted as dropped.
+
+#define VULKAN_READBACK_RING_SIZE   (VULKAN_MAX_FRAMES_IN_FLIGHT + 2)
+
+namespace Vulkan
+{
+    struct ReadbackSlot
+    {
+        VkBuffer Buffer;
+        MemoryAllocation Memory;
+        uint64_t FrameNumber;
+        uint32_t FenceIndex;    // Note: The frame in flight it was recorded in.
+        bool32 Pending;         // Note: Copy recorded, not picked up yet.
+    };
+
+    // Note: What the platform gets back. Pixels point into the mapped buffer and are only valid until the next DrawFrame.
+    struct ReadbackFrame
+    {
+        void* Pixels;
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t Pitch;
+        uint64_t FrameNumber;
+    };
+
+    struct ReadbackStats
+    {
+        uint64_t FramesCopied;
+        uint64_t FramesRead;
+        uint64_t FramesDropped;
+        uint64_t BytesRead;
+    };
+
+    struct ReadbackRing
+    {
+        ReadbackSlot Slots[VULKAN_READBACK_RING_SIZE];
+        uint64_t CompletedFrames;   // Note: Every frame below this is known to be done.
+        uint32_t Width;
+        uint32_t Height;
+        uint32_t Pitch;
+        VkDeviceSize SlotSize;
+        bool32 HostCached;      // Note: Uncached (write combined) memory is very slow to read from the CPU.
+
+        ReadbackStats Stats;
+    };
+
+    // Note: The readback pass of the render graph, which has the image in TRANSFER_SRC_OPTIMAL by then.
+    internal void
+    RecordReadbackCopy(ReadbackRing* Ring, VkCommandBuffer CommandBuffer, VkImage Image, uint32_t FenceIndex, uint64_t FrameNumber)
+    {
+        ReadbackSlot* Slot = &Ring->Slots[FrameNumber % VULKAN_READBACK_RING_SIZE];
+        if (Slot->Pending)
+        {
+            ++Ring->Stats.FramesDropped;
+        }
+
+        VkBufferImageCopy Region = {};
+        Region.bufferOffset = 0;
+        Region.bufferRowLength = 0;     // Note: Tightly packed, Pitch is Width * 4.
+        Region.bufferImageHeight = 0;
+        Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Region.imageSubresource.layerCount = 1;
+        Region.imageExtent = { Ring->Width, Ring->Height, 1 };
+        vkCmdCopyImageToBuffer(CommandBuffer, Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Slot->Buffer, 1, &Region);
+
+        // Note: Makes the copy visible to the host once the fence signals.
+        VkBufferMemoryBarrier Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.buffer = Slot->Buffer;
+        Barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 0, nullptr, 1, &Barrier, 0, nullptr);
+
+        Slot->FrameNumber = FrameNumber;
+        Slot->FenceIndex = FenceIndex;
+        Slot->Pending = true;
+        ++Ring->Stats.FramesCopied;
+    }
+
+    // Note: Call once DrawFrame has waited on the fence of frame FrameNumber. Its fence is about to be reused,
+    // so from here on the fence can't tell us about it anymore.
+    inline void
+    RetireReadbackFrames(ReadbackRing* Ring, uint64_t FrameNumber)
+    {
+        if (FrameNumber + 1 > Ring->CompletedFrames)
+        {
+            Ring->CompletedFrames = FrameNumber + 1;
+        }
+    }
+
+    inline ReadbackSlot*
+    GetOldestReadbackSlot(ReadbackRing* Ring)
+    {
+        ReadbackSlot* Result = nullptr;
+        for (uint32_t SlotIndex = 0; SlotIndex < VULKAN_READBACK_RING_SIZE; ++SlotIndex)
+        {
+            ReadbackSlot* Slot = &Ring->Slots[SlotIndex];
+            if (Slot->Pending && (!Result || Slot->FrameNumber < Result->FrameNumber))
+            {
+                Result = Slot;
+            }
+        }
+        return(Result);
+    }
+
+    // Note: Never blocks. Hands out the oldest finished frame, in order; returns false if it isn't done yet.
+    // FrameFences are the in flight fences.
+    internal bool32
+    AcquireReadbackFrame(ReadbackRing* Ring, VkDevice Device, VkFence* FrameFences, ReadbackFrame* Frame)
+    {
+        ReadbackSlot* Oldest = GetOldestReadbackSlot(Ring);
+        if (!Oldest)
+        {
+            return(false);
+        }
+
+        // Note: Frames finish in submission order, so if the oldest isn't done, none of the others are either.
+        bool32 Done = (Oldest->FrameNumber < Ring->CompletedFrames ||
+                       vkGetFenceStatus(Device, FrameFences[Oldest->FenceIndex]) == VK_SUCCESS);
+        if (!Done)
+        {
+            return(false);
+        }
+
+        Frame->Pixels = Oldest->Memory.Mapped;
+        Frame->Width = Ring->Width;
+        Frame->Height = Ring->Height;
+        Frame->Pitch = Ring->Pitch;
+        Frame->FrameNumber = Oldest->FrameNumber;
+
+        Oldest->Pending = false;
+        ++Ring->Stats.FramesRead;
+        Ring->Stats.BytesRead += Ring->SlotSize;
+        return(true);
+    }
+
+    internal void
+    OutputReadbackStats(ReadbackRing* Ring)
+    {
+        ReadbackStats* Stats = &Ring->Stats;
+        char Text[256];
+        snprintf(Text, sizeof(Text),
+            "readback (%ux%u, %s memory): %llu frames copied, %llu read, %llu dropped, %.2fMB read\n",
+            Ring->Width, Ring->Height, Ring->HostCached ? "cached" : "uncached",
+            Stats->FramesCopied, Stats->FramesRead, Stats->FramesDropped,
+            (double)Stats->BytesRead / (1024.0 * 1024.0));
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,240 @@
+// Note: Multithreaded command recording.
+// Everything inside the render pass goes into secondary command buffers, one per slice of the sprite rows.
+// Each slice has its own command pool per frame in flight, so the threads never share a pool, and the pools
+// are reset as a whole once the frame's fence has signaled instead of resetting buffers one by one.
+// The primary buffer executes the secondaries in slice order, so the draw order never depends on the threads.
+
+#define VULKAN_RECORD_MIN_ROWS_PER_SLICE    (16 * 1024) // Note: Below this a slice costs more to hand off than to do.
+
+namespace Vulkan
+{
+    struct FrameCommandPools
+    {
+        VkCommandPool PrimaryPool;
+        VkCommandBuffer Primary;
+        VkCommandPool SlicePools[VULKAN_SPRITE_MAX_SLICES];
+        VkCommandBuffer Secondaries[VULKAN_SPRITE_MAX_SLICES];
+    };
+
+    // Note: Everything a slice needs to record its part of the frame. Filled by the main thread, read-only for the jobs.
+    struct FrameRecordState
+    {
+        VkRenderPass RenderPass;
+        VkFramebuffer Framebuffer;
+        VkExtent2D Extent;
+        uint32_t FrameIndex;
+
+        VkPipelineLayout PipelineLayout;
+        VkDescriptorSet DescriptorSets[2];  // Note: 0 = the main set, 1 = the bindless set.
+        uint32_t DynamicOffsets[VULKAN_DYNAMIC_OFFSET_COUNT];
+        VkPipeline QuadPipeline;
+        VkBuffer GeometryVertexBuffer;  // Note: Bound once per slice, every draw picks its mesh by offsets.
+        VkBuffer GeometryIndexBuffer;
+        GeometryRange Quad;
+
+        SpriteRenderer* Sprites;
+        SpriteCuller* Culler;
+        SpriteEntityColumns* Columns;   // Note: Null if no CPU sprites were submitted this frame.
+        SpriteDefinition* Definitions;
+        glm::vec4* SheetTransforms;     // Note: This frame's atlas residency, one per atlas.
+
+        VkPipeline ObjectPipeline;
+        ObjectBatch* ObjectBatches;     // Note: Already copied into the dynamic ring, FirstObject is set.
+        uint32_t ObjectBatchCount;
+
+        bool32 SoftwareFrame;           // Note: The render pass starts with the software back buffer in it.
+    };
+
+    struct RecordSliceJob
+    {
+        FrameRecordState* State;
+        uint32_t SliceIndex;
+        VkCommandBuffer CommandBuffer;
+        VkResult Result;    // Note: Jobs can't throw across threads, the main thread checks this.
+    };
+
+    internal void
+    CreateFrameCommandPools(VkDevice Device, uint32_t QueueFamily, FrameCommandPools* Pools)
+    {
+        *Pools = {};
+
+        VkCommandPoolCreateInfo PoolInfo = {};
+        PoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        PoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        PoolInfo.queueFamilyIndex = QueueFamily;
+
+        if (vkCreateCommandPool(Device, &PoolInfo, nullptr, &Pools->PrimaryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+
+        VkCommandBufferAllocateInfo AllocInfo = {};
+        AllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        AllocInfo.commandPool = Pools->PrimaryPool;
+        AllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        AllocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(Device, &AllocInfo, &Pools->Primary) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        for (uint32_t SliceIndex = 0; SliceIndex < VULKAN_SPRITE_MAX_SLICES; ++SliceIndex)
+        {
+            if (vkCreateCommandPool(Device, &PoolInfo, nullptr, &Pools->SlicePools[SliceIndex]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create command pool!");
+            }
+
+            AllocInfo.commandPool = Pools->SlicePools[SliceIndex];
+            AllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            if (vkAllocateCommandBuffers(Device, &AllocInfo, &Pools->Secondaries[SliceIndex]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+        }
+    }
+
+    // Note: Only once the frame's fence has signaled. The buffers are reset along with their pool.
+    internal void
+    ResetFrameCommandPools(VkDevice Device, FrameCommandPools* Pools, uint32_t SliceCount)
+    {
+        vkResetCommandPool(Device, Pools->PrimaryPool, 0);
+        for (uint32_t SliceIndex = 0; SliceIndex < SliceCount; ++SliceIndex)
+        {
+            vkResetCommandPool(Device, Pools->SlicePools[SliceIndex], 0);
+        }
+    }
+
+    internal void
+    DestroyFrameCommandPools(VkDevice Device, FrameCommandPools* Pools)
+    {
+        for (uint32_t SliceIndex = 0; SliceIndex < VULKAN_SPRITE_MAX_SLICES; ++SliceIndex)
+        {
+            vkDestroyCommandPool(Device, Pools->SlicePools[SliceIndex], nullptr);
+        }
+        vkDestroyCommandPool(Device, Pools->PrimaryPool, nullptr);
+    }
+
+    // Note: How many slices the rows are worth, given ThreadCount threads to run them on.
+    inline uint32_t
+    GetRecordSliceCount(uint32_t RowCount, uint32_t ThreadCount)
+    {
+        uint32_t Result = RowCount / VULKAN_RECORD_MIN_ROWS_PER_SLICE;
+        if (Result > ThreadCount)
+        {
+            Result = ThreadCount;
+        }
+        if (Result > VULKAN_SPRITE_MAX_SLICES)
+        {
+            Result = VULKAN_SPRITE_MAX_SLICES;
+        }
+        if (Result < 1)
+        {
+            Result = 1;
+        }
+        return(Result);
+    }
+
+    internal void
+    CullSliceJob(void* Data)
+    {
+        RecordSliceJob* Job = (RecordSliceJob*)Data;
+        FrameRecordState* State = Job->State;
+        CullSpriteSlice(State->Sprites, &State->Sprites->Slices[Job->SliceIndex], State->Columns, State->Definitions);
+    }
+
+    // Note: One instanced draw per batch. Only the push constants and the mesh offsets change between them,
+    // the set and the geometry buffers stay bound.
+    internal void
+    RecordObjectDraws(FrameRecordState* State, VkCommandBuffer CommandBuffer)
+    {
+        vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, State->ObjectPipeline);
+        vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, State->PipelineLayout, 0, 1, &State->DescriptorSets[0],
+            VULKAN_DYNAMIC_OFFSET_COUNT, State->DynamicOffsets);
+
+        for (uint32_t BatchIndex = 0; BatchIndex < State->ObjectBatchCount; ++BatchIndex)
+        {
+            ObjectBatch* Batch = &State->ObjectBatches[BatchIndex];
+            if (!Batch->Count)
+            {
+                continue;
+            }
+
+            ObjectDrawConstants Constants = {};
+            Constants.FirstObject = Batch->FirstObject;
+            Constants.Tint = Batch->Tint;
+            vkCmdPushConstants(CommandBuffer, State->PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Constants), &Constants);
+            vkCmdDrawIndexed(CommandBuffer, Batch->Mesh.IndexCount, Batch->Count, Batch->Mesh.FirstIndex, Batch->Mesh.VertexOffset, 0);
+        }
+    }
+
+    // Note: Writes the slice's instances, then records its draws. Slice 0 also gets the draws that aren't split:
+    // the GPU culled sprites (drawn first), the objects (drawn last) and the test quad (when there's nothing else).
+    internal void
+    RecordSliceJobProc(void* Data)
+    {
+        RecordSliceJob* Job = (RecordSliceJob*)Data;
+        FrameRecordState* State = Job->State;
+        SpriteSlice* Slice = &State->Sprites->Slices[Job->SliceIndex];
+        VkCommandBuffer CommandBuffer = Job->CommandBuffer;
+
+        if (State->Columns)
+        {
+            WriteSpriteSlice(State->Sprites, Slice, State->FrameIndex, State->Columns, State->Definitions, State->SheetTransforms);
+        }
+
+        VkCommandBufferInheritanceInfo InheritanceInfo = {};
+        InheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        InheritanceInfo.renderPass = State->RenderPass;
+        InheritanceInfo.subpass = 0;
+        InheritanceInfo.framebuffer = State->Framebuffer;
+
+        VkCommandBufferBeginInfo BeginInfo = {};
+        BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        BeginInfo.pInheritanceInfo = &InheritanceInfo;
+
+        Job->Result = vkBeginCommandBuffer(CommandBuffer, &BeginInfo);
+        if (Job->Result != VK_SUCCESS)
+        {
+            return;
+        }
+
+        // Note: Dynamic state isn't inherited from the primary.
+        VkViewport Viewport = {};
+        Viewport.width = (float)State->Extent.width;
+        Viewport.height = (float)State->Extent.height;
+        Viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(CommandBuffer, 0, 1, &Viewport);
+
+        VkRect2D Scissor = {};
+        Scissor.extent = State->Extent;
+        vkCmdSetScissor(CommandBuffer, 0, 1, &Scissor);
+
+        // Note: Neither is inherited either. These are the only geometry binds the slice makes.
+        BindGeometryBuffers(CommandBuffer, State->GeometryVertexBuffer, State->GeometryIndexBuffer);
+
+        bool32 FirstSlice = (Job->SliceIndex == 0);
+        if (FirstSlice && State->Culler->SourceCount)
+        {
+            RecordSpriteCullDraws(State->Culler, CommandBuffer, State->FrameIndex, State->Sprites->Pipeline, State->PipelineLayout,
+                State->DescriptorSets, State->DynamicOffsets);
+        }
+
+        RecordSpriteDraws(State->Sprites, Slice, CommandBuffer, State->FrameIndex, State->PipelineLayout, State->DescriptorSets,
+            State->DynamicOffsets, &State->Quad);
+
+        if (FirstSlice && State->ObjectBatchCount)
+        {
+            RecordObjectDraws(State, CommandBuffer);
+        }
+
+        if (FirstSlice && !State->Culler->SourceCount && !State->Sprites->InstanceCount && !State->ObjectBatchCount && !State->SoftwareFrame)
+        {
+            // Note: Nothing submitted, draw the test quad.
+            vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, State->QuadPipeline);
+            vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, State->PipelineLayout, 0, 1, &State->DescriptorSets[0],
+                VULKAN_DYNAMIC_OFFSET_COUNT, State->DynamicOffsets);
+            vkCmdDrawIndexed(CommandBuffer, State->Quad.IndexCount, 1, State->Quad.FirstIndex, State->Quad.VertexOffset, 0);
+        }
+
+        Job->Result = vkEndCommandBuffer(CommandBuffer);
+    }
+}
@@ -0,0 +1,677 @@
+// Note: A small render graph for the frame's image work.
+// Passes say which images they touch and how (RenderGraphAccessType), and record their commands in a callback.
+// The graph puts them in an order that respects those uses, drops passes nothing needs, and before each pass puts
+// one vkCmdPipelineBarrier with the layout transitions and hazards of all the images the pass touches. Reads of an
+// image in the layout it's already in need no barrier at all.
+// Images are imported (the swap chain or offscreen image, set every frame) or transient: made by the graph, only
+// alive between their first and last pass of a frame, contents undefined before that. Transients whose lifetimes
+// don't overlap share memory; their usage flags come from how the passes use them.
+// Ordering: a pass that writes an image comes after the passes declared before it that write it too, and before every
+// pass that only reads it, wherever that one was declared. Between passes that don't care the declaration order wins.
+// The graph is compiled once, with every pass that may ever run; a frame can then turn passes off. Aliasing is planned
+// over the whole order, so it holds for any subset, and barriers are worked out as the frame is recorded.
+// Buffers aren't tracked, the passes that use them (simulation, culling, readback) still put their own barriers. A pass
+// whose output is one of those, like the readback into its ring, is marked NeverCull, or the graph would think nothing
+// needs it.
+
+#define VULKAN_RENDER_GRAPH_MAX_PASSES      16
+#define VULKAN_RENDER_GRAPH_MAX_RESOURCES   16
+#define VULKAN_RENDER_GRAPH_MAX_ACCESSES    4
+#define VULKAN_RENDER_GRAPH_NO_SLOT         0xFFFFFFFF
+
+namespace Vulkan
+{
+    enum RenderGraphAccessType
+    {
+        RenderGraphAccess_ColorWrite,       // Note: Color attachment that's cleared or overwritten.
+        RenderGraphAccess_ColorReadWrite,   // Note: Color attachment that's loaded (blending, or drawing over what's there).
+        RenderGraphAccess_SampledRead,      // Note: Sampled in fragment shaders.
+        RenderGraphAccess_TransferRead,
+        RenderGraphAccess_TransferWrite,
+    };
+
+    struct RenderGraphAccessInfo
+    {
+        VkPipelineStageFlags Stage;
+        VkAccessFlags Access;
+        VkImageLayout Layout;
+        VkImageUsageFlags Usage;
+        bool32 Writes;
+    };
+
+    typedef void RenderGraphCallback(VkCommandBuffer CommandBuffer, void* Data);
+
+    struct RenderGraphAccess
+    {
+        uint32_t Resource;
+        RenderGraphAccessType Type;
+    };
+
+    struct RenderGraphPass
+    {
+        const char* Name;
+        RenderGraphCallback* Callback;
+        void* Data;
+        RenderGraphAccess Accesses[VULKAN_RENDER_GRAPH_MAX_ACCESSES];
+        uint32_t AccessCount;
+        bool32 Enabled;             // Note: Per frame, all passes start out enabled.
+        bool32 NeverCull;           // Note: Writes something the graph doesn't track, always live.
+        bool32 Culled;              // Note: Nothing reads what it writes, set by CompileRenderGraph.
+    };
+
+    struct RenderGraphResource
+    {
+        const char* Name;
+        bool32 Transient;
+
+        // Note: Imported images. InitialStage is what the first barrier of a frame waits for (e.g. the acquire
+        // semaphore's wait stage), FinalLayout where the image has to be at the end (UNDEFINED if anywhere will do).
+        VkPipelineStageFlags InitialStage;
+        VkImageLayout FinalLayout;
+
+        // Note: Transient images, made by CompileRenderGraph.
+        VkFormat Format;
+        VkExtent2D Extent;
+        VkImageUsageFlags Usage;
+        VkMemoryRequirements Requirements;
+        uint32_t Slot;
+        uint32_t FirstUse;          // Note: Positions in Order.
+        uint32_t LastUse;
+
+        VkImage Image;
+
+        // Note: Where the image is at, while a frame is recorded.
+        VkPipelineStageFlags Stage;
+        VkAccessFlags Access;
+        VkImageLayout Layout;
+        bool32 Used;
+    };
+
+    // Note: Memory shared by transients. Remembers the last use of whichever of them went last, including in the previous
+    // frame, so the next one to start in it waits for that.
+    struct RenderGraphSlot
+    {
+        MemoryAllocation Memory;
+        VkMemoryRequirements Requirements;
+        uint32_t LastUse;
+        VkPipelineStageFlags Stage;
+        VkAccessFlags Access;
+    };
+
+    struct RenderGraphStats
+    {
+        uint64_t Frames;
+        uint64_t Barriers;          // Note: Image barriers, layout transitions included.
+        uint64_t BarrierCalls;      // Note: vkCmdPipelineBarrier calls, at most one per pass plus the final one.
+        uint64_t SkippedBarriers;   // Note: Reads in the layout the image was already in.
+        uint32_t LastBarriers;
+        uint32_t PassCount;
+        uint32_t CulledPasses;
+        uint32_t TransientCount;
+        uint32_t SlotCount;
+        VkDeviceSize TransientBytes;    // Note: What the transients would take on their own.
+        VkDeviceSize AllocatedBytes;    // Note: What their slots take.
+    };
+
+    struct RenderGraph
+    {
+        VkDevice Device;
+        DeviceMemoryAllocator* Allocator;
+
+        RenderGraphResource Resources[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+        uint32_t ResourceCount;
+        RenderGraphPass Passes[VULKAN_RENDER_GRAPH_MAX_PASSES];
+        uint32_t PassCount;
+
+        uint32_t Order[VULKAN_RENDER_GRAPH_MAX_PASSES];
+        uint32_t OrderCount;
+        RenderGraphSlot Slots[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+        uint32_t SlotCount;
+        bool32 Compiled;
+
+        RenderGraphStats Stats;
+    };
+
+    internal RenderGraphAccessInfo
+    GetRenderGraphAccessInfo(RenderGraphAccessType Type)
+    {
+        RenderGraphAccessInfo Result = {};
+        switch (Type)
+        {
+            case RenderGraphAccess_ColorWrite:
+            {
+                Result.Stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                Result.Access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                Result.Layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                Result.Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                Result.Writes = true;
+            } break;
+            case RenderGraphAccess_ColorReadWrite:
+            {
+                Result.Stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                Result.Access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                Result.Layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                Result.Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                Result.Writes = true;
+            } break;
+            case RenderGraphAccess_SampledRead:
+            {
+                Result.Stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+                Result.Access = VK_ACCESS_SHADER_READ_BIT;
+                Result.Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                Result.Usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+            } break;
+            case RenderGraphAccess_TransferRead:
+            {
+                Result.Stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+                Result.Access = VK_ACCESS_TRANSFER_READ_BIT;
+                Result.Layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                Result.Usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            } break;
+            case RenderGraphAccess_TransferWrite:
+            {
+                Result.Stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+                Result.Access = VK_ACCESS_TRANSFER_WRITE_BIT;
+                Result.Layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                Result.Usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+                Result.Writes = true;
+            } break;
+        }
+        return(Result);
+    }
+
+    internal void
+    InitRenderGraph(RenderGraph* Graph, VkDevice Device, DeviceMemoryAllocator* Allocator)
+    {
+        *Graph = {};
+        Graph->Device = Device;
+        Graph->Allocator = Allocator;
+    }
+
+    internal uint32_t
+    AddRenderGraphImport(RenderGraph* Graph, const char* Name, VkPipelineStageFlags InitialStage, VkImageLayout FinalLayout)
+    {
+        Assert(!Graph->Compiled && Graph->ResourceCount < VULKAN_RENDER_GRAPH_MAX_RESOURCES);
+        uint32_t Result = Graph->ResourceCount++;
+        RenderGraphResource* Resource = &Graph->Resources[Result];
+        Resource->Name = Name;
+        Resource->InitialStage = InitialStage;
+        Resource->FinalLayout = FinalLayout;
+        Resource->Slot = VULKAN_RENDER_GRAPH_NO_SLOT;
+        return(Result);
+    }
+
+    internal uint32_t
+    AddRenderGraphTransient(RenderGraph* Graph, const char* Name, VkFormat Format, uint32_t Width, uint32_t Height)
+    {
+        Assert(!Graph->Compiled && Graph->ResourceCount < VULKAN_RENDER_GRAPH_MAX_RESOURCES);
+        uint32_t Result = Graph->ResourceCount++;
+        RenderGraphResource* Resource = &Graph->Resources[Result];
+        Resource->Name = Name;
+        Resource->Transient = true;
+        Resource->Format = Format;
+        Resource->Extent = { Width, Height };
+        Resource->Slot = VULKAN_RENDER_GRAPH_NO_SLOT;
+        return(Result);
+    }
+
+    internal uint32_t
+    AddRenderGraphPass(RenderGraph* Graph, const char* Name, RenderGraphCallback* Callback, void* Data)
+    {
+        Assert(!Graph->Compiled && Graph->PassCount < VULKAN_RENDER_GRAPH_MAX_PASSES);
+        uint32_t Result = Graph->PassCount++;
+        RenderGraphPass* Pass = &Graph->Passes[Result];
+        Pass->Name = Name;
+        Pass->Callback = Callback;
+        Pass->Data = Data;
+        Pass->Enabled = true;
+        return(Result);
+    }
+
+    inline void
+    SetRenderGraphPassNeverCull(RenderGraph* Graph, uint32_t PassIndex)
+    {
+        Assert(!Graph->Compiled);
+        Graph->Passes[PassIndex].NeverCull = true;
+    }
+
+    // Note: Each image at most once per pass.
+    internal void
+    UseRenderGraphImage(RenderGraph* Graph, uint32_t PassIndex, uint32_t ResourceIndex, RenderGraphAccessType Type)
+    {
+        RenderGraphPass* Pass = &Graph->Passes[PassIndex];
+        Assert(!Graph->Compiled && Pass->AccessCount < VULKAN_RENDER_GRAPH_MAX_ACCESSES && ResourceIndex < Graph->ResourceCount);
+        for (uint32_t AccessIndex = 0; AccessIndex < Pass->AccessCount; ++AccessIndex)
+        {
+            Assert(Pass->Accesses[AccessIndex].Resource != ResourceIndex);
+        }
+        Pass->Accesses[Pass->AccessCount].Resource = ResourceIndex;
+        Pass->Accesses[Pass->AccessCount].Type = Type;
+        ++Pass->AccessCount;
+    }
+
+    internal RenderGraphAccess*
+    FindRenderGraphAccess(RenderGraphPass* Pass, uint32_t ResourceIndex)
+    {
+        for (uint32_t AccessIndex = 0; AccessIndex < Pass->AccessCount; ++AccessIndex)
+        {
+            if (Pass->Accesses[AccessIndex].Resource == ResourceIndex)
+            {
+                return(&Pass->Accesses[AccessIndex]);
+            }
+        }
+        return(nullptr);
+    }
+
+    // Note: True if pass After has to run after pass Before, see the ordering rules at the top.
+    internal bool32
+    RenderGraphPassDependsOn(RenderGraph* Graph, uint32_t After, uint32_t Before)
+    {
+        for (uint32_t AccessIndex = 0; AccessIndex < Graph->Passes[After].AccessCount; ++AccessIndex)
+        {
+            RenderGraphAccess* AfterAccess = &Graph->Passes[After].Accesses[AccessIndex];
+            RenderGraphAccess* BeforeAccess = FindRenderGraphAccess(&Graph->Passes[Before], AfterAccess->Resource);
+            if (!BeforeAccess)
+            {
+                continue;
+            }
+
+            bool32 AfterWrites = GetRenderGraphAccessInfo(AfterAccess->Type).Writes;
+            bool32 BeforeWrites = GetRenderGraphAccessInfo(BeforeAccess->Type).Writes;
+            if ((BeforeWrites && !AfterWrites) || (BeforeWrites && AfterWrites && Before < After))
+            {
+                return(true);
+            }
+        }
+        return(false);
+    }
+
+    internal uint32_t
+    FindRenderGraphMemoryType(DeviceMemoryAllocator* Allocator, uint32_t TypeBits)
+    {
+        for (uint32_t TypeIndex = 0; TypeIndex < Allocator->MemoryProperties.memoryTypeCount; ++TypeIndex)
+        {
+            if ((TypeBits & (1 << TypeIndex)) &&
+                (Allocator->MemoryProperties.memoryTypes[TypeIndex].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+            {
+                return(TypeIndex);
+            }
+        }
+        throw std::runtime_error("failed to find a device local memory type for a render graph image!");
+    }
+
+    // Note: Orders and culls the passes, then makes the transient images and their (shared) memory.
+    internal void
+    CompileRenderGraph(RenderGraph* Graph)
+    {
+        Assert(!Graph->Compiled);
+
+        // Note: Each time the first pass (in declaration order) that doesn't wait for any pass still left over.
+        bool32 Placed[VULKAN_RENDER_GRAPH_MAX_PASSES] = {};
+        Graph->OrderCount = 0;
+        while (Graph->OrderCount < Graph->PassCount)
+        {
+            uint32_t Next = VULKAN_RENDER_GRAPH_MAX_PASSES;
+            for (uint32_t PassIndex = 0; PassIndex < Graph->PassCount && Next == VULKAN_RENDER_GRAPH_MAX_PASSES; ++PassIndex)
+            {
+                if (Placed[PassIndex])
+                {
+                    continue;
+                }
+                bool32 Ready = true;
+                for (uint32_t OtherIndex = 0; OtherIndex < Graph->PassCount && Ready; ++OtherIndex)
+                {
+                    if (OtherIndex != PassIndex && !Placed[OtherIndex] && RenderGraphPassDependsOn(Graph, PassIndex, OtherIndex))
+                    {
+                        Ready = false;
+                    }
+                }
+                if (Ready)
+                {
+                    Next = PassIndex;
+                }
+            }
+            if (Next == VULKAN_RENDER_GRAPH_MAX_PASSES)
+            {
+                throw std::runtime_error("failed to order the render graph, its passes depend on each other!");
+            }
+            Placed[Next] = true;
+            Graph->Order[Graph->OrderCount++] = Next;
+        }
+
+        // Note: A pass is needed if it's NeverCull, or writes an imported image or something a needed pass reads. Going
+        // backwards over the order settles every pass before the ones it could be needed by.
+        bool32 Needed[VULKAN_RENDER_GRAPH_MAX_RESOURCES] = {};
+        for (uint32_t OrderIndex = Graph->OrderCount; OrderIndex-- > 0;)
+        {
+            RenderGraphPass* Pass = &Graph->Passes[Graph->Order[OrderIndex]];
+            bool32 Live = Pass->NeverCull;
+            for (uint32_t AccessIndex = 0; AccessIndex < Pass->AccessCount; ++AccessIndex)
+            {
+                RenderGraphAccess* Access = &Pass->Accesses[AccessIndex];
+                if (GetRenderGraphAccessInfo(Access->Type).Writes &&
+                    (!Graph->Resources[Access->Resource].Transient || Needed[Access->Resource]))
+                {
+                    Live = true;
+                }
+            }
+            Pass->Culled = !Live;
+            if (Live)
+            {
+                ++Graph->Stats.PassCount;
+                for (uint32_t AccessIndex = 0; AccessIndex < Pass->AccessCount; ++AccessIndex)
+                {
+                    RenderGraphAccess* Access = &Pass->Accesses[AccessIndex];
+                    if (!GetRenderGraphAccessInfo(Access->Type).Writes)
+                    {
+                        Needed[Access->Resource] = true;
+                    }
+                }
+            }
+            else
+            {
+                ++Graph->Stats.CulledPasses;
+            }
+        }
+
+        // Note: Lifetimes and usage of the transients, over the passes that are left.
+        for (uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ++ResourceIndex)
+        {
+            Graph->Resources[ResourceIndex].FirstUse = VULKAN_RENDER_GRAPH_MAX_PASSES;
+        }
+        for (uint32_t OrderIndex = 0; OrderIndex < Graph->OrderCount; ++OrderIndex)
+        {
+            RenderGraphPass* Pass = &Graph->Passes[Graph->Order[OrderIndex]];
+            for (uint32_t AccessIndex = 0; AccessIndex < Pass->AccessCount && !Pass->Culled; ++AccessIndex)
+            {
+                RenderGraphResource* Resource = &Graph->Resources[Pass->Accesses[AccessIndex].Resource];
+                if (Resource->FirstUse == VULKAN_RENDER_GRAPH_MAX_PASSES)
+                {
+                    Resource->FirstUse = OrderIndex;
+                }
+                Resource->LastUse = OrderIndex;
+                Resource->Usage |= GetRenderGraphAccessInfo(Pass->Accesses[AccessIndex].Type).Usage;
+            }
+        }
+
+        // Note: In order of first use, each transient goes into the first slot whose current owner is done by then
+        // and whose memory type suits it too, otherwise into a new slot.
+        for (uint32_t OrderIndex = 0; OrderIndex < Graph->OrderCount; ++OrderIndex)
+        {
+            for (uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ++ResourceIndex)
+            {
+                RenderGraphResource* Resource = &Graph->Resources[ResourceIndex];
+                if (!Resource->Transient || Resource->FirstUse != OrderIndex)
+                {
+                    continue;
+                }
+
+                VkImageCreateInfo ImageInfo = {};
+                ImageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                ImageInfo.imageType = VK_IMAGE_TYPE_2D;
+                ImageInfo.format = Resource->Format;
+                ImageInfo.extent = { Resource->Extent.width, Resource->Extent.height, 1 };
+                ImageInfo.mipLevels = 1;
+                ImageInfo.arrayLayers = 1;
+                ImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                ImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                ImageInfo.usage = Resource->Usage;
+                ImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                ImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                if (vkCreateImage(Graph->Device, &ImageInfo, nullptr, &Resource->Image) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create render graph image!");
+                }
+                vkGetImageMemoryRequirements(Graph->Device, Resource->Image, &Resource->Requirements);
+
+                uint32_t SlotIndex = 0;
+                for (; SlotIndex < Graph->SlotCount; ++SlotIndex)
+                {
+                    RenderGraphSlot* Slot = &Graph->Slots[SlotIndex];
+                    if (Slot->LastUse < Resource->FirstUse &&
+                        (Slot->Requirements.memoryTypeBits & Resource->Requirements.memoryTypeBits))
+                    {
+                        break;
+                    }
+                }
+                if (SlotIndex == Graph->SlotCount)
+                {
+                    RenderGraphSlot* Slot = &Graph->Slots[Graph->SlotCount++];
+                    Slot->Requirements = Resource->Requirements;
+                }
+
+                RenderGraphSlot* Slot = &Graph->Slots[SlotIndex];
+                if (Resource->Requirements.size > Slot->Requirements.size)
+                {
+                    Slot->Requirements.size = Resource->Requirements.size;
+                }
+                if (Resource->Requirements.alignment > Slot->Requirements.alignment)
+                {
+                    Slot->Requirements.alignment = Resource->Requirements.alignment;
+                }
+                Slot->Requirements.memoryTypeBits &= Resource->Requirements.memoryTypeBits;
+                Slot->LastUse = Resource->LastUse;
+                Resource->Slot = SlotIndex;
+
+                ++Graph->Stats.TransientCount;
+                Graph->Stats.TransientBytes += Resource->Requirements.size;
+            }
+        }
+
+        for (uint32_t SlotIndex = 0; SlotIndex < Graph->SlotCount; ++SlotIndex)
+        {
+            RenderGraphSlot* Slot = &Graph->Slots[SlotIndex];
+            uint32_t MemoryTypeIndex = FindRenderGraphMemoryType(Graph->Allocator, Slot->Requirements.memoryTypeBits);
+            AllocateDeviceMemory(Graph->Allocator, Slot->Requirements, MemoryTypeIndex, MemoryResourceKind_Optimal,
+                                 MemoryCategory_Image, &Slot->Memory);
+            Slot->Stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            Slot->Access = 0;
+            Graph->Stats.AllocatedBytes += Slot->Requirements.size;
+        }
+        Graph->Stats.SlotCount = Graph->SlotCount;
+
+        for (uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ++ResourceIndex)
+        {
+            RenderGraphResource* Resource = &Graph->Resources[ResourceIndex];
+            if (Resource->Transient && Resource->Slot != VULKAN_RENDER_GRAPH_NO_SLOT)
+            {
+                MemoryAllocation* Memory = &Graph->Slots[Resource->Slot].Memory;
+                vkBindImageMemory(Graph->Device, Resource->Image, Memory->Memory, Memory->Offset);
+            }
+        }
+
+        Graph->Compiled = true;
+    }
+
+    inline VkImage
+    GetRenderGraphImage(RenderGraph* Graph, uint32_t ResourceIndex)
+    {
+        return(Graph->Resources[ResourceIndex].Image);
+    }
+
+    // Note: Before anything of the frame is recorded. Every pass starts out enabled.
+    internal void
+    BeginRenderGraphFrame(RenderGraph* Graph)
+    {
+        Assert(Graph->Compiled);
+        for (uint32_t PassIndex = 0; PassIndex < Graph->PassCount; ++PassIndex)
+        {
+            Graph->Passes[PassIndex].Enabled = true;
+        }
+        for (uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ++ResourceIndex)
+        {
+            RenderGraphResource* Resource = &Graph->Resources[ResourceIndex];
+            Resource->Stage = Resource->InitialStage;
+            Resource->Access = 0;
+            Resource->Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            Resource->Used = false;
+        }
+    }
+
+    inline void
+    SetRenderGraphImage(RenderGraph* Graph, uint32_t ResourceIndex, VkImage Image)
+    {
+        Assert(!Graph->Resources[ResourceIndex].Transient);
+        Graph->Resources[ResourceIndex].Image = Image;
+    }
+
+    inline void
+    SetRenderGraphPassEnabled(RenderGraph* Graph, uint32_t PassIndex, bool32 Enabled)
+    {
+        Graph->Passes[PassIndex].Enabled = Enabled;
+    }
+
+    inline void
+    InitRenderGraphBarrier(VkImageMemoryBarrier* Barrier, VkImage Image, VkAccessFlags SourceAccess, VkImageLayout OldLayout,
+                           VkAccessFlags DestinationAccess, VkImageLayout NewLayout)
+    {
+        *Barrier = {};
+        Barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        Barrier->srcAccessMask = SourceAccess;
+        Barrier->dstAccessMask = DestinationAccess;
+        Barrier->oldLayout = OldLayout;
+        Barrier->newLayout = NewLayout;
+        Barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier->image = Image;
+        Barrier->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Barrier->subresourceRange.levelCount = 1;
+        Barrier->subresourceRange.layerCount = 1;
+    }
+
+    // Note: Records the enabled passes, each behind the barrier it needs, and leaves the imported images in their final layout.
+    internal void
+    ExecuteRenderGraph(RenderGraph* Graph, VkCommandBuffer CommandBuffer)
+    {
+        RenderGraphStats* Stats = &Graph->Stats;
+        uint32_t FrameBarriers = 0;
+        for (uint32_t OrderIndex = 0; OrderIndex < Graph->OrderCount; ++OrderIndex)
+        {
+            RenderGraphPass* Pass = &Graph->Passes[Graph->Order[OrderIndex]];
+            if (Pass->Culled || !Pass->Enabled)
+            {
+                continue;
+            }
+
+            VkImageMemoryBarrier Barriers[VULKAN_RENDER_GRAPH_MAX_ACCESSES];
+            uint32_t BarrierCount = 0;
+            VkPipelineStageFlags SourceStages = 0;
+            VkPipelineStageFlags DestinationStages = 0;
+            for (uint32_t AccessIndex = 0; AccessIndex < Pass->AccessCount; ++AccessIndex)
+            {
+                RenderGraphResource* Resource = &Graph->Resources[Pass->Accesses[AccessIndex].Resource];
+                RenderGraphAccessInfo Info = GetRenderGraphAccessInfo(Pass->Accesses[AccessIndex].Type);
+
+                // Note: A transient's first use of the frame starts from nothing, after whatever used its memory last.
+                RenderGraphSlot* Slot = Resource->Transient ? &Graph->Slots[Resource->Slot] : nullptr;
+                if (Slot && !Resource->Used)
+                {
+                    Resource->Stage = Slot->Stage;
+                    Resource->Access = Slot->Access;
+                }
+
+                bool32 LastWrote = (Resource->Access & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT)) != 0;
+                if (Resource->Used && !Info.Writes && !LastWrote && Resource->Layout == Info.Layout)
+                {
+                    ++Stats->SkippedBarriers;
+                    Resource->Stage |= Info.Stage;
+                    Resource->Access |= Info.Access;
+                }
+                else
+                {
+                    // Note: Only writes need making visible, after a read waiting for it to finish is enough.
+                    VkAccessFlags SourceAccess = LastWrote ? Resource->Access : 0;
+                    InitRenderGraphBarrier(&Barriers[BarrierCount++], Resource->Image, SourceAccess, Resource->Layout,
+                                           Info.Access, Info.Layout);
+                    SourceStages |= Resource->Stage;
+                    DestinationStages |= Info.Stage;
+                    Resource->Stage = Info.Stage;
+                    Resource->Access = Info.Access;
+                    Resource->Layout = Info.Layout;
+                }
+                Resource->Used = true;
+
+                if (Slot)
+                {
+                    Slot->Stage = Resource->Stage;
+                    Slot->Access = Resource->Access;
+                }
+            }
+
+            if (BarrierCount)
+            {
+                vkCmdPipelineBarrier(CommandBuffer, SourceStages, DestinationStages, 0, 0, nullptr, 0, nullptr, BarrierCount, Barriers);
+                ++Stats->BarrierCalls;
+                FrameBarriers += BarrierCount;
+            }
+            Pass->Callback(CommandBuffer, Pass->Data);
+        }
+
+        VkImageMemoryBarrier FinalBarriers[VULKAN_RENDER_GRAPH_MAX_RESOURCES];
+        uint32_t FinalCount = 0;
+        VkPipelineStageFlags SourceStages = 0;
+        for (uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ++ResourceIndex)
+        {
+            RenderGraphResource* Resource = &Graph->Resources[ResourceIndex];
+            if (!Resource->Transient && Resource->FinalLayout != VK_IMAGE_LAYOUT_UNDEFINED && Resource->Layout != Resource->FinalLayout)
+            {
+                bool32 LastWrote = (Resource->Access & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT)) != 0;
+                InitRenderGraphBarrier(&FinalBarriers[FinalCount++], Resource->Image, LastWrote ? Resource->Access : 0,
+                                       Resource->Layout, 0, Resource->FinalLayout);
+                SourceStages |= Resource->Stage;
+            }
+        }
+        if (FinalCount)
+        {
+            // Note: Whatever comes next (present, the next frame) waits on a semaphore or its own barrier.
+            vkCmdPipelineBarrier(CommandBuffer, SourceStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+                                 FinalCount, FinalBarriers);
+            ++Stats->BarrierCalls;
+            FrameBarriers += FinalCount;
+        }
+
+        ++Stats->Frames;
+        Stats->Barriers += FrameBarriers;
+        Stats->LastBarriers = FrameBarriers;
+    }
+
+    internal void
+    DestroyRenderGraph(RenderGraph* Graph)
+    {
+        for (uint32_t ResourceIndex = 0; ResourceIndex < Graph->ResourceCount; ++ResourceIndex)
+        {
+            RenderGraphResource* Resource = &Graph->Resources[ResourceIndex];
+            if (Resource->Transient && Resource->Image)
+            {
+                vkDestroyImage(Graph->Device, Resource->Image, nullptr);
+            }
+        }
+        for (uint32_t SlotIndex = 0; SlotIndex < Graph->SlotCount; ++SlotIndex)
+        {
+            FreeDeviceMemory(Graph->Allocator, &Graph->Slots[SlotIndex].Memory);
+        }
+        *Graph = {};
+    }
+
+    internal int
+    FormatRenderGraphStats(char* Text, int Size, RenderGraphStats* Stats)
+    {
+        uint64_t Frames = Stats->Frames ? Stats->Frames : 1;
+        float MB = 1024.0f * 1024.0f;
+        int Used = snprintf(Text, Size,
+            "render graph: %u passes (%u culled), %.1f image barriers in %.1f calls per frame (last frame %u), %.1f skipped; "
+            "%u transients in %u slots, %.2fMB instead of %.2fMB (%.2fMB saved by aliasing)\n",
+            Stats->PassCount, Stats->CulledPasses, (double)Stats->Barriers / (double)Frames, (double)Stats->BarrierCalls / (double)Frames,
+            Stats->LastBarriers, (double)Stats->SkippedBarriers / (double)Frames, Stats->TransientCount, Stats->SlotCount,
+            Stats->AllocatedBytes / MB, Stats->TransientBytes / MB, (Stats->TransientBytes - Stats->AllocatedBytes) / MB);
+        return(ClampReportLength(Used, Size));
+    }
+
+    internal void
+    OutputRenderGraphStats(RenderGraphStats* Stats)
+    {
+        char Text[512];
+        FormatRenderGraphStats(Text, sizeof(Text), Stats);
+        OutputDebugStringA(Text);
+    }
+}
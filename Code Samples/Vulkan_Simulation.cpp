@@ -0,0 +1,174 @@
+// Note: GPU entity simulation.
+// The simple per-entity systems (VelocitySystem, MoveSelfSystem) are a loop over packed columns with no dependencies
+// between rows, so they can just as well run as compute kernels at the start of the frame. The positions they move
+// are the GPU-culled sprites' own source instances (SpriteCuller::SourceInstances), so the cull pass that follows picks
+// the new positions straight up: nothing is read back or uploaded again per frame. The other columns (velocity,
+// destination) are storage buffers of their own, uploaded once with SetSimulatedSprites.
+// One step is: move to destination (adds Speed toward the destination to the velocity, unless within the row's
+// tolerance), then velocity (position += velocity * DeltaTime, and the velocity is used up, as in VelocitySystem).
+// SimulateSpriteStepCPU does the same on the CPU, to check the kernels against and to compare the time with.
+
+#define VULKAN_SIM_GROUP_SIZE               64  // Note: Has to match local_size_x in sprite_sim.comp.
+#define VULKAN_SIM_KERNEL_MOVE_TO_DESTINATION 0
+#define VULKAN_SIM_KERNEL_VELOCITY          1
+#define VULKAN_SIM_KERNEL_COUNT             2
+
+namespace Vulkan
+{
+    // Note: Mirrors the push constant block in sprite_sim.comp.
+    struct SimulationConstants
+    {
+        uint32_t Count;
+        float DeltaTime;
+        float Speed;
+    };
+
+    struct SimulationStats
+    {
+        uint64_t Steps;
+        uint64_t Rows;
+        uint32_t Readbacks;
+    };
+
+    struct SpriteSimulation
+    {
+        VkDescriptorSetLayout SetLayout;
+        VkPipelineLayout PipelineLayout;
+        VkPipeline Pipelines[VULKAN_SIM_KERNEL_COUNT];
+        VkDescriptorPool DescriptorPool;
+        VkDescriptorSet DescriptorSet;  // Note: One for every frame, the columns aren't per frame (see RecordSpriteSimulation).
+
+        VkBuffer Velocities;            // Note: Packed vec3 (12 bytes) per row.
+        MemoryAllocation VelocityMemory;
+        VkBuffer Destinations;          // Note: vec4 per row: xyz = where to, w = how close is close enough.
+        MemoryAllocation DestinationMemory;
+        VkBuffer Readback;              // Note: Host visible copy of the source instances, only for checking.
+        MemoryAllocation ReadbackMemory;
+
+        uint32_t Count;                 // Note: Rows with columns; 0 = nothing is simulated.
+        bool32 StepQueued;
+        SimulationConstants Step;
+
+        bool32 ReadbackQueued;
+        bool32 ReadbackRecorded;
+        uint32_t ReadbackFrameIndex;    // Note: The frame in flight whose fence says the readback is there.
+
+        SimulationStats Stats;
+    };
+
+    // Note: Both kernels on one row, the way sprite_sim.comp does them.
+    inline void
+    SimulateSpriteRowCPU(glm::vec3* Position, glm::vec3* Velocity, glm::vec4 Destination, float DeltaTime, float Speed)
+    {
+        glm::vec3 ToDestination = glm::vec3(Destination) - *Position;
+        float Distance = glm::length(ToDestination);
+        if (Distance > Destination.w)
+        {
+            *Velocity += ToDestination * (Speed / Distance);
+        }
+
+        *Position += *Velocity * DeltaTime;
+        *Velocity = glm::vec3(0.0f);
+    }
+
+    internal void
+    SimulateSpriteStepCPU(glm::vec3* Positions, glm::vec3* Velocities, glm::vec4* Destinations, uint32_t Count,
+                          float DeltaTime, float Speed)
+    {
+        for (uint32_t Row = 0; Row < Count; ++Row)
+        {
+            SimulateSpriteRowCPU(&Positions[Row], &Velocities[Row], Destinations[Row], DeltaTime, Speed);
+        }
+    }
+
+    // Note: For the rows of the culled sprites, in the same order. The caller has to make sure no frame in flight is
+    // still simulating the old contents.
+    internal void
+    UploadSimulationColumns(SpriteSimulation* Simulation, UploadContext* Upload, glm::vec3* Velocities, glm::vec4* Destinations,
+                            uint32_t Count)
+    {
+        if (Count > VULKAN_SPRITE_MAX_INSTANCES)
+        {
+            // Todo: Logging.
+            Count = VULKAN_SPRITE_MAX_INSTANCES;
+        }
+
+        if (Count)
+        {
+            UploadToBuffer(Upload, Simulation->Velocities, 0, Velocities, Count * sizeof(glm::vec3));
+            UploadToBuffer(Upload, Simulation->Destinations, 0, Destinations, Count * sizeof(glm::vec4));
+        }
+        Simulation->Count = Count;
+    }
+
+    // Note: Records the queued step, if there is one, ahead of the cull. Has to go outside the render pass.
+    // The source instances and columns are shared by all frames in flight, but on one queue: the barrier up front
+    // keeps this frame's writes behind the previous frame's cull reads, which is all the ordering they need.
+    internal void
+    RecordSpriteSimulation(SpriteSimulation* Simulation, VkCommandBuffer CommandBuffer, VkBuffer SourceInstances,
+                           uint32_t SourceCount, uint32_t FrameIndex)
+    {
+        uint32_t Count = (Simulation->Count < SourceCount) ? Simulation->Count : SourceCount;
+        if (!Simulation->StepQueued || !Count)
+        {
+            return;
+        }
+        Simulation->StepQueued = false;
+
+        VkMemoryBarrier Barrier = {};
+        Barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+        SimulationConstants Constants = Simulation->Step;
+        Constants.Count = Count;
+        vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Simulation->PipelineLayout, 0, 1,
+            &Simulation->DescriptorSet, 0, nullptr);
+        vkCmdPushConstants(CommandBuffer, Simulation->PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants), &Constants);
+
+        uint32_t GroupCount = (Count + VULKAN_SIM_GROUP_SIZE - 1) / VULKAN_SIM_GROUP_SIZE;
+        for (uint32_t Kernel = 0; Kernel < VULKAN_SIM_KERNEL_COUNT; ++Kernel)
+        {
+            vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Simulation->Pipelines[Kernel]);
+            vkCmdDispatch(CommandBuffer, GroupCount, 1, 1);
+            vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 1, &Barrier, 0, nullptr, 0, nullptr);
+        }
+
+        ++Simulation->Stats.Steps;
+        Simulation->Stats.Rows += Count;
+
+        if (Simulation->ReadbackQueued)
+        {
+            Simulation->ReadbackQueued = false;
+            Simulation->ReadbackRecorded = true;
+            Simulation->ReadbackFrameIndex = FrameIndex;
+
+            Barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 1, &Barrier, 0, nullptr, 0, nullptr);
+
+            VkBufferCopy CopyRegion = {};
+            CopyRegion.size = Count * sizeof(SpriteInstance);
+            vkCmdCopyBuffer(CommandBuffer, SourceInstances, Simulation->Readback, 1, &CopyRegion);
+
+            Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            Barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                0, 1, &Barrier, 0, nullptr, 0, nullptr);
+        }
+    }
+
+    internal void
+    OutputSimulationStats(SpriteSimulation* Simulation)
+    {
+        SimulationStats* Stats = &Simulation->Stats;
+        char Text[256];
+        snprintf(Text, sizeof(Text), "simulation: %llu steps, %llu rows, %u readbacks\n",
+                 Stats->Steps, Stats->Rows, Stats->Readbacks);
+        OutputDebugStringA(Text);
+    }
+}
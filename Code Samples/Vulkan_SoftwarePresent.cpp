@@ -0,0 +1,168 @@
+// Note: Presents the game's software back buffer through the swap chain, instead of GDI.
+// The platform hands its game_offscreen_buffer over with SubmitSoftwareFrame before DrawFrame. DrawFrame copies the
+// pixels into a persistently mapped staging ring right after its fence wait: one slot per frame in flight, so the slot
+// being written was last read by the frame that fence just covered and the CPU never waits on the GPU for it. More
+// slots wouldn't buy anything, the slot is free as soon as its frame's copy out of it is done; how many swap chain
+// images there are (triple buffering or not) doesn't come into it. On the GPU the slot is copied into a device local image and blitted, scaled, onto the
+// swap chain image: two render graph passes, the image is one of the graph's transients and the graph puts the
+// barriers. The render pass then loads that instead of clearing, so whatever is drawn with Vulkan goes on top.
+// The pixels are 32 bit BGRX, like a top-down DIB section. The image is BGRA with the swap chain's encoding (sRGB or
+// not), so the blit hands the values through unchanged. Buffers bigger than VULKAN_SOFTWARE_FRAME_MAX_* are cropped.
+// Swap chains that can't be a transfer destination, or devices that can't blit the formats, leave Supported false,
+// and the platform keeps presenting with GDI.
+
+#define VULKAN_SOFTWARE_FRAME_MAX_WIDTH     1920
+#define VULKAN_SOFTWARE_FRAME_MAX_HEIGHT    1080
+#define VULKAN_SOFTWARE_FRAME_BYTES_PER_PIXEL 4
+
+namespace Vulkan
+{
+    struct SoftwarePresentStats
+    {
+        uint64_t Frames;
+        uint64_t Bytes;             // Note: Copied into the staging ring, over all frames.
+        float TotalCopyMS;
+        uint32_t CroppedFrames;
+    };
+
+    struct SoftwarePresent
+    {
+        bool32 Supported;
+        VkFormat Format;
+
+        VkBuffer StagingBuffer;
+        MemoryAllocation StagingMemory;
+        uint8_t* Staging;           // Note: Mapped, SlotSize per frame in flight.
+        VkDeviceSize SlotSize;
+
+        // Note: Submitted for the next DrawFrame. The pixels have to stay valid until then.
+        game_offscreen_buffer Pending;
+        bool32 HasPending;
+
+        // Note: The frame being recorded.
+        bool32 Active;
+        uint32_t Width;
+        uint32_t Height;
+
+        SoftwarePresentStats Stats;
+    };
+
+    // Note: Both formats need the blit features; a transfer destination swap chain image is checked for separately.
+    internal bool32
+    CanBlitSoftwareFrame(VkPhysicalDevice PhysicalDevice, VkFormat SourceFormat, VkFormat TargetFormat)
+    {
+        VkFormatProperties Source;
+        vkGetPhysicalDeviceFormatProperties(PhysicalDevice, SourceFormat, &Source);
+        VkFormatProperties Target;
+        vkGetPhysicalDeviceFormatProperties(PhysicalDevice, TargetFormat, &Target);
+
+        VkFormatFeatureFlags SourceFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+        bool32 Result = ((Source.optimalTilingFeatures & SourceFeatures) == SourceFeatures) &&
+                        (Target.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+        return(Result);
+    }
+
+    // Note: Right after the fence wait for FrameIndex. Takes whatever was submitted, or turns the path off for this frame.
+    internal void
+    WriteSoftwareFrame(SoftwarePresent* Present, uint32_t FrameIndex)
+    {
+        Present->Active = false;
+        if (!Present->HasPending)
+        {
+            return;
+        }
+        Present->HasPending = false;
+
+        game_offscreen_buffer* Buffer = &Present->Pending;
+        if (!Present->Supported || !Buffer->Memory || Buffer->Width <= 0 || Buffer->Height <= 0 ||
+            Buffer->BytesPerPixel != VULKAN_SOFTWARE_FRAME_BYTES_PER_PIXEL)
+        {
+            return;
+        }
+
+        LARGE_INTEGER CopyCounter;
+        QueryPerformanceCounter(&CopyCounter);
+
+        uint32_t Width = (Buffer->Width < VULKAN_SOFTWARE_FRAME_MAX_WIDTH) ? (uint32_t)Buffer->Width : VULKAN_SOFTWARE_FRAME_MAX_WIDTH;
+        uint32_t Height = (Buffer->Height < VULKAN_SOFTWARE_FRAME_MAX_HEIGHT) ? (uint32_t)Buffer->Height : VULKAN_SOFTWARE_FRAME_MAX_HEIGHT;
+        uint32_t RowSize = Width * VULKAN_SOFTWARE_FRAME_BYTES_PER_PIXEL;
+
+        // Note: Rows go in tightly packed, the copy into the image says so with a row length of Width.
+        uint8_t* Destination = Present->Staging + FrameIndex * Present->SlotSize;
+        uint8_t* Source = (uint8_t*)Buffer->Memory;
+        if (RowSize == (uint32_t)Buffer->Pitch)
+        {
+            memcpy(Destination, Source, (size_t)RowSize * Height);
+        }
+        else
+        {
+            for (uint32_t Y = 0; Y < Height; ++Y)
+            {
+                memcpy(Destination, Source, RowSize);
+                Destination += RowSize;
+                Source += Buffer->Pitch;
+            }
+        }
+
+        Present->Active = true;
+        Present->Width = Width;
+        Present->Height = Height;
+
+        SoftwarePresentStats* Stats = &Present->Stats;
+        ++Stats->Frames;
+        Stats->Bytes += (uint64_t)RowSize * Height;
+        Stats->TotalCopyMS += MillisecondsSince(CopyCounter);
+        if (Width != (uint32_t)Buffer->Width || Height != (uint32_t)Buffer->Height)
+        {
+            ++Stats->CroppedFrames;
+        }
+    }
+
+    // Note: Image is VULKAN_SOFTWARE_FRAME_MAX_* big and in TRANSFER_DST_OPTIMAL, only Width x Height of it is written.
+    internal void
+    RecordSoftwareFrameCopy(SoftwarePresent* Present, VkCommandBuffer CommandBuffer, uint32_t FrameIndex, VkImage Image)
+    {
+        VkBufferImageCopy Copy = {};
+        Copy.bufferOffset = FrameIndex * Present->SlotSize;
+        Copy.bufferRowLength = Present->Width;
+        Copy.bufferImageHeight = Present->Height;
+        Copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Copy.imageSubresource.layerCount = 1;
+        Copy.imageExtent = { Present->Width, Present->Height, 1 };
+        vkCmdCopyBufferToImage(CommandBuffer, Present->StagingBuffer, Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Copy);
+    }
+
+    // Note: Source in TRANSFER_SRC_OPTIMAL, Target in TRANSFER_DST_OPTIMAL.
+    internal void
+    RecordSoftwareFrameBlit(SoftwarePresent* Present, VkCommandBuffer CommandBuffer, VkImage Source, VkImage Target, VkExtent2D TargetExtent)
+    {
+        // Todo: Aspect ratio correction, like the GDI path this just stretches to the window.
+        VkImageBlit Blit = {};
+        Blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Blit.srcSubresource.layerCount = 1;
+        Blit.srcOffsets[1] = { (int32_t)Present->Width, (int32_t)Present->Height, 1 };
+        Blit.dstSubresource = Blit.srcSubresource;
+        Blit.dstOffsets[1] = { (int32_t)TargetExtent.width, (int32_t)TargetExtent.height, 1 };
+        vkCmdBlitImage(CommandBuffer, Source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &Blit, VK_FILTER_NEAREST);
+    }
+
+    internal void
+    OutputSoftwarePresentStats(SoftwarePresent* Present)
+    {
+        SoftwarePresentStats* Stats = &Present->Stats;
+        char Text[256];
+        if (!Present->Supported)
+        {
+            snprintf(Text, sizeof(Text), "software present: not supported, presented with GDI\n");
+        }
+        else
+        {
+            uint64_t Frames = Stats->Frames ? Stats->Frames : 1;
+            snprintf(Text, sizeof(Text), "software present: %llu frames, %.2fMB and %.3fms of copying per frame, %u cropped\n",
+                     Stats->Frames, (double)Stats->Bytes / (1024.0 * 1024.0) / (double)Frames, Stats->TotalCopyMS / (double)Frames,
+                     Stats->CroppedFrames);
+        }
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,265 @@
+// Note: Instanced sprites.
+// Every sprite is the same quad (the test quad mesh in the geometry buffer), stretched and placed by one
+// SpriteInstance. Instances are written straight into a persistently mapped buffer (one per frame in flight),
+// in row order, and each instance carries the bindless ID of its texture (Vulkan_Bindless.cpp), so all of them
+// are one vkCmdDrawIndexed per slice no matter how many sheets and textures they use.
+// The game hands us its packed columns (position, size, sprite, tint), the same arrays the systems run over.
+// Each atlas is a sprite sheet in the texture atlas (Vulkan_Atlas.cpp); the UV rects are moved into the atlas as they're written.
+// The rows are split into slices that can be filled and recorded on different threads. Each slice culls its rows
+// against the camera first (Vulkan_FrustumCull.cpp) and writes only the visible ones, packed from the slice's first
+// row on, so a slice's instances never run into the next slice's. Slices start on a multiple of 8 rows, the cull
+// writes its visibility a byte per 8 rows. The result is the same however many slices there are.
+
+#define VULKAN_SPRITE_MAX_INSTANCES     (400 * 1024) // Note: About 17MB of instances, one host block per frame.
+#define VULKAN_SPRITE_MAX_ATLASES       64
+#define VULKAN_SPRITE_MAX_SLICES        VULKAN_MAX_JOB_THREADS
+#define VULKAN_SPRITE_CHUNK_SIZE        (64 * 1024) // Note: Of the GPU culled source instances, the unit of their dirty tracking.
+#define VULKAN_SPRITE_CHUNK_ROWS        ((uint32_t)(VULKAN_SPRITE_CHUNK_SIZE / sizeof(Vulkan::SpriteInstance)))
+#define VULKAN_SPRITE_MAX_CHUNKS        ((VULKAN_SPRITE_MAX_INSTANCES + VULKAN_SPRITE_CHUNK_ROWS - 1) / VULKAN_SPRITE_CHUNK_ROWS)
+
+namespace Vulkan
+{
+    struct SpriteInstance
+    {
+        glm::vec3 Position;
+        glm::vec2 Size;
+        glm::vec4 UVRect;   // Note: xy = min, zw = max, in the texture's UV space (the atlas for sheets).
+        uint32_t Tint;      // Note: RGBA8, read as unorm by the shader.
+        uint32_t Texture;   // Note: Bindless texture ID.
+    };
+
+    // Note: One entry per sprite in a sprite sheet. The game's sprite column indexes into this table.
+    // Texture 0 (VULKAN_BINDLESS_ATLAS_TEXTURE) means the sheet Atlas, anything else is a texture from RegisterTexture,
+    // with UVRect straight in that texture's UV space. Atlas still has to be a valid index, the GPU cull groups by it.
+    struct SpriteDefinition
+    {
+        uint32_t Atlas;
+        glm::vec4 UVRect;
+        uint32_t Texture;
+    };
+
+    // Note: The game's packed component arrays. Everything is indexed by the same entity row.
+    struct SpriteEntityColumns
+    {
+        uint32_t Count;
+        glm::vec3* Positions;
+        glm::vec2* Sizes;
+        uint32_t* Sprites;  // Note: Index into the SpriteDefinition table.
+        uint32_t* Tints;    // Note: Optional, white if null.
+
+        // Note: Optional, for the GPU culled path (UpdateCulledSprites). One version per VULKAN_SPRITE_CHUNK_ROWS rows,
+        // VULKAN_SPRITE_MAX_CHUNKS of them; the game bumps a chunk's version whenever it writes any column in its rows
+        // (MarkSpriteRowsWritten). Chunks whose version didn't change aren't uploaded again. Null means always changed.
+        uint32_t* ChunkVersions;
+    };
+
+    // Note: Rows First up to End.
+    inline void
+    MarkSpriteRowsWritten(SpriteEntityColumns* Columns, uint32_t First, uint32_t End)
+    {
+        if (Columns->ChunkVersions && First < End)
+        {
+            for (uint32_t Chunk = First / VULKAN_SPRITE_CHUNK_ROWS; Chunk <= (End - 1) / VULKAN_SPRITE_CHUNK_ROWS; ++Chunk)
+            {
+                ++Columns->ChunkVersions[Chunk];
+            }
+        }
+    }
+
+    struct SpriteFrame
+    {
+        VkBuffer InstanceBuffer;
+        MemoryAllocation InstanceMemory;
+        SpriteInstance* Instances;  // Note: Mapped, write-only from the CPU's side.
+    };
+
+    // Note: One contiguous range of rows, drawn with one instanced draw.
+    struct SpriteSlice
+    {
+        uint32_t RowBegin;
+        uint32_t RowEnd;
+        uint64_t Sheets;    // Note: Bit per atlas the slice's visible rows use, for the atlas residency.
+        uint32_t VisibleCount;
+    };
+
+    struct SpriteRenderer
+    {
+        VkPipeline Pipeline;
+        SpriteFrame Frames[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+        SpriteSlice Slices[VULKAN_SPRITE_MAX_SLICES];
+        uint32_t SliceCount;
+        uint32_t InstanceCount;
+
+        FrustumPlanes Frustum;  // Note: This frame's camera, set before the slices are culled.
+        bool32 UseAVX2;
+        uint8_t VisibleMasks[VULKAN_SPRITE_MAX_INSTANCES / VULKAN_CULL_ROWS_PER_MASK]; // Note: Bit per row.
+        FrustumCullStats CullStats;
+    };
+
+    // Note: Binding 1, locations 2..6; 0 and 1 are the quad's own vertex attributes.
+    constexpr VertexField SpriteInstanceFields[] =
+    {
+        VERTEX_FIELD(SpriteInstance, Position),
+        VERTEX_FIELD(SpriteInstance, Size),
+        VERTEX_FIELD(SpriteInstance, UVRect),
+        VERTEX_FIELD_AS(SpriteInstance, Tint, VK_FORMAT_R8G8B8A8_UNORM),
+        VERTEX_FIELD(SpriteInstance, Texture),
+    };
+    constexpr VertexLayout<5> SpriteInstanceLayout = MakeVertexLayout<SpriteInstance>(SpriteInstanceFields, 1, 2, VK_VERTEX_INPUT_RATE_INSTANCE);
+
+    // Note: Splits the rows into SliceCount ranges, each starting on a multiple of 8. Returns the number of rows that
+    // will be culled.
+    internal uint32_t
+    BeginSpriteSlices(SpriteRenderer* Renderer, SpriteEntityColumns* Columns, uint32_t SliceCount)
+    {
+        uint32_t Count = Columns->Count;
+        if (Count > VULKAN_SPRITE_MAX_INSTANCES)
+        {
+            // Todo: Logging. Sprites past the end just don't draw this frame.
+            Count = VULKAN_SPRITE_MAX_INSTANCES;
+        }
+
+        Assert(SliceCount >= 1 && SliceCount <= VULKAN_SPRITE_MAX_SLICES);
+        Renderer->SliceCount = SliceCount;
+        for (uint32_t SliceIndex = 0; SliceIndex < SliceCount; ++SliceIndex)
+        {
+            SpriteSlice* Slice = &Renderer->Slices[SliceIndex];
+            Slice->RowBegin = (uint32_t)(((uint64_t)Count * SliceIndex) / SliceCount) & ~(VULKAN_CULL_ROWS_PER_MASK - 1);
+            Slice->RowEnd = (uint32_t)(((uint64_t)Count * (SliceIndex + 1)) / SliceCount) & ~(VULKAN_CULL_ROWS_PER_MASK - 1);
+            if (SliceIndex == SliceCount - 1)
+            {
+                Slice->RowEnd = Count;
+            }
+            Slice->Sheets = 0;
+            Slice->VisibleCount = 0;
+        }
+
+        Renderer->InstanceCount = Count;
+        return(Count);
+    }
+
+    // Note: Culls the slice's rows, then gathers which atlases the visible ones use. A visible row whose sheet Atlas is out
+    // of range is culled too, WriteSpriteSlice never sees it. Only touches the slice's own bytes
+    // of VisibleMasks, so it's safe to run for different slices at the same time, and it has to be done for all of them
+    // before any instance is written (see UpdateAtlasResidency).
+    internal void
+    CullSpriteSlice(SpriteRenderer* Renderer, SpriteSlice* Slice, SpriteEntityColumns* Columns, SpriteDefinition* Definitions)
+    {
+        if (Renderer->UseAVX2)
+        {
+            Slice->VisibleCount = CullSpheresAVX2(&Renderer->Frustum, Columns->Positions, Columns->Sizes, Slice->RowBegin, Slice->RowEnd,
+                                                  Renderer->VisibleMasks);
+        }
+        else
+        {
+            Slice->VisibleCount = CullSpheresScalar(&Renderer->Frustum, Columns->Positions, Columns->Sizes, Slice->RowBegin, Slice->RowEnd,
+                                                    Renderer->VisibleMasks);
+        }
+
+        uint64_t Sheets = 0;
+        for (uint32_t GroupRow = Slice->RowBegin; GroupRow < Slice->RowEnd; GroupRow += VULKAN_CULL_ROWS_PER_MASK)
+        {
+            uint32_t Mask = Renderer->VisibleMasks[GroupRow / VULKAN_CULL_ROWS_PER_MASK];
+            while (Mask)
+            {
+                unsigned long Bit;
+                _BitScanForward(&Bit, Mask);
+                Mask &= Mask - 1;
+
+                SpriteDefinition* Definition = &Definitions[Columns->Sprites[GroupRow + Bit]];
+                if (Definition->Texture == VULKAN_BINDLESS_ATLAS_TEXTURE)
+                {
+                    if (Definition->Atlas >= VULKAN_SPRITE_MAX_ATLASES)
+                    {
+                        // Todo: Logging.
+                        Renderer->VisibleMasks[GroupRow / VULKAN_CULL_ROWS_PER_MASK] &= (uint8_t)~(1u << Bit);
+                        --Slice->VisibleCount;
+                        continue;
+                    }
+                    Sheets |= 1ull << Definition->Atlas;
+                }
+            }
+        }
+        Slice->Sheets = Sheets;
+    }
+
+    // Note: After every slice is culled.
+    internal void
+    AddSpriteCullFrame(SpriteRenderer* Renderer)
+    {
+        uint32_t Visible = 0;
+        for (uint32_t SliceIndex = 0; SliceIndex < Renderer->SliceCount; ++SliceIndex)
+        {
+            Visible += Renderer->Slices[SliceIndex].VisibleCount;
+        }
+        AddFrustumCullFrame(&Renderer->CullStats, Visible, Renderer->InstanceCount - Visible);
+    }
+
+    // Note: Sheet space UV rect to atlas space. Transform is the sheet's UV scale (xy) and offset (zw);
+    // the offset's x carries the atlas page as its integer part.
+    inline glm::vec4
+    ApplySheetTransform(glm::vec4 UVRect, glm::vec4 Transform)
+    {
+        glm::vec4 Result = glm::vec4(UVRect.x * Transform.x + Transform.z, UVRect.y * Transform.y + Transform.w,
+                                     UVRect.z * Transform.x + Transform.z, UVRect.w * Transform.y + Transform.w);
+        return(Result);
+    }
+
+    // Note: The one pass over the visible rows, written packed from RowBegin on. Slices write disjoint ranges, so this
+    // can run in parallel too.
+    // SheetTransforms has one entry per atlas, for this frame's residency. Other textures' UV rects go in as they are.
+    internal void
+    WriteSpriteSlice(SpriteRenderer* Renderer, SpriteSlice* Slice, uint32_t FrameIndex, SpriteEntityColumns* Columns, SpriteDefinition* Definitions,
+                     glm::vec4* SheetTransforms)
+    {
+        SpriteInstance* Instance = &Renderer->Frames[FrameIndex].Instances[Slice->RowBegin];
+        for (uint32_t GroupRow = Slice->RowBegin; GroupRow < Slice->RowEnd; GroupRow += VULKAN_CULL_ROWS_PER_MASK)
+        {
+            uint32_t Mask = Renderer->VisibleMasks[GroupRow / VULKAN_CULL_ROWS_PER_MASK];
+            while (Mask)
+            {
+                unsigned long Bit;
+                _BitScanForward(&Bit, Mask);
+                Mask &= Mask - 1;
+
+                uint32_t Row = GroupRow + Bit;
+                SpriteDefinition* Definition = &Definitions[Columns->Sprites[Row]];
+
+                Instance->Position = Columns->Positions[Row];
+                Instance->Size = Columns->Sizes[Row];
+                Instance->UVRect = Definition->UVRect;
+                if (Definition->Texture == VULKAN_BINDLESS_ATLAS_TEXTURE)
+                {
+                    Assert(Definition->Atlas < VULKAN_SPRITE_MAX_ATLASES);  // Note: CullSpriteSlice dropped the others.
+                    Instance->UVRect = ApplySheetTransform(Definition->UVRect, SheetTransforms[Definition->Atlas]);
+                }
+                Instance->Tint = Columns->Tints ? Columns->Tints[Row] : 0xFFFFFFFF;
+                Instance->Texture = Definition->Texture;
+                ++Instance;
+            }
+        }
+    }
+
+    // Note: Set 0 is the main set, set 1 the bindless one the textures come from. The geometry buffers have to be bound
+    // already (BindGeometryBuffers), only the instances are bound here.
+    internal void
+    RecordSpriteDraws(SpriteRenderer* Renderer, SpriteSlice* Slice, VkCommandBuffer CommandBuffer, uint32_t FrameIndex, VkPipelineLayout PipelineLayout,
+                      VkDescriptorSet* DescriptorSets, uint32_t* DynamicOffsets, GeometryRange* Quad)
+    {
+        uint32_t InstanceCount = Slice->VisibleCount;
+        if (!InstanceCount)
+        {
+            return;
+        }
+
+        vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Renderer->Pipeline);
+        vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, 2, DescriptorSets, VULKAN_DYNAMIC_OFFSET_COUNT, DynamicOffsets);
+
+        VkDeviceSize Offset = 0;
+        vkCmdBindVertexBuffers(CommandBuffer, 1, 1, &Renderer->Frames[FrameIndex].InstanceBuffer, &Offset);
+
+        // Note: Every texture is in the bindless set, so the slice's sprites only differ in their instances.
+        vkCmdDrawIndexed(CommandBuffer, Quad->IndexCount, InstanceCount, Quad->FirstIndex, Quad->VertexOffset, Slice->RowBegin);
+    }
+}
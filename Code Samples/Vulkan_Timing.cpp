@@ -0,0 +1,269 @@
+// Note: GPU timestamps.
+// Every frame in flight has its own small query pool, written at the start and end of its command buffer and around
+// the render pass. The results are read right after DrawFrame has waited on that frame's fence, a frame or two
+// after they were written, so by then they're always there and reading them never stalls. Upload batches carry
+// their own timestamps (see Vulkan_Upload.cpp), since they aren't tied to a frame and may run on another queue;
+// their time is added to the frame in which they were seen to finish.
+// The CPU side of frame pacing is kept here too: how long DrawFrame waits on the frame fence, how long the acquire
+// takes and how long it is from acquire to the present returning, so frames in flight and present modes can be
+// compared on real numbers.
+
+#define VULKAN_TIMESTAMP_FRAME_BEGIN        0
+#define VULKAN_TIMESTAMP_SIMULATION_END     1   // Note: Also where the sprite cull begins.
+#define VULKAN_TIMESTAMP_RENDER_PASS_BEGIN  2   // Note: Also where the sprite cull ends.
+#define VULKAN_TIMESTAMP_RENDER_PASS_END    3
+#define VULKAN_TIMESTAMP_FRAME_END          4
+#define VULKAN_TIMESTAMP_COUNT              5
+
+namespace Vulkan
+{
+    // Note: One frame's worth of GPU timing, what the platform gets back.
+    struct FrameGPUTiming
+    {
+        uint64_t FrameNumber;
+        float FrameMS;          // Note: First to last command of the frame's command buffer.
+        float SimulationMS;
+        float CullMS;
+        float RenderPassMS;
+        float UploadMS;         // Note: Upload batches that finished since the previous frame's timing.
+        float FenceWaitMS;      // Note: CPU time DrawFrame spent waiting on this frame's fence before reusing it.
+    };
+
+    struct FrameTimestamps
+    {
+        VkQueryPool Pool;
+        uint64_t FrameNumber;
+        bool32 Written;         // Note: Recorded and submitted, not read yet.
+    };
+
+    struct GPUTimer
+    {
+        VkDevice Device;
+        float TimestampPeriod;  // Note: Nanoseconds per tick.
+        uint64_t TimestampMask;
+        FrameTimestamps Frames[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+        FrameGPUTiming Latest;
+        bool32 LatestIsNew;
+
+        // Note: Running totals for OutputGPUTimerStats.
+        uint32_t FrameCount;
+        double TotalFrameMS;
+        double TotalSimulationMS;
+        double TotalRenderPassMS;
+        double TotalUploadMS;
+        double TotalFenceWaitMS;
+    };
+
+    struct FramePacingStats
+    {
+        uint32_t FrameCount;
+        double TotalFenceWaitMS;
+        float MaxFenceWaitMS;
+        double TotalAcquireMS;          // Note: Inside vkAcquireNextImageKHR.
+        double TotalAcquireToPresentMS; // Note: From calling acquire to vkQueuePresentKHR returning.
+        float MaxAcquireToPresentMS;
+        double TotalIntervalMS;         // Note: Present to present.
+        float MaxIntervalMS;
+        int64_t LastPresentCounter;
+    };
+
+    // Note: Ticks only have ValidBits meaningful bits, so the difference is taken modulo that.
+    inline float
+    TimestampDeltaMS(uint64_t Begin, uint64_t End, uint64_t Mask, float Period)
+    {
+        uint64_t Ticks = (End - Begin) & Mask;
+        return((float)((double)Ticks * (double)Period / 1000000.0));
+    }
+
+    inline uint64_t
+    GetTimestampMask(uint32_t ValidBits)
+    {
+        uint64_t Result = (ValidBits >= 64) ? ~0ull : ((1ull << ValidBits) - 1);
+        return(Result);
+    }
+
+    // Note: ValidBits of 0 means the graphics queue can't write timestamps; the timer then stays off.
+    internal void
+    InitGPUTimer(GPUTimer* Timer, VkDevice Device, uint32_t FramesInFlight, uint32_t ValidBits, float TimestampPeriod)
+    {
+        *Timer = {};
+        Timer->Device = Device;
+        Timer->TimestampPeriod = TimestampPeriod;
+        Timer->TimestampMask = GetTimestampMask(ValidBits);
+        if (!ValidBits)
+        {
+            return;
+        }
+
+        VkQueryPoolCreateInfo PoolInfo = {};
+        PoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        PoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        PoolInfo.queryCount = VULKAN_TIMESTAMP_COUNT;
+
+        for (uint32_t FrameIndex = 0; FrameIndex < FramesInFlight; ++FrameIndex)
+        {
+            if (vkCreateQueryPool(Device, &PoolInfo, nullptr, &Timer->Frames[FrameIndex].Pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+        }
+    }
+
+    internal void
+    DestroyGPUTimer(GPUTimer* Timer)
+    {
+        for (uint32_t FrameIndex = 0; FrameIndex < VULKAN_MAX_FRAMES_IN_FLIGHT; ++FrameIndex)
+        {
+            vkDestroyQueryPool(Timer->Device, Timer->Frames[FrameIndex].Pool, nullptr);
+            Timer->Frames[FrameIndex].Pool = VK_NULL_HANDLE;
+        }
+    }
+
+    // Note: First thing in the frame's primary command buffer, outside any render pass.
+    internal void
+    BeginFrameTimestamps(GPUTimer* Timer, VkCommandBuffer CommandBuffer, uint32_t FrameIndex, uint64_t FrameNumber)
+    {
+        FrameTimestamps* Frame = &Timer->Frames[FrameIndex];
+        if (!Frame->Pool)
+        {
+            return;
+        }
+
+        vkCmdResetQueryPool(CommandBuffer, Frame->Pool, 0, VULKAN_TIMESTAMP_COUNT);
+        vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, Frame->Pool, VULKAN_TIMESTAMP_FRAME_BEGIN);
+        Frame->FrameNumber = FrameNumber;
+        Frame->Written = true;
+    }
+
+    // Note: Written once everything recorded before it has finished.
+    inline void
+    WriteFrameTimestamp(GPUTimer* Timer, VkCommandBuffer CommandBuffer, uint32_t FrameIndex, uint32_t Query)
+    {
+        FrameTimestamps* Frame = &Timer->Frames[FrameIndex];
+        if (Frame->Pool)
+        {
+            vkCmdWriteTimestamp(CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, Frame->Pool, Query);
+        }
+    }
+
+    // Note: Call right after the frame's fence has been waited on, before its command buffer is recorded again.
+    internal void
+    ResolveFrameTimestamps(GPUTimer* Timer, uint32_t FrameIndex, float FenceWaitMS, float UploadMS)
+    {
+        FrameTimestamps* Frame = &Timer->Frames[FrameIndex];
+        if (!Frame->Pool || !Frame->Written)
+        {
+            return;
+        }
+        Frame->Written = false;
+
+        // Note: No WAIT_BIT. The fence has signaled, so NOT_READY would mean the frame never got submitted.
+        uint64_t Ticks[VULKAN_TIMESTAMP_COUNT];
+        VkResult Result = vkGetQueryPoolResults(Timer->Device, Frame->Pool, 0, VULKAN_TIMESTAMP_COUNT, sizeof(Ticks), Ticks,
+                                                sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (Result != VK_SUCCESS)
+        {
+            return;
+        }
+
+        FrameGPUTiming* Timing = &Timer->Latest;
+        Timing->FrameNumber = Frame->FrameNumber;
+        Timing->FrameMS = TimestampDeltaMS(Ticks[VULKAN_TIMESTAMP_FRAME_BEGIN], Ticks[VULKAN_TIMESTAMP_FRAME_END], Timer->TimestampMask, Timer->TimestampPeriod);
+        Timing->SimulationMS = TimestampDeltaMS(Ticks[VULKAN_TIMESTAMP_FRAME_BEGIN], Ticks[VULKAN_TIMESTAMP_SIMULATION_END], Timer->TimestampMask, Timer->TimestampPeriod);
+        Timing->CullMS = TimestampDeltaMS(Ticks[VULKAN_TIMESTAMP_SIMULATION_END], Ticks[VULKAN_TIMESTAMP_RENDER_PASS_BEGIN], Timer->TimestampMask, Timer->TimestampPeriod);
+        Timing->RenderPassMS = TimestampDeltaMS(Ticks[VULKAN_TIMESTAMP_RENDER_PASS_BEGIN], Ticks[VULKAN_TIMESTAMP_RENDER_PASS_END], Timer->TimestampMask, Timer->TimestampPeriod);
+        Timing->UploadMS = UploadMS;
+        Timing->FenceWaitMS = FenceWaitMS;
+        Timer->LatestIsNew = true;
+
+        ++Timer->FrameCount;
+        Timer->TotalFrameMS += Timing->FrameMS;
+        Timer->TotalSimulationMS += Timing->SimulationMS;
+        Timer->TotalRenderPassMS += Timing->RenderPassMS;
+        Timer->TotalUploadMS += Timing->UploadMS;
+        Timer->TotalFenceWaitMS += Timing->FenceWaitMS;
+    }
+
+    // Note: Counters are QueryPerformanceCounter values. Without a present (headless) they're all 0 and only the fence wait counts.
+    internal void
+    AddFramePacing(FramePacingStats* Stats, float FenceWaitMS, int64_t AcquireCounter, int64_t AcquireDoneCounter, int64_t PresentCounter)
+    {
+        ++Stats->FrameCount;
+        Stats->TotalFenceWaitMS += FenceWaitMS;
+        Stats->MaxFenceWaitMS = (FenceWaitMS > Stats->MaxFenceWaitMS) ? FenceWaitMS : Stats->MaxFenceWaitMS;
+        if (!PresentCounter)
+        {
+            return;
+        }
+
+        LARGE_INTEGER Frequency;
+        QueryPerformanceFrequency(&Frequency);
+        double MSPerCount = 1000.0 / (double)Frequency.QuadPart;
+
+        float AcquireToPresentMS = (float)((double)(PresentCounter - AcquireCounter) * MSPerCount);
+        Stats->TotalAcquireMS += (double)(AcquireDoneCounter - AcquireCounter) * MSPerCount;
+        Stats->TotalAcquireToPresentMS += AcquireToPresentMS;
+        Stats->MaxAcquireToPresentMS = (AcquireToPresentMS > Stats->MaxAcquireToPresentMS) ? AcquireToPresentMS : Stats->MaxAcquireToPresentMS;
+
+        if (Stats->LastPresentCounter)
+        {
+            float IntervalMS = (float)((double)(PresentCounter - Stats->LastPresentCounter) * MSPerCount);
+            Stats->TotalIntervalMS += IntervalMS;
+            Stats->MaxIntervalMS = (IntervalMS > Stats->MaxIntervalMS) ? IntervalMS : Stats->MaxIntervalMS;
+        }
+        Stats->LastPresentCounter = PresentCounter;
+    }
+
+    inline const char*
+    GetPresentModeName(VkPresentModeKHR Mode)
+    {
+        switch (Mode)
+        {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR: return("IMMEDIATE");
+            case VK_PRESENT_MODE_MAILBOX_KHR: return("MAILBOX");
+            case VK_PRESENT_MODE_FIFO_KHR: return("FIFO");
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return("FIFO_RELAXED");
+            default: return("other");
+        }
+    }
+
+    internal int
+    FormatFramePacingStats(char* Text, size_t Size, FramePacingStats* Stats, uint32_t FramesInFlight, VkPresentModeKHR Mode)
+    {
+        double Count = Stats->FrameCount ? (double)Stats->FrameCount : 1.0;
+        double Intervals = (Stats->FrameCount > 1) ? (double)(Stats->FrameCount - 1) : 1.0;
+        int Used = snprintf(Text, Size,
+            "%s, %u frames in flight, %u frames: fence wait %.3fms avg/%.3fms max, acquire %.3fms avg, "
+            "acquire to present %.3fms avg/%.3fms max, present interval %.3fms avg/%.3fms max\n",
+            GetPresentModeName(Mode), FramesInFlight, Stats->FrameCount,
+            Stats->TotalFenceWaitMS / Count, Stats->MaxFenceWaitMS, Stats->TotalAcquireMS / Count,
+            Stats->TotalAcquireToPresentMS / Count, Stats->MaxAcquireToPresentMS,
+            Stats->TotalIntervalMS / Intervals, Stats->MaxIntervalMS);
+        return(ClampReportLength(Used, Size));
+    }
+
+    internal void
+    OutputFramePacingStats(FramePacingStats* Stats, uint32_t FramesInFlight, VkPresentModeKHR Mode)
+    {
+        char Text[512];
+        FormatFramePacingStats(Text, sizeof(Text), Stats, FramesInFlight, Mode);
+        OutputDebugStringA(Text);
+    }
+
+    internal void
+    OutputGPUTimerStats(GPUTimer* Timer)
+    {
+        if (!Timer->FrameCount)
+        {
+            return;
+        }
+
+        double Count = (double)Timer->FrameCount;
+        char Text[256];
+        snprintf(Text, sizeof(Text),
+            "GPU timing over %u frames (avg): frame %.3fms, simulation %.3fms, render pass %.3fms, uploads %.3fms; CPU fence wait %.3fms\n",
+            Timer->FrameCount, Timer->TotalFrameMS / Count, Timer->TotalSimulationMS / Count, Timer->TotalRenderPassMS / Count,
+            Timer->TotalUploadMS / Count, Timer->TotalFenceWaitMS / Count);
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,471 @@
+// Note: Batched uploads.
+// Uploads get copied into a persistent, mapped staging ring and recorded into one command buffer per batch.
+// FlushUploads submits the batch (on the dedicated transfer queue if the device has one) and signals a timeline
+// semaphore. The renderer waits on that value on the GPU, so the CPU never has to sit in vkQueueWaitIdle.
+// Ring space is given back once the batch that used it has signaled. The only CPU wait left is when the ring or
+// the batch slots are completely used up.
+// When the upload queue can write timestamps, each batch is bracketed by two, read back when the batch retires.
+// A transfer-only queue can write timestamps but can't reset queries, so the two are reset from the host
+// (vkResetQueryPool, hostQueryReset) before the batch is recorded. Without hostQueryReset uploads aren't timed.
+
+#define VULKAN_UPLOAD_RING_SIZE     (16 * 1024 * 1024)
+#define VULKAN_UPLOAD_MAX_BATCHES   16
+#define VULKAN_UPLOAD_ALIGNMENT     16
+
+namespace Vulkan
+{
+    struct UploadBatch
+    {
+        VkCommandBuffer CommandBuffer;
+        uint64_t TimelineValue;     // Note: Value the batch signals when done. 0 = slot is free.
+        uint64_t RingHead;          // Note: Ring head after this batch. The tail moves here once it's done.
+        VkDeviceSize Bytes;
+        uint32_t CopyCount;
+        int64_t SubmitCounter;
+        bool32 Timed;               // Note: Has a pair of timestamps (queries 2 * slot and 2 * slot + 1).
+    };
+
+    struct UploadStats
+    {
+        uint64_t TotalBytes;        // Note: Completed uploads only.
+        uint32_t BatchCount;
+        uint32_t CopyCount;
+        uint32_t RingStalls;        // Note: Times we had to wait on the CPU for ring space or a batch slot.
+        float MBPerSecond;          // Note: Completed bytes / wall-clock time with uploads in flight.
+        float GPUMS;                // Note: Completed batches, first to last timestamp.
+    };
+
+    struct UploadContext
+    {
+        VkDevice Device;
+        VkQueue Queue;
+        uint32_t QueueFamily;
+        bool32 DedicatedQueue;
+        VkCommandPool CommandPool;
+        VkSemaphore Timeline;
+        uint64_t LastSubmittedValue;
+        uint64_t CompletedValue;
+
+        VkBuffer RingBuffer;
+        uint8_t* RingMapped;
+        VkDeviceSize RingSize;
+        uint64_t RingHead;          // Note: Head and tail only ever grow; the ring offset is Head % RingSize.
+        uint64_t RingTail;
+
+        UploadBatch Batches[VULKAN_UPLOAD_MAX_BATCHES];
+        uint32_t CurrentBatch;
+        bool32 Recording;
+
+        VkQueryPool TimestampPool;  // Note: Null if the upload queue has no timestamps.
+        uint64_t TimestampMask;
+        float TimestampPeriod;
+        float RetiredGPUMS;         // Note: GPU time of the batches retired since TakeRetiredUploadMS.
+
+        UploadStats Stats;
+        double CompletedSeconds;    // Note: Union of the batches' submit to completion spans, overlaps counted once.
+        int64_t CompletedUntilCounter;
+    };
+
+    internal void
+    InitUploadContext(UploadContext* Upload, VkDevice Device, VkQueue Queue, uint32_t QueueFamily, bool32 DedicatedQueue,
+                      VkBuffer RingBuffer, void* RingMapped, VkDeviceSize RingSize, uint32_t TimestampValidBits, float TimestampPeriod,
+                      bool32 HostQueryReset)
+    {
+        *Upload = {};
+        Upload->Device = Device;
+        Upload->Queue = Queue;
+        Upload->QueueFamily = QueueFamily;
+        Upload->DedicatedQueue = DedicatedQueue;
+        Upload->RingBuffer = RingBuffer;
+        Upload->RingMapped = (uint8_t*)RingMapped;
+        Upload->RingSize = RingSize;
+
+        VkCommandPoolCreateInfo PoolInfo = {};
+        PoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        PoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        PoolInfo.queueFamilyIndex = QueueFamily;
+
+        if (vkCreateCommandPool(Device, &PoolInfo, nullptr, &Upload->CommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload command pool!");
+        }
+
+        VkCommandBuffer CommandBuffers[VULKAN_UPLOAD_MAX_BATCHES];
+        VkCommandBufferAllocateInfo AllocInfo = {};
+        AllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        AllocInfo.commandPool = Upload->CommandPool;
+        AllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        AllocInfo.commandBufferCount = VULKAN_UPLOAD_MAX_BATCHES;
+
+        if (vkAllocateCommandBuffers(Device, &AllocInfo, CommandBuffers) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffers!");
+        }
+        for (uint32_t BatchIndex = 0; BatchIndex < VULKAN_UPLOAD_MAX_BATCHES; ++BatchIndex)
+        {
+            Upload->Batches[BatchIndex].CommandBuffer = CommandBuffers[BatchIndex];
+        }
+
+        VkSemaphoreTypeCreateInfo TypeInfo = {};
+        TypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        TypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        TypeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo SemaphoreInfo = {};
+        SemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        SemaphoreInfo.pNext = &TypeInfo;
+
+        if (vkCreateSemaphore(Device, &SemaphoreInfo, nullptr, &Upload->Timeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload timeline semaphore!");
+        }
+
+        Upload->TimestampMask = GetTimestampMask(TimestampValidBits);
+        Upload->TimestampPeriod = TimestampPeriod;
+        if (TimestampValidBits && HostQueryReset)
+        {
+            VkQueryPoolCreateInfo QueryPoolInfo = {};
+            QueryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            QueryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            QueryPoolInfo.queryCount = 2 * VULKAN_UPLOAD_MAX_BATCHES;
+
+            if (vkCreateQueryPool(Device, &QueryPoolInfo, nullptr, &Upload->TimestampPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create upload timestamp query pool!");
+            }
+        }
+    }
+
+    internal void
+    DestroyUploadContext(UploadContext* Upload)
+    {
+        vkDestroyQueryPool(Upload->Device, Upload->TimestampPool, nullptr);
+        vkDestroySemaphore(Upload->Device, Upload->Timeline, nullptr);
+        vkDestroyCommandPool(Upload->Device, Upload->CommandPool, nullptr); // Note: Frees the batch command buffers.
+    }
+
+    // Note: Non-blocking. Gives back ring space and batch slots of everything the GPU has finished.
+    internal void
+    RetireUploads(UploadContext* Upload)
+    {
+        vkGetSemaphoreCounterValue(Upload->Device, Upload->Timeline, &Upload->CompletedValue);
+
+        LARGE_INTEGER Now;
+        QueryPerformanceCounter(&Now);
+        LARGE_INTEGER Frequency;
+        QueryPerformanceFrequency(&Frequency);
+
+        bool32 Retired = false;
+        int64_t EarliestSubmitCounter = Now.QuadPart;
+        for (uint32_t BatchIndex = 0; BatchIndex < VULKAN_UPLOAD_MAX_BATCHES; ++BatchIndex)
+        {
+            UploadBatch* Batch = &Upload->Batches[BatchIndex];
+            if (Batch->TimelineValue && Batch->TimelineValue <= Upload->CompletedValue)
+            {
+                if (Batch->RingHead > Upload->RingTail)
+                {
+                    Upload->RingTail = Batch->RingHead;
+                }
+
+                Upload->Stats.TotalBytes += Batch->Bytes;
+                if (Batch->SubmitCounter < EarliestSubmitCounter)
+                {
+                    EarliestSubmitCounter = Batch->SubmitCounter;
+                }
+                Retired = true;
+
+                if (Batch->Timed)
+                {
+                    // Note: The timeline value covers the whole submit, so the results are there; no need to wait.
+                    uint64_t Ticks[2];
+                    if (vkGetQueryPoolResults(Upload->Device, Upload->TimestampPool, 2 * BatchIndex, 2, sizeof(Ticks), Ticks,
+                                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+                    {
+                        float BatchMS = TimestampDeltaMS(Ticks[0], Ticks[1], Upload->TimestampMask, Upload->TimestampPeriod);
+                        Upload->Stats.GPUMS += BatchMS;
+                        Upload->RetiredGPUMS += BatchMS;
+                    }
+                    Batch->Timed = false;
+                }
+
+                Batch->TimelineValue = 0;
+            }
+        }
+
+        // Note: Everything retired here completed by Now, so together they cover EarliestSubmitCounter to Now.
+        // Whatever of that was already counted up to the last retire isn't counted again, so batches that overlap
+        // on the queue add their wall-clock time once. Only as precise as how often we get polled (about once a frame).
+        if (Retired)
+        {
+            int64_t StartCounter = (EarliestSubmitCounter > Upload->CompletedUntilCounter) ? EarliestSubmitCounter : Upload->CompletedUntilCounter;
+            if (Now.QuadPart > StartCounter)
+            {
+                Upload->CompletedSeconds += (double)(Now.QuadPart - StartCounter) / (double)Frequency.QuadPart;
+            }
+            Upload->CompletedUntilCounter = Now.QuadPart;
+
+            if (Upload->CompletedSeconds > 0.0)
+            {
+                Upload->Stats.MBPerSecond = (float)((double)Upload->Stats.TotalBytes / (1024.0 * 1024.0) / Upload->CompletedSeconds);
+            }
+        }
+    }
+
+    // Note: Blocks until the given value has signaled. Only used when we've run out of room, and at load/shutdown.
+    internal void
+    WaitForUploads(UploadContext* Upload, uint64_t Value)
+    {
+        if (Value > Upload->CompletedValue)
+        {
+            VkSemaphoreWaitInfo WaitInfo = {};
+            WaitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            WaitInfo.semaphoreCount = 1;
+            WaitInfo.pSemaphores = &Upload->Timeline;
+            WaitInfo.pValues = &Value;
+            vkWaitSemaphores(Upload->Device, &WaitInfo, UINT64_MAX);
+        }
+        RetireUploads(Upload);
+    }
+
+    // Note: Submits the batch that is being recorded. Returns the timeline value that signals when it's done
+    // (or the last submitted value if there was nothing to submit).
+    internal uint64_t
+    FlushUploads(UploadContext* Upload)
+    {
+        if (!Upload->Recording)
+        {
+            return(Upload->LastSubmittedValue);
+        }
+
+        UploadBatch* Batch = &Upload->Batches[Upload->CurrentBatch];
+        if (Batch->Timed)
+        {
+            vkCmdWriteTimestamp(Batch->CommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, Upload->TimestampPool, 2 * Upload->CurrentBatch + 1);
+        }
+        if (vkEndCommandBuffer(Batch->CommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record upload command buffer!");
+        }
+
+        uint64_t SignalValue = Upload->LastSubmittedValue + 1;
+
+        VkTimelineSemaphoreSubmitInfo TimelineInfo = {};
+        TimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        TimelineInfo.signalSemaphoreValueCount = 1;
+        TimelineInfo.pSignalSemaphoreValues = &SignalValue;
+
+        VkSubmitInfo SubmitInfo = {};
+        SubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        SubmitInfo.pNext = &TimelineInfo;
+        SubmitInfo.commandBufferCount = 1;
+        SubmitInfo.pCommandBuffers = &Batch->CommandBuffer;
+        SubmitInfo.signalSemaphoreCount = 1;
+        SubmitInfo.pSignalSemaphores = &Upload->Timeline;
+
+        if (vkQueueSubmit(Upload->Queue, 1, &SubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload batch!");
+        }
+
+        LARGE_INTEGER SubmitCounter;
+        QueryPerformanceCounter(&SubmitCounter);
+
+        Batch->TimelineValue = SignalValue;
+        Batch->RingHead = Upload->RingHead;
+        Batch->SubmitCounter = SubmitCounter.QuadPart;
+        Upload->LastSubmittedValue = SignalValue;
+        Upload->Recording = false;
+        Upload->CurrentBatch = (Upload->CurrentBatch + 1) % VULKAN_UPLOAD_MAX_BATCHES;
+
+        ++Upload->Stats.BatchCount;
+        return(SignalValue);
+    }
+
+    internal VkCommandBuffer
+    BeginUploadBatch(UploadContext* Upload)
+    {
+        UploadBatch* Batch = &Upload->Batches[Upload->CurrentBatch];
+        if (!Upload->Recording)
+        {
+            if (Batch->TimelineValue)
+            {
+                // Note: Every batch slot is still in flight.
+                ++Upload->Stats.RingStalls;
+                WaitForUploads(Upload, Batch->TimelineValue);
+            }
+
+            vkResetCommandBuffer(Batch->CommandBuffer, 0);
+
+            // Note: The slot's last batch has retired (and its timestamps were read), so its queries are free.
+            if (Upload->TimestampPool)
+            {
+                vkResetQueryPool(Upload->Device, Upload->TimestampPool, 2 * Upload->CurrentBatch, 2);
+            }
+
+            VkCommandBufferBeginInfo BeginInfo = {};
+            BeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            BeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            if (vkBeginCommandBuffer(Batch->CommandBuffer, &BeginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("failed to begin upload command buffer!");
+            }
+
+            if (Upload->TimestampPool)
+            {
+                vkCmdWriteTimestamp(Batch->CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, Upload->TimestampPool, 2 * Upload->CurrentBatch);
+            }
+
+            Batch->Bytes = 0;
+            Batch->CopyCount = 0;
+            Batch->Timed = (Upload->TimestampPool != VK_NULL_HANDLE);
+            Upload->Recording = true;
+        }
+        return(Batch->CommandBuffer);
+    }
+
+    // Note: Reserves Size bytes in the staging ring. Returns the ring offset.
+    internal VkDeviceSize
+    ReserveUploadSpace(UploadContext* Upload, VkDeviceSize Size)
+    {
+        Assert(Size <= Upload->RingSize);
+
+        for (;;)
+        {
+            uint64_t Head = (Upload->RingHead + (VULKAN_UPLOAD_ALIGNMENT - 1)) & ~(uint64_t)(VULKAN_UPLOAD_ALIGNMENT - 1);
+            VkDeviceSize Offset = Head % Upload->RingSize;
+            if (Offset + Size > Upload->RingSize)
+            {
+                // Note: Doesn't fit before the end, skip to the start of the ring.
+                Head += Upload->RingSize - Offset;
+                Offset = 0;
+            }
+
+            if (Head + Size - Upload->RingTail <= Upload->RingSize)
+            {
+                Upload->RingHead = Head + Size;
+                return(Offset);
+            }
+
+            // Note: Out of ring space. Give back what we can, and if that isn't enough, wait on the oldest batch.
+            RetireUploads(Upload);
+            if (Head + Size - Upload->RingTail > Upload->RingSize)
+            {
+                ++Upload->Stats.RingStalls;
+                if (Upload->Recording)
+                {
+                    // Note: The current batch might be the one holding the space.
+                    FlushUploads(Upload);
+                }
+
+                uint64_t OldestValue = 0;
+                for (uint32_t BatchIndex = 0; BatchIndex < VULKAN_UPLOAD_MAX_BATCHES; ++BatchIndex)
+                {
+                    uint64_t Value = Upload->Batches[BatchIndex].TimelineValue;
+                    if (Value && (!OldestValue || Value < OldestValue))
+                    {
+                        OldestValue = Value;
+                    }
+                }
+                if (!OldestValue)
+                {
+                    throw std::runtime_error("upload ring is full with nothing in flight!");
+                }
+                WaitForUploads(Upload, OldestValue);
+            }
+        }
+    }
+
+    // Note: Copies Data into the staging ring and records the copy into the current batch. Nothing reaches
+    // the GPU until FlushUploads. Big uploads are split so one copy never needs more than half the ring.
+    internal void
+    UploadToBuffer(UploadContext* Upload, VkBuffer DstBuffer, VkDeviceSize DstOffset, const void* Data, VkDeviceSize Size)
+    {
+        VkDeviceSize MaxChunk = Upload->RingSize / 2;
+        const uint8_t* Source = (const uint8_t*)Data;
+
+        while (Size > 0)
+        {
+            VkDeviceSize ChunkSize = (Size < MaxChunk) ? Size : MaxChunk;
+            VkDeviceSize RingOffset = ReserveUploadSpace(Upload, ChunkSize);
+            memcpy(Upload->RingMapped + RingOffset, Source, (size_t)ChunkSize);
+
+            // Note: Reserve first, it may flush the current batch.
+            VkCommandBuffer CommandBuffer = BeginUploadBatch(Upload);
+
+            VkBufferCopy CopyRegion = {};
+            CopyRegion.srcOffset = RingOffset;
+            CopyRegion.dstOffset = DstOffset;
+            CopyRegion.size = ChunkSize;
+            vkCmdCopyBuffer(CommandBuffer, Upload->RingBuffer, DstBuffer, 1, &CopyRegion);
+
+            UploadBatch* Batch = &Upload->Batches[Upload->CurrentBatch];
+            Batch->Bytes += ChunkSize;
+            ++Batch->CopyCount;
+            ++Upload->Stats.CopyCount;
+
+            Source += ChunkSize;
+            DstOffset += ChunkSize;
+            Size -= ChunkSize;
+        }
+    }
+
+    // Note: RGBA8 pixels, tightly packed, into one layer of an image that is in GENERAL layout (the atlas).
+    // Split by rows the same way UploadToBuffer splits by bytes.
+    internal void
+    UploadToImage(UploadContext* Upload, VkImage DstImage, uint32_t Layer, uint32_t X, uint32_t Y,
+                  uint32_t Width, uint32_t Height, const uint32_t* Pixels)
+    {
+        VkDeviceSize RowSize = (VkDeviceSize)Width * 4;
+        uint32_t MaxRows = (uint32_t)((Upload->RingSize / 2) / RowSize);
+        Assert(MaxRows > 0);
+
+        while (Height > 0)
+        {
+            uint32_t ChunkRows = (Height < MaxRows) ? Height : MaxRows;
+            VkDeviceSize ChunkSize = RowSize * ChunkRows;
+            VkDeviceSize RingOffset = ReserveUploadSpace(Upload, ChunkSize);
+            memcpy(Upload->RingMapped + RingOffset, Pixels, (size_t)ChunkSize);
+
+            VkCommandBuffer CommandBuffer = BeginUploadBatch(Upload);
+
+            VkBufferImageCopy Region = {};
+            Region.bufferOffset = RingOffset;
+            Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            Region.imageSubresource.baseArrayLayer = Layer;
+            Region.imageSubresource.layerCount = 1;
+            Region.imageOffset = { (int32_t)X, (int32_t)Y, 0 };
+            Region.imageExtent = { Width, ChunkRows, 1 };
+            vkCmdCopyBufferToImage(CommandBuffer, Upload->RingBuffer, DstImage, VK_IMAGE_LAYOUT_GENERAL, 1, &Region);
+
+            UploadBatch* Batch = &Upload->Batches[Upload->CurrentBatch];
+            Batch->Bytes += ChunkSize;
+            ++Batch->CopyCount;
+            ++Upload->Stats.CopyCount;
+
+            Pixels += (size_t)Width * ChunkRows;
+            Y += ChunkRows;
+            Height -= ChunkRows;
+        }
+    }
+
+    // Note: True if the renderer has to wait on Timeline before using uploaded data.
+    inline bool32
+    UploadsPending(UploadContext* Upload)
+    {
+        return(Upload->LastSubmittedValue > Upload->CompletedValue);
+    }
+
+    // Note: GPU time of the batches that retired since the last call.
+    inline float
+    TakeRetiredUploadMS(UploadContext* Upload)
+    {
+        float Result = Upload->RetiredGPUMS;
+        Upload->RetiredGPUMS = 0.0f;
+        return(Result);
+    }
+
+    internal void
+    OutputUploadStats(UploadContext* Upload)
+    {
+        char Text[256];
+        snprintf(Text, sizeof(Text),
+            "Uploads: %.2fMB in %u batches, %u copies, %u ring stalls, %.1fMB/s, %.2fms on the GPU (%s queue)\n",
+            Upload->Stats.TotalBytes / (1024.0f * 1024.0f), Upload->Stats.BatchCount, Upload->Stats.CopyCount,
+            Upload->Stats.RingStalls, Upload->Stats.MBPerSecond, Upload->Stats.GPUMS, Upload->DedicatedQueue ? "transfer" : "graphics");
+        OutputDebugStringA(Text);
+    }
+}
@@ -0,0 +1,182 @@
+// Note: Vertex input layouts from the vertex structs themselves.
+// A layout is a list of VERTEX_FIELD(Struct, Member), in shader location order. Each field's VkFormat comes from its C++
+// type (VertexFormatOf) and its offset from offsetof, so a struct and its attribute table can't drift apart.
+// MakeVertexLayout turns the list into the binding and attribute descriptions, at compile time.
+// Besides the plain float and uint types there are compact encodings that the shaders still read as floats:
+// - Half2 / Half4: 16 bit floats (R16G16[B16A16]_SFLOAT), for positions and UVs that don't need 23 bits of mantissa.
+// - Unorm8x4: 0..1 in 8 bits a channel (R8G8B8A8_UNORM), for colors.
+// - Snorm16x4: -1..1 in 16 bits a component (R16G16B16A16_SNORM), for normals and tangents. xyz + w, three component
+//   16 bit formats aren't required for vertex buffers.
+// All of these are required vertex buffer formats, so no device needs checking. A shader input with fewer components
+// than the format is fine (the rest are dropped), so a vec3 color can come from a Unorm8x4.
+// A member whose type doesn't say how it's read (e.g. a packed uint32_t color) uses VERTEX_FIELD_AS with the format.
+
+namespace Vulkan
+{
+    struct Half2
+    {
+        uint16_t X, Y;
+    };
+
+    struct Half4
+    {
+        uint16_t X, Y, Z, W;
+    };
+
+    struct Unorm8x4
+    {
+        uint8_t R, G, B, A;
+    };
+
+    struct Snorm16x4
+    {
+        int16_t X, Y, Z, W;
+    };
+
+    template <typename FieldType> struct VertexFormatOf;
+    template <> struct VertexFormatOf<float>        { static constexpr VkFormat Format = VK_FORMAT_R32_SFLOAT; };
+    template <> struct VertexFormatOf<glm::vec2>    { static constexpr VkFormat Format = VK_FORMAT_R32G32_SFLOAT; };
+    template <> struct VertexFormatOf<glm::vec3>    { static constexpr VkFormat Format = VK_FORMAT_R32G32B32_SFLOAT; };
+    template <> struct VertexFormatOf<glm::vec4>    { static constexpr VkFormat Format = VK_FORMAT_R32G32B32A32_SFLOAT; };
+    template <> struct VertexFormatOf<uint32_t>     { static constexpr VkFormat Format = VK_FORMAT_R32_UINT; };
+    template <> struct VertexFormatOf<Half2>        { static constexpr VkFormat Format = VK_FORMAT_R16G16_SFLOAT; };
+    template <> struct VertexFormatOf<Half4>        { static constexpr VkFormat Format = VK_FORMAT_R16G16B16A16_SFLOAT; };
+    template <> struct VertexFormatOf<Unorm8x4>     { static constexpr VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM; };
+    template <> struct VertexFormatOf<Snorm16x4>    { static constexpr VkFormat Format = VK_FORMAT_R16G16B16A16_SNORM; };
+
+    // Note: Bytes per vertex of the formats above, 0 for any other.
+    constexpr uint32_t
+    GetVertexFormatSize(VkFormat Format)
+    {
+        return((Format == VK_FORMAT_R32_SFLOAT || Format == VK_FORMAT_R32_UINT ||
+                Format == VK_FORMAT_R16G16_SFLOAT || Format == VK_FORMAT_R8G8B8A8_UNORM) ? 4 :
+               (Format == VK_FORMAT_R32G32_SFLOAT || Format == VK_FORMAT_R16G16B16A16_SFLOAT ||
+                Format == VK_FORMAT_R16G16B16A16_SNORM) ? 8 :
+               (Format == VK_FORMAT_R32G32B32_SFLOAT) ? 12 :
+               (Format == VK_FORMAT_R32G32B32A32_SFLOAT) ? 16 : 0);
+    }
+
+    struct VertexField
+    {
+        VkFormat Format;
+        uint32_t Offset;
+    };
+
+    template <uint32_t Count>
+    struct VertexLayout
+    {
+        static constexpr uint32_t AttributeCount = Count;
+        VkVertexInputBindingDescription Binding;
+        VkVertexInputAttributeDescription Attributes[Count];
+    };
+
+    // Note: Field i goes to location FirstLocation + i.
+    template <typename VertexType, uint32_t AttributeCount>
+    constexpr VertexLayout<AttributeCount>
+    MakeVertexLayout(const VertexField (&Fields)[AttributeCount], uint32_t Binding, uint32_t FirstLocation,
+                     VkVertexInputRate InputRate = VK_VERTEX_INPUT_RATE_VERTEX)
+    {
+        VertexLayout<AttributeCount> Result = {};
+        Result.Binding.binding = Binding;
+        Result.Binding.stride = sizeof(VertexType);
+        Result.Binding.inputRate = InputRate;
+        for (uint32_t FieldIndex = 0; FieldIndex < AttributeCount; ++FieldIndex)
+        {
+            Result.Attributes[FieldIndex].location = FirstLocation + FieldIndex;
+            Result.Attributes[FieldIndex].binding = Binding;
+            Result.Attributes[FieldIndex].format = Fields[FieldIndex].Format;
+            Result.Attributes[FieldIndex].offset = Fields[FieldIndex].Offset;
+        }
+        return(Result);
+    }
+
+    // Note: Float to IEEE half, rounded to nearest even. Too big turns into infinity, too small into (signed) zero.
+    inline uint16_t
+    HalfFromFloat(float Value)
+    {
+        uint32_t Bits;
+        memcpy(&Bits, &Value, sizeof(Bits));
+
+        uint32_t Sign = (Bits >> 16) & 0x8000;
+        uint32_t Exponent = (Bits >> 23) & 0xFF;
+        uint32_t Mantissa = Bits & 0x7FFFFF;
+
+        uint16_t Result;
+        if (Exponent == 0xFF)
+        {
+            Result = (uint16_t)(Sign | 0x7C00 | (Mantissa ? 0x200 : 0)); // Note: NaN stays NaN.
+        }
+        else if (Exponent > 142) // Note: 2^16 and up.
+        {
+            Result = (uint16_t)(Sign | 0x7C00);
+        }
+        else if (Exponent < 102) // Note: Under half of the smallest half subnormal.
+        {
+            Result = (uint16_t)Sign;
+        }
+        else
+        {
+            uint32_t Shift = 13;
+            uint32_t HalfExponent = 0;
+            if (Exponent < 113)
+            {
+                // Note: Subnormal half, the implicit 1 becomes explicit.
+                Mantissa |= 0x800000;
+                Shift = 126 - Exponent;
+            }
+            else
+            {
+                HalfExponent = Exponent - 112;
+            }
+
+            uint32_t Half = (HalfExponent << 10) + (Mantissa >> Shift);
+            uint32_t Remainder = Mantissa & ((1u << Shift) - 1);
+            uint32_t Halfway = 1u << (Shift - 1);
+            if (Remainder > Halfway || (Remainder == Halfway && (Half & 1)))
+            {
+                ++Half; // Note: A carry out of the mantissa rightly bumps the exponent (up to infinity).
+            }
+            Result = (uint16_t)(Sign | Half);
+        }
+        return(Result);
+    }
+
+    inline Half2
+    PackHalf2(glm::vec2 Value)
+    {
+        Half2 Result = { HalfFromFloat(Value.x), HalfFromFloat(Value.y) };
+        return(Result);
+    }
+
+    inline Half4
+    PackHalf4(glm::vec4 Value)
+    {
+        Half4 Result = { HalfFromFloat(Value.x), HalfFromFloat(Value.y), HalfFromFloat(Value.z), HalfFromFloat(Value.w) };
+        return(Result);
+    }
+
+    inline Unorm8x4
+    PackUnorm8x4(glm::vec4 Value)
+    {
+        glm::vec4 Scaled = glm::clamp(Value, 0.0f, 1.0f) * 255.0f + 0.5f;
+        Unorm8x4 Result = { (uint8_t)Scaled.x, (uint8_t)Scaled.y, (uint8_t)Scaled.z, (uint8_t)Scaled.w };
+        return(Result);
+    }
+
+    // Note: For normals, W is usually the tangent's handedness or just 0.
+    inline Snorm16x4
+    PackSnorm16x4(glm::vec4 Value)
+    {
+        glm::vec4 Scaled = glm::round(glm::clamp(Value, -1.0f, 1.0f) * 32767.0f);
+        Snorm16x4 Result = { (int16_t)Scaled.x, (int16_t)Scaled.y, (int16_t)Scaled.z, (int16_t)Scaled.w };
+        return(Result);
+    }
+}
+
+#define VERTEX_FIELD(Type, Member) \
+    Vulkan::VertexField{ Vulkan::VertexFormatOf<decltype(Type::Member)>::Format, (uint32_t)offsetof(Type, Member) }
+
+// Note: Has to be as big as the member, checked at compile time.
+#define VERTEX_FIELD_AS(Type, Member, FieldFormat) \
+    Vulkan::VertexField{ (Vulkan::GetVertexFormatSize(FieldFormat) == sizeof(Type::Member)) ? (FieldFormat) : \
+        throw "VERTEX_FIELD_AS: format doesn't match the member's size", (uint32_t)offsetof(Type, Member) }
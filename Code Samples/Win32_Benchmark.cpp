@@ -0,0 +1,304 @@
+// Note: Sprite throughput benchmark ("-spritebench").
+// Fills a set of columns with random sprites and ramps the count up while the frame still fits in the budget.
+// The frame limiter is skipped for the run, so frame time is the real cost of filling and drawing the sprites
+// (plus the wait on vsync, which is why the budget has a little slack).
+// With "-gpucull" the sprites go through the GPU culling path instead: UpdateCulledSprites every frame, but the rows
+// never change, so only the chunks added when the count steps up get uploaded and the CPU side of a frame stays the
+// same no matter how many there are.
+
+#define SPRITE_BENCH_BUDGET_MS          (1000.0f / 60.0f)
+#define SPRITE_BENCH_SLACK_MS           1.0f
+#define SPRITE_BENCH_FRAMES_PER_STEP    120
+#define SPRITE_BENCH_MAX_SLOW_FRAMES    6   // Note: 5% of a step, so one hitch doesn't end the run.
+#define SPRITE_BENCH_START_COUNT        1024
+#define SPRITE_BENCH_DEFINITIONS        16
+#define SPRITE_BENCH_ATLASES            4
+#define SPRITE_BENCH_SHEET_SIZE         512 // Note: 4x4 sprites of 128x128 per sheet.
+
+struct win32_sprite_benchmark
+{
+    bool32 Enabled;
+    bool32 Done;
+    bool32 GPUCull;
+
+    uint32 Capacity;
+    Vulkan::SpriteEntityColumns Columns;
+    uint32 ChunkVersions[VULKAN_SPRITE_MAX_CHUNKS];
+    Vulkan::SpriteDefinition Definitions[SPRITE_BENCH_DEFINITIONS];
+    uint32* SheetPixels;    // Note: SPRITE_BENCH_ATLASES sheets, one after the other.
+
+    uint32 FramesThisStep;
+    uint32 SlowFramesThisStep;
+    real32 TotalMSThisStep;
+    uint32 GPUFramesThisStep;
+    real32 TotalGPUMSThisStep;
+    real32 TotalFenceWaitMSThisStep;
+
+    uint32 MaxSustainedCount;
+    real32 MaxSustainedAverageMS;
+    real32 MaxSustainedGPUMS;       // Note: Average GPU frame time at MaxSustainedCount (0 without timestamps).
+    real32 MaxSustainedFenceWaitMS;
+};
+
+inline uint32
+Win32BenchRandom(uint32* State)
+{
+    // Note: xorshift32, good enough to scatter sprites.
+    uint32 X = *State;
+    X ^= X << 13;
+    X ^= X >> 17;
+    X ^= X << 5;
+    *State = X;
+    return(X);
+}
+
+inline real32
+Win32BenchRandomUnilateral(uint32* State)
+{
+    real32 Result = (real32)(Win32BenchRandom(State) >> 8) / (real32)(1 << 24);
+    return(Result);
+}
+
+internal void
+Win32SpriteBenchmarkInit(win32_sprite_benchmark* Bench, bool32 Enabled, bool32 GPUCull, uint32 Capacity)
+{
+    *Bench = {};
+    Bench->Enabled = Enabled;
+    Bench->GPUCull = GPUCull;
+    if (!Enabled)
+    {
+        return;
+    }
+
+    Bench->Capacity = Capacity;
+    size_t RowSize = sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(uint32) + sizeof(uint32);
+    uint8* Memory = (uint8*)VirtualAlloc(0, RowSize * Capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!Memory)
+    {
+        Bench->Enabled = false;
+        return;
+    }
+
+    Bench->Columns.Positions = (glm::vec3*)Memory;
+    Bench->Columns.Sizes = (glm::vec2*)(Bench->Columns.Positions + Capacity);
+    Bench->Columns.Sprites = (uint32*)(Bench->Columns.Sizes + Capacity);
+    Bench->Columns.Tints = Bench->Columns.Sprites + Capacity;
+    Bench->Columns.ChunkVersions = Bench->ChunkVersions;
+    Bench->Columns.Count = SPRITE_BENCH_START_COUNT;
+
+    for (uint32 DefinitionIndex = 0; DefinitionIndex < SPRITE_BENCH_DEFINITIONS; ++DefinitionIndex)
+    {
+        // Note: 4x4 cells per atlas page, spread over a few atlases so sprites from different sheets share the draws.
+        uint32 Cell = DefinitionIndex % 4;
+        Vulkan::SpriteDefinition* Definition = &Bench->Definitions[DefinitionIndex];
+        Definition->Atlas = DefinitionIndex % SPRITE_BENCH_ATLASES;
+        Definition->UVRect = glm::vec4(0.25f * Cell, 0.0f, 0.25f * (Cell + 1), 0.25f);
+        Definition->Texture = VULKAN_BINDLESS_ATLAS_TEXTURE;
+    }
+
+    // Note: Generated sheets: every 128x128 sprite is a flat color with a dark border, a different color per sheet.
+    uint32 SheetTexels = SPRITE_BENCH_SHEET_SIZE * SPRITE_BENCH_SHEET_SIZE;
+    Bench->SheetPixels = (uint32*)VirtualAlloc(0, SheetTexels * SPRITE_BENCH_ATLASES * sizeof(uint32), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (Bench->SheetPixels)
+    {
+        for (uint32 Sheet = 0; Sheet < SPRITE_BENCH_ATLASES; ++Sheet)
+        {
+            uint32* Pixels = Bench->SheetPixels + Sheet * SheetTexels;
+            for (uint32 Y = 0; Y < SPRITE_BENCH_SHEET_SIZE; ++Y)
+            {
+                for (uint32 X = 0; X < SPRITE_BENCH_SHEET_SIZE; ++X)
+                {
+                    uint32 CellX = X % 128;
+                    uint32 CellY = Y % 128;
+                    bool32 Border = (CellX < 4 || CellY < 4 || CellX >= 124 || CellY >= 124);
+                    uint32 Shade = 0x40 + 0x60 * (((X / 128) + (Y / 128)) % 2);
+                    uint32 Color = (Sheet == 0) ? Shade : (Sheet == 1) ? (Shade << 8) : (Sheet == 2) ? (Shade << 16) : (Shade | (Shade << 8));
+                    *Pixels++ = 0xFF000000 | (Border ? 0x00101010 : Color);
+                }
+            }
+        }
+    }
+
+    uint32 RandomState = 0x12345678;
+    for (uint32 Row = 0; Row < Capacity; ++Row)
+    {
+        Bench->Columns.Positions[Row] = glm::vec3(2.0f * Win32BenchRandomUnilateral(&RandomState) - 1.0f,
+                                                  2.0f * Win32BenchRandomUnilateral(&RandomState) - 1.0f,
+                                                  0.0f);
+        Bench->Columns.Sizes[Row] = glm::vec2(0.02f, 0.02f);
+        Bench->Columns.Sprites[Row] = Win32BenchRandom(&RandomState) % SPRITE_BENCH_DEFINITIONS;
+        Bench->Columns.Tints[Row] = Win32BenchRandom(&RandomState) | 0xFF000000;
+    }
+}
+
+// Note: After InitVulkan. Without sheets the sprites draw as plain tint.
+internal void
+Win32SpriteBenchmarkRegisterSheets(win32_sprite_benchmark* Bench, Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    if (!Bench->Enabled || !Bench->SheetPixels)
+    {
+        return;
+    }
+
+    for (uint32 Sheet = 0; Sheet < SPRITE_BENCH_ATLASES; ++Sheet)
+    {
+        VulkanApp->RegisterSpriteSheet(Sheet, Bench->SheetPixels + Sheet * SPRITE_BENCH_SHEET_SIZE * SPRITE_BENCH_SHEET_SIZE,
+                                       SPRITE_BENCH_SHEET_SIZE, SPRITE_BENCH_SHEET_SIZE);
+    }
+}
+
+// Note: GPU timings trail the frames they belong to by a frame or two; near a step change they're attributed to the new step.
+internal void
+Win32SpriteBenchmarkAddGPUTiming(win32_sprite_benchmark* Bench, Vulkan::FrameGPUTiming* Timing)
+{
+    if (!Bench->Enabled || Bench->Done)
+    {
+        return;
+    }
+
+    ++Bench->GPUFramesThisStep;
+    Bench->TotalGPUMSThisStep += Timing->FrameMS;
+    Bench->TotalFenceWaitMSThisStep += Timing->FenceWaitMS;
+}
+
+// Note: Call once per frame with the full frame time. Steps the sprite count up after every
+// SPRITE_BENCH_FRAMES_PER_STEP frames that held the budget, and finishes on the first step that didn't.
+internal void
+Win32SpriteBenchmarkEndFrame(win32_sprite_benchmark* Bench, real32 FrameMS)
+{
+    if (!Bench->Enabled || Bench->Done)
+    {
+        return;
+    }
+
+    ++Bench->FramesThisStep;
+    Bench->TotalMSThisStep += FrameMS;
+    if (FrameMS > SPRITE_BENCH_BUDGET_MS + SPRITE_BENCH_SLACK_MS)
+    {
+        ++Bench->SlowFramesThisStep;
+    }
+
+    if (Bench->SlowFramesThisStep > SPRITE_BENCH_MAX_SLOW_FRAMES)
+    {
+        Bench->Done = true;
+    }
+    else if (Bench->FramesThisStep == SPRITE_BENCH_FRAMES_PER_STEP)
+    {
+        Bench->MaxSustainedCount = Bench->Columns.Count;
+        Bench->MaxSustainedAverageMS = Bench->TotalMSThisStep / (real32)Bench->FramesThisStep;
+        if (Bench->GPUFramesThisStep)
+        {
+            Bench->MaxSustainedGPUMS = Bench->TotalGPUMSThisStep / (real32)Bench->GPUFramesThisStep;
+            Bench->MaxSustainedFenceWaitMS = Bench->TotalFenceWaitMSThisStep / (real32)Bench->GPUFramesThisStep;
+        }
+
+        if (Bench->Columns.Count == Bench->Capacity)
+        {
+            Bench->Done = true;
+        }
+        else
+        {
+            uint32 NextCount = Bench->Columns.Count + Bench->Columns.Count / 4;
+            Bench->Columns.Count = (NextCount < Bench->Capacity) ? NextCount : Bench->Capacity;
+        }
+
+        Bench->FramesThisStep = 0;
+        Bench->SlowFramesThisStep = 0;
+        Bench->TotalMSThisStep = 0.0f;
+        Bench->GPUFramesThisStep = 0;
+        Bench->TotalGPUMSThisStep = 0.0f;
+        Bench->TotalFenceWaitMSThisStep = 0.0f;
+    }
+}
+
+internal void
+Win32SpriteBenchmarkOutput(win32_sprite_benchmark* Bench, game_memory* GameMemory, char* Filename, uint32 RecordThreadCount,
+                           Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    char Report[1024];
+    int Used = snprintf(Report, sizeof(Report),
+        "Sprite benchmark (%s, %u recording threads)\n"
+        "max sustained: %u sprites/frame at %.2fms avg (budget %.2fms, %d atlases)\n"
+        "at that count: %.2fms GPU per frame, %.2fms CPU waiting on the frame fence\n"
+        "%s\n",
+        Bench->GPUCull ? "GPU culled, indirect draws" : "CPU filled instances", RecordThreadCount,
+        Bench->MaxSustainedCount, Bench->MaxSustainedAverageMS, SPRITE_BENCH_BUDGET_MS, SPRITE_BENCH_ATLASES,
+        Bench->MaxSustainedGPUMS, Bench->MaxSustainedFenceWaitMS,
+        (Bench->MaxSustainedCount == Bench->Capacity) ? "hit the instance buffer limit before the frame budget" : "limited by frame time");
+    Used = ClampReportLength(Used, sizeof(Report));
+    if (VulkanApp)
+    {
+        Used += VulkanApp->FormatSpriteAtlasStats(Report + Used, sizeof(Report) - Used);
+        Used += VulkanApp->FormatSpriteCullStats(Report + Used, sizeof(Report) - Used);
+        Used += VulkanApp->FormatCulledSpriteUploadStats(Report + Used, sizeof(Report) - Used);
+    }
+
+    OutputDebugStringA(Report);
+    if (Filename)
+    {
+        GameMemory->DEBUGPlatformWriteEntireFile(Filename, Used, Report);
+    }
+}
+
+// Note: "-objects N" draws N small spinning quads, each its own object with its own transform, through the dynamic ring.
+// Half of them go in a second batch with another tint, so the per-draw push constants get exercised too.
+#define OBJECT_GRID_MAX_OBJECTS     (48 * 1024)  // Note: What fits in a frame of the dynamic ring.
+
+struct win32_object_grid
+{
+    bool32 Enabled;
+    uint32 Count;
+    Vulkan::ObjectData* Objects;
+};
+
+internal void
+Win32ObjectGridInit(win32_object_grid* Grid, char* CommandLine)
+{
+    *Grid = {};
+    char* Objects = strstr(CommandLine, "-objects ");
+    if (!Objects)
+    {
+        return;
+    }
+
+    uint32 Count = (uint32)atoi(Objects + 9);
+    Grid->Count = (Count < OBJECT_GRID_MAX_OBJECTS) ? Count : OBJECT_GRID_MAX_OBJECTS;
+    Grid->Objects = (Vulkan::ObjectData*)VirtualAlloc(0, Grid->Count * sizeof(Vulkan::ObjectData), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    Grid->Enabled = (Grid->Count && Grid->Objects);
+}
+
+// Note: Fills every transform for this frame and hands them to the renderer for the next DrawFrame.
+internal void
+Win32ObjectGridSubmit(win32_object_grid* Grid, Vulkan::HelloTriangleApplication* VulkanApp, real32 Time)
+{
+    if (!Grid->Enabled)
+    {
+        return;
+    }
+
+    uint32 Side = 1;
+    while (Side * Side < Grid->Count)
+    {
+        ++Side;
+    }
+    real32 Spacing = 2.0f / (real32)Side;
+
+    for (uint32 Index = 0; Index < Grid->Count; ++Index)
+    {
+        real32 X = -1.0f + Spacing * ((real32)(Index % Side) + 0.5f);
+        real32 Y = -1.0f + Spacing * ((real32)(Index / Side) + 0.5f);
+        real32 Angle = Time * glm::radians(90.0f) + 0.1f * (real32)Index;
+
+        glm::mat4 Model = glm::translate(glm::mat4(1.0f), glm::vec3(X, Y, 0.0f));
+        Model = glm::rotate(Model, Angle, glm::vec3(0.0f, 0.0f, 1.0f));
+        Model = glm::scale(Model, glm::vec3(0.8f * Spacing));
+
+        Vulkan::ObjectData* Object = &Grid->Objects[Index];
+        Object->Model = Model;
+        Object->Color = glm::vec4(X * 0.5f + 0.5f, Y * 0.5f + 0.5f, 1.0f, 1.0f);
+    }
+
+    uint32 FirstHalf = Grid->Count / 2;
+    VulkanApp->SubmitObjects(Grid->Objects, FirstHalf, glm::vec4(1.0f));
+    VulkanApp->SubmitObjects(Grid->Objects + FirstHalf, Grid->Count - FirstHalf, glm::vec4(1.0f, 0.6f, 0.6f, 1.0f));
+}
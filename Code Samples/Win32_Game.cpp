@@ -1,6 +1,7 @@
 // Note: Not a final platform layer, but gets us started with an arbitrary game. Demonstrates knowledge of basic Win32 API calls.
 
 #include "Game.h"
+#include "Game_RenderCommands.h"
 #include "Vulkan_Game.cpp"
 
 #include <windows.h>
@@ -21,9 +22,15 @@
 global_variable bool GlobalRunning;
 global_variable bool GlobalPause;
 global_variable win32_offscreen_buffer GlobalBackBuffer;
+global_variable bool GlobalBackBufferOnGPU; // Note: Vulkan presents the back buffer, GDI stays out of the way.
 global_variable LPDIRECTSOUNDBUFFER GlobalSecondaryBuffer;
 global_variable int64 GlobalPerfCountFrequency;
 
+#include "Win32_Latency.cpp"
+#include "Win32_Benchmark.cpp"
+#include "Win32_RenderCommands.cpp"
+#include "Win32_Pacing.cpp"
+#include "Win32_Headless.cpp"
 
 // Note: XInputGetState
 #define X_INPUT_GET_STATE(name) DWORD WINAPI name(DWORD dwUserIndex, XINPUT_STATE *pState)
@@ -406,8 +413,11 @@ Win32MainWindowCallback(
             PAINTSTRUCT Paint;
             HDC DeviceContext = BeginPaint(Window, &Paint);
             win32_window_dimension Dimension = Win32GetWindowDimension(Window);
-            //Win32CopyBufferToWindow(&GlobalBackBuffer, DeviceContext, Dimension.Width, Dimension.Height);
-            Win32CopyBufferToWindow(&GlobalBackBuffer, DeviceContext, 1280, 720);
+            if (!GlobalBackBufferOnGPU)
+            {
+                //Win32CopyBufferToWindow(&GlobalBackBuffer, DeviceContext, Dimension.Width, Dimension.Height);
+                Win32CopyBufferToWindow(&GlobalBackBuffer, DeviceContext, 1280, 720);
+            }
             EndPaint(Window, &Paint);
         } break;
         default:
@@ -537,6 +547,17 @@ int CALLBACK WinMain(
     UINT DesiredSchedulerMS = 1;
     bool32 SleepIsGranular = (timeBeginPeriod(DesiredSchedulerMS) == TIMERR_NOERROR);
 
+    // Note: "-headless" renders offscreen with no window, sound or input, reports throughput and exits.
+    // Vulkan only needs the file functions out of the game memory.
+    if (strstr(CommandLine, "-headless") != 0)
+    {
+        game_memory HeadlessMemory = {};
+        HeadlessMemory.DEBUGPlatformFreeFileMemory = DEBUGPlatformFreeFileMemory;
+        HeadlessMemory.DEBUGPlatformReadEntireFile = DEBUGPlatformReadEntireFile;
+        HeadlessMemory.DEBUGPlatformWriteEntireFile = DEBUGPlatformWriteEntireFile;
+        return(Win32RunHeadless(&HeadlessMemory, CommandLine));
+    }
+
     Win32LoadXInput();
 
     WNDCLASS WindowClass = {};
@@ -573,16 +594,6 @@ int CALLBACK WinMain(
         {
             HDC DeviceContext = GetDC(Window);
 
-            Vulkan::HelloTriangleApplication VulkanApp;
-            try {
-                VulkanApp.InitVulkan(Window, Instance);
-            }
-            catch (const std::exception& e) {
-                OutputDebugStringA(e.what());
-                OutputDebugStringA("\n");
-                GlobalPause = TRUE;
-            }
-
             // Note: Sound test.
             win32_sound_output SoundOutput = {};
             SoundOutput.SamplesPerSecond = 48000;
@@ -619,7 +630,52 @@ int CALLBACK WinMain(
             GameMemory.TransientStorage = (uint8*)GameMemory.PermanentStorage + 
                                             GameMemory.PermanentStorageSize;
 
-            if (Samples && GameMemory.PermanentStorage && GameMemory.TransientStorage)
+            // Note: The render command push buffer comes off the end of the transient storage. Without at least its
+            // header the game would write past the storage, so that's as fatal as not getting the storage at all.
+            win32_render_commands RenderCommands;
+            bool32 RenderCommandsAreReady = Win32RenderCommandsInit(&RenderCommands, &GameMemory);
+
+            // Note: Vulkan reads its shaders through the game memory file functions, so it has to come after them.
+            Vulkan::HelloTriangleApplication VulkanApp;
+            bool VulkanIsWorking = false;
+            try {
+                Win32ApplyRendererOptions(&VulkanApp, CommandLine);
+                VulkanApp.InitVulkan(Window, Instance, &GameMemory);
+                VulkanIsWorking = true;
+            }
+            catch (const std::exception& e) {
+                OutputDebugStringA(e.what());
+                OutputDebugStringA("\n");
+                GlobalPause = TRUE;
+            }
+
+            // Note: "-latencytest" injects synthetic key presses and quits once the histogram has enough samples.
+            win32_latency_trace LatencyTrace;
+            bool32 LatencyTest = (strstr(CommandLine, "-latencytest") != 0);
+            Win32LatencyInit(&LatencyTrace, LatencyTest, LatencyTest ? 1000 : 0);
+            uint32 FrameLatencyID = 0;
+
+            // Note: "-spritebench" draws random sprites without the frame limiter and ramps the count until frames go over budget.
+            // Add "-gpucull" to run it through the GPU culling path.
+            win32_sprite_benchmark SpriteBench;
+            Win32SpriteBenchmarkInit(&SpriteBench, VulkanIsWorking && (strstr(CommandLine, "-spritebench") != 0),
+                                     (strstr(CommandLine, "-gpucull") != 0), VULKAN_SPRITE_MAX_INSTANCES);
+            Win32SpriteBenchmarkRegisterSheets(&SpriteBench, &VulkanApp);
+
+            // Note: "-pacingtest" measures every present mode the device has for the current frames in flight, then quits.
+            win32_pacing_test PacingTest;
+            Win32PacingTestInit(&PacingTest, VulkanIsWorking && (strstr(CommandLine, "-pacingtest") != 0), &VulkanApp);
+
+            // Note: "-resizetest" resizes the window over and over and reports the swap chain recreation stalls, then quits.
+            win32_resize_test ResizeTest;
+            Win32ResizeTestInit(&ResizeTest, VulkanIsWorking && (strstr(CommandLine, "-resizetest") != 0), Window, CommandLine);
+
+            // Note: "-objects N" draws N separately transformed quads on top of whatever else is drawn.
+            win32_object_grid ObjectGrid;
+            Win32ObjectGridInit(&ObjectGrid, CommandLine);
+            real32 ObjectGridTime = 0.0f;
+
+            if (Samples && GameMemory.PermanentStorage && GameMemory.TransientStorage && RenderCommandsAreReady)
             {
                 game_input Input[2] = {};
                 game_input* NewInput = &Input[0];
@@ -674,6 +730,7 @@ int CALLBACK WinMain(
                         case WM_KEYDOWN:
                         {
                             uint32 VKCode = (uint32)Message.wParam;
+                            FrameLatencyID = Win32LatencyTagInput(&LatencyTrace, FrameLatencyID);
 
                             if (VKCode == VK_MBUTTON)
                             {
@@ -726,6 +783,7 @@ int CALLBACK WinMain(
                         case WM_KEYUP:
                         {
                             uint32 VKCode = (uint32)Message.wParam;
+                            FrameLatencyID = Win32LatencyTagInput(&LatencyTrace, FrameLatencyID);
                             bool WasDown = ((Message.lParam & (1 << 30)) != 0);
                             bool IsDown = ((Message.lParam & (1 << 31)) == 0);
                             if (WasDown != IsDown)
@@ -906,7 +964,19 @@ int CALLBACK WinMain(
                         Buffer.Height = GlobalBackBuffer.Height;
                         Buffer.Pitch = GlobalBackBuffer.Pitch;
                         Buffer.BytesPerPixel = GlobalBackBuffer.BytesPerPixel;
+
+                        LARGE_INTEGER UpdateBeginCounter = Win32GetWallClock();
+                        Win32BeginRenderCommands(&RenderCommands);
                         Game.UpdateAndRender(&GameMemory, NewInput, &Buffer, &SoundBuffer);
+                        Win32LatencyMarkUpdate(&LatencyTrace, FrameLatencyID, UpdateBeginCounter, Win32GetWallClock());
+
+                        // Note: The game's render commands go to Vulkan unless it isn't working or the sprite benchmark
+                        // has the sprites, then they're drawn into the back buffer.
+                        Win32SortRenderCommands(&RenderCommands);
+                        if (!VulkanIsWorking || SpriteBench.Enabled)
+                        {
+                            Win32RenderBatchesSoftware(&RenderCommands, &Buffer);
+                        }
 
                         if (SoundIsWorking && SoundIsValid)
                         {
@@ -918,7 +988,11 @@ int CALLBACK WinMain(
 
                         // If we're going too fast, wait until we hit our target update rate
                         real32 SecondsElapsedForFrame = WorkSecondsElapsed;
-                        if (SecondsElapsedForFrame < TargetSecondsPerFrame)
+                        if (SpriteBench.Enabled || PacingTest.Enabled)
+                        {
+                            // Note: The benchmarks measure the whole frame themselves.
+                        }
+                        else if (SecondsElapsedForFrame < TargetSecondsPerFrame)
                         {
                             while (SecondsElapsedForFrame < TargetSecondsPerFrame)
                             {
@@ -937,8 +1011,79 @@ int CALLBACK WinMain(
                         }
 
                         win32_window_dimension Dimension = Win32GetWindowDimension(Window);
-                        //Win32CopyBufferToWindow(&GlobalBackBuffer, DeviceContext, Dimension.Width, Dimension.Height);
-                        Win32CopyBufferToWindow(&GlobalBackBuffer, DeviceContext, 1280, 720);
+                        if (VulkanIsWorking)
+                        {
+                            try {
+                                if (SpriteBench.Enabled && SpriteBench.GPUCull)
+                                {
+                                    VulkanApp.UpdateCulledSprites(&SpriteBench.Columns, SpriteBench.Definitions);
+                                }
+                                else if (SpriteBench.Enabled)
+                                {
+                                    VulkanApp.SubmitSprites(&SpriteBench.Columns, SpriteBench.Definitions);
+                                }
+                                else
+                                {
+                                    Win32SubmitRenderBatches(&RenderCommands, &VulkanApp);
+                                }
+                                Win32ObjectGridSubmit(&ObjectGrid, &VulkanApp, ObjectGridTime);
+                                ObjectGridTime += TargetSecondsPerFrame;
+                                // Note: The benchmarks time the Vulkan scene on its own.
+                                if (!SpriteBench.Enabled && !PacingTest.Enabled)
+                                {
+                                    GlobalBackBufferOnGPU = VulkanApp.SubmitSoftwareFrame(&Buffer);
+                                }
+                                VulkanApp.DrawFrame(Dimension.Width, Dimension.Height, FrameLatencyID);
+
+                                Vulkan::FrameGPUTiming GPUTiming;
+                                if (VulkanApp.GetFrameGPUTiming(&GPUTiming))
+                                {
+                                    Win32SpriteBenchmarkAddGPUTiming(&SpriteBench, &GPUTiming);
+                                }
+                                Win32PacingTestEndFrame(&PacingTest, &VulkanApp);
+                            }
+                            catch (const std::exception& e) {
+                                OutputDebugStringA(e.what());
+                                OutputDebugStringA("\n");
+                                VulkanIsWorking = false;
+                                GlobalBackBufferOnGPU = false;
+                            }
+
+                            Vulkan::FrameLatencyStamp LatencyStamp;
+                            if (VulkanApp.GetPresentedLatencyStamp(&LatencyStamp))
+                            {
+                                // Note: If the frame didn't present, the ID stays pending for the next one.
+                                Win32LatencyRecordPresent(&LatencyTrace, &LatencyStamp);
+                                FrameLatencyID = 0;
+                            }
+                        }
+                        else
+                        {
+                            // Note: The GDI blit is both the submit and the present here, so "-latencytest" still
+                            // gets its samples (and finishes) without Vulkan.
+                            Vulkan::FrameLatencyStamp LatencyStamp = {};
+                            LatencyStamp.InputID = FrameLatencyID;
+                            LatencyStamp.SubmitCounter = Win32GetWallClock().QuadPart;
+                            //Win32CopyBufferToWindow(&GlobalBackBuffer, DeviceContext, Dimension.Width, Dimension.Height);
+                            Win32CopyBufferToWindow(&GlobalBackBuffer, DeviceContext, 1280, 720);
+                            LatencyStamp.PresentCounter = Win32GetWallClock().QuadPart;
+                            Win32LatencyRecordPresent(&LatencyTrace, &LatencyStamp);
+                            FrameLatencyID = 0;
+                        }
+
+                        Win32LatencyInject(&LatencyTrace, Window);
+                        if (Win32LatencyIsDone(&LatencyTrace))
+                        {
+                            GlobalRunning = false;
+                        }
+
+                        real32 FrameMS = 1000.0f * Win32GetSecondsElapsed(LastCounter, Win32GetWallClock());
+                        Win32SpriteBenchmarkEndFrame(&SpriteBench, FrameMS);
+                        Win32ResizeTestEndFrame(&ResizeTest, Window, FrameMS);
+                        if (SpriteBench.Done || PacingTest.Done || ResizeTest.Done)
+                        {
+                            GlobalRunning = false;
+                        }
 
 #if 0
                         int32 MSPerFrame = (int32)((1000 * CounterElapsed) / GlobalPerfCountFrequency);
@@ -961,7 +1106,35 @@ int CALLBACK WinMain(
                         LastCycleCount = EndCycleCount;
                     }
                 }
-                VulkanApp.OnDestroy();
+                if (LatencyTrace.SampleCount > 0)
+                {
+                    Win32LatencyOutputHistogram(&LatencyTrace, &GameMemory, (char*)"latency_histogram.txt",
+                        VulkanIsWorking ? VulkanApp.GetFramesInFlight() : 0, TargetSecondsPerFrame,
+                        SoundOutput.LatencySampleCount, SoundOutput.SamplesPerSecond);
+                }
+
+                Win32RenderCommandsOutput(&RenderCommands);
+
+                if (SpriteBench.Enabled)
+                {
+                    Win32SpriteBenchmarkOutput(&SpriteBench, &GameMemory, (char*)"sprite_benchmark.txt",
+                                               VulkanIsWorking ? VulkanApp.GetRecordThreadCount() : 0, VulkanIsWorking ? &VulkanApp : 0);
+                }
+
+                if (PacingTest.Enabled)
+                {
+                    Win32PacingTestOutput(&PacingTest, &GameMemory, (char*)"pacing_report.txt");
+                }
+
+                if (ResizeTest.Enabled && VulkanIsWorking)
+                {
+                    Win32ResizeTestOutput(&ResizeTest, &GameMemory, (char*)"resize_report.txt", &VulkanApp);
+                }
+
+                if (VulkanIsWorking)
+                {
+                    VulkanApp.Cleanup();
+                }
             }
             else
             {
@@ -0,0 +1,413 @@
+// Note: Headless render run ("-headless").
+// Renders a fixed number of frames offscreen with no window, picking up every frame's readback as it finishes, and
+// reports frames per second for the whole loop (render + readback). One frame is written out as a PPM; if a reference
+// image from an earlier run is there, the two are compared and the run fails when they're too far apart.
+// Animation runs on a fixed step when headless, so the same frame on the same driver (e.g. lavapipe on CI) should match.
+// Add "-spritebench" to draw the benchmark's sprites instead of the test quad, and "-gpucull" to cull them on the GPU.
+// "-objects N" adds N separately transformed quads (see Win32ObjectGridSubmit).
+// "-simulate" (with "-spritebench -gpucull") moves the sprites toward random destinations with the GPU simulation
+// kernels, runs the same steps on the CPU alongside, and checks the GPU positions against the CPU ones at the end.
+// In Game_SLOW builds the run also fails if any DrawFrame allocated from the heap (see Vulkan_HeapCheck.cpp).
+
+#define HEADLESS_WIDTH              1280
+#define HEADLESS_HEIGHT             720
+#define HEADLESS_FRAME_COUNT        1000
+#define HEADLESS_CAPTURE_FRAME      60
+#define HEADLESS_TOLERANCE          2   // Note: Per channel, drivers are allowed to round a little differently.
+#define HEADLESS_SPRITE_COUNT       (64 * 1024)
+#define HEADLESS_SIM_DELTA_TIME     (1.0f / 60.0f)
+#define HEADLESS_SIM_SPEED          0.5f
+#define HEADLESS_SIM_ARRIVED        0.02f   // Note: A sprite's size, close enough to stop.
+// Note: A row whose distance lands right on the tolerance can stop a step earlier on one side than the other.
+#define HEADLESS_SIM_MAX_ERROR      (HEADLESS_SIM_SPEED * HEADLESS_SIM_DELTA_TIME + 0.0001f)
+
+struct win32_headless_run
+{
+    uint64 FramesRead;
+    real32 TotalMS;
+
+    uint32 GPUFrames;
+    real32 TotalGPUFrameMS;
+    real32 TotalGPURenderPassMS;
+    real32 TotalGPUSimulationMS;
+    real32 TotalGPUUploadMS;
+
+    bool32 Captured;
+    bool32 SimulationChecked;
+    bool32 SimulationMatched;
+    bool32 ReferenceFound;
+    bool32 ReferenceMatched;
+    uint32 MismatchedPixels;
+    uint32 MaxChannelDifference;
+
+    Vulkan::FrameAllocationStats FrameAllocations;
+};
+
+struct win32_simulation_check
+{
+    bool32 Enabled;
+    uint32 Count;
+    glm::vec3* Positions;       // Note: The CPU's copy, stepped alongside the GPU.
+    glm::vec3* Velocities;
+    glm::vec4* Destinations;
+    glm::vec3* GPUPositions;
+
+    uint32 Steps;
+    real32 TotalCPUMS;
+    real32 MaxError;
+    uint32 MismatchedRows;
+};
+
+internal void
+Win32SimulationCheckInit(win32_simulation_check* Check, bool32 Enabled, win32_sprite_benchmark* SpriteBench)
+{
+    *Check = {};
+    Check->Enabled = Enabled && SpriteBench->Enabled && SpriteBench->GPUCull;
+    if (!Check->Enabled)
+    {
+        return;
+    }
+
+    Check->Count = SpriteBench->Columns.Count;
+    size_t RowSize = 3 * sizeof(glm::vec3) + sizeof(glm::vec4);
+    uint8* Memory = (uint8*)VirtualAlloc(0, RowSize * Check->Count, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!Memory)
+    {
+        Check->Enabled = false;
+        return;
+    }
+
+    Check->Destinations = (glm::vec4*)Memory;
+    Check->Positions = (glm::vec3*)(Check->Destinations + Check->Count);
+    Check->Velocities = Check->Positions + Check->Count;
+    Check->GPUPositions = Check->Velocities + Check->Count;
+
+    uint32 RandomState = 0x9E3779B9;
+    for (uint32 Row = 0; Row < Check->Count; ++Row)
+    {
+        Check->Positions[Row] = SpriteBench->Columns.Positions[Row];
+        Check->Velocities[Row] = glm::vec3(0.0f);
+        Check->Destinations[Row] = glm::vec4(2.0f * Win32BenchRandomUnilateral(&RandomState) - 1.0f,
+                                             2.0f * Win32BenchRandomUnilateral(&RandomState) - 1.0f,
+                                             0.0f, HEADLESS_SIM_ARRIVED);
+    }
+}
+
+// Note: Queues the GPU step for the coming DrawFrame and does the same step on the CPU.
+internal void
+Win32SimulationCheckStep(win32_simulation_check* Check, Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    if (!Check->Enabled)
+    {
+        return;
+    }
+
+    VulkanApp->SimulateSprites(HEADLESS_SIM_DELTA_TIME, HEADLESS_SIM_SPEED);
+
+    LARGE_INTEGER StartCounter;
+    QueryPerformanceCounter(&StartCounter);
+    Vulkan::SimulateSpriteStepCPU(Check->Positions, Check->Velocities, Check->Destinations, Check->Count,
+                                  HEADLESS_SIM_DELTA_TIME, HEADLESS_SIM_SPEED);
+    Check->TotalCPUMS += Vulkan::MillisecondsSince(StartCounter);
+    ++Check->Steps;
+}
+
+internal void
+Win32SimulationCheckCompare(win32_simulation_check* Check, win32_headless_run* Run, Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    if (!Check->Enabled || !VulkanApp->GetSimulatedPositions(Check->GPUPositions, Check->Count))
+    {
+        return;
+    }
+
+    Run->SimulationChecked = true;
+    for (uint32 Row = 0; Row < Check->Count; ++Row)
+    {
+        real32 Error = glm::length(Check->GPUPositions[Row] - Check->Positions[Row]);
+        if (Error > HEADLESS_SIM_MAX_ERROR)
+        {
+            ++Check->MismatchedRows;
+        }
+        if (Error > Check->MaxError)
+        {
+            Check->MaxError = Error;
+        }
+    }
+    Run->SimulationMatched = (Check->MismatchedRows == 0);
+}
+
+// Note: Drops the alpha, PPM is plain RGB.
+internal bool32
+Win32HeadlessWritePPM(game_memory* GameMemory, char* Filename, Vulkan::ReadbackFrame* Frame)
+{
+    char Header[64];
+    int HeaderSize = snprintf(Header, sizeof(Header), "P6\n%u %u\n255\n", Frame->Width, Frame->Height);
+
+    uint32 Size = HeaderSize + Frame->Width * Frame->Height * 3;
+    uint8* Memory = (uint8*)VirtualAlloc(0, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!Memory)
+    {
+        return(false);
+    }
+
+    memcpy(Memory, Header, HeaderSize);
+    uint8* Dest = Memory + HeaderSize;
+    for (uint32 Y = 0; Y < Frame->Height; ++Y)
+    {
+        uint8* Source = (uint8*)Frame->Pixels + Y * Frame->Pitch;
+        for (uint32 X = 0; X < Frame->Width; ++X)
+        {
+            *Dest++ = Source[0];
+            *Dest++ = Source[1];
+            *Dest++ = Source[2];
+            Source += 4;
+        }
+    }
+
+    bool32 Result = GameMemory->DEBUGPlatformWriteEntireFile(Filename, Size, Memory);
+    VirtualFree(Memory, 0, MEM_RELEASE);
+    return(Result);
+}
+
+internal void
+Win32HeadlessCompare(win32_headless_run* Run, game_memory* GameMemory, char* Filename, Vulkan::ReadbackFrame* Frame)
+{
+    debug_read_file_result Reference = GameMemory->DEBUGPlatformReadEntireFile(Filename);
+    if (!Reference.Contents)
+    {
+        return;
+    }
+    Run->ReferenceFound = true;
+
+    // Note: Only reads back what Win32HeadlessWritePPM writes, not PPM in general.
+    char Header[64] = {};
+    memcpy(Header, Reference.Contents, (Reference.ContentsSize < sizeof(Header) - 1) ? Reference.ContentsSize : sizeof(Header) - 1);
+    uint32 Width = 0;
+    uint32 Height = 0;
+    int HeaderSize = 0;
+    sscanf(Header, "P6\n%u %u\n255\n%n", &Width, &Height, &HeaderSize);
+
+    if (HeaderSize && Width == Frame->Width && Height == Frame->Height &&
+        Reference.ContentsSize >= HeaderSize + Width * Height * 3)
+    {
+        uint8* Expected = (uint8*)Reference.Contents + HeaderSize;
+        for (uint32 Y = 0; Y < Height; ++Y)
+        {
+            uint8* Source = (uint8*)Frame->Pixels + Y * Frame->Pitch;
+            for (uint32 X = 0; X < Width; ++X)
+            {
+                uint32 PixelMax = 0;
+                for (uint32 Channel = 0; Channel < 3; ++Channel)
+                {
+                    int Difference = (int)Source[Channel] - (int)Expected[Channel];
+                    uint32 AbsDifference = (uint32)((Difference < 0) ? -Difference : Difference);
+                    PixelMax = (AbsDifference > PixelMax) ? AbsDifference : PixelMax;
+                }
+
+                if (PixelMax > HEADLESS_TOLERANCE)
+                {
+                    ++Run->MismatchedPixels;
+                }
+                if (PixelMax > Run->MaxChannelDifference)
+                {
+                    Run->MaxChannelDifference = PixelMax;
+                }
+                Source += 4;
+                Expected += 3;
+            }
+        }
+        Run->ReferenceMatched = (Run->MismatchedPixels == 0);
+    }
+    else
+    {
+        // Note: A reference of another size never matches.
+        Run->MismatchedPixels = Frame->Width * Frame->Height;
+    }
+
+    GameMemory->DEBUGPlatformFreeFileMemory(Reference.Contents);
+}
+
+internal void
+Win32HeadlessTakeFrame(win32_headless_run* Run, game_memory* GameMemory, Vulkan::ReadbackFrame* Frame)
+{
+    ++Run->FramesRead;
+    if (Frame->FrameNumber == HEADLESS_CAPTURE_FRAME)
+    {
+        Win32HeadlessCompare(Run, GameMemory, (char*)"headless_reference.ppm", Frame);
+        Run->Captured = Win32HeadlessWritePPM(GameMemory, (char*)"headless_frame.ppm", Frame);
+    }
+}
+
+internal void
+Win32HeadlessAddGPUTiming(win32_headless_run* Run, Vulkan::FrameGPUTiming* Timing)
+{
+    ++Run->GPUFrames;
+    Run->TotalGPUFrameMS += Timing->FrameMS;
+    Run->TotalGPURenderPassMS += Timing->RenderPassMS;
+    Run->TotalGPUSimulationMS += Timing->SimulationMS;
+    Run->TotalGPUUploadMS += Timing->UploadMS;
+}
+
+internal void
+Win32HeadlessOutput(win32_headless_run* Run, game_memory* GameMemory, char* Filename, char* Scene,
+                    Vulkan::HelloTriangleApplication* VulkanApp, win32_simulation_check* Simulation)
+{
+    real32 FramesPerSecond = (Run->TotalMS > 0.0f) ? 1000.0f * (real32)HEADLESS_FRAME_COUNT / Run->TotalMS : 0.0f;
+    real32 GPUFrames = Run->GPUFrames ? (real32)Run->GPUFrames : 1.0f;
+
+    char Report[4096];
+    int Used = snprintf(Report, sizeof(Report),
+        "Headless run (%ux%u, %s, %u recording threads)\n"
+        "%u frames in %.2fms: %.1f frames/s, %.3fms/frame; %llu frames read back\n"
+        "GPU (avg of %u frames): %.3fms/frame, render pass %.3fms, uploads %.3fms\n"
+        "frame %u: %s, %s\n",
+        HEADLESS_WIDTH, HEADLESS_HEIGHT, Scene, VulkanApp->GetRecordThreadCount(),
+        HEADLESS_FRAME_COUNT, Run->TotalMS, FramesPerSecond, Run->TotalMS / (real32)HEADLESS_FRAME_COUNT, Run->FramesRead,
+        Run->GPUFrames, Run->TotalGPUFrameMS / GPUFrames, Run->TotalGPURenderPassMS / GPUFrames, Run->TotalGPUUploadMS / GPUFrames,
+        HEADLESS_CAPTURE_FRAME, Run->Captured ? "written to headless_frame.ppm" : "not captured",
+        !Run->ReferenceFound ? "no reference image" :
+        Run->ReferenceMatched ? "matches headless_reference.ppm" : "DIFFERS from headless_reference.ppm");
+    Used = ClampReportLength(Used, sizeof(Report));
+
+    if (Run->ReferenceFound && !Run->ReferenceMatched)
+    {
+        int More = snprintf(Report + Used, sizeof(Report) - Used, "%u pixels off by more than %d, max channel difference %u\n",
+                            Run->MismatchedPixels, HEADLESS_TOLERANCE, Run->MaxChannelDifference);
+        Used += More;
+        Used = ClampReportLength(Used, sizeof(Report));
+    }
+    if (Simulation->Enabled)
+    {
+        real32 Steps = Simulation->Steps ? (real32)Simulation->Steps : 1.0f;
+        real32 CPUMS = Simulation->TotalCPUMS / Steps;
+        real32 GPUMS = Run->TotalGPUSimulationMS / GPUFrames;
+        int More = snprintf(Report + Used, sizeof(Report) - Used,
+            "simulation of %u rows: CPU %.3fms/step (%.1fM rows/s), GPU %.3fms/step (%.1fM rows/s); %s, max error %f, %u rows off\n",
+            Simulation->Count, CPUMS, (CPUMS > 0.0f) ? (real32)Simulation->Count / (1000.0f * CPUMS) : 0.0f,
+            GPUMS, (GPUMS > 0.0f) ? (real32)Simulation->Count / (1000.0f * GPUMS) : 0.0f,
+            !Run->SimulationChecked ? "not read back" : Run->SimulationMatched ? "matches the CPU" : "DIFFERS from the CPU",
+            Simulation->MaxError, Simulation->MismatchedRows);
+        Used += More;
+        Used = ClampReportLength(Used, sizeof(Report));
+    }
+    if (Run->FrameAllocations.FramesThatAllocated)
+    {
+        int More = snprintf(Report + Used, sizeof(Report) - Used,
+            "%llu frames ALLOCATED from the heap (first: frame %llu), %llu allocations, at most %u in a frame\n",
+            Run->FrameAllocations.FramesThatAllocated, Run->FrameAllocations.FirstFrameThatAllocated,
+            Run->FrameAllocations.Allocations, Run->FrameAllocations.MostInAFrame);
+        Used += More;
+        Used = ClampReportLength(Used, sizeof(Report));
+    }
+    Used += VulkanApp->FormatSpriteAtlasStats(Report + Used, sizeof(Report) - Used);
+    Used += VulkanApp->FormatSpriteCullStats(Report + Used, sizeof(Report) - Used);
+    Used += VulkanApp->FormatCulledSpriteUploadStats(Report + Used, sizeof(Report) - Used);
+    Used += VulkanApp->FormatDeviceMemoryStats(Report + Used, sizeof(Report) - Used);
+    Used += VulkanApp->FormatFrameGraphStats(Report + Used, sizeof(Report) - Used);
+
+    OutputDebugStringA(Report);
+    if (Filename)
+    {
+        GameMemory->DEBUGPlatformWriteEntireFile(Filename, Used, Report);
+    }
+}
+
+// Note: Returns the process exit code: 0 if everything rendered, the captured frame matched (or had nothing to match)
+// and no frame allocated.
+internal int
+Win32RunHeadless(game_memory* GameMemory, char* CommandLine)
+{
+    win32_headless_run Run = {};
+    Vulkan::HelloTriangleApplication VulkanApp;
+    try {
+        Win32ApplyRendererOptions(&VulkanApp, CommandLine);
+        VulkanApp.InitVulkanHeadless(GameMemory, HEADLESS_WIDTH, HEADLESS_HEIGHT);
+    }
+    catch (const std::exception& e) {
+        OutputDebugStringA(e.what());
+        OutputDebugStringA("\n");
+        return(1);
+    }
+
+    win32_sprite_benchmark SpriteBench;
+    Win32SpriteBenchmarkInit(&SpriteBench, (strstr(CommandLine, "-spritebench") != 0),
+                             (strstr(CommandLine, "-gpucull") != 0), HEADLESS_SPRITE_COUNT);
+    SpriteBench.Columns.Count = HEADLESS_SPRITE_COUNT;
+    Win32SpriteBenchmarkRegisterSheets(&SpriteBench, &VulkanApp);
+    win32_object_grid ObjectGrid;
+    Win32ObjectGridInit(&ObjectGrid, CommandLine);
+    win32_simulation_check Simulation;
+    Win32SimulationCheckInit(&Simulation, (strstr(CommandLine, "-simulate") != 0), &SpriteBench);
+
+    char* Scene = ObjectGrid.Enabled ? (char*)"objects" : !SpriteBench.Enabled ? (char*)"test quad" :
+                  SpriteBench.GPUCull ? (char*)"64K sprites, GPU culled" : (char*)"64K sprites, CPU filled";
+
+    bool32 Failed = false;
+    LARGE_INTEGER StartCounter;
+    QueryPerformanceCounter(&StartCounter);
+    try {
+        if (SpriteBench.Enabled && SpriteBench.GPUCull)
+        {
+            VulkanApp.SetCulledSprites(&SpriteBench.Columns, SpriteBench.Definitions);
+        }
+        if (Simulation.Enabled)
+        {
+            VulkanApp.SetSimulatedSprites(Simulation.Velocities, Simulation.Destinations, Simulation.Count);
+        }
+
+        Vulkan::ReadbackFrame Frame;
+        for (uint32 FrameIndex = 0; FrameIndex < HEADLESS_FRAME_COUNT; ++FrameIndex)
+        {
+            if (SpriteBench.Enabled && !SpriteBench.GPUCull)
+            {
+                VulkanApp.SubmitSprites(&SpriteBench.Columns, SpriteBench.Definitions);
+            }
+            Win32ObjectGridSubmit(&ObjectGrid, &VulkanApp, (real32)FrameIndex / 60.0f);
+            Win32SimulationCheckStep(&Simulation, &VulkanApp);
+            if (Simulation.Enabled && FrameIndex == HEADLESS_FRAME_COUNT - 1)
+            {
+                VulkanApp.RequestSimulationReadback();
+            }
+            VulkanApp.DrawFrame(HEADLESS_WIDTH, HEADLESS_HEIGHT);
+
+            Vulkan::FrameGPUTiming GPUTiming;
+            if (VulkanApp.GetFrameGPUTiming(&GPUTiming))
+            {
+                Win32HeadlessAddGPUTiming(&Run, &GPUTiming);
+            }
+
+            while (VulkanApp.GetReadbackFrame(&Frame))
+            {
+                Win32HeadlessTakeFrame(&Run, GameMemory, &Frame);
+            }
+        }
+
+        // Note: The last frames in flight. Nothing else is submitted, so polling is all the wait there is.
+        while (VulkanApp.IsReadbackPending())
+        {
+            if (VulkanApp.GetReadbackFrame(&Frame))
+            {
+                Win32HeadlessTakeFrame(&Run, GameMemory, &Frame);
+            }
+            else
+            {
+                Sleep(0);
+            }
+        }
+        Win32SimulationCheckCompare(&Simulation, &Run, &VulkanApp);
+    }
+    catch (const std::exception& e) {
+        OutputDebugStringA(e.what());
+        OutputDebugStringA("\n");
+        Failed = true;
+    }
+    Run.TotalMS = Vulkan::MillisecondsSince(StartCounter);
+    VulkanApp.GetFrameAllocations(&Run.FrameAllocations);
+
+    Win32HeadlessOutput(&Run, GameMemory, (char*)"headless_benchmark.txt", Scene, &VulkanApp, &Simulation);
+    VulkanApp.Cleanup();
+
+    int Result = (Failed || (Run.ReferenceFound && !Run.ReferenceMatched) ||
+                  (Simulation.Enabled && !Run.SimulationMatched) || Run.FrameAllocations.FramesThatAllocated) ? 1 : 0;
+    return(Result);
+}
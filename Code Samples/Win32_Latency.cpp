@@ -0,0 +1,215 @@
+// Note: Input-to-present latency tracing.
+// The platform tags the first input event it sees in a frame with an ID. That ID rides along with the
+// game_input for the frame, through GameUpdateAndRender, and into the Vulkan submit/present, where the
+// renderer hands back a stamp (without Vulkan the platform stamps its GDI blit). Each completed event goes
+// into a histogram, so MAX_FRAMES_IN_FLIGHT, the frame limiter and the audio latency can be tuned against
+// real numbers.
+// The synthetic injector posts key messages into our own queue, so a run doesn't need anyone at the keyboard.
+
+#define LATENCY_MAX_EVENTS 256
+#define LATENCY_HISTOGRAM_BUCKETS 100 // Note: 1ms per bucket, the last bucket catches everything above.
+#define LATENCY_INJECT_KEY VK_F9      // Note: Not bound to anything in the game.
+
+struct win32_latency_event
+{
+    uint32 ID;
+    int64 InputCounter;
+    int64 UpdateBeginCounter;
+    int64 UpdateEndCounter;
+    int64 SubmitCounter;
+    int64 PresentCounter;
+};
+
+struct win32_latency_trace
+{
+    uint32 NextID;
+    win32_latency_event Events[LATENCY_MAX_EVENTS]; // Note: Ring, indexed by ID.
+
+    uint32 Histogram[LATENCY_HISTOGRAM_BUCKETS];
+    uint32 SampleCount;
+    real32 MinMS;
+    real32 MaxMS;
+    real32 TotalMS;
+    real32 InputToUpdateMS;
+    real32 UpdateMS;
+    real32 UpdateToSubmitMS;
+    real32 SubmitToPresentMS;
+
+    // Note: Synthetic input injector.
+    bool32 InjectorEnabled;
+    uint32 InjectEveryNFrames;
+    uint32 FramesUntilInject;
+    uint32 SamplesWanted;
+    int64 PendingInjectCounter;
+};
+
+inline real32
+Win32LatencyMS(int64 Start, int64 End)
+{
+    real32 Result = 1000.0f * (real32)(End - Start) / (real32)GlobalPerfCountFrequency;
+    return(Result);
+}
+
+internal void
+Win32LatencyInit(win32_latency_trace* Trace, bool32 InjectorEnabled, uint32 SamplesWanted)
+{
+    *Trace = {};
+    Trace->NextID = 1; // Note: 0 means "no event this frame".
+    Trace->MinMS = 1000000.0f;
+    Trace->InjectorEnabled = InjectorEnabled;
+    // Note: Odd interval, so injected events don't lock onto a multiple of the frames in flight.
+    Trace->InjectEveryNFrames = 7;
+    Trace->FramesUntilInject = Trace->InjectEveryNFrames;
+    Trace->SamplesWanted = SamplesWanted;
+}
+
+// Note: Called from the message loop for every input message. Only the first one in a frame gets an ID,
+// everything after it is affected by the same update, so it would only measure the same thing again.
+internal uint32
+Win32LatencyTagInput(win32_latency_trace* Trace, uint32 FrameLatencyID)
+{
+    uint32 Result = FrameLatencyID;
+    if (!Result)
+    {
+        Result = Trace->NextID++;
+        if (Trace->NextID == 0)
+        {
+            Trace->NextID = 1;
+        }
+
+        win32_latency_event* Event = &Trace->Events[Result % LATENCY_MAX_EVENTS];
+        *Event = {};
+        Event->ID = Result;
+        if (Trace->PendingInjectCounter)
+        {
+            // Note: For synthetic input we know exactly when the event was created.
+            Event->InputCounter = Trace->PendingInjectCounter;
+            Trace->PendingInjectCounter = 0;
+        }
+        else
+        {
+            LARGE_INTEGER Counter;
+            QueryPerformanceCounter(&Counter);
+            Event->InputCounter = Counter.QuadPart;
+        }
+    }
+    return(Result);
+}
+
+internal void
+Win32LatencyMarkUpdate(win32_latency_trace* Trace, uint32 ID, LARGE_INTEGER Begin, LARGE_INTEGER End)
+{
+    win32_latency_event* Event = &Trace->Events[ID % LATENCY_MAX_EVENTS];
+    if (ID && (Event->ID == ID) && !Event->UpdateBeginCounter)
+    {
+        Event->UpdateBeginCounter = Begin.QuadPart;
+        Event->UpdateEndCounter = End.QuadPart;
+    }
+}
+
+// Note: Returns true when the event is finished and the ID can be dropped.
+internal bool32
+Win32LatencyRecordPresent(win32_latency_trace* Trace, Vulkan::FrameLatencyStamp* Stamp)
+{
+    win32_latency_event* Event = &Trace->Events[Stamp->InputID % LATENCY_MAX_EVENTS];
+    if (!Stamp->InputID || (Event->ID != Stamp->InputID) || !Event->UpdateBeginCounter)
+    {
+        return(false);
+    }
+
+    Event->SubmitCounter = Stamp->SubmitCounter;
+    Event->PresentCounter = Stamp->PresentCounter;
+
+    real32 TotalMS = Win32LatencyMS(Event->InputCounter, Event->PresentCounter);
+    int Bucket = (int)TotalMS;
+    if (Bucket >= LATENCY_HISTOGRAM_BUCKETS)
+    {
+        Bucket = LATENCY_HISTOGRAM_BUCKETS - 1;
+    }
+    ++Trace->Histogram[Bucket];
+    ++Trace->SampleCount;
+
+    if (TotalMS < Trace->MinMS) { Trace->MinMS = TotalMS; }
+    if (TotalMS > Trace->MaxMS) { Trace->MaxMS = TotalMS; }
+    Trace->TotalMS += TotalMS;
+    Trace->InputToUpdateMS += Win32LatencyMS(Event->InputCounter, Event->UpdateBeginCounter);
+    Trace->UpdateMS += Win32LatencyMS(Event->UpdateBeginCounter, Event->UpdateEndCounter);
+    Trace->UpdateToSubmitMS += Win32LatencyMS(Event->UpdateEndCounter, Event->SubmitCounter);
+    Trace->SubmitToPresentMS += Win32LatencyMS(Event->SubmitCounter, Event->PresentCounter);
+
+    return(true);
+}
+
+// Note: Posts a key down/up pair into our own queue, so it goes through exactly the same path as a real key.
+internal void
+Win32LatencyInject(win32_latency_trace* Trace, HWND Window)
+{
+    if (Trace->InjectorEnabled && !Trace->PendingInjectCounter)
+    {
+        if (--Trace->FramesUntilInject == 0)
+        {
+            Trace->FramesUntilInject = Trace->InjectEveryNFrames;
+            LARGE_INTEGER Counter;
+            QueryPerformanceCounter(&Counter);
+            Trace->PendingInjectCounter = Counter.QuadPart;
+            PostMessageA(Window, WM_KEYDOWN, LATENCY_INJECT_KEY, 0);
+            PostMessageA(Window, WM_KEYUP, LATENCY_INJECT_KEY, (LPARAM)((1u << 30) | (1u << 31)));
+        }
+    }
+}
+
+internal bool32
+Win32LatencyIsDone(win32_latency_trace* Trace)
+{
+    bool32 Result = (Trace->SamplesWanted && (Trace->SampleCount >= Trace->SamplesWanted));
+    return(Result);
+}
+
+// Note: Writes the histogram to the debugger and to disk. The header records the settings the numbers were taken with.
+internal void
+Win32LatencyOutputHistogram(win32_latency_trace* Trace, game_memory* GameMemory, char* Filename,
+                            int FramesInFlight, real32 TargetSecondsPerFrame, int AudioLatencySampleCount, int SamplesPerSecond)
+{
+    char Report[16384];
+    int Used = 0;
+    int Size = sizeof(Report);
+
+    real32 Count = (Trace->SampleCount > 0) ? (real32)Trace->SampleCount : 1.0f;
+    Used += snprintf(Report + Used, Size - Used,
+        "Input-to-present latency (%u samples)\n"
+        "frames in flight: %d, target frame: %.2fms, audio latency: %.2fms\n"
+        "min %.2fms, avg %.2fms, max %.2fms\n"
+        "avg input->update %.2fms, update %.2fms, update->submit %.2fms, submit->present %.2fms\n",
+        Trace->SampleCount,
+        FramesInFlight, 1000.0f * TargetSecondsPerFrame, 1000.0f * (real32)AudioLatencySampleCount / (real32)SamplesPerSecond,
+        (Trace->SampleCount > 0) ? Trace->MinMS : 0.0f, Trace->TotalMS / Count, Trace->MaxMS,
+        Trace->InputToUpdateMS / Count, Trace->UpdateMS / Count, Trace->UpdateToSubmitMS / Count, Trace->SubmitToPresentMS / Count);
+
+    uint32 MaxBucket = 1;
+    for (int BucketIndex = 0; BucketIndex < LATENCY_HISTOGRAM_BUCKETS; ++BucketIndex)
+    {
+        if (Trace->Histogram[BucketIndex] > MaxBucket) { MaxBucket = Trace->Histogram[BucketIndex]; }
+    }
+
+    for (int BucketIndex = 0; BucketIndex < LATENCY_HISTOGRAM_BUCKETS; ++BucketIndex)
+    {
+        uint32 BucketCount = Trace->Histogram[BucketIndex];
+        if (BucketCount && (Used < Size - 1))
+        {
+            char Bar[41] = {};
+            int BarLength = (int)((40 * (uint64)BucketCount) / MaxBucket);
+            for (int BarIndex = 0; BarIndex < BarLength; ++BarIndex) { Bar[BarIndex] = '#'; }
+
+            Used += snprintf(Report + Used, Size - Used, "%3d%s ms | %-40s %u\n",
+                BucketIndex, (BucketIndex == LATENCY_HISTOGRAM_BUCKETS - 1) ? "+" : " ", Bar, BucketCount);
+        }
+    }
+
+    Used = ClampReportLength(Used, Size);
+
+    OutputDebugStringA(Report);
+    if (Filename)
+    {
+        GameMemory->DEBUGPlatformWriteEntireFile(Filename, Used, Report);
+    }
+}
@@ -0,0 +1,259 @@
+// Note: Frame pacing options and test.
+// "-frames N" sets the frames in flight (1 to 4) and "-present fifo|relaxed|mailbox|immediate" the present mode;
+// both apply to the normal run and to "-headless". A mode the device doesn't have falls back to FIFO.
+// "-pacingtest" goes through every present mode the device has, one after the other without restarting, and writes
+// the fence wait and acquire-to-present times of each to pacing_report.txt. The frame limiter is skipped for the run,
+// so the present mode alone decides the pacing. Run it once per "-frames" setting to cover those as well.
+// "-resizetest" resizes the window back and forth every RESIZE_TEST_INTERVAL frames and writes how long the swap chain
+// recreations and the frames around them took to resize_report.txt. Add "-resizeidle" to recreate the old way, waiting
+// for the device to go idle, for the number to compare against.
+
+#define PACING_WARMUP_FRAMES        60  // Note: Covers the swap chain recreation and the queue settling into the new mode.
+#define PACING_MEASURE_FRAMES       600
+#define PACING_MODE_COUNT           4
+#define RESIZE_TEST_INTERVAL        30
+#define RESIZE_TEST_COUNT           40
+#define RESIZE_TEST_SHRINK_X        160
+#define RESIZE_TEST_SHRINK_Y        90
+
+global_variable VkPresentModeKHR GlobalPacingModes[PACING_MODE_COUNT] =
+{
+    VK_PRESENT_MODE_FIFO_KHR,
+    VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    VK_PRESENT_MODE_MAILBOX_KHR,
+    VK_PRESENT_MODE_IMMEDIATE_KHR,
+};
+
+struct win32_pacing_result
+{
+    bool32 Measured;
+    VkPresentModeKHR Mode;
+    Vulkan::FramePacingStats Stats;
+};
+
+struct win32_pacing_test
+{
+    bool32 Enabled;
+    bool32 Done;
+    uint32 ModeIndex;
+    uint32 FramesThisMode;
+    uint32 FramesInFlight;
+    win32_pacing_result Results[PACING_MODE_COUNT];
+};
+
+struct win32_resize_test
+{
+    bool32 Enabled;
+    bool32 Done;
+    bool32 WaitsIdle;
+    uint32 FramesThisSize;
+    uint32 ResizeCount;
+    int32 BaseWidth;        // Note: Of the window, not the client area.
+    int32 BaseHeight;
+
+    uint32 FrameCount;
+    real32 TotalFrameMS;
+    real32 MaxFrameMS;
+};
+
+// Note: Call before InitVulkan, the frames in flight can't change after that.
+internal void
+Win32ApplyRendererOptions(Vulkan::HelloTriangleApplication* VulkanApp, char* CommandLine)
+{
+    char* Frames = strstr(CommandLine, "-frames ");
+    if (Frames)
+    {
+        VulkanApp->SetFramesInFlight((uint32)atoi(Frames + 8));
+    }
+
+    char* Present = strstr(CommandLine, "-present ");
+    if (Present)
+    {
+        Present += 9;
+        if (strncmp(Present, "fifo", 4) == 0 && strncmp(Present, "fifo_relaxed", 12) != 0)
+        {
+            VulkanApp->SetPresentMode(VK_PRESENT_MODE_FIFO_KHR);
+        }
+        else if (strncmp(Present, "relaxed", 7) == 0 || strncmp(Present, "fifo_relaxed", 12) == 0)
+        {
+            VulkanApp->SetPresentMode(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+        }
+        else if (strncmp(Present, "mailbox", 7) == 0)
+        {
+            VulkanApp->SetPresentMode(VK_PRESENT_MODE_MAILBOX_KHR);
+        }
+        else if (strncmp(Present, "immediate", 9) == 0)
+        {
+            VulkanApp->SetPresentMode(VK_PRESENT_MODE_IMMEDIATE_KHR);
+        }
+    }
+
+    VulkanApp->SetSwapChainRecreateWaitsIdle(strstr(CommandLine, "-resizeidle") != 0);
+}
+
+// Note: Moves on to the next mode the device has, starting at ModeIndex. Returns false when there are none left.
+internal bool32
+Win32PacingTestStartMode(win32_pacing_test* Test, Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    for (; Test->ModeIndex < PACING_MODE_COUNT; ++Test->ModeIndex)
+    {
+        VkPresentModeKHR Mode = GlobalPacingModes[Test->ModeIndex];
+        if (VulkanApp->IsPresentModeSupported(Mode))
+        {
+            VulkanApp->SetPresentMode(Mode);
+            Test->FramesThisMode = 0;
+            return(true);
+        }
+    }
+    return(false);
+}
+
+// Note: After InitVulkan.
+internal void
+Win32PacingTestInit(win32_pacing_test* Test, bool32 Enabled, Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    *Test = {};
+    Test->Enabled = Enabled;
+    if (!Enabled)
+    {
+        return;
+    }
+
+    Test->FramesInFlight = VulkanApp->GetFramesInFlight();
+    if (!Win32PacingTestStartMode(Test, VulkanApp))
+    {
+        Test->Done = true;
+    }
+}
+
+// Note: Call once per frame, after DrawFrame.
+internal void
+Win32PacingTestEndFrame(win32_pacing_test* Test, Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    if (!Test->Enabled || Test->Done)
+    {
+        return;
+    }
+
+    ++Test->FramesThisMode;
+    if (Test->FramesThisMode == PACING_WARMUP_FRAMES)
+    {
+        VulkanApp->ResetFramePacing();
+    }
+    else if (Test->FramesThisMode == PACING_WARMUP_FRAMES + PACING_MEASURE_FRAMES)
+    {
+        win32_pacing_result* Result = &Test->Results[Test->ModeIndex];
+        Result->Measured = true;
+        Result->Mode = VulkanApp->GetPresentMode();
+        VulkanApp->GetFramePacing(&Result->Stats);
+
+        ++Test->ModeIndex;
+        if (!Win32PacingTestStartMode(Test, VulkanApp))
+        {
+            Test->Done = true;
+        }
+    }
+}
+
+internal void
+Win32PacingTestOutput(win32_pacing_test* Test, game_memory* GameMemory, char* Filename)
+{
+    char Report[2048];
+    int Used = snprintf(Report, sizeof(Report), "Frame pacing (%u frames in flight, %u frames per mode after %u warmup frames)\n",
+                        Test->FramesInFlight, PACING_MEASURE_FRAMES, PACING_WARMUP_FRAMES);
+    Used = ClampReportLength(Used, sizeof(Report));
+
+    for (uint32 ModeIndex = 0; ModeIndex < PACING_MODE_COUNT; ++ModeIndex)
+    {
+        win32_pacing_result* Result = &Test->Results[ModeIndex];
+        if (Result->Measured)
+        {
+            Used += Vulkan::FormatFramePacingStats(Report + Used, sizeof(Report) - Used, &Result->Stats,
+                                                   Test->FramesInFlight, Result->Mode);
+        }
+        else
+        {
+            int More = snprintf(Report + Used, sizeof(Report) - Used, "%s: not supported\n",
+                                Vulkan::GetPresentModeName(GlobalPacingModes[ModeIndex]));
+            Used += More;
+            Used = ClampReportLength(Used, sizeof(Report));
+        }
+    }
+
+    OutputDebugStringA(Report);
+    if (Filename)
+    {
+        GameMemory->DEBUGPlatformWriteEntireFile(Filename, Used, Report);
+    }
+}
+
+internal void
+Win32ResizeTestInit(win32_resize_test* Test, bool32 Enabled, HWND Window, char* CommandLine)
+{
+    *Test = {};
+    Test->Enabled = Enabled;
+    Test->WaitsIdle = (strstr(CommandLine, "-resizeidle") != 0);
+
+    RECT WindowRect;
+    GetWindowRect(Window, &WindowRect);
+    Test->BaseWidth = WindowRect.right - WindowRect.left;
+    Test->BaseHeight = WindowRect.bottom - WindowRect.top;
+}
+
+// Note: Call once per frame, after DrawFrame. The new size is picked up by the next DrawFrame.
+internal void
+Win32ResizeTestEndFrame(win32_resize_test* Test, HWND Window, real32 FrameMS)
+{
+    if (!Test->Enabled || Test->Done)
+    {
+        return;
+    }
+
+    ++Test->FrameCount;
+    Test->TotalFrameMS += FrameMS;
+    if (FrameMS > Test->MaxFrameMS)
+    {
+        Test->MaxFrameMS = FrameMS;
+    }
+
+    ++Test->FramesThisSize;
+    if (Test->FramesThisSize == RESIZE_TEST_INTERVAL)
+    {
+        if (Test->ResizeCount == RESIZE_TEST_COUNT)
+        {
+            Test->Done = true;
+            return;
+        }
+
+        bool32 Shrink = ((Test->ResizeCount & 1) == 0);
+        int32 Width = Test->BaseWidth - (Shrink ? RESIZE_TEST_SHRINK_X : 0);
+        int32 Height = Test->BaseHeight - (Shrink ? RESIZE_TEST_SHRINK_Y : 0);
+        SetWindowPos(Window, 0, 0, 0, Width, Height, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+
+        ++Test->ResizeCount;
+        Test->FramesThisSize = 0;
+    }
+}
+
+internal void
+Win32ResizeTestOutput(win32_resize_test* Test, game_memory* GameMemory, char* Filename, Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    Vulkan::SwapChainRecreateStats Stats;
+    VulkanApp->GetSwapChainRecreateStats(&Stats);
+
+    real32 FrameCount = Test->FrameCount ? (real32)Test->FrameCount : 1.0f;
+    char Report[512];
+    int Used = snprintf(Report, sizeof(Report),
+        "Resize test (%s, %u frames in flight, %u resizes every %u frames)\n"
+        "frames: %.3fms avg, %.3fms max\n",
+        Test->WaitsIdle ? "waiting idle" : "deferred destroys", VulkanApp->GetFramesInFlight(),
+        Test->ResizeCount, RESIZE_TEST_INTERVAL, Test->TotalFrameMS / FrameCount, Test->MaxFrameMS);
+    Used = ClampReportLength(Used, sizeof(Report));
+    Used += Vulkan::FormatSwapChainRecreateStats(Report + Used, sizeof(Report) - Used, &Stats);
+
+    OutputDebugStringA(Report);
+    if (Filename)
+    {
+        GameMemory->DEBUGPlatformWriteEntireFile(Filename, Used, Report);
+    }
+}
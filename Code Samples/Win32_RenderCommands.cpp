@@ -0,0 +1,509 @@
+// Note: The platform side of the game's render commands (Game_RenderCommands.h).
+// Before GameUpdateAndRender the push buffer is reset. After it, the sort entries are copied out in push order and
+// LSD radix sorted, 8 bits a pass. The histograms of all eight digits come out of one read of the keys, and a pass
+// whose digit is the same for every key is skipped, which is most of the high ones: a frame only has a few layers
+// and pipelines. The sorted commands are then cut into batches that share a layer, pipeline and texture.
+// The batches go to one of two backends:
+// - Vulkan: the sprites turn into one set of sprite columns in sorted order (one instanced draw, the textures are
+//   bindless), the rectangles into objects (one instanced draw). A texture is registered the first time a batch
+//   uses it. The render pass clears, so clear commands are skipped, and the Vulkan pipelines draw in their own order,
+//   so layers only order commands within a pipeline.
+// - Software: everything is drawn into the back buffer, in sorted order. Rectangles are opaque, sprite texels with
+//   alpha under half are skipped and the rest are tinted and nearest sampled.
+// Without render commands from the game the back buffer is left the way GameUpdateAndRender drew it.
+
+#define RENDER_COMMANDS_TEXTURE_FAILED  0xFFFFFFFF  // Note: render_texture::RendererHandle when RegisterTexture wouldn't take it.
+#define RENDER_COMMANDS_DIGIT_BITS      8
+#define RENDER_COMMANDS_DIGIT_COUNT     (64 / RENDER_COMMANDS_DIGIT_BITS)
+#define RENDER_COMMANDS_BUCKETS         (1 << RENDER_COMMANDS_DIGIT_BITS)
+
+struct win32_render_batch
+{
+    uint64 Material;            // Note: The key above depth.
+    uint32 Pipeline;
+    render_texture* Texture;    // Note: Sprites only.
+    uint32 FirstEntry;          // Note: Into the sorted entries.
+    uint32 EntryCount;
+};
+
+struct win32_render_command_stats
+{
+    uint64 Frames;              // Note: That had any commands.
+    uint64 Commands;
+    uint64 Dropped;             // Note: Didn't fit in the push buffer.
+    uint64 Batches;
+    uint64 UnsortedBatches;     // Note: What the same rule would have made of the commands in push order.
+    uint64 StateChanges;        // Note: Pipeline or texture switches from one batch to the next.
+    uint64 SortPasses;
+    uint64 SkippedPasses;
+    uint32 MaxCommands;
+    real32 TotalSortMS;         // Note: Sorting and batching.
+    real32 MaxSortMS;
+};
+
+struct win32_render_commands
+{
+    game_render_commands* Game;
+    uint32 MaxEntries;
+    uint32 MaxSprites;
+    uint32 MaxRectangles;
+
+    // Note: Two halves of MaxEntries, the sort goes back and forth between them.
+    render_sort_entry* SortEntries;
+    render_sort_entry* Sorted;
+    uint32 SortedCount;
+
+    win32_render_batch* Batches;
+    uint32 BatchCount;
+
+    // Note: For the Vulkan backend, they have to stay valid until DrawFrame.
+    Vulkan::SpriteEntityColumns Columns;
+    Vulkan::SpriteDefinition* Definitions;
+    Vulkan::ObjectData* Objects;
+
+    win32_render_command_stats Stats;
+};
+
+// Note: Takes the push buffer off the end of the transient storage, before the game ever sees it. If the transient
+// storage is too small for the whole buffer, only the header is taken and its Size is 0, so every push is dropped and
+// the game can tell there's no buffer. Returns false if not even the header fits: GetRenderCommands would point past
+// the storage, so the game must not run.
+internal bool32
+Win32RenderCommandsInit(win32_render_commands* Commands, game_memory* Memory)
+{
+    *Commands = {};
+    uint32 HeaderSize = (sizeof(game_render_commands) + 15) & ~15;
+    if (!Memory->PermanentStorage || Memory->TransientStorageSize < HeaderSize)
+    {
+        return(false);
+    }
+
+    uint32 BufferSize = (Memory->TransientStorageSize >= RENDER_COMMANDS_SIZE) ? (uint32)RENDER_COMMANDS_SIZE : HeaderSize;
+    Memory->TransientStorageSize -= BufferSize;
+    game_render_commands* Game = GetRenderCommands(Memory);
+    *Game = {};
+    Game->Base = (uint8*)Game + HeaderSize;
+    Game->Size = BufferSize - HeaderSize;
+    Game->SortEntryAt = Game->Size;
+    Commands->Game = Game;
+    if (!Game->Size)
+    {
+        return(true);
+    }
+
+    // Note: As many as the smallest entry (a clear) fits, and as many sprites and rectangles as fit.
+    Commands->MaxEntries = Game->Size / (((sizeof(render_entry_clear) + 7) & ~7) + sizeof(render_sort_entry));
+    Commands->MaxSprites = Game->Size / (((sizeof(render_entry_sprite) + 7) & ~7) + sizeof(render_sort_entry));
+    Commands->MaxRectangles = Game->Size / (((sizeof(render_entry_rectangle) + 7) & ~7) + sizeof(render_sort_entry));
+
+    size_t SortSize = 2 * Commands->MaxEntries * sizeof(render_sort_entry);
+    size_t BatchSize = Commands->MaxEntries * sizeof(win32_render_batch);
+    size_t SpriteRowSize = sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(uint32) + sizeof(uint32) + sizeof(Vulkan::SpriteDefinition);
+    size_t SpriteSize = Commands->MaxSprites * SpriteRowSize;
+    size_t ObjectSize = Commands->MaxRectangles * sizeof(Vulkan::ObjectData);
+    uint8* Storage = (uint8*)VirtualAlloc(0, SortSize + BatchSize + SpriteSize + ObjectSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!Storage)
+    {
+        // Note: The game can still push, nothing gets drawn.
+        Commands->MaxEntries = 0;
+        return(true);
+    }
+
+    Commands->SortEntries = (render_sort_entry*)Storage;
+    Commands->Objects = (Vulkan::ObjectData*)(Storage + SortSize);
+    Commands->Batches = (win32_render_batch*)(Storage + SortSize + ObjectSize);
+    Commands->Definitions = (Vulkan::SpriteDefinition*)(Storage + SortSize + ObjectSize + BatchSize);
+    Commands->Columns.Positions = (glm::vec3*)(Commands->Definitions + Commands->MaxSprites);
+    Commands->Columns.Sizes = (glm::vec2*)(Commands->Columns.Positions + Commands->MaxSprites);
+    Commands->Columns.Sprites = (uint32*)(Commands->Columns.Sizes + Commands->MaxSprites);
+    Commands->Columns.Tints = Commands->Columns.Sprites + Commands->MaxSprites;
+    return(true);
+}
+
+internal void
+Win32BeginRenderCommands(win32_render_commands* Commands)
+{
+    game_render_commands* Game = Commands->Game;
+    if (Game)
+    {
+        Game->PushUsed = 0;
+        Game->SortEntryAt = Game->Size;
+        Game->EntryCount = 0;
+        Game->DroppedCount = 0;
+    }
+    Commands->SortedCount = 0;
+    Commands->BatchCount = 0;
+}
+
+inline render_entry_header*
+Win32GetRenderEntry(win32_render_commands* Commands, render_sort_entry* SortEntry)
+{
+    render_entry_header* Result = (render_entry_header*)(Commands->Game->Base + SortEntry->Offset);
+    return(Result);
+}
+
+inline render_texture*
+Win32GetRenderEntryTexture(render_entry_header* Header)
+{
+    render_texture* Result = (Header->Type == RenderPipeline_Sprite) ? ((render_entry_sprite*)Header)->Texture : 0;
+    return(Result);
+}
+
+// Note: Stable, Count entries from Source, which has room for MaxEntries more behind it. Returns where they ended up.
+internal render_sort_entry*
+Win32RadixSortRenderEntries(win32_render_commands* Commands, render_sort_entry* Source, uint32 Count)
+{
+    render_sort_entry* Destination = Source + Commands->MaxEntries;
+
+    uint32 Counts[RENDER_COMMANDS_DIGIT_COUNT][RENDER_COMMANDS_BUCKETS] = {};
+    for (uint32 Index = 0; Index < Count; ++Index)
+    {
+        uint64 Key = Source[Index].Key;
+        for (uint32 Digit = 0; Digit < RENDER_COMMANDS_DIGIT_COUNT; ++Digit)
+        {
+            ++Counts[Digit][(Key >> (Digit * RENDER_COMMANDS_DIGIT_BITS)) & (RENDER_COMMANDS_BUCKETS - 1)];
+        }
+    }
+
+    for (uint32 Digit = 0; Digit < RENDER_COMMANDS_DIGIT_COUNT; ++Digit)
+    {
+        uint32 Shift = Digit * RENDER_COMMANDS_DIGIT_BITS;
+        uint32* DigitCounts = Counts[Digit];
+        if (DigitCounts[(Source[0].Key >> Shift) & (RENDER_COMMANDS_BUCKETS - 1)] == Count)
+        {
+            ++Commands->Stats.SkippedPasses;
+            continue;
+        }
+
+        uint32 Offset = 0;
+        for (uint32 Bucket = 0; Bucket < RENDER_COMMANDS_BUCKETS; ++Bucket)
+        {
+            uint32 BucketCount = DigitCounts[Bucket];
+            DigitCounts[Bucket] = Offset;
+            Offset += BucketCount;
+        }
+
+        for (uint32 Index = 0; Index < Count; ++Index)
+        {
+            uint32 Bucket = (Source[Index].Key >> Shift) & (RENDER_COMMANDS_BUCKETS - 1);
+            Destination[DigitCounts[Bucket]++] = Source[Index];
+        }
+
+        render_sort_entry* Swap = Source;
+        Source = Destination;
+        Destination = Swap;
+        ++Commands->Stats.SortPasses;
+    }
+    return(Source);
+}
+
+// Note: After GameUpdateAndRender, ahead of either backend.
+internal void
+Win32SortRenderCommands(win32_render_commands* Commands)
+{
+    game_render_commands* Game = Commands->Game;
+    if (!Game || !Game->EntryCount || !Commands->MaxEntries)
+    {
+        return;
+    }
+
+    LARGE_INTEGER StartCounter;
+    QueryPerformanceCounter(&StartCounter);
+
+    // Note: The sort entries were pushed down from the end, the copy puts them back in push order so the sort keeps it.
+    uint32 Count = Game->EntryCount;
+    Assert(Count <= Commands->MaxEntries);
+    render_sort_entry* Pushed = (render_sort_entry*)(Game->Base + Game->SortEntryAt);
+    render_sort_entry* Source = Commands->SortEntries;
+    uint32 UnsortedBatches = 0;
+    for (uint32 Index = 0; Index < Count; ++Index)
+    {
+        Source[Index] = Pushed[Count - 1 - Index];
+        if (!Index ||
+            (Source[Index].Key >> RENDER_SORT_MATERIAL_SHIFT) != (Source[Index - 1].Key >> RENDER_SORT_MATERIAL_SHIFT) ||
+            Win32GetRenderEntryTexture(Win32GetRenderEntry(Commands, &Source[Index])) !=
+            Win32GetRenderEntryTexture(Win32GetRenderEntry(Commands, &Source[Index - 1])))
+        {
+            ++UnsortedBatches;
+        }
+    }
+
+    Commands->Sorted = Win32RadixSortRenderEntries(Commands, Source, Count);
+    Commands->SortedCount = Count;
+
+    // Note: Textures that share a sort index sort together but still get batches of their own.
+    uint32 StateChanges = 0;
+    Commands->BatchCount = 0;
+    win32_render_batch* Batch = 0;
+    for (uint32 Index = 0; Index < Count; ++Index)
+    {
+        render_entry_header* Header = Win32GetRenderEntry(Commands, &Commands->Sorted[Index]);
+        uint64 Material = Commands->Sorted[Index].Key >> RENDER_SORT_MATERIAL_SHIFT;
+        render_texture* Texture = Win32GetRenderEntryTexture(Header);
+        if (!Batch || Batch->Material != Material || Batch->Texture != Texture)
+        {
+            if (Batch && (Batch->Pipeline != Header->Type || Batch->Texture != Texture))
+            {
+                ++StateChanges;
+            }
+
+            Batch = &Commands->Batches[Commands->BatchCount++];
+            Batch->Material = Material;
+            Batch->Pipeline = Header->Type;
+            Batch->Texture = Texture;
+            Batch->FirstEntry = Index;
+            Batch->EntryCount = 0;
+        }
+        ++Batch->EntryCount;
+    }
+
+    real32 SortMS = Vulkan::MillisecondsSince(StartCounter);
+    win32_render_command_stats* Stats = &Commands->Stats;
+    ++Stats->Frames;
+    Stats->Commands += Count;
+    Stats->Dropped += Game->DroppedCount;
+    Stats->Batches += Commands->BatchCount;
+    Stats->UnsortedBatches += UnsortedBatches;
+    Stats->StateChanges += StateChanges;
+    if (Count > Stats->MaxCommands)
+    {
+        Stats->MaxCommands = Count;
+    }
+    Stats->TotalSortMS += SortMS;
+    if (SortMS > Stats->MaxSortMS)
+    {
+        Stats->MaxSortMS = SortMS;
+    }
+}
+
+// Note: RGBA8 to the back buffer's BGRX, each channel scaled by the tint's.
+inline uint32
+Win32RenderCommandPixel(uint32 Color, uint32 Tint)
+{
+    uint32 R = (((Color >> 0) & 0xFF) * ((Tint >> 0) & 0xFF) + 0xFF) >> 8;
+    uint32 G = (((Color >> 8) & 0xFF) * ((Tint >> 8) & 0xFF) + 0xFF) >> 8;
+    uint32 B = (((Color >> 16) & 0xFF) * ((Tint >> 16) & 0xFF) + 0xFF) >> 8;
+    return((R << 16) | (G << 8) | B);
+}
+
+// Note: The quad's edges in pixels, and the pixels whose centers it covers, clipped to the buffer.
+internal bool32
+Win32GetRenderCommandRect(game_offscreen_buffer* Buffer, real32 X, real32 Y, real32 Width, real32 Height,
+                          real32* Left, real32* Top, real32* Right, real32* Bottom,
+                          int32* MinX, int32* MinY, int32* MaxX, int32* MaxY)
+{
+    real32 HalfWidth = 0.5f * (real32)Buffer->Width;
+    real32 HalfHeight = 0.5f * (real32)Buffer->Height;
+    *Left = (X - 0.5f * Width + 1.0f) * HalfWidth;
+    *Right = (X + 0.5f * Width + 1.0f) * HalfWidth;
+    *Top = (1.0f - (Y + 0.5f * Height)) * HalfHeight;
+    *Bottom = (1.0f - (Y - 0.5f * Height)) * HalfHeight;
+
+    *MinX = (*Left > 0.0f) ? (int32)ceilf(*Left - 0.5f) : 0;
+    *MinY = (*Top > 0.0f) ? (int32)ceilf(*Top - 0.5f) : 0;
+    *MaxX = (*Right < (real32)Buffer->Width) ? (int32)ceilf(*Right - 0.5f) : Buffer->Width;
+    *MaxY = (*Bottom < (real32)Buffer->Height) ? (int32)ceilf(*Bottom - 0.5f) : Buffer->Height;
+    return(*MinX < *MaxX && *MinY < *MaxY);
+}
+
+internal void
+Win32DrawRenderRectangle(game_offscreen_buffer* Buffer, render_entry_rectangle* Entry)
+{
+    real32 Left, Top, Right, Bottom;
+    int32 MinX, MinY, MaxX, MaxY;
+    if (!Win32GetRenderCommandRect(Buffer, Entry->X, Entry->Y, Entry->Width, Entry->Height,
+                                   &Left, &Top, &Right, &Bottom, &MinX, &MinY, &MaxX, &MaxY))
+    {
+        return;
+    }
+
+    uint32 Pixel = Win32RenderCommandPixel(Entry->Color, 0xFFFFFFFF);
+    uint8* Row = (uint8*)Buffer->Memory + MinY * Buffer->Pitch;
+    for (int32 Y = MinY; Y < MaxY; ++Y)
+    {
+        uint32* Destination = (uint32*)Row + MinX;
+        for (int32 X = MinX; X < MaxX; ++X)
+        {
+            *Destination++ = Pixel;
+        }
+        Row += Buffer->Pitch;
+    }
+}
+
+internal void
+Win32DrawRenderSprite(game_offscreen_buffer* Buffer, render_entry_sprite* Entry)
+{
+    render_texture* Texture = Entry->Texture;
+    real32 Left, Top, Right, Bottom;
+    int32 MinX, MinY, MaxX, MaxY;
+    if (!Texture->Pixels || !Texture->Width || !Texture->Height ||
+        !Win32GetRenderCommandRect(Buffer, Entry->X, Entry->Y, Entry->Width, Entry->Height,
+                                   &Left, &Top, &Right, &Bottom, &MinX, &MinY, &MaxX, &MaxY))
+    {
+        return;
+    }
+
+    // Note: Texels per pixel, from the left and top edges.
+    real32 TexelsPerX = (Entry->UVRect[2] - Entry->UVRect[0]) * (real32)Texture->Width / (Right - Left);
+    real32 TexelsPerY = (Entry->UVRect[3] - Entry->UVRect[1]) * (real32)Texture->Height / (Bottom - Top);
+    real32 FirstU = Entry->UVRect[0] * (real32)Texture->Width + ((real32)MinX + 0.5f - Left) * TexelsPerX;
+    real32 FirstV = Entry->UVRect[1] * (real32)Texture->Height + ((real32)MinY + 0.5f - Top) * TexelsPerY;
+    int32 LastTexelX = (int32)Texture->Width - 1;
+    int32 LastTexelY = (int32)Texture->Height - 1;
+
+    uint8* Row = (uint8*)Buffer->Memory + MinY * Buffer->Pitch;
+    real32 V = FirstV;
+    for (int32 Y = MinY; Y < MaxY; ++Y)
+    {
+        int32 TexelY = (int32)V;
+        TexelY = (TexelY < 0) ? 0 : (TexelY > LastTexelY) ? LastTexelY : TexelY;
+        uint32* TexelRow = Texture->Pixels + TexelY * Texture->Width;
+
+        uint32* Destination = (uint32*)Row + MinX;
+        real32 U = FirstU;
+        for (int32 X = MinX; X < MaxX; ++X)
+        {
+            int32 TexelX = (int32)U;
+            TexelX = (TexelX < 0) ? 0 : (TexelX > LastTexelX) ? LastTexelX : TexelX;
+            uint32 Texel = TexelRow[TexelX];
+            if ((Texel >> 24) >= 0x80)
+            {
+                *Destination = Win32RenderCommandPixel(Texel, Entry->Tint);
+            }
+            ++Destination;
+            U += TexelsPerX;
+        }
+        Row += Buffer->Pitch;
+        V += TexelsPerY;
+    }
+}
+
+// Note: Into the game's back buffer, before it's presented.
+internal void
+Win32RenderBatchesSoftware(win32_render_commands* Commands, game_offscreen_buffer* Buffer)
+{
+    if (!Commands->SortedCount || !Buffer->Memory || Buffer->BytesPerPixel != 4)
+    {
+        return;
+    }
+
+    for (uint32 BatchIndex = 0; BatchIndex < Commands->BatchCount; ++BatchIndex)
+    {
+        win32_render_batch* Batch = &Commands->Batches[BatchIndex];
+        for (uint32 Index = Batch->FirstEntry; Index < Batch->FirstEntry + Batch->EntryCount; ++Index)
+        {
+            render_entry_header* Header = Win32GetRenderEntry(Commands, &Commands->Sorted[Index]);
+            switch (Batch->Pipeline)
+            {
+                case RenderPipeline_Clear:
+                {
+                    uint32 Pixel = Win32RenderCommandPixel(((render_entry_clear*)Header)->Color, 0xFFFFFFFF);
+                    uint8* Row = (uint8*)Buffer->Memory;
+                    for (int32 Y = 0; Y < Buffer->Height; ++Y)
+                    {
+                        uint32* Destination = (uint32*)Row;
+                        for (int32 X = 0; X < Buffer->Width; ++X)
+                        {
+                            *Destination++ = Pixel;
+                        }
+                        Row += Buffer->Pitch;
+                    }
+                } break;
+
+                case RenderPipeline_Rectangle:
+                {
+                    Win32DrawRenderRectangle(Buffer, (render_entry_rectangle*)Header);
+                } break;
+
+                case RenderPipeline_Sprite:
+                {
+                    Win32DrawRenderSprite(Buffer, (render_entry_sprite*)Header);
+                } break;
+            }
+        }
+    }
+}
+
+// Note: Hands the batches to the next DrawFrame. Registers new textures, so it can throw like the renderer does.
+internal void
+Win32SubmitRenderBatches(win32_render_commands* Commands, Vulkan::HelloTriangleApplication* VulkanApp)
+{
+    uint32 SpriteCount = 0;
+    uint32 ObjectCount = 0;
+    for (uint32 BatchIndex = 0; BatchIndex < Commands->BatchCount; ++BatchIndex)
+    {
+        win32_render_batch* Batch = &Commands->Batches[BatchIndex];
+        render_texture* Texture = Batch->Texture;
+        if (Batch->Pipeline == RenderPipeline_Sprite)
+        {
+            if (!Texture->RendererHandle)
+            {
+                uint32 ID = VulkanApp->RegisterTexture(Texture->Pixels, Texture->Width, Texture->Height);
+                Texture->RendererHandle = (ID == VULKAN_BINDLESS_INVALID_ID) ? RENDER_COMMANDS_TEXTURE_FAILED : ID + 1;
+            }
+            if (Texture->RendererHandle == RENDER_COMMANDS_TEXTURE_FAILED)
+            {
+                continue;
+            }
+        }
+
+        for (uint32 Index = Batch->FirstEntry; Index < Batch->FirstEntry + Batch->EntryCount; ++Index)
+        {
+            render_entry_header* Header = Win32GetRenderEntry(Commands, &Commands->Sorted[Index]);
+            if (Batch->Pipeline == RenderPipeline_Sprite && SpriteCount < Commands->MaxSprites)
+            {
+                render_entry_sprite* Entry = (render_entry_sprite*)Header;
+                uint32 Row = SpriteCount++;
+                Commands->Columns.Positions[Row] = glm::vec3(Entry->X, Entry->Y, Entry->Z);
+                Commands->Columns.Sizes[Row] = glm::vec2(Entry->Width, Entry->Height);
+                Commands->Columns.Sprites[Row] = Row;
+                Commands->Columns.Tints[Row] = Entry->Tint;
+
+                Vulkan::SpriteDefinition* Definition = &Commands->Definitions[Row];
+                Definition->Atlas = 0;
+                Definition->UVRect = glm::vec4(Entry->UVRect[0], Entry->UVRect[1], Entry->UVRect[2], Entry->UVRect[3]);
+                Definition->Texture = Texture->RendererHandle - 1;
+            }
+            else if (Batch->Pipeline == RenderPipeline_Rectangle && ObjectCount < Commands->MaxRectangles)
+            {
+                render_entry_rectangle* Entry = (render_entry_rectangle*)Header;
+                Vulkan::ObjectData* Object = &Commands->Objects[ObjectCount++];
+                Object->Model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(Entry->X, Entry->Y, Entry->Z)),
+                                           glm::vec3(Entry->Width, Entry->Height, 1.0f));
+                Object->Color = glm::vec4((real32)((Entry->Color >> 0) & 0xFF), (real32)((Entry->Color >> 8) & 0xFF),
+                                          (real32)((Entry->Color >> 16) & 0xFF), (real32)((Entry->Color >> 24) & 0xFF)) / 255.0f;
+            }
+        }
+    }
+
+    if (SpriteCount)
+    {
+        Commands->Columns.Count = SpriteCount;
+        VulkanApp->SubmitSprites(&Commands->Columns, Commands->Definitions);
+    }
+    if (ObjectCount)
+    {
+        VulkanApp->SubmitObjects(Commands->Objects, ObjectCount, glm::vec4(1.0f));
+    }
+}
+
+internal void
+Win32RenderCommandsOutput(win32_render_commands* Commands)
+{
+    win32_render_command_stats* Stats = &Commands->Stats;
+    if (!Stats->Frames)
+    {
+        return;
+    }
+
+    double Frames = (double)Stats->Frames;
+    char Text[512];
+    snprintf(Text, sizeof(Text),
+        "render commands: %llu frames, %.0f commands per frame avg (%u max, %llu dropped)\n"
+        "batches: %.1f per frame sorted, %.1f in push order, %.1f state changes per frame\n"
+        "sort: %.3fms per frame avg, %.3fms max, %llu radix passes, %llu skipped\n",
+        Stats->Frames, (double)Stats->Commands / Frames, Stats->MaxCommands, Stats->Dropped,
+        (double)Stats->Batches / Frames, (double)Stats->UnsortedBatches / Frames, (double)Stats->StateChanges / Frames,
+        Stats->TotalSortMS / Frames, Stats->MaxSortMS, Stats->SortPasses, Stats->SkippedPasses);
+    OutputDebugStringA(Text);
+}